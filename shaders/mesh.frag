@@ -1,11 +1,18 @@
 #version 450
 
+// Set 1 is the material; untextured draws get a 1x1 white texture.
+layout(set = 1, binding = 0) uniform sampler2D base_color;
+
 layout(location = 0) in vec3 vNormal;
 layout(location = 1) in vec2 vUV;
 
 layout(location = 0) out vec4 outColor;
 
+const vec3 kLightDir = normalize(vec3(0.4, 0.8, 0.45)); // object space, like vNormal
+
 void main() {
   vec3 n = normalize(vNormal);
-  outColor = vec4(abs(n), 1.0);
+  float lambert = 0.3 + 0.7 * max(dot(n, kLightDir), 0.0);
+  vec4 albedo = texture(base_color, vUV);
+  outColor = vec4(albedo.rgb * lambert, albedo.a);
 }
@@ -1,18 +1,19 @@
 #version 450
 
-layout(push_constant) uniform PC {
-  mat4 mvp;
-} pc;
+layout(set = 0, binding = 0) uniform FrameGlobals {
+  mat4 view_proj;
+} g;
 
 layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUV;
+layout(location = 3) in mat4 inModel;  // per instance
 
 layout(location = 0) out vec3 vNormal;
 layout(location = 1) out vec2 vUV;
 
 void main() {
-  gl_Position = pc.mvp * vec4(inPos, 1.0);
+  gl_Position = g.view_proj * (inModel * vec4(inPos, 1.0));
   vNormal = inNormal;
   vUV = inUV;
 }
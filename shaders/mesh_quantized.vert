@@ -0,0 +1,29 @@
+#version 450
+
+// VertexQuantized: the SNORM position dequant is folded into each instance's
+// model matrix on the CPU.
+layout(set = 0, binding = 0) uniform FrameGlobals {
+  mat4 view_proj;
+} g;
+
+layout(location = 0) in vec4 inPos;    // R16G16B16A16_SNORM, w unused
+layout(location = 1) in vec2 inNormal; // R16G16_SNORM, octahedral
+layout(location = 2) in vec2 inUV;     // R16G16_SFLOAT
+layout(location = 3) in mat4 inModel;  // per instance
+
+layout(location = 0) out vec3 vNormal;
+layout(location = 1) out vec2 vUV;
+
+vec3 decode_octahedral(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += (n.x >= 0.0) ? -t : t;
+  n.y += (n.y >= 0.0) ? -t : t;
+  return normalize(n);
+}
+
+void main() {
+  gl_Position = g.view_proj * (inModel * vec4(inPos.xyz, 1.0));
+  vNormal = decode_octahedral(inNormal);
+  vUV = inUV;
+}
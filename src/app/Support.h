@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "gfx/Vertex.h"
+
+// Helpers shared by the executables (app, bench). Header-only, so the
+// GFX_SHADER_*_PATH definitions each executable is built with apply.
+namespace app {
+
+[[noreturn]] inline void die(char const* msg) {
+  std::fprintf(stderr, "%s\n", msg);
+  std::fflush(stderr);
+  std::exit(EXIT_FAILURE);
+}
+
+inline char const* shader_vert_path() {
+#ifdef GFX_SHADER_VERT_PATH
+  return GFX_SHADER_VERT_PATH;
+#else
+  return "shaders/compiled/mesh.vert.spv";
+#endif
+}
+
+inline char const* shader_vert_quantized_path() {
+#ifdef GFX_SHADER_VERT_QUANTIZED_PATH
+  return GFX_SHADER_VERT_QUANTIZED_PATH;
+#else
+  return "shaders/compiled/mesh_quantized.vert.spv";
+#endif
+}
+
+inline char const* shader_vert_path(gfx::VertexFormat format) {
+  return (format == gfx::VertexFormat::Quantized) ? shader_vert_quantized_path() : shader_vert_path();
+}
+
+inline char const* shader_frag_path() {
+#ifdef GFX_SHADER_FRAG_PATH
+  return GFX_SHADER_FRAG_PATH;
+#else
+  return "shaders/compiled/mesh.frag.spv";
+#endif
+}
+
+inline char const* shader_cull_path() {
+#ifdef GFX_SHADER_CULL_PATH
+  return GFX_SHADER_CULL_PATH;
+#else
+  return "shaders/compiled/cull.comp.spv";
+#endif
+}
+
+inline char const* shader_depth_pyramid_path() {
+#ifdef GFX_SHADER_DEPTH_PYRAMID_PATH
+  return GFX_SHADER_DEPTH_PYRAMID_PATH;
+#else
+  return "shaders/compiled/depth_pyramid.comp.spv";
+#endif
+}
+
+} // namespace app
@@ -0,0 +1,150 @@
+#include "assets/MappedFile.h"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace assets {
+
+namespace {
+
+[[noreturn]] void fail(std::string const& msg) {
+  throw std::runtime_error(msg);
+}
+
+} // namespace
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  close();
+
+  data_ = other.data_;
+  size_ = other.size_;
+
+  other.data_ = nullptr;
+  other.size_ = 0;
+
+  return *this;
+}
+
+#if defined(_WIN32)
+
+void MappedFile::open(std::string const& path) {
+  if (data_ != nullptr) {
+    fail("MappedFile::open: already open");
+  }
+
+  HANDLE const file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    fail("MappedFile: failed to open: " + path);
+  }
+
+  LARGE_INTEGER size{};
+  if (GetFileSizeEx(file, &size) == 0) {
+    CloseHandle(file);
+    fail("MappedFile: failed to stat: " + path);
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return;
+  }
+
+  HANDLE const mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) {
+    fail("MappedFile: CreateFileMapping failed: " + path);
+  }
+
+  void const* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping); // the view keeps the mapping alive
+  if (view == nullptr) {
+    fail("MappedFile: MapViewOfFile failed: " + path);
+  }
+
+  data_ = static_cast<char const*>(view);
+  size_ = static_cast<std::size_t>(size.QuadPart);
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+    data_ = nullptr;
+  }
+  size_ = 0;
+}
+
+#else
+
+void MappedFile::open(std::string const& path) {
+  if (data_ != nullptr) {
+    fail("MappedFile::open: already open");
+  }
+
+  int const fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fail("MappedFile: failed to open: " + path);
+  }
+
+  struct stat st{};
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    fail("MappedFile: failed to stat: " + path);
+  }
+  if (st.st_size == 0) {
+    ::close(fd);
+    return;
+  }
+
+  std::size_t const size = static_cast<std::size_t>(st.st_size);
+  void* const addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping holds its own reference
+  if (addr == MAP_FAILED) {
+    fail("MappedFile: mmap failed: " + path);
+  }
+
+  // Parsers walk the file front to back; let the kernel read ahead aggressively.
+  (void)::madvise(addr, size, MADV_SEQUENTIAL);
+
+  data_ = static_cast<char const*>(addr);
+  size_ = size;
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<char*>(data_), size_);
+    data_ = nullptr;
+  }
+  size_ = 0;
+}
+
+#endif
+
+} // namespace assets
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace assets {
+
+// Read-only view of a whole file. Uses mmap / MapViewOfFile; an empty file maps to
+// data() == nullptr, size() == 0.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  void open(std::string const& path);
+  void close();
+
+  char const* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  char const* begin() const { return data_; }
+  char const* end() const { return data_ + size_; }
+
+private:
+  char const* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+} // namespace assets
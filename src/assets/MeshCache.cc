@@ -0,0 +1,323 @@
+#include "assets/MeshCache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace assets {
+
+namespace {
+
+[[noreturn]] void fail(std::string const& msg) {
+  throw std::runtime_error(msg);
+}
+
+constexpr char kMagic[8] = {'M', 'E', 'S', 'H', 'C', 'O', 'O', 'K'};
+constexpr std::uint64_t kBlobAlignment = 64;
+
+std::uint64_t align_up(std::uint64_t v, std::uint64_t a) {
+  return ((v + a - 1U) / a) * a;
+}
+
+std::uint64_t rotl(std::uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+std::int64_t file_mtime(std::filesystem::path const& p, std::error_code& ec) {
+  auto const t = std::filesystem::last_write_time(p, ec);
+  return ec ? 0 : static_cast<std::int64_t>(t.time_since_epoch().count());
+}
+
+} // namespace
+
+struct MeshCache::Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t vertex_layout;
+  std::uint32_t vertex_stride;
+  std::uint32_t index_size;
+  std::uint64_t vertex_count;
+  std::uint64_t index_count;
+  std::uint64_t vertex_offset; // from file start
+  std::uint64_t index_offset;
+  std::uint64_t source_size;
+  std::int64_t source_mtime;
+  std::uint64_t source_hash;
+  float aabb_min[3];
+  float aabb_max[3];
+  float sphere[4]; // center, radius
+  std::uint32_t lod_count;
+  std::uint32_t pad;
+  std::uint64_t lod_offset;
+  std::uint64_t reserved[1];
+};
+
+std::uint64_t hash_bytes(void const* data, std::size_t size) {
+  constexpr std::uint64_t k1 = 0x9e3779b185ebca87ULL;
+  constexpr std::uint64_t k2 = 0xc2b2ae3d27d4eb4fULL;
+
+  auto const* p = static_cast<unsigned char const*>(data);
+  std::uint64_t h = 0x27d4eb2f165667c5ULL ^ (static_cast<std::uint64_t>(size) * k1);
+
+  std::size_t i = 0;
+  for (; i + 8U <= size; i += 8U) {
+    std::uint64_t w = 0;
+    std::memcpy(&w, p + i, 8);
+    h = rotl(h ^ (w * k2), 31) * k1;
+  }
+
+  std::uint64_t tail = 0;
+  for (std::size_t j = 0; i + j < size; ++j) {
+    tail |= static_cast<std::uint64_t>(p[i + j]) << (8U * j);
+  }
+  h = rotl(h ^ (tail * k2), 31) * k1;
+
+  // murmur3 finalizer
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+MeshCache::~MeshCache() {
+}
+
+MeshCache::MeshCache(MeshCache&& other) noexcept {
+  *this = std::move(other);
+}
+
+MeshCache& MeshCache::operator=(MeshCache&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  file_ = std::move(other.file_);
+  header_ = other.header_;
+  other.header_ = nullptr;
+
+  return *this;
+}
+
+SourceStamp MeshCache::stamp(std::string const& source_path) {
+  MappedFile file{};
+  file.open(source_path);
+
+  SourceStamp s{};
+  s.size = file.size();
+  s.hash = hash_bytes(file.data(), file.size());
+
+  std::error_code ec;
+  s.mtime = file_mtime(source_path, ec);
+  return s;
+}
+
+void MeshCache::write(std::string const& path, ObjIndexedMesh const& mesh, SourceStamp const& source) {
+  static_assert(sizeof(Header) == 144, "MeshCache header layout changed; bump kVersion");
+
+  Header h{};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  h.vertex_layout = static_cast<std::uint32_t>(VertexLayout::PNUV32);
+  h.vertex_stride = static_cast<std::uint32_t>(sizeof(VertexPNUV));
+  h.index_size = static_cast<std::uint32_t>(sizeof(std::uint32_t));
+  h.vertex_count = mesh.vertices.size();
+  h.index_count = mesh.indices.size();
+  h.vertex_offset = align_up(sizeof(Header), kBlobAlignment);
+  h.index_offset = align_up(h.vertex_offset + h.vertex_count * h.vertex_stride, kBlobAlignment);
+  h.source_size = source.size;
+  h.source_mtime = source.mtime;
+  h.source_hash = source.hash;
+  for (int a = 0; a < 3; ++a) {
+    h.aabb_min[a] = mesh.bounds.aabb_min[a];
+    h.aabb_max[a] = mesh.bounds.aabb_max[a];
+    h.sphere[a] = mesh.bounds.sphere_center[a];
+  }
+  h.sphere[3] = mesh.bounds.sphere_radius;
+  h.lod_count = static_cast<std::uint32_t>(mesh.lods.size());
+  h.lod_offset = align_up(h.index_offset + h.index_count * h.index_size, kBlobAlignment);
+
+  std::string const tmp = path + ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+      fail("MeshCache: failed to create: " + tmp);
+    }
+
+    char const zeros[kBlobAlignment] = {};
+    auto pad_to = [&](std::uint64_t offset) {
+      auto const at = static_cast<std::uint64_t>(ofs.tellp());
+      if (offset > at) {
+        ofs.write(zeros, static_cast<std::streamsize>(offset - at));
+      }
+    };
+
+    ofs.write(reinterpret_cast<char const*>(&h), sizeof(h));
+    pad_to(h.vertex_offset);
+    ofs.write(reinterpret_cast<char const*>(mesh.vertices.data()),
+              static_cast<std::streamsize>(mesh.vertices.size() * sizeof(VertexPNUV)));
+    pad_to(h.index_offset);
+    ofs.write(reinterpret_cast<char const*>(mesh.indices.data()),
+              static_cast<std::streamsize>(mesh.indices.size() * sizeof(std::uint32_t)));
+    pad_to(h.lod_offset);
+    ofs.write(reinterpret_cast<char const*>(mesh.lods.data()),
+              static_cast<std::streamsize>(mesh.lods.size() * sizeof(MeshLod)));
+
+    ofs.flush();
+    if (!ofs) {
+      fail("MeshCache: write failed: " + tmp);
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+    fail("MeshCache: failed to move cache into place: " + path);
+  }
+}
+
+bool MeshCache::open(std::string const& path) {
+  close();
+
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec)) {
+    return false;
+  }
+
+  file_.open(path);
+  if (file_.size() < sizeof(Header)) {
+    close();
+    return false;
+  }
+
+  Header const* h = reinterpret_cast<Header const*>(file_.data());
+
+  bool ok = std::memcmp(h->magic, kMagic, sizeof(kMagic)) == 0
+         && h->version == kVersion
+         && h->vertex_layout == static_cast<std::uint32_t>(VertexLayout::PNUV32)
+         && h->vertex_stride == sizeof(VertexPNUV)
+         && h->index_size == sizeof(std::uint32_t)
+         && h->vertex_offset % kBlobAlignment == 0U
+         && h->index_offset % kBlobAlignment == 0U;
+
+  // bounds, written to survive hostile counts without overflowing
+  std::uint64_t const file_size = file_.size();
+  ok = ok
+    && h->vertex_offset <= file_size
+    && h->vertex_count <= (file_size - h->vertex_offset) / h->vertex_stride
+    && h->index_offset <= file_size
+    && h->index_count <= (file_size - h->index_offset) / h->index_size
+    && h->vertex_offset + h->vertex_count * h->vertex_stride <= h->index_offset
+    && h->lod_offset % kBlobAlignment == 0U
+    && h->lod_offset <= file_size
+    && h->lod_count <= (file_size - h->lod_offset) / sizeof(MeshLod)
+    && h->index_offset + h->index_count * h->index_size <= h->lod_offset;
+
+  if (ok) {
+    auto const* lods = reinterpret_cast<MeshLod const*>(file_.data() + h->lod_offset);
+    for (std::uint32_t i = 0; i < h->lod_count && ok; ++i) {
+      ok = lods[i].first_index <= h->index_count && lods[i].index_count <= h->index_count - lods[i].first_index;
+    }
+  }
+
+  if (ok) {
+    // one pass over the blob keeps a corrupt index from reading past the vertices
+    auto const* indices = reinterpret_cast<std::uint32_t const*>(file_.data() + h->index_offset);
+    for (std::uint64_t i = 0; i < h->index_count && ok; ++i) {
+      ok = indices[i] < h->vertex_count;
+    }
+  }
+
+  if (!ok) {
+    close();
+    return false;
+  }
+
+  header_ = h;
+  return true;
+}
+
+void MeshCache::close() {
+  header_ = nullptr;
+  file_.close();
+}
+
+bool MeshCache::matches(std::string const& source_path) const {
+  if (header_ == nullptr) {
+    return false;
+  }
+
+  std::error_code ec;
+  std::uint64_t const size = std::filesystem::file_size(source_path, ec);
+  if (ec) {
+    // no source next to the cache: cache-only install
+    return true;
+  }
+  if (size != header_->source_size) {
+    return false;
+  }
+
+  std::int64_t const mtime = file_mtime(source_path, ec);
+  if (!ec && mtime == header_->source_mtime) {
+    return true;
+  }
+
+  // touched but maybe not changed (checkout, copy): compare contents
+  return stamp(source_path).hash == header_->source_hash;
+}
+
+MeshCache::VertexLayout MeshCache::vertex_layout() const {
+  return (header_ != nullptr) ? static_cast<VertexLayout>(header_->vertex_layout) : VertexLayout::PNUV32;
+}
+
+std::uint32_t MeshCache::vertex_stride() const {
+  return (header_ != nullptr) ? header_->vertex_stride : 0U;
+}
+
+std::span<VertexPNUV const> MeshCache::vertices() const {
+  if (header_ == nullptr) {
+    return {};
+  }
+  auto const* v = reinterpret_cast<VertexPNUV const*>(file_.data() + header_->vertex_offset);
+  return {v, static_cast<std::size_t>(header_->vertex_count)};
+}
+
+std::span<std::uint32_t const> MeshCache::indices() const {
+  if (header_ == nullptr) {
+    return {};
+  }
+  auto const* i = reinterpret_cast<std::uint32_t const*>(file_.data() + header_->index_offset);
+  return {i, static_cast<std::size_t>(header_->index_count)};
+}
+
+std::span<MeshLod const> MeshCache::lods() const {
+  if (header_ == nullptr) {
+    return {};
+  }
+  auto const* l = reinterpret_cast<MeshLod const*>(file_.data() + header_->lod_offset);
+  return {l, static_cast<std::size_t>(header_->lod_count)};
+}
+
+MeshBounds MeshCache::bounds() const {
+  MeshBounds b{};
+  if (header_ == nullptr) {
+    return b;
+  }
+  for (int a = 0; a < 3; ++a) {
+    b.aabb_min[a] = header_->aabb_min[a];
+    b.aabb_max[a] = header_->aabb_max[a];
+    b.sphere_center[a] = header_->sphere[a];
+  }
+  b.sphere_radius = header_->sphere[3];
+  return b;
+}
+
+} // namespace assets
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "assets/MappedFile.h"
+#include "assets/ObjLoader.h"
+
+namespace assets {
+
+// Identifies the OBJ a cache was cooked from. size + mtime is the fast staleness
+// check; the content hash settles it when only the timestamp moved.
+struct SourceStamp {
+  std::uint64_t size = 0;
+  std::int64_t mtime = 0;  // std::filesystem::file_time_type ticks
+  std::uint64_t hash = 0;  // content hash of the whole file
+};
+
+// Binary mesh container:
+//   Header (incl. MeshBounds) | vertex blob (VertexPNUV, stride in header)
+//   | index blob (u32, every LOD level) | LOD table (MeshLod)
+// Blobs are 64-byte aligned so a mapped file can be handed to the GPU upload as is.
+class MeshCache {
+public:
+  static constexpr std::uint32_t kVersion = 3;
+
+  enum class VertexLayout : std::uint32_t {
+    PNUV32 = 0, // float pos[3], normal[3], uv[2] -- matches gfx::Vertex
+  };
+
+public:
+  MeshCache() = default;
+  ~MeshCache();
+
+  MeshCache(MeshCache const&) = delete;
+  MeshCache& operator=(MeshCache const&) = delete;
+
+  MeshCache(MeshCache&& other) noexcept;
+  MeshCache& operator=(MeshCache&& other) noexcept;
+
+  // Offline / first run. Writes to a temporary file and renames it into place.
+  static void write(std::string const& path, ObjIndexedMesh const& mesh, SourceStamp const& source);
+
+  static SourceStamp stamp(std::string const& source_path);
+
+  // Maps `path` and validates header, blob bounds and every index against the
+  // vertex count; returns false if the file is missing, from another version,
+  // or malformed.
+  bool open(std::string const& path);
+  void close();
+
+  bool is_open() const { return header_ != nullptr; }
+
+  // Fast path compares size + mtime; hashes the source only when those disagree.
+  bool matches(std::string const& source_path) const;
+
+  VertexLayout vertex_layout() const;
+  std::uint32_t vertex_stride() const;
+
+  std::span<VertexPNUV const> vertices() const;
+  std::span<std::uint32_t const> indices() const;
+
+  MeshBounds bounds() const;
+
+  // Empty for meshes cooked without build_lods().
+  std::span<MeshLod const> lods() const;
+
+private:
+  struct Header;
+
+  MappedFile file_{};
+  Header const* header_ = nullptr;
+};
+
+// 64-bit content hash, word-at-a-time (not cryptographic).
+std::uint64_t hash_bytes(void const* data, std::size_t size);
+
+} // namespace assets
@@ -0,0 +1,196 @@
+#include "assets/MeshOptimize.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace assets {
+
+namespace {
+
+[[noreturn]] void fail(std::string const& msg) {
+  throw std::runtime_error(msg);
+}
+
+constexpr std::uint32_t kNoVertex = 0xffffffffU;
+
+void check_indices(std::span<std::uint32_t const> indices, std::size_t vertex_count, char const* who) {
+  if ((indices.size() % 3U) != 0U) {
+    fail(std::string(who) + ": index count is not a multiple of 3");
+  }
+  for (std::uint32_t const i : indices) {
+    if (i >= vertex_count) {
+      fail(std::string(who) + ": index out of range");
+    }
+  }
+}
+
+// Per-vertex triangle lists in one flat array (CSR).
+struct Adjacency {
+  std::vector<std::uint32_t> offsets;   // vertex_count + 1
+  std::vector<std::uint32_t> triangles;
+
+  void build(std::span<std::uint32_t const> indices, std::size_t vertex_count) {
+    offsets.assign(vertex_count + 1U, 0U);
+    for (std::uint32_t const v : indices) {
+      ++offsets[v + 1U];
+    }
+    for (std::size_t v = 0; v < vertex_count; ++v) {
+      offsets[v + 1U] += offsets[v];
+    }
+
+    triangles.resize(indices.size());
+    std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      triangles[cursor[indices[i]]++] = static_cast<std::uint32_t>(i / 3U);
+    }
+  }
+};
+
+} // namespace
+
+float compute_acmr(std::span<std::uint32_t const> indices, std::size_t vertex_count, std::uint32_t cache_size) {
+  check_indices(indices, vertex_count, "compute_acmr");
+  if (indices.empty()) {
+    return 0.0f;
+  }
+
+  // A vertex is resident while fewer than cache_size others entered after it.
+  std::vector<std::uint64_t> stamp(vertex_count, 0U);
+  std::uint64_t clock = std::uint64_t{cache_size} + 1U;
+  std::size_t misses = 0;
+
+  for (std::uint32_t const v : indices) {
+    if (clock - stamp[v] > cache_size) {
+      stamp[v] = clock++;
+      ++misses;
+    }
+  }
+
+  return static_cast<float>(misses) / static_cast<float>(indices.size() / 3U);
+}
+
+void optimize_vertex_cache(std::vector<std::uint32_t>& indices, std::size_t vertex_count, std::uint32_t cache_size) {
+  check_indices(indices, vertex_count, "optimize_vertex_cache");
+  if (indices.empty()) {
+    return;
+  }
+
+  std::size_t const tri_count = indices.size() / 3U;
+
+  Adjacency adj{};
+  adj.build(indices, vertex_count);
+
+  std::vector<std::uint32_t> live(vertex_count);
+  for (std::size_t v = 0; v < vertex_count; ++v) {
+    live[v] = adj.offsets[v + 1U] - adj.offsets[v];
+  }
+
+  std::vector<std::uint64_t> cache_time(vertex_count, 0U);
+  std::vector<bool> emitted(tri_count, false);
+  std::vector<std::uint32_t> dead_end;   // recently touched vertices, newest last
+  std::vector<std::uint32_t> candidates; // one-ring of the current fan
+
+  std::vector<std::uint32_t> out;
+  out.reserve(indices.size());
+
+  std::uint64_t time = std::uint64_t{cache_size} + 1U;
+  std::size_t scan = 0; // next vertex to try once the dead-end stack runs dry
+
+  auto skip_dead_end = [&]() -> std::uint32_t {
+    while (!dead_end.empty()) {
+      std::uint32_t const d = dead_end.back();
+      dead_end.pop_back();
+      if (live[d] > 0U) {
+        return d;
+      }
+    }
+    for (; scan < vertex_count; ++scan) {
+      if (live[scan] > 0U) {
+        return static_cast<std::uint32_t>(scan);
+      }
+    }
+    return kNoVertex;
+  };
+
+  std::uint32_t fan = 0;
+  while (fan != kNoVertex) {
+    candidates.clear();
+
+    for (std::uint32_t k = adj.offsets[fan]; k < adj.offsets[fan + 1U]; ++k) {
+      std::uint32_t const t = adj.triangles[k];
+      if (emitted[t]) {
+        continue;
+      }
+      emitted[t] = true;
+
+      for (std::size_t c = 0; c < 3U; ++c) {
+        std::uint32_t const v = indices[t * 3U + c];
+        out.push_back(v);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        if (time - cache_time[v] > cache_size) {
+          cache_time[v] = time++;
+        }
+      }
+    }
+
+    // Prefer the candidate that will still be cached after its remaining fan
+    // is emitted, and among those the one that entered the cache earliest.
+    std::uint32_t best = kNoVertex;
+    std::int64_t best_priority = -1;
+    for (std::uint32_t const v : candidates) {
+      if (live[v] == 0U) {
+        continue;
+      }
+      std::int64_t priority = 0;
+      std::uint64_t const age = time - cache_time[v];
+      if (age + 2U * live[v] <= cache_size) {
+        priority = static_cast<std::int64_t>(age);
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        best = v;
+      }
+    }
+
+    fan = (best != kNoVertex) ? best : skip_dead_end();
+  }
+
+  indices.swap(out);
+}
+
+void optimize_vertex_fetch(std::vector<VertexPNUV>& vertices, std::vector<std::uint32_t>& indices) {
+  check_indices(indices, vertices.size(), "optimize_vertex_fetch");
+
+  std::vector<std::uint32_t> remap(vertices.size(), kNoVertex);
+  std::vector<VertexPNUV> out;
+  out.reserve(vertices.size());
+
+  for (std::uint32_t& i : indices) {
+    if (remap[i] == kNoVertex) {
+      remap[i] = static_cast<std::uint32_t>(out.size());
+      out.push_back(vertices[i]);
+    }
+    i = remap[i];
+  }
+
+  vertices.swap(out);
+}
+
+MeshOptimizeStats optimize_mesh(ObjIndexedMesh& mesh) {
+  MeshOptimizeStats s{};
+  s.acmr_before = compute_acmr(mesh.indices, mesh.vertices.size());
+
+  optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+  optimize_vertex_fetch(mesh.vertices, mesh.indices);
+
+  s.acmr_after = compute_acmr(mesh.indices, mesh.vertices.size());
+  return s;
+}
+
+} // namespace assets
@@ -0,0 +1,483 @@
+#include "assets/MeshSimplify.h"
+
+#include "assets/MeshOptimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace assets {
+
+namespace {
+
+[[noreturn]] void fail(std::string const& msg) {
+  throw std::runtime_error(msg);
+}
+
+constexpr int kMaxPasses = 64;
+
+// Symmetric 4x4 error quadric, upper triangle; evaluates to the area-weighted
+// mean squared distance to the accumulated planes.
+struct Quadric {
+  double xx = 0.0, xy = 0.0, xz = 0.0, xw = 0.0;
+  double yy = 0.0, yz = 0.0, yw = 0.0;
+  double zz = 0.0, zw = 0.0;
+  double ww = 0.0;
+  double weight = 0.0;
+
+  void add_plane(double a, double b, double c, double d, double w) {
+    xx += w * a * a; xy += w * a * b; xz += w * a * c; xw += w * a * d;
+    yy += w * b * b; yz += w * b * c; yw += w * b * d;
+    zz += w * c * c; zw += w * c * d;
+    ww += w * d * d;
+    weight += w;
+  }
+
+  void add(Quadric const& o) {
+    xx += o.xx; xy += o.xy; xz += o.xz; xw += o.xw;
+    yy += o.yy; yz += o.yz; yw += o.yw;
+    zz += o.zz; zw += o.zw;
+    ww += o.ww;
+    weight += o.weight;
+  }
+
+  double eval(float const p[3]) const {
+    double const x = p[0];
+    double const y = p[1];
+    double const z = p[2];
+    double const q = xx * x * x + 2.0 * (xy * x * y + xz * x * z + xw * x)
+                   + yy * y * y + 2.0 * (yz * y * z + yw * y)
+                   + zz * z * z + 2.0 * zw * z
+                   + ww;
+    return (weight > 0.0) ? std::max(q / weight, 0.0) : 0.0;
+  }
+};
+
+struct PositionKey {
+  std::uint32_t bits[3];
+  bool operator==(PositionKey const& o) const {
+    return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2];
+  }
+};
+
+struct PositionHash {
+  std::size_t operator()(PositionKey const& k) const {
+    std::uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (std::uint32_t const b : k.bits) {
+      h = (h ^ b) * 0xff51afd7ed558ccdULL;
+      h ^= h >> 32;
+    }
+    return static_cast<std::size_t>(h);
+  }
+};
+
+// Flat adjacency list: items of key k are items[offsets[k] .. offsets[k + 1]).
+struct Csr {
+  std::vector<std::uint32_t> offsets;
+  std::vector<std::uint32_t> items;
+};
+
+void cross(float const a[3], float const b[3], float const c[3], double n[3]) {
+  double const e1[3] = {double{b[0]} - a[0], double{b[1]} - a[1], double{b[2]} - a[2]};
+  double const e2[3] = {double{c[0]} - a[0], double{c[1]} - a[1], double{c[2]} - a[2]};
+  n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+std::uint64_t edge_key(std::uint32_t a, std::uint32_t b) {
+  return (a < b) ? ((std::uint64_t{a} << 32) | b) : ((std::uint64_t{b} << 32) | a);
+}
+
+class Simplifier {
+public:
+  Simplifier(std::span<VertexPNUV const> vertices, std::span<std::uint32_t const> indices)
+    : vertices_(vertices), tris_(indices.begin(), indices.end()) {
+    build_classes();
+    build_quadrics();
+    lock_borders();
+
+    remap_.resize(vertices_.size());
+    for (std::size_t v = 0; v < remap_.size(); ++v) {
+      remap_[v] = static_cast<std::uint32_t>(v);
+    }
+  }
+
+  std::vector<std::uint32_t> run(std::size_t target_index_count, float& error) {
+    double max_cost = 0.0;
+
+    for (int pass = 0; pass < kMaxPasses && tris_.size() > target_index_count; ++pass) {
+      if (!collapse_pass(target_index_count / 3U, max_cost)) {
+        break;
+      }
+      rebuild_triangles();
+    }
+
+    error = static_cast<float>(std::sqrt(max_cost));
+    return std::move(tris_);
+  }
+
+private:
+  struct Collapse {
+    std::uint32_t from;
+    std::uint32_t to;
+    double cost;
+  };
+
+  float const* position(std::uint32_t cls) const { return vertices_[class_rep_[cls]].pos; }
+
+  // Vertices with bit-identical positions form one class; seams move together.
+  void build_classes() {
+    std::unordered_map<PositionKey, std::uint32_t, PositionHash> lookup;
+    lookup.reserve(vertices_.size());
+    class_of_.resize(vertices_.size());
+
+    for (std::size_t v = 0; v < vertices_.size(); ++v) {
+      PositionKey k{};
+      std::memcpy(k.bits, vertices_[v].pos, sizeof(k.bits));
+      auto const [it, inserted] = lookup.emplace(k, static_cast<std::uint32_t>(class_rep_.size()));
+      if (inserted) {
+        class_rep_.push_back(static_cast<std::uint32_t>(v));
+      }
+      class_of_[v] = it->second;
+    }
+
+    std::size_t const classes = class_rep_.size();
+    wedges_.offsets.assign(classes + 1U, 0U);
+    for (std::uint32_t const c : class_of_) {
+      ++wedges_.offsets[c + 1U];
+    }
+    for (std::size_t c = 0; c < classes; ++c) {
+      wedges_.offsets[c + 1U] += wedges_.offsets[c];
+    }
+    wedges_.items.resize(vertices_.size());
+    std::vector<std::uint32_t> cursor(wedges_.offsets.begin(), wedges_.offsets.end() - 1);
+    for (std::size_t v = 0; v < vertices_.size(); ++v) {
+      wedges_.items[cursor[class_of_[v]]++] = static_cast<std::uint32_t>(v);
+    }
+  }
+
+  void build_quadrics() {
+    quadrics_.assign(class_rep_.size(), Quadric{});
+
+    for (std::size_t t = 0; t < tris_.size(); t += 3U) {
+      std::uint32_t const c[3] = {class_of_[tris_[t]], class_of_[tris_[t + 1U]], class_of_[tris_[t + 2U]]};
+      double n[3]{};
+      cross(position(c[0]), position(c[1]), position(c[2]), n);
+
+      double const len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (!(len > 0.0)) {
+        continue;
+      }
+      n[0] /= len;
+      n[1] /= len;
+      n[2] /= len;
+
+      float const* p = position(c[0]);
+      double const d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+      for (std::uint32_t const k : c) {
+        quadrics_[k].add_plane(n[0], n[1], n[2], d, 0.5 * len);
+      }
+    }
+  }
+
+  // Edges with a single triangle (in position space) are open borders; collapsing
+  // along them would eat into the silhouette.
+  void lock_borders() {
+    locked_.assign(class_rep_.size(), 0U);
+
+    std::vector<std::uint64_t> edges;
+    edges.reserve(tris_.size());
+    for (std::size_t t = 0; t < tris_.size(); t += 3U) {
+      for (std::size_t e = 0; e < 3U; ++e) {
+        std::uint32_t const a = class_of_[tris_[t + e]];
+        std::uint32_t const b = class_of_[tris_[t + (e + 1U) % 3U]];
+        if (a != b) {
+          edges.push_back(edge_key(a, b));
+        }
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (std::size_t i = 0; i < edges.size();) {
+      std::size_t j = i + 1U;
+      while (j < edges.size() && edges[j] == edges[i]) {
+        ++j;
+      }
+      if (j - i == 1U) {
+        locked_[static_cast<std::uint32_t>(edges[i] >> 32)] = 1U;
+        locked_[static_cast<std::uint32_t>(edges[i] & 0xffffffffU)] = 1U;
+      }
+      i = j;
+    }
+  }
+
+  // One round of non-overlapping collapses, cheapest first. Returns false when
+  // nothing could be collapsed.
+  bool collapse_pass(std::size_t target_tris, double& max_cost) {
+    std::size_t const tri_count = tris_.size() / 3U;
+    std::size_t const classes = class_rep_.size();
+
+    // class -> triangles touching it
+    Csr adj{};
+    adj.offsets.assign(classes + 1U, 0U);
+    for (std::uint32_t const v : tris_) {
+      ++adj.offsets[class_of_[v] + 1U];
+    }
+    for (std::size_t c = 0; c < classes; ++c) {
+      adj.offsets[c + 1U] += adj.offsets[c];
+    }
+    adj.items.resize(tris_.size());
+    {
+      std::vector<std::uint32_t> cursor(adj.offsets.begin(), adj.offsets.end() - 1);
+      for (std::size_t i = 0; i < tris_.size(); ++i) {
+        adj.items[cursor[class_of_[tris_[i]]]++] = static_cast<std::uint32_t>(i / 3U);
+      }
+    }
+
+    std::vector<std::uint64_t> edges;
+    edges.reserve(tris_.size());
+    for (std::size_t t = 0; t < tris_.size(); t += 3U) {
+      for (std::size_t e = 0; e < 3U; ++e) {
+        edges.push_back(edge_key(class_of_[tris_[t + e]], class_of_[tris_[t + (e + 1U) % 3U]]));
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    std::vector<Collapse> candidates;
+    candidates.reserve(edges.size());
+    for (std::uint64_t const key : edges) {
+      std::uint32_t const a = static_cast<std::uint32_t>(key >> 32);
+      std::uint32_t const b = static_cast<std::uint32_t>(key & 0xffffffffU);
+
+      Quadric q = quadrics_[a];
+      q.add(quadrics_[b]);
+
+      double const inf = std::numeric_limits<double>::infinity();
+      double const ab = (locked_[a] != 0U) ? inf : q.eval(position(b));
+      double const ba = (locked_[b] != 0U) ? inf : q.eval(position(a));
+      if (ab == inf && ba == inf) {
+        continue;
+      }
+      candidates.push_back((ab <= ba) ? Collapse{a, b, ab} : Collapse{b, a, ba});
+    }
+    std::sort(candidates.begin(), candidates.end(), [](Collapse const& x, Collapse const& y) {
+      return x.cost < y.cost;
+    });
+
+    std::vector<std::uint8_t> touched(classes, 0U);
+    std::size_t removed = 0;
+    bool any = false;
+
+    for (Collapse const& c : candidates) {
+      if (touched[c.from] != 0U || touched[c.to] != 0U) {
+        continue;
+      }
+      if (!collapse_keeps_orientation(adj, c)) {
+        continue;
+      }
+
+      // Each wedge of `from` moves onto the wedge of `to` it shares a triangle
+      // with, keeping its attributes continuous where possible.
+      for (std::uint32_t k = wedges_.offsets[c.from]; k < wedges_.offsets[c.from + 1U]; ++k) {
+        std::uint32_t const w = wedges_.items[k];
+        if (remap_[w] != w) {
+          continue;
+        }
+        std::uint32_t target = class_rep_[c.to];
+        for (std::uint32_t a = adj.offsets[c.from]; a < adj.offsets[c.from + 1U]; ++a) {
+          std::uint32_t const* t = &tris_[std::size_t{adj.items[a]} * 3U];
+          if (t[0] != w && t[1] != w && t[2] != w) {
+            continue;
+          }
+          for (int j = 0; j < 3; ++j) {
+            if (class_of_[t[j]] == c.to) {
+              target = t[j];
+            }
+          }
+        }
+        remap_[w] = target;
+      }
+
+      // Everything around `from` is frozen for the rest of the pass, so later
+      // orientation checks never see a triangle that already changed.
+      for (std::uint32_t a = adj.offsets[c.from]; a < adj.offsets[c.from + 1U]; ++a) {
+        std::uint32_t const* t = &tris_[std::size_t{adj.items[a]} * 3U];
+        bool dying = false;
+        for (int j = 0; j < 3; ++j) {
+          touched[class_of_[t[j]]] = 1U;
+          dying = dying || class_of_[t[j]] == c.to;
+        }
+        removed += dying ? 1U : 0U;
+      }
+
+      quadrics_[c.to].add(quadrics_[c.from]);
+      max_cost = std::max(max_cost, c.cost);
+      any = true;
+
+      if (tri_count - std::min(removed, tri_count) <= target_tris) {
+        break;
+      }
+    }
+
+    return any;
+  }
+
+  // Rejects collapses that would flip a surviving triangle around `from`.
+  bool collapse_keeps_orientation(Csr const& adj, Collapse const& c) const {
+    for (std::uint32_t a = adj.offsets[c.from]; a < adj.offsets[c.from + 1U]; ++a) {
+      std::uint32_t const* t = &tris_[std::size_t{adj.items[a]} * 3U];
+      std::uint32_t const k[3] = {class_of_[t[0]], class_of_[t[1]], class_of_[t[2]]};
+      if (k[0] == c.to || k[1] == c.to || k[2] == c.to) {
+        continue; // degenerates and goes away
+      }
+
+      float const* before[3] = {position(k[0]), position(k[1]), position(k[2])};
+      float const* after[3] = {before[0], before[1], before[2]};
+      for (int j = 0; j < 3; ++j) {
+        if (k[j] == c.from) {
+          after[j] = position(c.to);
+        }
+      }
+
+      double n0[3]{};
+      double n1[3]{};
+      cross(before[0], before[1], before[2], n0);
+      cross(after[0], after[1], after[2], n1);
+      // Also refuse to turn a triangle more than ~75 degrees; slivers that
+      // barely pass the sign test tend to flip in a later pass.
+      double const dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+      double const len2 = (n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]) * (n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+      if (dot <= 0.0 || dot * dot < 0.0625 * len2) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::uint32_t resolve(std::uint32_t v) {
+    std::uint32_t r = v;
+    while (remap_[r] != r) {
+      r = remap_[r];
+    }
+    while (remap_[v] != r) {
+      std::uint32_t const next = remap_[v];
+      remap_[v] = r;
+      v = next;
+    }
+    return r;
+  }
+
+  void rebuild_triangles() {
+    std::size_t out = 0;
+    for (std::size_t t = 0; t < tris_.size(); t += 3U) {
+      std::uint32_t const a = resolve(tris_[t]);
+      std::uint32_t const b = resolve(tris_[t + 1U]);
+      std::uint32_t const c = resolve(tris_[t + 2U]);
+      std::uint32_t const ka = class_of_[a];
+      std::uint32_t const kb = class_of_[b];
+      std::uint32_t const kc = class_of_[c];
+      if (ka == kb || kb == kc || ka == kc) {
+        continue;
+      }
+      tris_[out++] = a;
+      tris_[out++] = b;
+      tris_[out++] = c;
+    }
+    tris_.resize(out);
+  }
+
+private:
+  std::span<VertexPNUV const> vertices_;
+  std::vector<std::uint32_t> tris_;
+
+  std::vector<std::uint32_t> class_of_;  // vertex -> position class
+  std::vector<std::uint32_t> class_rep_; // class -> its first vertex
+  Csr wedges_{};                         // class -> vertices
+  std::vector<Quadric> quadrics_;        // per class
+  std::vector<std::uint8_t> locked_;     // per class, border
+  std::vector<std::uint32_t> remap_;     // vertex -> vertex it collapsed onto
+};
+
+} // namespace
+
+std::vector<std::uint32_t> simplify_mesh(std::span<VertexPNUV const> vertices,
+                                         std::span<std::uint32_t const> indices,
+                                         std::size_t target_index_count,
+                                         float& error) {
+  if ((indices.size() % 3U) != 0U) {
+    fail("simplify_mesh: index count is not a multiple of 3");
+  }
+  for (std::uint32_t const i : indices) {
+    if (i >= vertices.size()) {
+      fail("simplify_mesh: index out of range");
+    }
+  }
+
+  error = 0.0f;
+  if (indices.size() <= target_index_count) {
+    return std::vector<std::uint32_t>(indices.begin(), indices.end());
+  }
+
+  Simplifier s(vertices, indices);
+  return s.run(target_index_count, error);
+}
+
+void build_lods(ObjIndexedMesh& mesh, std::span<float const> ratios) {
+  mesh.lods.clear();
+  if (mesh.indices.empty()) {
+    return;
+  }
+
+  std::size_t const base_count = mesh.indices.size();
+  mesh.lods.push_back(MeshLod{0U, static_cast<std::uint32_t>(base_count), 0.0f});
+
+  // Each level starts from the previous one; errors add up along the chain.
+  std::vector<std::uint32_t> prev(mesh.indices.begin(), mesh.indices.end());
+  float prev_error = 0.0f;
+
+  for (float const ratio : ratios) {
+    if (mesh.lods.size() >= kMaxMeshLods) {
+      break;
+    }
+
+    std::size_t const target = static_cast<std::size_t>(static_cast<double>(base_count / 3U) * ratio) * 3U;
+    if (target >= prev.size()) {
+      continue;
+    }
+
+    float error = 0.0f;
+    std::vector<std::uint32_t> level = simplify_mesh(mesh.vertices, prev, target, error);
+    if (level.empty() || level.size() * 10U > prev.size() * 9U) {
+      break; // stuck on locked borders / flips; further levels would not help
+    }
+    optimize_vertex_cache(level, mesh.vertices.size());
+
+    MeshLod lod{};
+    lod.first_index = static_cast<std::uint32_t>(mesh.indices.size());
+    lod.index_count = static_cast<std::uint32_t>(level.size());
+    lod.error = prev_error + error;
+    mesh.lods.push_back(lod);
+
+    mesh.indices.insert(mesh.indices.end(), level.begin(), level.end());
+    prev = std::move(level);
+    prev_error = lod.error;
+  }
+}
+
+void build_lods(ObjIndexedMesh& mesh) {
+  float const ratios[] = {0.5f, 0.25f, 0.125f};
+  build_lods(mesh, ratios);
+}
+
+} // namespace assets
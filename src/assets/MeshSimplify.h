@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "assets/ObjLoader.h"
+
+namespace assets {
+
+// At most this many levels, level 0 included.
+constexpr std::uint32_t kMaxMeshLods = 4;
+
+// Quadric-error edge collapse (Garland & Heckbert 1997) down to about
+// `target_index_count` indices. Collapses move a vertex onto an existing
+// neighbour, so the result indexes the same vertex array. Vertices that share a
+// position (UV / normal seams) move together; open borders are kept. Returns the
+// new index list and sets `error` to the object-space deviation estimate.
+std::vector<std::uint32_t> simplify_mesh(std::span<VertexPNUV const> vertices,
+                                         std::span<std::uint32_t const> indices,
+                                         std::size_t target_index_count,
+                                         float& error);
+
+// Appends a chain of simplified levels to mesh.indices and fills mesh.lods.
+// Each entry of `ratios` is a triangle fraction of level 0; levels that do not
+// reduce the previous one meaningfully are skipped. Run after optimize_mesh().
+void build_lods(ObjIndexedMesh& mesh, std::span<float const> ratios);
+void build_lods(ObjIndexedMesh& mesh); // 1/2, 1/4, 1/8
+
+} // namespace assets
@@ -0,0 +1,156 @@
+#include "assets/Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace assets {
+
+namespace {
+
+[[noreturn]] void fail(std::string const& msg) {
+  throw std::runtime_error(msg);
+}
+
+constexpr std::uint32_t kNoMeshlet = 0xffffffffU;
+
+// Bounds and normal cone of the triangles [m.first_index, +3 * triangle_count).
+void finish_meshlet(Meshlet& m, std::span<VertexPNUV const> vertices, std::span<std::uint32_t const> indices) {
+  std::span<std::uint32_t const> const tri = indices.subspan(m.first_index, std::size_t{m.triangle_count} * 3U);
+
+  float lo[3] = {vertices[tri[0]].pos[0], vertices[tri[0]].pos[1], vertices[tri[0]].pos[2]};
+  float hi[3] = {lo[0], lo[1], lo[2]};
+  for (std::uint32_t const i : tri) {
+    for (int a = 0; a < 3; ++a) {
+      lo[a] = std::min(lo[a], vertices[i].pos[a]);
+      hi[a] = std::max(hi[a], vertices[i].pos[a]);
+    }
+  }
+  for (int a = 0; a < 3; ++a) {
+    m.center[a] = 0.5f * (lo[a] + hi[a]);
+  }
+
+  float r2 = 0.0f;
+  for (std::uint32_t const i : tri) {
+    float const dx = vertices[i].pos[0] - m.center[0];
+    float const dy = vertices[i].pos[1] - m.center[1];
+    float const dz = vertices[i].pos[2] - m.center[2];
+    r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+  }
+  m.radius = std::sqrt(r2);
+
+  // Face normals from the positions; degenerate triangles do not constrain the cone.
+  std::vector<float> normals;
+  normals.reserve(std::size_t{m.triangle_count} * 3U);
+  float axis[3] = {0.0f, 0.0f, 0.0f};
+  for (std::size_t t = 0; t < tri.size(); t += 3U) {
+    float const* p0 = vertices[tri[t]].pos;
+    float const* p1 = vertices[tri[t + 1U]].pos;
+    float const* p2 = vertices[tri[t + 2U]].pos;
+
+    float const e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    float const e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+
+    float const len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (!(len > 0.0f)) {
+      continue;
+    }
+    for (int a = 0; a < 3; ++a) {
+      n[a] /= len;
+      axis[a] += n[a];
+      normals.push_back(n[a]);
+    }
+  }
+
+  float const axis_len = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  if (normals.empty() || !(axis_len > 0.0f)) {
+    m.cone_cutoff = 1.0f;
+    return;
+  }
+  for (int a = 0; a < 3; ++a) {
+    m.cone_axis[a] = axis[a] / axis_len;
+  }
+
+  float min_dot = 1.0f;
+  for (std::size_t k = 0; k < normals.size(); k += 3U) {
+    float const d = normals[k] * m.cone_axis[0] + normals[k + 1U] * m.cone_axis[1] + normals[k + 2U] * m.cone_axis[2];
+    min_dot = std::min(min_dot, d);
+  }
+
+  // Sine of the cone's half angle, measured from the plane orthogonal to the axis.
+  m.cone_cutoff = (min_dot <= 0.0f) ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+}
+
+} // namespace
+
+std::vector<Meshlet> build_meshlets(std::span<VertexPNUV const> vertices,
+                                    std::span<std::uint32_t const> indices,
+                                    std::uint32_t max_vertices,
+                                    std::uint32_t max_triangles) {
+  if (max_vertices < 3U || max_triangles == 0U) {
+    fail("build_meshlets: limits too small");
+  }
+  if ((indices.size() % 3U) != 0U) {
+    fail("build_meshlets: index count is not a multiple of 3");
+  }
+  for (std::uint32_t const i : indices) {
+    if (i >= vertices.size()) {
+      fail("build_meshlets: index out of range");
+    }
+  }
+
+  std::vector<Meshlet> out;
+  if (indices.empty()) {
+    return out;
+  }
+
+  // owner[v] is the meshlet that last counted v as one of its vertices.
+  std::vector<std::uint32_t> owner(vertices.size(), kNoMeshlet);
+  Meshlet cur{};
+  std::uint32_t id = 0;
+
+  // Vertices of triangle t not yet in `meshlet`, counting a repeated corner once.
+  auto fresh_vertices = [&](std::size_t t, std::uint32_t meshlet) {
+    std::uint32_t fresh = 0;
+    for (std::size_t c = 0; c < 3U; ++c) {
+      std::uint32_t const v = indices[t + c];
+      bool const repeated = (c > 0U && indices[t] == v) || (c > 1U && indices[t + 1U] == v);
+      if (owner[v] != meshlet && !repeated) {
+        ++fresh;
+      }
+    }
+    return fresh;
+  };
+
+  for (std::size_t t = 0; t < indices.size(); t += 3U) {
+    std::uint32_t fresh = fresh_vertices(t, id);
+
+    if (cur.triangle_count == max_triangles || cur.vertex_count + fresh > max_vertices) {
+      finish_meshlet(cur, vertices, indices);
+      out.push_back(cur);
+
+      cur = Meshlet{};
+      cur.first_index = static_cast<std::uint32_t>(t);
+      ++id;
+      fresh = fresh_vertices(t, id);
+    }
+
+    for (std::size_t c = 0; c < 3U; ++c) {
+      owner[indices[t + c]] = id;
+    }
+    cur.vertex_count += fresh;
+    ++cur.triangle_count;
+  }
+
+  finish_meshlet(cur, vertices, indices);
+  out.push_back(cur);
+  return out;
+}
+
+} // namespace assets
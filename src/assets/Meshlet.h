@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "assets/ObjLoader.h"
+
+namespace assets {
+
+// Limits that suit both the vertex pipeline and typical mesh shader workgroups.
+constexpr std::uint32_t kMeshletMaxVertices = 64;
+constexpr std::uint32_t kMeshletMaxTriangles = 124;
+
+// A cluster of triangles that is culled as a unit. Clusters are contiguous runs
+// of the mesh's index buffer, so drawing one is a plain indexed draw of
+// [first_index, first_index + 3 * triangle_count).
+//
+// Culling data is in object space. The normal cone bounds the cluster's face
+// normals: the cluster is entirely back-facing from `eye` when
+//   dot(center - eye, cone_axis) >= cone_cutoff * |center - eye| + radius.
+// cone_cutoff = 1 disables the test (normals spread over more than a hemisphere).
+struct Meshlet {
+  std::uint32_t first_index = 0;
+  std::uint32_t triangle_count = 0;
+  std::uint32_t vertex_count = 0; // unique vertices referenced
+  std::uint32_t pad = 0;
+
+  float center[3] = {0.0f, 0.0f, 0.0f};
+  float radius = 0.0f;
+  float cone_axis[3] = {0.0f, 0.0f, 1.0f};
+  float cone_cutoff = 1.0f;
+};
+
+// Splits the triangle list into clusters of at most max_vertices unique vertices
+// and max_triangles triangles, in index order. Run after optimize_mesh(): the
+// cache-optimized order is what keeps clusters spatially compact.
+std::vector<Meshlet> build_meshlets(std::span<VertexPNUV const> vertices,
+                                    std::span<std::uint32_t const> indices,
+                                    std::uint32_t max_vertices = kMeshletMaxVertices,
+                                    std::uint32_t max_triangles = kMeshletMaxTriangles);
+
+} // namespace assets
@@ -1,12 +1,22 @@
 #include "assets/ObjLoader.h"
 
+#include "assets/MappedFile.h"
+#include "core/JobSystem.h"
+#include "core/Profile.h"
+
+#include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -57,8 +67,713 @@ struct KeyHash {
   }
 };
 
+std::uint64_t key_mix(Key const& k) {
+  // KeyHash is weak in the low bits; finalize so both halves are usable.
+  std::uint64_t h = static_cast<std::uint64_t>(KeyHash{}(k));
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Open-addressing (linear probe) Key -> vertex index map; one flat allocation that
+// only grows, instead of a node per entry.
+class DedupTable {
+public:
+  static constexpr std::uint32_t kEmpty = UINT32_MAX;
+
+  explicit DedupTable(std::size_t expected) {
+    std::size_t cap = 16;
+    while (cap < expected * 2U) {
+      cap *= 2U;
+    }
+    slots_.assign(cap, Slot{});
+  }
+
+  // Returns the existing value for `key`, or inserts `value` and returns kEmpty.
+  std::uint32_t find_or_insert(Key const& key, std::uint32_t value) {
+    if ((size_ + 1U) * 2U > slots_.size()) {
+      grow();
+    }
+
+    std::size_t const mask = slots_.size() - 1U;
+    std::size_t i = static_cast<std::size_t>(key_mix(key)) & mask;
+    for (;;) {
+      Slot& s = slots_[i];
+      if (s.value == kEmpty) {
+        s.key = key;
+        s.value = value;
+        ++size_;
+        return kEmpty;
+      }
+      if (s.key == key) {
+        return s.value;
+      }
+      i = (i + 1U) & mask;
+    }
+  }
+
+private:
+  struct Slot {
+    Key key{0, 0, 0};
+    std::uint32_t value = kEmpty;
+  };
+
+  void grow() {
+    std::vector<Slot> old = std::move(slots_);
+    slots_.assign(old.size() * 2U, Slot{});
+    size_ = 0;
+    for (auto const& s : old) {
+      if (s.value != kEmpty) {
+        (void)find_or_insert(s.key, s.value);
+      }
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::size_t size_ = 0;
+};
+
+// Whitespace as seen by operator>> in the "C" locale ('\n' never reaches the parsers).
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+char const* skip_space(char const* p, char const* end) {
+  while (p < end && is_space(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Like `iss >> f`: leading whitespace, optional sign, decimal only (no inf/nan/hex).
+bool parse_float(char const*& p, char const* end, float& out) {
+  char const* q = skip_space(p, end);
+  if (q < end && *q == '+') {
+    ++q; // from_chars rejects an explicit '+'
+    if (q < end && *q == '-') {
+      return false;
+    }
+  }
+
+  char const* digits = (q < end && *q == '-') ? q + 1 : q;
+  if (digits >= end || !(is_digit(*digits) || *digits == '.')) {
+    return false;
+  }
+
+  auto const r = std::from_chars(q, end, out, std::chars_format::general);
+  if (r.ec != std::errc{}) {
+    return false;
+  }
+  p = r.ptr;
+  return true;
+}
+
+// Like std::stoi on a field: optional sign, then the longest digit prefix.
+bool parse_int(char const* first, char const* last, std::int32_t& out) {
+  if (first < last && *first == '+') {
+    ++first;
+    if (first < last && *first == '-') {
+      return false;
+    }
+  }
+  auto const r = std::from_chars(first, last, out);
+  return r.ec == std::errc{};
+}
+
+VertexPNUV make_vertex(float const* positions,
+                       float const* texcoords,
+                       float const* normals,
+                       Key const& key) {
+  VertexPNUV vtx{};
+
+  vtx.pos[0] = positions[static_cast<std::size_t>(key.v) * 3 + 0];
+  vtx.pos[1] = positions[static_cast<std::size_t>(key.v) * 3 + 1];
+  vtx.pos[2] = positions[static_cast<std::size_t>(key.v) * 3 + 2];
+
+  if (key.vt >= 0) {
+    vtx.uv[0] = texcoords[static_cast<std::size_t>(key.vt) * 2 + 0];
+    vtx.uv[1] = texcoords[static_cast<std::size_t>(key.vt) * 2 + 1];
+  } else {
+    vtx.uv[0] = 0.0f;
+    vtx.uv[1] = 0.0f;
+  }
+
+  if (key.vn >= 0) {
+    vtx.normal[0] = normals[static_cast<std::size_t>(key.vn) * 3 + 0];
+    vtx.normal[1] = normals[static_cast<std::size_t>(key.vn) * 3 + 1];
+    vtx.normal[2] = normals[static_cast<std::size_t>(key.vn) * 3 + 2];
+  } else {
+    // fallback (no normals in file)
+    vtx.normal[0] = 0.0f;
+    vtx.normal[1] = 0.0f;
+    vtx.normal[2] = 1.0f;
+  }
+
+  return vtx;
+}
+
+// Runs fn(0..count-1) on `jobs` (the caller included) and rethrows the first
+// failure in index order.
+template <class Fn>
+void run_parallel(core::JobSystem& jobs, std::size_t count, Fn const& fn) {
+  std::vector<std::exception_ptr> errors(count);
+  jobs.parallel_for(count, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      try {
+        fn(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  });
+
+  for (auto const& e : errors) {
+    if (e) {
+      std::rethrow_exception(e);
+    }
+  }
+}
+
 } // namespace
 
+struct ObjLoader::LineParser {
+  struct Error {
+    std::size_t line = 0;       // 1-based, relative to the parsed range
+    char const* what = nullptr; // nullptr -> no error
+  };
+
+  // Walks [first, last) line by line and feeds v/vt/vn/f records to `sink`.
+  // Stops at the first malformed record instead of throwing so callers can
+  // translate chunk-relative line numbers.
+  template <class Sink>
+  static Error run(char const* first, char const* last, Sink& sink, std::size_t& line_count) {
+    std::vector<Ref> face; // reused for every f line
+    face.reserve(16);
+
+    char const* p = first;
+    std::size_t line_no = 0;
+
+    while (p < last) {
+      char const* nl = static_cast<char const*>(std::memchr(p, '\n', static_cast<std::size_t>(last - p)));
+      char const* const line_end = (nl != nullptr) ? nl : last;
+      ++line_no;
+
+      char const* s = skip_space(p, line_end);
+      p = (nl != nullptr) ? nl + 1 : last;
+
+      std::size_t const n = static_cast<std::size_t>(line_end - s);
+      if (n == 0U || s[0] == '#') {
+        continue;
+      }
+
+      if (n >= 2U && s[0] == 'v' && s[1] == ' ') {
+        char const* q = s + 2;
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        if (!parse_float(q, line_end, x) || !parse_float(q, line_end, y) || !parse_float(q, line_end, z)) {
+          line_count = line_no;
+          return Error{line_no, "malformed v"};
+        }
+        sink.position(x, y, z);
+        continue;
+      }
+
+      if (n >= 3U && s[0] == 'v' && s[1] == 't' && s[2] == ' ') {
+        char const* q = s + 3;
+        float u = 0.0f;
+        float v = 0.0f;
+        if (!parse_float(q, line_end, u) || !parse_float(q, line_end, v)) {
+          line_count = line_no;
+          return Error{line_no, "malformed vt"};
+        }
+        sink.texcoord(u, v);
+        continue;
+      }
+
+      if (n >= 3U && s[0] == 'v' && s[1] == 'n' && s[2] == ' ') {
+        char const* q = s + 3;
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        if (!parse_float(q, line_end, x) || !parse_float(q, line_end, y) || !parse_float(q, line_end, z)) {
+          line_count = line_no;
+          return Error{line_no, "malformed vn"};
+        }
+        sink.normal(x, y, z);
+        continue;
+      }
+
+      if (n >= 2U && s[0] == 'f' && s[1] == ' ') {
+        face.clear();
+        char const* q = s + 2;
+        for (;;) {
+          q = skip_space(q, line_end);
+          if (q == line_end) {
+            break;
+          }
+          char const* tok_end = q;
+          while (tok_end < line_end && !is_space(*tok_end)) {
+            ++tok_end;
+          }
+          Ref r{};
+          if (!parse_face_ref(q, tok_end, r)) {
+            line_count = line_no;
+            return Error{line_no, "malformed face index"};
+          }
+          face.push_back(r);
+          q = tok_end;
+        }
+
+        if (face.size() < 3U) {
+          line_count = line_no;
+          return Error{line_no, "face has <3 vertices"};
+        }
+        sink.face(face.data(), face.size(), line_no);
+        continue;
+      }
+
+      // Ignore: o, g, s, usemtl, mtllib, etc.
+    }
+
+    line_count = line_no;
+    return Error{};
+  }
+
+  // [first, last) is one whitespace-free token; same field rules as the string overload
+  // of ObjLoader::parse_face_ref (std::stoi takes the longest numeric prefix).
+  static bool parse_face_ref(char const* first, char const* last, Ref& out) {
+    out = Ref{};
+    std::int32_t* const fields[3] = {&out.v, &out.vt, &out.vn};
+
+    char const* p = first;
+    for (std::size_t f = 0; f < 3U; ++f) {
+      char const* field_end = p;
+      while (field_end < last && *field_end != '/') {
+        ++field_end;
+      }
+
+      if (field_end != p && !parse_int(p, field_end, *fields[f])) {
+        return false;
+      }
+
+      if (field_end == last) {
+        break;
+      }
+      p = field_end + 1;
+    }
+    return true;
+  }
+};
+
+class ObjLoader::Builder {
+public:
+  explicit Builder(ObjIndexedMesh& out)
+    : out_(out)
+    , dedup_(4096) {
+  }
+
+  std::vector<float> positions;  // x,y,z...
+  std::vector<float> texcoords;  // u,v...
+  std::vector<float> normals;    // x,y,z...
+
+  void position(float x, float y, float z) {
+    positions.push_back(x);
+    positions.push_back(y);
+    positions.push_back(z);
+  }
+
+  void texcoord(float u, float v) {
+    texcoords.push_back(u);
+    texcoords.push_back(v);
+  }
+
+  void normal(float x, float y, float z) {
+    normals.push_back(x);
+    normals.push_back(y);
+    normals.push_back(z);
+  }
+
+  void face(Ref const* refs, std::size_t count, std::size_t line_no) {
+    if (count < 3U) {
+      fail("OBJ: face has <3 vertices at line " + std::to_string(line_no));
+    }
+
+    // triangulate fan: (0, i, i+1)
+    std::uint32_t const i0 = get_or_add(refs[0], line_no);
+    for (std::size_t i = 1; i + 1 < count; ++i) {
+      std::uint32_t const i1 = get_or_add(refs[i], line_no);
+      std::uint32_t const i2 = get_or_add(refs[i + 1], line_no);
+      out_.indices.push_back(i0);
+      out_.indices.push_back(i1);
+      out_.indices.push_back(i2);
+    }
+  }
+
+private:
+  std::uint32_t get_or_add(Ref const& r, std::size_t line_no) {
+    if (r.v == 0) {
+      fail("OBJ: face vertex missing position index at line " + std::to_string(line_no));
+    }
+
+    std::size_t const pos_count = positions.size() / 3U;
+    std::size_t const uv_count = texcoords.size() / 2U;
+    std::size_t const n_count = normals.size() / 3U;
+
+    Key const key{
+      to_zero_based(r.v, pos_count, "v"),
+      (r.vt != 0) ? to_zero_based(r.vt, uv_count, "vt") : -1,
+      (r.vn != 0) ? to_zero_based(r.vn, n_count, "vn") : -1,
+    };
+
+    std::uint32_t const new_index = static_cast<std::uint32_t>(out_.vertices.size());
+    std::uint32_t const existing = dedup_.find_or_insert(key, new_index);
+    if (existing != DedupTable::kEmpty) {
+      return existing;
+    }
+
+    out_.vertices.push_back(make_vertex(positions.data(), texcoords.data(), normals.data(), key));
+    return new_index;
+  }
+
+  ObjIndexedMesh& out_;
+  DedupTable dedup_;
+};
+
+// Parallel equivalent of Builder. Vertex numbering must match the serial loader,
+// i.e. vertices appear in order of the first corner (in file order) that uses them:
+//  1) parse chunks into local arrays; faces remember the local v/vt/vn counts
+//  2) resolve corners to absolute keys and scatter (key, corner position) by shard
+//  3) per shard, find the first corner of every key; mark it and link repeats to it
+//  4) prefix-sum the marks over all corners -> vertex ids in first-use order
+//  5) write vertices per shard and triangles per chunk
+class ObjLoader::ParallelBuilder {
+public:
+  static ObjIndexedMesh run(core::JobSystem& jobs,
+                            char const* first,
+                            char const* last,
+                            std::size_t threads,
+                            std::string const& path) {
+    std::vector<Chunk> chunks(threads);
+
+    // -- split at line boundaries
+    std::size_t const size = static_cast<std::size_t>(last - first);
+    char const* begin = first;
+    for (std::size_t i = 0; i < threads; ++i) {
+      char const* end = (i + 1 == threads) ? last : first + size * (i + 1) / threads;
+      if (end < begin) {
+        end = begin;
+      }
+      if (end < last && end > first && end[-1] != '\n') {
+        char const* nl = static_cast<char const*>(std::memchr(end, '\n', static_cast<std::size_t>(last - end)));
+        end = (nl != nullptr) ? nl + 1 : last;
+      }
+      chunks[i].first = begin;
+      chunks[i].last = end;
+      begin = end;
+    }
+
+    // 1) parse
+    {
+      CORE_ZONE("obj parse");
+      run_parallel(jobs, threads, [&](std::size_t i) {
+        Chunk& c = chunks[i];
+        c.error = LineParser::run(c.first, c.last, c, c.line_count);
+      });
+    }
+
+    std::size_t line_base = 0;
+    std::size_t corner_total = 0;
+    std::size_t triangle_total = 0;
+    std::size_t pos_total = 0;
+    std::size_t uv_total = 0;
+    std::size_t n_total = 0;
+    for (auto& c : chunks) {
+      if (c.error.what != nullptr) {
+        fail(std::string("OBJ: ") + c.error.what + " at line " + std::to_string(line_base + c.error.line));
+      }
+      c.line_base = line_base;
+      c.corner_base = corner_total;
+      c.triangle_base = triangle_total;
+      c.pos_base = pos_total;
+      c.uv_base = uv_total;
+      c.n_base = n_total;
+
+      line_base += c.line_count;
+      corner_total += c.corners.size();
+      triangle_total += c.triangle_count;
+      pos_total += c.positions.size() / 3U;
+      uv_total += c.texcoords.size() / 2U;
+      n_total += c.normals.size() / 3U;
+    }
+
+    if (corner_total >= UINT32_MAX) {
+      fail("OBJ: too many face corners for 32-bit indices: " + path);
+    }
+
+    std::vector<float> positions(pos_total * 3U);
+    std::vector<float> texcoords(uv_total * 2U);
+    std::vector<float> normals(n_total * 3U);
+
+    std::size_t const shards = threads;
+
+    // 2) resolve + scatter; attribute arrays are concatenated on the way
+    {
+      CORE_ZONE("obj scatter");
+      run_parallel(jobs, threads, [&](std::size_t i) {
+        Chunk& c = chunks[i];
+        std::copy(c.positions.begin(), c.positions.end(), positions.begin() + static_cast<std::ptrdiff_t>(c.pos_base * 3U));
+        std::copy(c.texcoords.begin(), c.texcoords.end(), texcoords.begin() + static_cast<std::ptrdiff_t>(c.uv_base * 2U));
+        std::copy(c.normals.begin(), c.normals.end(), normals.begin() + static_cast<std::ptrdiff_t>(c.n_base * 3U));
+        c.positions = {};
+        c.texcoords = {};
+        c.normals = {};
+
+        c.buckets.resize(shards);
+        for (auto& b : c.buckets) {
+          b.reserve(c.corners.size() / shards + 16U);
+        }
+
+        for (auto const& f : c.faces) {
+          std::size_t const pos_count = c.pos_base + f.pos_count;
+          std::size_t const uv_count = c.uv_base + f.uv_count;
+          std::size_t const n_count = c.n_base + f.n_count;
+
+          for (std::uint32_t j = 0; j < f.corner_count; ++j) {
+            Ref const& r = c.corners[f.first_corner + j];
+            if (r.v == 0) {
+              fail("OBJ: face vertex missing position index at line " + std::to_string(c.line_base + f.line));
+            }
+
+            Entry e{};
+            e.key.v = to_zero_based(r.v, pos_count, "v");
+            e.key.vt = (r.vt != 0) ? to_zero_based(r.vt, uv_count, "vt") : -1;
+            e.key.vn = (r.vn != 0) ? to_zero_based(r.vn, n_count, "vn") : -1;
+            e.corner = static_cast<std::uint32_t>(c.corner_base + f.first_corner + j);
+
+            c.buckets[shard_of(e.key, shards)].push_back(e);
+          }
+        }
+        c.corners = {};
+      });
+    }
+
+    // 3) per-shard dedup; chunks and buckets are visited in file order, so the
+    //    first insertion of a key is its first corner
+    std::vector<std::uint32_t> rep(corner_total);
+    std::vector<std::uint32_t> ids(corner_total, 0U);
+
+    {
+      CORE_ZONE("obj dedup");
+      run_parallel(jobs, shards, [&](std::size_t s) {
+        std::size_t expected = 0;
+        for (auto const& c : chunks) {
+          expected += c.buckets[s].size();
+        }
+
+        DedupTable table(expected / 2U);
+        for (auto const& c : chunks) {
+          for (auto const& e : c.buckets[s]) {
+            std::uint32_t const existing = table.find_or_insert(e.key, e.corner);
+            if (existing == DedupTable::kEmpty) {
+              rep[e.corner] = e.corner;
+              ids[e.corner] = 1U;
+            } else {
+              rep[e.corner] = existing;
+            }
+          }
+        }
+      });
+    }
+
+    // 4) exclusive prefix sum of the first-use marks
+    std::vector<std::uint32_t> partial(threads + 1U, 0U);
+    {
+      CORE_ZONE("obj prefix");
+      run_parallel(jobs, threads, [&](std::size_t i) {
+        std::size_t const b = corner_total * i / threads;
+        std::size_t const e = corner_total * (i + 1) / threads;
+        std::uint32_t sum = 0;
+        for (std::size_t k = b; k < e; ++k) {
+          sum += ids[k];
+        }
+        partial[i + 1] = sum;
+      });
+      for (std::size_t i = 0; i < threads; ++i) {
+        partial[i + 1] += partial[i];
+      }
+      run_parallel(jobs, threads, [&](std::size_t i) {
+        std::size_t const b = corner_total * i / threads;
+        std::size_t const e = corner_total * (i + 1) / threads;
+        std::uint32_t running = partial[i];
+        for (std::size_t k = b; k < e; ++k) {
+          std::uint32_t const mark = ids[k];
+          ids[k] = running;
+          running += mark;
+        }
+      });
+    }
+
+    // 5) emit
+    ObjIndexedMesh out{};
+    out.vertices.resize(partial[threads]);
+    out.indices.resize(triangle_total * 3U);
+
+    {
+      CORE_ZONE("obj emit");
+      run_parallel(jobs, shards, [&](std::size_t s) {
+        for (auto const& c : chunks) {
+          for (auto const& e : c.buckets[s]) {
+            if (rep[e.corner] == e.corner) {
+              out.vertices[ids[e.corner]] = make_vertex(positions.data(), texcoords.data(), normals.data(), e.key);
+            }
+          }
+        }
+      });
+
+      run_parallel(jobs, threads, [&](std::size_t i) {
+        Chunk const& c = chunks[i];
+        std::uint32_t* dst = out.indices.data() + c.triangle_base * 3U;
+
+        for (auto const& f : c.faces) {
+          std::size_t const base = c.corner_base + f.first_corner;
+          std::uint32_t const i0 = ids[rep[base]];
+          for (std::uint32_t j = 1; j + 1 < f.corner_count; ++j) {
+            *dst++ = i0;
+            *dst++ = ids[rep[base + j]];
+            *dst++ = ids[rep[base + j + 1]];
+          }
+        }
+      });
+    }
+
+    if (out.vertices.empty()) {
+      fail("OBJ: no vertices generated: " + path);
+    }
+    if (out.indices.empty()) {
+      fail("OBJ: no faces/indices generated: " + path);
+    }
+
+    out.bounds = compute_bounds(out.vertices);
+    return out;
+  }
+
+private:
+  struct Face {
+    std::uint32_t first_corner = 0; // into Chunk::corners
+    std::uint32_t corner_count = 0;
+    std::uint32_t pos_count = 0;    // chunk-local counts when the face was read
+    std::uint32_t uv_count = 0;
+    std::uint32_t n_count = 0;
+    std::size_t line = 0;           // chunk-local
+  };
+
+  struct Entry {
+    Key key{0, 0, 0};
+    std::uint32_t corner = 0; // global corner position
+  };
+
+  struct Chunk {
+    char const* first = nullptr;
+    char const* last = nullptr;
+
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    std::vector<float> normals;
+    std::vector<Ref> corners;
+    std::vector<Face> faces;
+    std::size_t triangle_count = 0;
+    std::size_t line_count = 0;
+    LineParser::Error error{};
+
+    std::size_t line_base = 0;
+    std::size_t corner_base = 0;
+    std::size_t triangle_base = 0;
+    std::size_t pos_base = 0;
+    std::size_t uv_base = 0;
+    std::size_t n_base = 0;
+
+    std::vector<std::vector<Entry>> buckets; // per shard
+
+    // LineParser sink
+    void position(float x, float y, float z) {
+      positions.push_back(x);
+      positions.push_back(y);
+      positions.push_back(z);
+    }
+
+    void texcoord(float u, float v) {
+      texcoords.push_back(u);
+      texcoords.push_back(v);
+    }
+
+    void normal(float x, float y, float z) {
+      normals.push_back(x);
+      normals.push_back(y);
+      normals.push_back(z);
+    }
+
+    void face(Ref const* refs, std::size_t count, std::size_t line_no) {
+      if (corners.size() + count >= UINT32_MAX) {
+        fail("OBJ: chunk has too many face corners");
+      }
+      Face f{};
+      f.first_corner = static_cast<std::uint32_t>(corners.size());
+      f.corner_count = static_cast<std::uint32_t>(count);
+      f.pos_count = static_cast<std::uint32_t>(positions.size() / 3U);
+      f.uv_count = static_cast<std::uint32_t>(texcoords.size() / 2U);
+      f.n_count = static_cast<std::uint32_t>(normals.size() / 3U);
+      f.line = line_no;
+      faces.push_back(f);
+
+      corners.insert(corners.end(), refs, refs + count);
+      triangle_count += count - 2U;
+    }
+  };
+
+  static std::size_t shard_of(Key const& key, std::size_t shards) {
+    // high bits: DedupTable probes with the low ones
+    return static_cast<std::size_t>(key_mix(key) >> 32) % shards;
+  }
+};
+
+MeshBounds compute_bounds(std::span<VertexPNUV const> vertices) {
+  MeshBounds b{};
+  if (vertices.empty()) {
+    return b;
+  }
+
+  for (int a = 0; a < 3; ++a) {
+    b.aabb_min[a] = vertices[0].pos[a];
+    b.aabb_max[a] = vertices[0].pos[a];
+  }
+  for (VertexPNUV const& v : vertices) {
+    for (int a = 0; a < 3; ++a) {
+      b.aabb_min[a] = std::min(b.aabb_min[a], v.pos[a]);
+      b.aabb_max[a] = std::max(b.aabb_max[a], v.pos[a]);
+    }
+  }
+
+  for (int a = 0; a < 3; ++a) {
+    b.sphere_center[a] = 0.5f * (b.aabb_min[a] + b.aabb_max[a]);
+  }
+
+  float r2 = 0.0f;
+  for (VertexPNUV const& v : vertices) {
+    float const dx = v.pos[0] - b.sphere_center[0];
+    float const dy = v.pos[1] - b.sphere_center[1];
+    float const dz = v.pos[2] - b.sphere_center[2];
+    r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+  }
+  b.sphere_radius = std::sqrt(r2);
+  return b;
+}
+
 ObjLoader::Ref ObjLoader::parse_face_ref(std::string const& token) {
   // token: v, v/vt, v//vn, v/vt/vn
   Ref r{};
@@ -112,20 +827,16 @@ std::int32_t ObjLoader::to_zero_based(std::int32_t obj_index, std::size_t count,
 }
 
 ObjIndexedMesh ObjLoader::load(std::string const& path) {
+  CORE_ZONE("obj load");
   std::ifstream ifs(path);
   if (!ifs) {
     fail("OBJ: failed to open: " + path);
   }
 
-  std::vector<float> positions;  // x,y,z...
-  std::vector<float> texcoords;  // u,v...
-  std::vector<float> normals;    // x,y,z...
-
   ObjIndexedMesh out{};
+  Builder b(out);
 
-  std::unordered_map<Key, std::uint32_t, KeyHash> dedup;
-  dedup.reserve(4096);
-
+  std::vector<Ref> face;
   std::string line;
   std::size_t line_no = 0;
 
@@ -149,9 +860,7 @@ ObjIndexedMesh ObjLoader::load(std::string const& path) {
         fail("OBJ: malformed v at line " + std::to_string(line_no));
       }
 
-      positions.push_back(x);
-      positions.push_back(y);
-      positions.push_back(z);
+      b.position(x, y, z);
       continue;
     }
 
@@ -167,8 +876,7 @@ ObjIndexedMesh ObjLoader::load(std::string const& path) {
         fail("OBJ: malformed vt at line " + std::to_string(line_no));
       }
 
-      texcoords.push_back(u);
-      texcoords.push_back(v);
+      b.texcoord(u, v);
       continue;
     }
 
@@ -185,9 +893,7 @@ ObjIndexedMesh ObjLoader::load(std::string const& path) {
         fail("OBJ: malformed vn at line " + std::to_string(line_no));
       }
 
-      normals.push_back(x);
-      normals.push_back(y);
-      normals.push_back(z);
+      b.normal(x, y, z);
       continue;
     }
 
@@ -196,80 +902,42 @@ ObjIndexedMesh ObjLoader::load(std::string const& path) {
       char ftag = '\0';
       iss >> ftag;
 
-      std::vector<Ref> face;
+      face.clear();
       std::string tok;
       while (iss >> tok) {
         face.push_back(parse_face_ref(tok));
       }
 
-      if (face.size() < 3U) {
-        fail("OBJ: face has <3 vertices at line " + std::to_string(line_no));
-      }
-
-      std::size_t const pos_count = positions.size() / 3U;
-      std::size_t const uv_count = texcoords.size() / 2U;
-      std::size_t const n_count = normals.size() / 3U;
-
-      auto get_or_add = [&](Ref const& r) -> std::uint32_t {
-        if (r.v == 0) {
-          fail("OBJ: face vertex missing position index at line " + std::to_string(line_no));
-        }
-
-        std::int32_t const zv = to_zero_based(r.v, pos_count, "v");
-        std::int32_t const zt = (r.vt != 0) ? to_zero_based(r.vt, uv_count, "vt") : -1;
-        std::int32_t const zn = (r.vn != 0) ? to_zero_based(r.vn, n_count, "vn") : -1;
-
-        Key const key{zv, zt, zn};
-        auto it = dedup.find(key);
-        if (it != dedup.end()) {
-          return it->second;
-        }
-
-        VertexPNUV vtx{};
+      b.face(face.data(), face.size(), line_no);
+      continue;
+    }
 
-        vtx.pos[0] = positions[static_cast<std::size_t>(zv) * 3 + 0];
-        vtx.pos[1] = positions[static_cast<std::size_t>(zv) * 3 + 1];
-        vtx.pos[2] = positions[static_cast<std::size_t>(zv) * 3 + 2];
+    // Ignore: o, g, s, usemtl, mtllib, etc.
+  }
 
-        if (zt >= 0) {
-          vtx.uv[0] = texcoords[static_cast<std::size_t>(zt) * 2 + 0];
-          vtx.uv[1] = texcoords[static_cast<std::size_t>(zt) * 2 + 1];
-        } else {
-          vtx.uv[0] = 0.0f;
-          vtx.uv[1] = 0.0f;
-        }
+  if (out.vertices.empty()) {
+    fail("OBJ: no vertices generated: " + path);
+  }
+  if (out.indices.empty()) {
+    fail("OBJ: no faces/indices generated: " + path);
+  }
 
-        if (zn >= 0) {
-          vtx.normal[0] = normals[static_cast<std::size_t>(zn) * 3 + 0];
-          vtx.normal[1] = normals[static_cast<std::size_t>(zn) * 3 + 1];
-          vtx.normal[2] = normals[static_cast<std::size_t>(zn) * 3 + 2];
-        } else {
-          // fallback (no normals in file)
-          vtx.normal[0] = 0.0f;
-          vtx.normal[1] = 0.0f;
-          vtx.normal[2] = 1.0f;
-        }
+  out.bounds = compute_bounds(out.vertices);
+  return out;
+}
 
-        std::uint32_t const new_index = static_cast<std::uint32_t>(out.vertices.size());
-        out.vertices.push_back(vtx);
-        dedup.emplace(key, new_index);
-        return new_index;
-      };
-
-      // triangulate fan: (0, i, i+1)
-      std::uint32_t const i0 = get_or_add(face[0]);
-      for (std::size_t i = 1; i + 1 < face.size(); ++i) {
-        std::uint32_t const i1 = get_or_add(face[i]);
-        std::uint32_t const i2 = get_or_add(face[i + 1]);
-        out.indices.push_back(i0);
-        out.indices.push_back(i1);
-        out.indices.push_back(i2);
-      }
+ObjIndexedMesh ObjLoader::load_mapped(std::string const& path) {
+  CORE_ZONE("obj load_mapped");
+  MappedFile file{};
+  file.open(path);
 
-      continue;
-    }
+  ObjIndexedMesh out{};
+  Builder b(out);
 
-    // Ignore: o, g, s, usemtl, mtllib, etc.
+  std::size_t line_count = 0;
+  LineParser::Error const err = LineParser::run(file.begin(), file.end(), b, line_count);
+  if (err.what != nullptr) {
+    fail(std::string("OBJ: ") + err.what + " at line " + std::to_string(err.line));
   }
 
   if (out.vertices.empty()) {
@@ -279,7 +947,46 @@ ObjIndexedMesh ObjLoader::load(std::string const& path) {
     fail("OBJ: no faces/indices generated: " + path);
   }
 
+  out.bounds = compute_bounds(out.vertices);
   return out;
 }
 
+ObjIndexedMesh ObjLoader::load_parallel(std::string const& path, core::JobSystem& jobs) {
+  CORE_ZONE("obj load_parallel");
+  // Below this a chunk is not worth a thread.
+  constexpr std::size_t kMinChunkBytes = 4u * 1024u * 1024u;
+
+  MappedFile file{};
+  file.open(path);
+
+  std::size_t workers = std::size_t{jobs.thread_count()} + 1U;
+  workers = std::min(workers, file.size() / kMinChunkBytes + 1U);
+
+  if (workers == 1U) {
+    file.close();
+    return load_mapped(path);
+  }
+
+  return ParallelBuilder::run(jobs, file.begin(), file.end(), workers, path);
+}
+
+ObjIndexedMesh ObjLoader::load_parallel(std::string const& path, unsigned threads) {
+  std::size_t const total = (threads != 0U) ? threads : std::thread::hardware_concurrency();
+
+  core::JobSystemConfig config{};
+  config.threads = static_cast<std::uint32_t>(std::max<std::size_t>(total, 2U) - 1U);
+  config.pin_threads = false;
+
+  core::JobSystem jobs{};
+  jobs.init(config);
+  try {
+    ObjIndexedMesh out = load_parallel(path, jobs);
+    jobs.shutdown();
+    return out;
+  } catch (...) {
+    jobs.shutdown();
+    throw;
+  }
+}
+
 } // namespace assets
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
+namespace core { class JobSystem; }
+
 namespace assets {
 
 struct VertexPNUV {
@@ -12,9 +16,30 @@ struct VertexPNUV {
   float uv[2];
 };
 
+// Object-space bounds of a vertex set. The sphere is centered on the box; not
+// minimal, but one pass and stable under vertex reordering.
+struct MeshBounds {
+  float aabb_min[3] = {0.0f, 0.0f, 0.0f};
+  float aabb_max[3] = {0.0f, 0.0f, 0.0f};
+  float sphere_center[3] = {0.0f, 0.0f, 0.0f};
+  float sphere_radius = 0.0f;
+};
+
+MeshBounds compute_bounds(std::span<VertexPNUV const> vertices);
+
+// One level of detail: a range of the index buffer over the shared vertices.
+// `error` is the object-space distance the level may deviate from level 0.
+struct MeshLod {
+  std::uint32_t first_index = 0;
+  std::uint32_t index_count = 0;
+  float error = 0.0f;
+};
+
 struct ObjIndexedMesh {
   std::vector<VertexPNUV> vertices;     // deduplicated (pos, uv, normal)
   std::vector<std::uint32_t> indices;   // triangulated indices into vertices
+  MeshBounds bounds{};                  // filled by the loaders
+  std::vector<MeshLod> lods;            // filled by build_lods; empty = one level, all indices
 };
 
 class ObjLoader {
@@ -31,6 +56,20 @@ public:
   // Triangulates n-gons by fan and deduplicates by (v,vt,vn) tuple.
   static ObjIndexedMesh load(std::string const& path);
 
+  // Same grammar and identical output as load(), but parses a memory-mapped view
+  // in place (std::from_chars, no per-line/per-token allocations).
+  static ObjIndexedMesh load_mapped(std::string const& path);
+
+  // load_mapped() split across the workers of `jobs` and the calling thread:
+  // chunks are parsed independently, indices are fixed up afterwards and dedup is
+  // sharded by key hash. Output is identical to load(); small files take the
+  // serial path.
+  static ObjIndexedMesh load_parallel(std::string const& path, core::JobSystem& jobs);
+
+  // Same, on a job system of its own with `threads` threads in total (0 =
+  // hardware concurrency), for tools that have none.
+  static ObjIndexedMesh load_parallel(std::string const& path, unsigned threads = 0);
+
 private:
   struct Ref {
     std::int32_t v = 0;   // OBJ index (can be negative), 0 means missing
@@ -38,6 +77,11 @@ private:
     std::int32_t vn = 0;  // OBJ index (can be negative), 0 means missing
   };
 
+  // Defined in ObjLoader.cc.
+  struct LineParser;      // in-place tokenizer shared by the mapped loaders
+  class Builder;          // serial index resolution, dedup and triangle emission
+  class ParallelBuilder;  // chunked + sharded equivalent of Builder
+
   static Ref parse_face_ref(std::string const& token);
 
   static std::int32_t to_zero_based(std::int32_t obj_index, std::size_t count, char const* what);
@@ -0,0 +1,339 @@
+#include "assets/TextureCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace assets {
+
+namespace {
+
+[[noreturn]] void fail(std::string const& msg) {
+  throw std::runtime_error(msg);
+}
+
+constexpr char kMagic[8] = {'T', 'E', 'X', 'C', 'O', 'O', 'K', '\0'};
+constexpr std::uint64_t kBlobAlignment = 64;
+constexpr std::size_t kPageSize = 4096;
+
+std::uint64_t align_up(std::uint64_t v, std::uint64_t a) {
+  return ((v + a - 1U) / a) * a;
+}
+
+bool valid_format(std::uint32_t f) {
+  return f <= static_cast<std::uint32_t>(TextureFormat::ASTC_4x4_SRGB);
+}
+
+float srgb_to_linear(float c) {
+  return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float linear_to_srgb(float c) {
+  return (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+unsigned char to_byte(float v) {
+  return static_cast<unsigned char>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+} // namespace
+
+struct TextureCache::Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t format;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t level_count;
+  std::uint32_t pad;
+  std::uint64_t level_table_offset; // TextureCache::Level[level_count]
+  std::uint64_t reserved[2];
+};
+
+std::uint32_t block_extent(TextureFormat format) {
+  return (format == TextureFormat::RGBA8_UNORM || format == TextureFormat::RGBA8_SRGB) ? 1U : 4U;
+}
+
+std::uint32_t block_bytes(TextureFormat format) {
+  return (format == TextureFormat::RGBA8_UNORM || format == TextureFormat::RGBA8_SRGB) ? 4U : 16U;
+}
+
+bool is_srgb(TextureFormat format) {
+  return format == TextureFormat::RGBA8_SRGB || format == TextureFormat::BC7_SRGB ||
+         format == TextureFormat::ASTC_4x4_SRGB;
+}
+
+std::uint64_t level_size(TextureFormat format, std::uint32_t width, std::uint32_t height) {
+  std::uint64_t const b = block_extent(format);
+  return ((width + b - 1U) / b) * ((height + b - 1U) / b) * block_bytes(format);
+}
+
+std::uint32_t mip_count(std::uint32_t width, std::uint32_t height) {
+  std::uint32_t n = 1;
+  for (std::uint32_t m = std::max(width, height); m > 1U; m >>= 1U) {
+    ++n;
+  }
+  return n;
+}
+
+TextureData build_mips_rgba8(std::uint32_t width,
+                             std::uint32_t height,
+                             std::span<unsigned char const> pixels,
+                             TextureFormat format) {
+  if (format != TextureFormat::RGBA8_UNORM && format != TextureFormat::RGBA8_SRGB) {
+    fail("build_mips_rgba8: format must be RGBA8");
+  }
+  if (width == 0U || height == 0U || pixels.size() != std::size_t{width} * height * 4U) {
+    fail("build_mips_rgba8: pixel data does not match the extent");
+  }
+
+  bool const srgb = is_srgb(format);
+  auto const decode = [srgb](unsigned char v, int channel) {
+    float const c = static_cast<float>(v) / 255.0f;
+    return (srgb && channel < 3) ? srgb_to_linear(c) : c;
+  };
+
+  TextureData t{};
+  t.format = format;
+  t.levels.resize(mip_count(width, height));
+  t.levels[0].width = width;
+  t.levels[0].height = height;
+  t.levels[0].data.assign(pixels.begin(), pixels.end());
+
+  // Each level from the previous one; the odd row / column folds into the last
+  // texel, so a 5-wide level averages its parent's last three columns.
+  for (std::size_t l = 1; l < t.levels.size(); ++l) {
+    TextureLevel const& src = t.levels[l - 1U];
+    TextureLevel& dst = t.levels[l];
+    dst.width = std::max(1U, src.width / 2U);
+    dst.height = std::max(1U, src.height / 2U);
+    dst.data.resize(std::size_t{dst.width} * dst.height * 4U);
+
+    for (std::uint32_t y = 0; y < dst.height; ++y) {
+      std::uint32_t const y0 = std::min(y * 2U, src.height - 1U);
+      std::uint32_t const y1 = (y + 1U == dst.height) ? src.height : std::min(y * 2U + 2U, src.height);
+      for (std::uint32_t x = 0; x < dst.width; ++x) {
+        std::uint32_t const x0 = std::min(x * 2U, src.width - 1U);
+        std::uint32_t const x1 = (x + 1U == dst.width) ? src.width : std::min(x * 2U + 2U, src.width);
+
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (std::uint32_t sy = y0; sy < y1; ++sy) {
+          for (std::uint32_t sx = x0; sx < x1; ++sx) {
+            unsigned char const* p = &src.data[(std::size_t{sy} * src.width + sx) * 4U];
+            for (int c = 0; c < 4; ++c) {
+              sum[c] += decode(p[c], c);
+            }
+          }
+        }
+
+        float const inv = 1.0f / static_cast<float>((y1 - y0) * (x1 - x0));
+        unsigned char* q = &dst.data[(std::size_t{y} * dst.width + x) * 4U];
+        for (int c = 0; c < 4; ++c) {
+          float const v = sum[c] * inv;
+          q[c] = to_byte((srgb && c < 3) ? linear_to_srgb(v) : v);
+        }
+      }
+    }
+  }
+
+  return t;
+}
+
+TextureCache::~TextureCache() {
+}
+
+TextureCache::TextureCache(TextureCache&& other) noexcept {
+  *this = std::move(other);
+}
+
+TextureCache& TextureCache::operator=(TextureCache&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  file_ = std::move(other.file_);
+  header_ = other.header_;
+  levels_ = other.levels_;
+  other.header_ = nullptr;
+  other.levels_ = nullptr;
+
+  return *this;
+}
+
+void TextureCache::write(std::string const& path, TextureData const& texture) {
+  static_assert(sizeof(Header) == 56, "TextureCache header layout changed; bump kVersion");
+  static_assert(sizeof(Level) == 24, "TextureCache level layout changed; bump kVersion");
+
+  if (texture.levels.empty() || texture.levels.size() > kMaxLevels) {
+    fail("TextureCache: level count out of range: " + path);
+  }
+
+  Header h{};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  h.format = static_cast<std::uint32_t>(texture.format);
+  h.width = texture.levels[0].width;
+  h.height = texture.levels[0].height;
+  h.level_count = static_cast<std::uint32_t>(texture.levels.size());
+  h.level_table_offset = sizeof(Header);
+
+  std::vector<Level> table(texture.levels.size());
+  std::uint64_t offset = align_up(h.level_table_offset + table.size() * sizeof(Level), kBlobAlignment);
+  for (std::size_t l = texture.levels.size(); l-- > 0U;) {
+    TextureLevel const& src = texture.levels[l];
+    if (src.data.size() != level_size(texture.format, src.width, src.height)) {
+      fail("TextureCache: level " + std::to_string(l) + " has the wrong size: " + path);
+    }
+    table[l] = Level{src.width, src.height, offset, src.data.size()};
+    offset = align_up(offset + src.data.size(), kBlobAlignment);
+  }
+
+  std::string const tmp = path + ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+      fail("TextureCache: failed to create: " + tmp);
+    }
+
+    char const zeros[kBlobAlignment] = {};
+    auto pad_to = [&](std::uint64_t to) {
+      auto const at = static_cast<std::uint64_t>(ofs.tellp());
+      if (to > at) {
+        ofs.write(zeros, static_cast<std::streamsize>(to - at));
+      }
+    };
+
+    ofs.write(reinterpret_cast<char const*>(&h), sizeof(h));
+    ofs.write(reinterpret_cast<char const*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(Level)));
+    for (std::size_t l = texture.levels.size(); l-- > 0U;) {
+      pad_to(table[l].offset);
+      ofs.write(reinterpret_cast<char const*>(texture.levels[l].data.data()),
+                static_cast<std::streamsize>(texture.levels[l].data.size()));
+    }
+
+    ofs.flush();
+    if (!ofs) {
+      fail("TextureCache: write failed: " + tmp);
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+    fail("TextureCache: failed to move texture into place: " + path);
+  }
+}
+
+bool TextureCache::open(std::string const& path) {
+  close();
+
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec)) {
+    return false;
+  }
+
+  file_.open(path);
+  if (file_.size() < sizeof(Header)) {
+    close();
+    return false;
+  }
+
+  Header const* h = reinterpret_cast<Header const*>(file_.data());
+  std::uint64_t const file_size = file_.size();
+
+  bool ok = std::memcmp(h->magic, kMagic, sizeof(kMagic)) == 0
+         && h->version == kVersion
+         && valid_format(h->format)
+         && h->level_count >= 1U
+         && h->level_count <= kMaxLevels
+         && h->level_count <= mip_count(h->width, h->height)
+         && h->level_table_offset % alignof(Level) == 0U
+         && h->level_table_offset <= file_size
+         && h->level_count <= (file_size - h->level_table_offset) / sizeof(Level);
+
+  // Levels must follow the mip chain exactly and stay inside the file.
+  if (ok) {
+    auto const format = static_cast<TextureFormat>(h->format);
+    auto const* levels = reinterpret_cast<Level const*>(file_.data() + h->level_table_offset);
+    for (std::uint32_t l = 0; l < h->level_count && ok; ++l) {
+      Level const& lv = levels[l];
+      ok = lv.width == std::max(1U, h->width >> l)
+        && lv.height == std::max(1U, h->height >> l)
+        && lv.size == level_size(format, lv.width, lv.height)
+        && lv.offset % kBlobAlignment == 0U
+        && lv.offset <= file_size
+        && lv.size <= file_size - lv.offset;
+    }
+    levels_ = levels;
+  }
+
+  if (!ok) {
+    close();
+    return false;
+  }
+
+  header_ = h;
+  return true;
+}
+
+void TextureCache::close() {
+  header_ = nullptr;
+  levels_ = nullptr;
+  file_.close();
+}
+
+TextureFormat TextureCache::format() const {
+  return (header_ != nullptr) ? static_cast<TextureFormat>(header_->format) : TextureFormat::RGBA8_SRGB;
+}
+
+std::uint32_t TextureCache::width() const {
+  return (header_ != nullptr) ? header_->width : 0U;
+}
+
+std::uint32_t TextureCache::height() const {
+  return (header_ != nullptr) ? header_->height : 0U;
+}
+
+std::uint32_t TextureCache::level_count() const {
+  return (header_ != nullptr) ? header_->level_count : 0U;
+}
+
+TextureCache::Level const& TextureCache::level(std::uint32_t index) const {
+  return levels_[index];
+}
+
+std::span<unsigned char const> TextureCache::level_data(std::uint32_t index) const {
+  if (header_ == nullptr || index >= header_->level_count) {
+    return {};
+  }
+  auto const* p = reinterpret_cast<unsigned char const*>(file_.data() + levels_[index].offset);
+  return {p, static_cast<std::size_t>(levels_[index].size)};
+}
+
+void TextureCache::prefetch(std::uint32_t first) const {
+  if (header_ == nullptr) {
+    return;
+  }
+
+  // Volatile so the reads are not optimized away.
+  unsigned volatile sink = 0;
+  for (std::uint32_t l = first; l < header_->level_count; ++l) {
+    std::span<unsigned char const> const data = level_data(l);
+    for (std::size_t i = 0; i < data.size(); i += kPageSize) {
+      sink = sink + data[i];
+    }
+  }
+}
+
+} // namespace assets
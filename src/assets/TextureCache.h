@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "assets/MappedFile.h"
+
+namespace assets {
+
+// GPU formats a cooked texture may hold; the renderer maps them to VkFormat.
+// Block-compressed data is stored as produced by an external encoder.
+enum class TextureFormat : std::uint32_t {
+  RGBA8_UNORM = 0,
+  RGBA8_SRGB = 1,
+  BC7_UNORM = 2,
+  BC7_SRGB = 3,
+  ASTC_4x4_UNORM = 4,
+  ASTC_4x4_SRGB = 5,
+};
+
+// 1x1 for uncompressed formats, 4x4 for BC7 and ASTC 4x4.
+std::uint32_t block_extent(TextureFormat format);
+std::uint32_t block_bytes(TextureFormat format);
+bool is_srgb(TextureFormat format);
+
+// Bytes of one `width` x `height` level, rounded up to whole blocks.
+std::uint64_t level_size(TextureFormat format, std::uint32_t width, std::uint32_t height);
+
+// Full chain length, floor(log2(max(w, h))) + 1; level n is max(1, w >> n) wide.
+std::uint32_t mip_count(std::uint32_t width, std::uint32_t height);
+
+struct TextureLevel {
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  std::vector<unsigned char> data;
+};
+
+// CPU-side texture, level 0 first.
+struct TextureData {
+  TextureFormat format = TextureFormat::RGBA8_SRGB;
+  std::vector<TextureLevel> levels;
+};
+
+// Box-filtered chain down to 1x1 from RGBA8 `pixels` (tightly packed). sRGB
+// formats are filtered in linear space.
+TextureData build_mips_rgba8(std::uint32_t width,
+                             std::uint32_t height,
+                             std::span<unsigned char const> pixels,
+                             TextureFormat format = TextureFormat::RGBA8_SRGB);
+
+// Cooked texture container:
+//   Header | level table (level 0 first) | level blobs, coarsest first
+// The coarse tail sits at the front of the file, so streaming in the first
+// levels touches one small contiguous range. Blobs are 64-byte aligned so the
+// mapping can be copied into staging as is.
+class TextureCache {
+public:
+  static constexpr std::uint32_t kVersion = 1;
+  static constexpr std::uint32_t kMaxLevels = 16;
+
+  struct Level {
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint64_t offset = 0; // from file start
+    std::uint64_t size = 0;
+  };
+
+public:
+  TextureCache() = default;
+  ~TextureCache();
+
+  TextureCache(TextureCache const&) = delete;
+  TextureCache& operator=(TextureCache const&) = delete;
+
+  TextureCache(TextureCache&& other) noexcept;
+  TextureCache& operator=(TextureCache&& other) noexcept;
+
+  // Writes to a temporary file and renames it into place.
+  static void write(std::string const& path, TextureData const& texture);
+
+  // Maps `path` and validates header and level bounds; returns false if the
+  // file is missing, from another version, or malformed.
+  bool open(std::string const& path);
+  void close();
+
+  bool is_open() const { return header_ != nullptr; }
+
+  TextureFormat format() const;
+  std::uint32_t width() const;
+  std::uint32_t height() const;
+  std::uint32_t level_count() const;
+
+  Level const& level(std::uint32_t index) const;
+  std::span<unsigned char const> level_data(std::uint32_t index) const;
+
+  // Reads one byte per page of levels [first, level_count()), so a later copy
+  // out of the mapping does not stall on disk. For worker threads.
+  void prefetch(std::uint32_t first) const;
+
+private:
+  struct Header;
+
+  MappedFile file_{};
+  Header const* header_ = nullptr;
+  Level const* levels_ = nullptr;
+};
+
+} // namespace assets
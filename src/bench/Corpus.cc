@@ -0,0 +1,348 @@
+#include "bench/Corpus.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+// Bumped whenever the generator's output changes, so stale files are not reused.
+constexpr int kCorpusVersion = 1;
+
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+struct Layout {
+  std::uint64_t width = 0;  // cells
+  std::uint64_t height = 0;
+  std::uint32_t extra = 0;  // points on each cell's bottom edge
+  std::uint64_t faces = 0;
+  std::uint64_t triangles = 0;
+  std::uint64_t corners = 0;
+};
+
+Layout layout_of(CorpusSpec const& spec) {
+  if (spec.face_sides < 3U) {
+    fail("corpus: face_sides must be at least 3");
+  }
+
+  std::uint64_t const per_cell = (spec.face_sides == 3U) ? 2U : spec.face_sides - 2U; // triangles
+  std::uint64_t const cells = std::max<std::uint64_t>(1U, (spec.triangles + per_cell - 1U) / per_cell);
+
+  Layout l{};
+  l.width = static_cast<std::uint64_t>(std::ceil(std::sqrt(static_cast<double>(cells))));
+  l.height = (cells + l.width - 1U) / l.width;
+  l.extra = (spec.face_sides > 4U) ? spec.face_sides - 4U : 0U;
+  l.faces = l.width * l.height * ((spec.face_sides == 3U) ? 2U : 1U);
+  l.triangles = l.width * l.height * per_cell;
+  l.corners = l.faces * spec.face_sides;
+  return l;
+}
+
+struct Point {
+  float pos[3];
+  float normal[3];
+  float uv[2];
+};
+
+// A gentle height field over [-1, 1]^2, with its analytic normal.
+Point surface(double u, double v) {
+  double const x = u * 2.0 - 1.0;
+  double const z = v * 2.0 - 1.0;
+  double const y = 0.05 * std::sin(6.0 * x) * std::cos(6.0 * z);
+  double const dx = 0.30 * std::cos(6.0 * x) * std::cos(6.0 * z);
+  double const dz = -0.30 * std::sin(6.0 * x) * std::sin(6.0 * z);
+  double const len = std::sqrt(dx * dx + 1.0 + dz * dz);
+
+  Point p{};
+  p.pos[0] = static_cast<float>(x);
+  p.pos[1] = static_cast<float>(y);
+  p.pos[2] = static_cast<float>(z);
+  p.normal[0] = static_cast<float>(-dx / len);
+  p.normal[1] = static_cast<float>(1.0 / len);
+  p.normal[2] = static_cast<float>(-dz / len);
+  p.uv[0] = static_cast<float>(u);
+  p.uv[1] = static_cast<float>(v);
+  return p;
+}
+
+// Buffered writer; std::to_chars keeps a 50M-triangle file to seconds.
+class ObjWriter {
+public:
+  explicit ObjWriter(std::FILE* f) : f_(f) { buf_.reserve(kFlushAt + 256U); }
+
+  ~ObjWriter() { flush(); }
+
+  ObjWriter(ObjWriter const&) = delete;
+  ObjWriter& operator=(ObjWriter const&) = delete;
+
+  void text(char const* s) {
+    while (*s != '\0') {
+      buf_.push_back(*s++);
+    }
+  }
+
+  void number(float v) {
+    char tmp[32];
+    auto const r = std::to_chars(tmp, tmp + sizeof(tmp), v, std::chars_format::fixed, 5);
+    buf_.append(tmp, r.ptr);
+  }
+
+  void number(std::int64_t v) {
+    char tmp[24];
+    auto const r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+    buf_.append(tmp, r.ptr);
+  }
+
+  void vertex(Point const& p, CorpusSpec const& spec) {
+    line3("v ", p.pos);
+    if (spec.texcoords) {
+      text("vt ");
+      number(p.uv[0]);
+      text(" ");
+      number(p.uv[1]);
+      text("\n");
+    }
+    if (spec.normals) {
+      line3("vn ", p.normal);
+    }
+  }
+
+  // `index` is used for every attribute present (shared grid, or negative
+  // relative indices in soup mode).
+  void corner(std::int64_t index, CorpusSpec const& spec) {
+    text(" ");
+    number(index);
+    if (spec.texcoords || spec.normals) {
+      text("/");
+      if (spec.texcoords) {
+        number(index);
+      }
+      if (spec.normals) {
+        text("/");
+        number(index);
+      }
+    }
+  }
+
+  void end_line() {
+    text("\n");
+    if (buf_.size() >= kFlushAt) {
+      flush();
+    }
+  }
+
+  void flush() {
+    if (!buf_.empty() && std::fwrite(buf_.data(), 1, buf_.size(), f_) != buf_.size()) {
+      failed_ = true;
+    }
+    buf_.clear();
+  }
+
+  bool failed() const { return failed_; }
+
+private:
+  static constexpr std::size_t kFlushAt = 1U << 20;
+
+  void line3(char const* prefix, float const* v) {
+    text(prefix);
+    number(v[0]);
+    text(" ");
+    number(v[1]);
+    text(" ");
+    number(v[2]);
+    text("\n");
+  }
+
+  std::FILE* f_ = nullptr;
+  std::string buf_;
+  bool failed_ = false;
+};
+
+void write_obj(std::FILE* f, CorpusSpec const& spec, Layout const& l) {
+  ObjWriter w(f);
+  w.text("# generated benchmark corpus\n");
+
+  double const du = 1.0 / static_cast<double>(l.width);
+  double const dv = 1.0 / static_cast<double>(l.height);
+
+  auto const extra_point = [&](std::uint64_t x, std::uint64_t y, std::uint32_t e) {
+    // Bulged below the edge so no fan triangle is degenerate.
+    double const t = static_cast<double>(e + 1U) / static_cast<double>(l.extra + 1U);
+    return surface((static_cast<double>(x) + t) * du, (static_cast<double>(y) - 0.25) * dv);
+  };
+
+  if (spec.shared) {
+    std::uint64_t const row = l.width + 1U;
+    for (std::uint64_t y = 0; y <= l.height; ++y) {
+      for (std::uint64_t x = 0; x <= l.width; ++x) {
+        w.vertex(surface(static_cast<double>(x) * du, static_cast<double>(y) * dv), spec);
+        w.end_line();
+      }
+    }
+    std::uint64_t const extra_base = row * (l.height + 1U);
+    for (std::uint64_t y = 0; y < l.height; ++y) {
+      for (std::uint64_t x = 0; x < l.width; ++x) {
+        for (std::uint32_t e = 0; e < l.extra; ++e) {
+          w.vertex(extra_point(x, y, e), spec);
+          w.end_line();
+        }
+      }
+    }
+
+    for (std::uint64_t y = 0; y < l.height; ++y) {
+      for (std::uint64_t x = 0; x < l.width; ++x) {
+        auto const g = [&](std::uint64_t gx, std::uint64_t gy) { return static_cast<std::int64_t>(gy * row + gx + 1U); };
+        std::int64_t const bl = g(x, y);
+        std::int64_t const br = g(x + 1U, y);
+        std::int64_t const tr = g(x + 1U, y + 1U);
+        std::int64_t const tl = g(x, y + 1U);
+
+        if (spec.face_sides == 3U) {
+          w.text("f");
+          w.corner(bl, spec);
+          w.corner(br, spec);
+          w.corner(tr, spec);
+          w.end_line();
+          w.text("f");
+          w.corner(bl, spec);
+          w.corner(tr, spec);
+          w.corner(tl, spec);
+          w.end_line();
+          continue;
+        }
+
+        std::int64_t const first_extra = static_cast<std::int64_t>(extra_base + (y * l.width + x) * l.extra + 1U);
+        w.text("f");
+        w.corner(tl, spec);
+        w.corner(bl, spec);
+        for (std::uint32_t e = 0; e < l.extra; ++e) {
+          w.corner(first_extra + e, spec);
+        }
+        w.corner(br, spec);
+        w.corner(tr, spec);
+        w.end_line();
+      }
+    }
+  } else {
+    // Soup: each face writes its own corners right before it and refers to
+    // them relatively, the way many exporters do.
+    std::vector<Point> polys[2];
+    for (std::uint64_t y = 0; y < l.height; ++y) {
+      for (std::uint64_t x = 0; x < l.width; ++x) {
+        auto const grid = [&](std::uint64_t gx, std::uint64_t gy) {
+          return surface(static_cast<double>(gx) * du, static_cast<double>(gy) * dv);
+        };
+        Point const bl = grid(x, y);
+        Point const br = grid(x + 1U, y);
+        Point const tr = grid(x + 1U, y + 1U);
+        Point const tl = grid(x, y + 1U);
+
+        polys[1].clear();
+        if (spec.face_sides == 3U) {
+          polys[0] = {bl, br, tr};
+          polys[1] = {bl, tr, tl};
+        } else {
+          polys[0] = {tl, bl};
+          for (std::uint32_t e = 0; e < l.extra; ++e) {
+            polys[0].push_back(extra_point(x, y, e));
+          }
+          polys[0].push_back(br);
+          polys[0].push_back(tr);
+        }
+
+        for (std::vector<Point> const& poly : polys) {
+          if (poly.empty()) {
+            continue;
+          }
+          for (Point const& p : poly) {
+            w.vertex(p, spec);
+          }
+          w.text("f");
+          std::int64_t const n = static_cast<std::int64_t>(poly.size());
+          for (std::int64_t i = 0; i < n; ++i) {
+            w.corner(i - n, spec);
+          }
+          w.end_line();
+        }
+      }
+    }
+  }
+
+  w.flush();
+  if (w.failed()) {
+    fail("corpus: write failed");
+  }
+}
+
+} // namespace
+
+std::string corpus_name(CorpusSpec const& spec) {
+  std::string name = "c" + std::to_string(kCorpusVersion) + "_";
+  if (spec.face_sides == 3U) {
+    name += "tri";
+  } else if (spec.face_sides == 4U) {
+    name += "quad";
+  } else {
+    name += "ngon" + std::to_string(spec.face_sides);
+  }
+  name += "_" + std::to_string(spec.triangles) + "_p";
+  if (spec.texcoords) {
+    name += "t";
+  }
+  if (spec.normals) {
+    name += "n";
+  }
+  name += spec.shared ? "_shared" : "_soup";
+  return name;
+}
+
+CorpusFile make_corpus(std::string const& dir, CorpusSpec const& spec) {
+  Layout const l = layout_of(spec);
+
+  CorpusFile out{};
+  out.path = (std::filesystem::path(dir) / (corpus_name(spec) + ".obj")).string();
+  out.triangles = l.triangles;
+  out.corners = l.corners;
+
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    fail("corpus: cannot create " + dir + ": " + ec.message());
+  }
+
+  if (!std::filesystem::exists(out.path, ec)) {
+    std::string const tmp = out.path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+      fail("corpus: cannot open " + tmp);
+    }
+    try {
+      write_obj(f, spec, l);
+    } catch (...) {
+      std::fclose(f);
+      std::filesystem::remove(tmp, ec);
+      throw;
+    }
+    if (std::fclose(f) != 0) {
+      fail("corpus: cannot close " + tmp);
+    }
+    std::filesystem::rename(tmp, out.path, ec);
+    if (ec) {
+      fail("corpus: cannot rename " + tmp + ": " + ec.message());
+    }
+  }
+
+  out.bytes = static_cast<std::uint64_t>(std::filesystem::file_size(out.path));
+  return out;
+}
+
+} // namespace bench
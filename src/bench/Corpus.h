@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace bench {
+
+// One generated OBJ: a wavy grid, so every file of a given spec is identical
+// across runs and machines.
+struct CorpusSpec {
+  std::uint64_t triangles = 1000; // rounded up to whole faces and grid rows
+  bool normals = true;
+  bool texcoords = true;
+  // 3 splits each grid cell in two triangles, 4 keeps quads, more adds points
+  // along the cell's bottom edge (fan-triangulated by the loader).
+  std::uint32_t face_sides = 3;
+  // false writes every face corner as its own v/vt/vn, so the loader's dedup
+  // merges nothing; true shares them between neighbouring faces.
+  bool shared = true;
+};
+
+struct CorpusFile {
+  std::string path;
+  std::uint64_t bytes = 0;
+  std::uint64_t triangles = 0; // after triangulation
+  std::uint64_t corners = 0;   // face corners the loader has to deduplicate
+};
+
+// e.g. "c1_tri_1000_ptn_shared"; the file name without extension. The leading
+// generator version keeps stale files from being reused.
+std::string corpus_name(CorpusSpec const& spec);
+
+// Writes `spec` to `dir`/<corpus_name>.obj unless that file is already there
+// (the output is deterministic). Creates `dir`. Throws on I/O errors.
+CorpusFile make_corpus(std::string const& dir, CorpusSpec const& spec);
+
+} // namespace bench
@@ -0,0 +1,146 @@
+#include "bench/Harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace bench {
+
+namespace {
+
+double percentile(std::vector<double> const& sorted, double p) {
+  std::size_t const rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+  return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1U)) - 1U];
+}
+
+// Names and tags are ours; escaping quotes and backslashes is enough.
+std::string json_string(std::string const& s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  out += '"';
+  return out;
+}
+
+} // namespace
+
+Stats summarize(std::vector<double>& samples_ms) {
+  Stats s{};
+  if (samples_ms.empty()) {
+    return s;
+  }
+
+  std::sort(samples_ms.begin(), samples_ms.end());
+  double sum = 0.0;
+  for (double v : samples_ms) {
+    sum += v;
+  }
+
+  s.samples = samples_ms.size();
+  s.min_ms = samples_ms.front();
+  s.median_ms = percentile(samples_ms, 0.5);
+  s.p99_ms = percentile(samples_ms, 0.99);
+  s.mean_ms = sum / static_cast<double>(samples_ms.size());
+  return s;
+}
+
+double now_ms() {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<double> measure(std::function<void()> const& fn,
+                            std::size_t min_iterations,
+                            std::size_t max_iterations,
+                            double min_seconds) {
+  std::vector<double> samples;
+  samples.reserve(max_iterations);
+
+  double const start = now_ms();
+  while (samples.size() < max_iterations) {
+    double const t0 = now_ms();
+    fn();
+    double const t1 = now_ms();
+    samples.push_back(t1 - t0);
+
+    if (samples.size() >= min_iterations && (t1 - start) >= min_seconds * 1000.0) {
+      break;
+    }
+  }
+  return samples;
+}
+
+std::uint64_t peak_rss_bytes() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS pmc{};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) == 0) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(pmc.PeakWorkingSetSize);
+#else
+  rusage ru{};
+  if (getrusage(RUSAGE_SELF, &ru) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return static_cast<std::uint64_t>(ru.ru_maxrss); // bytes
+#else
+  return static_cast<std::uint64_t>(ru.ru_maxrss) * 1024U; // kilobytes
+#endif
+#endif
+}
+
+Report::Report(std::FILE* out, std::string tag)
+  : out_(out), tag_(std::move(tag)) {
+}
+
+void Report::add(Result const& r) {
+  double const seconds = r.stats.median_ms * 1e-3;
+  double const mb_per_s = (r.bytes > 0.0 && seconds > 0.0) ? r.bytes / (1024.0 * 1024.0) / seconds : 0.0;
+  double const items_per_s = (r.items > 0.0 && seconds > 0.0) ? r.items / seconds : 0.0;
+  double const rss_mb = static_cast<double>(peak_rss_bytes()) / (1024.0 * 1024.0);
+
+  std::string params;
+  for (auto const& [key, value] : r.params) {
+    char num[64];
+    std::snprintf(num, sizeof(num), "%.17g", value);
+    params += (params.empty() ? "" : ",") + json_string(key) + ":" + num;
+  }
+
+  std::fprintf(out_,
+               "{\"suite\":%s,\"name\":%s,\"tag\":%s,\"params\":{%s},"
+               "\"samples\":%zu,\"median_ms\":%.6f,\"p99_ms\":%.6f,\"min_ms\":%.6f,\"mean_ms\":%.6f,"
+               "\"mb_per_s\":%.3f,\"items_per_s\":%.3f,\"item_unit\":%s,\"peak_rss_mb\":%.1f}\n",
+               json_string(r.suite).c_str(), json_string(r.name).c_str(), json_string(tag_).c_str(), params.c_str(),
+               r.stats.samples, r.stats.median_ms, r.stats.p99_ms, r.stats.min_ms, r.stats.mean_ms,
+               mb_per_s, items_per_s, json_string(r.item_unit).c_str(), rss_mb);
+  std::fflush(out_);
+
+  std::fprintf(stderr, "%-7s %-28s median %10.3f ms  p99 %10.3f ms", r.suite.c_str(), r.name.c_str(),
+               r.stats.median_ms, r.stats.p99_ms);
+  if (mb_per_s > 0.0) {
+    std::fprintf(stderr, "  %9.1f MB/s", mb_per_s);
+  }
+  if (items_per_s > 0.0) {
+    std::fprintf(stderr, "  %12.0f %s/s", items_per_s, r.item_unit.c_str());
+  }
+  std::fprintf(stderr, "  rss %.0f MB\n", rss_mb);
+}
+
+} // namespace bench
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+struct Stats {
+  double median_ms = 0.0;
+  double p99_ms = 0.0;
+  double min_ms = 0.0;
+  double mean_ms = 0.0;
+  std::size_t samples = 0;
+};
+
+// Order statistics of `samples_ms` (nearest rank; reordered in place).
+Stats summarize(std::vector<double>& samples_ms);
+
+// Times fn() until at least `min_iterations` runs and `min_seconds` have
+// passed, or `max_iterations` runs, whichever comes first; one sample per run.
+std::vector<double> measure(std::function<void()> const& fn,
+                            std::size_t min_iterations,
+                            std::size_t max_iterations,
+                            double min_seconds);
+
+double now_ms();
+
+// High-water mark of the process's resident set, in bytes; 0 where unknown.
+// Monotonic over the run, so a suite's value includes every earlier one.
+std::uint64_t peak_rss_bytes();
+
+struct Result {
+  std::string suite;
+  std::string name;
+  std::vector<std::pair<std::string, double>> params; // sizes, counts, flags (0/1)
+  Stats stats{};
+  double bytes = 0.0;     // per sample; 0 leaves MB/s out
+  double items = 0.0;     // per sample (triangles, frames, ...); 0 leaves items/s out
+  std::string item_unit;
+};
+
+// One JSON object per line: suite, name, tag, params, the stats, MB/s,
+// items/s and peak RSS. Values are plain numbers, so runs on different commits
+// can be diffed or loaded into a dataframe directly. A short line per result
+// also goes to stderr.
+class Report {
+public:
+  Report(std::FILE* out, std::string tag);
+
+  void add(Result const& r);
+
+private:
+  std::FILE* out_ = nullptr; // not owned
+  std::string tag_;
+};
+
+} // namespace bench
@@ -0,0 +1,471 @@
+// Benchmarks for the asset and rendering hot paths. Results go to stdout (or
+// --out) as JSON lines, one per measurement; see bench/Harness.h.
+//
+//   bench [--quick | --full] [--suite loader|dedup|upload|frame]...
+//         [--out results.jsonl] [--tag name] [--corpus-dir dir]
+//
+// The OBJ corpus is generated into --corpus-dir on first use and reused after.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "app/Support.h"
+#include "assets/ObjLoader.h"
+#include "bench/Corpus.h"
+#include "bench/Harness.h"
+#include "gfx/Context.h"
+#include "gfx/Depth.h"
+#include "gfx/DrawList.h"
+#include "gfx/Mesh.h"
+#include "gfx/OffscreenTarget.h"
+#include "gfx/Pipeline.h"
+#include "gfx/Renderer.h"
+#include "gfx/Upload.h"
+#include "math/Camera.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+enum class Tier { Quick, Default, Full };
+
+struct Options {
+  Tier tier = Tier::Default;
+  std::vector<std::string> suites; // empty = all
+  std::string out_path;            // empty = stdout
+  std::string tag;
+  std::string corpus_dir = "bench_corpus";
+};
+
+bool wants(Options const& o, char const* suite) {
+  if (o.suites.empty()) {
+    return true;
+  }
+  for (std::string const& s : o.suites) {
+    if (s == suite) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Triangle counts of the size sweep. 10M and 50M take minutes to generate and
+// gigabytes to load, so only --full runs them.
+std::vector<std::uint64_t> sizes(Tier tier) {
+  switch (tier) {
+    case Tier::Quick: return {1000, 10000, 100000};
+    case Tier::Default: return {1000, 10000, 100000, 1000000};
+    case Tier::Full: return {1000, 10000, 100000, 1000000, 10000000, 50000000};
+  }
+  return {};
+}
+
+// Enough repetitions for a stable median on small inputs, at least three on
+// the big ones.
+std::vector<double> repeat(std::function<void()> const& fn) {
+  return bench::measure(fn, 3, 200, 1.0);
+}
+
+bench::Result corpus_result(char const* suite, std::string name, bench::CorpusFile const& file,
+                            bench::CorpusSpec const& spec) {
+  bench::Result r{};
+  r.suite = suite;
+  r.name = std::move(name);
+  r.params = {{"triangles", static_cast<double>(file.triangles)},
+              {"corners", static_cast<double>(file.corners)},
+              {"file_bytes", static_cast<double>(file.bytes)},
+              {"face_sides", static_cast<double>(spec.face_sides)},
+              {"normals", spec.normals ? 1.0 : 0.0},
+              {"texcoords", spec.texcoords ? 1.0 : 0.0},
+              {"shared", spec.shared ? 1.0 : 0.0}};
+  return r;
+}
+
+bench::CorpusFile corpus(Options const& o, bench::CorpusSpec const& spec) {
+  double const t0 = bench::now_ms();
+  bench::CorpusFile const f = bench::make_corpus(o.corpus_dir, spec);
+  double const ms = bench::now_ms() - t0;
+  if (ms > 1000.0) {
+    std::fprintf(stderr, "corpus  %s generated in %.1f s\n", f.path.c_str(), ms * 1e-3);
+  }
+  return f;
+}
+
+// ---- loader: parse throughput of the three entry points -----------------------
+
+using LoadFn = assets::ObjIndexedMesh (*)(std::string const&);
+
+assets::ObjIndexedMesh load_parallel_default(std::string const& path) {
+  return assets::ObjLoader::load_parallel(path);
+}
+
+struct Loader {
+  char const* name;
+  LoadFn fn;
+};
+
+constexpr Loader kLoaders[] = {
+  {"load", &assets::ObjLoader::load},
+  {"load_mapped", &assets::ObjLoader::load_mapped},
+  {"load_parallel", &load_parallel_default},
+};
+
+void run_load(bench::Report& report, char const* suite, Loader const& loader, bench::CorpusFile const& file,
+              bench::CorpusSpec const& spec, char const* item_unit, double items) {
+  std::size_t vertices = 0;
+  std::vector<double> samples = repeat([&]() {
+    assets::ObjIndexedMesh const m = loader.fn(file.path);
+    vertices = m.vertices.size();
+  });
+
+  bench::Result r = corpus_result(suite, std::string(loader.name) + "/" + bench::corpus_name(spec), file, spec);
+  r.params.emplace_back("vertices", static_cast<double>(vertices));
+  r.stats = bench::summarize(samples);
+  r.bytes = static_cast<double>(file.bytes);
+  r.items = items;
+  r.item_unit = item_unit;
+  report.add(r);
+}
+
+void suite_loader(Options const& o, bench::Report& report) {
+  for (std::uint64_t triangles : sizes(o.tier)) {
+    bench::CorpusSpec spec{};
+    spec.triangles = triangles;
+    bench::CorpusFile const file = corpus(o, spec);
+    for (Loader const& loader : kLoaders) {
+      run_load(report, "loader", loader, file, spec, "triangles", static_cast<double>(file.triangles));
+    }
+  }
+
+  // Attribute and face-shape variants at one mid size: fewer tokens per corner,
+  // and fan triangulation of quads and hexagons.
+  bench::CorpusSpec variants[5]{};
+  variants[0].normals = false;
+  variants[0].texcoords = false;
+  variants[1].normals = false;
+  variants[2].texcoords = false;
+  variants[3].face_sides = 4;
+  variants[4].face_sides = 6;
+  for (bench::CorpusSpec& spec : variants) {
+    spec.triangles = 100000;
+    bench::CorpusFile const file = corpus(o, spec);
+    for (Loader const& loader : kLoaders) {
+      run_load(report, "loader", loader, file, spec, "triangles", static_cast<double>(file.triangles));
+    }
+  }
+}
+
+// ---- dedup: shared corners (most merge) against a soup (none merge) -----------
+
+void suite_dedup(Options const& o, bench::Report& report) {
+  for (std::uint64_t triangles : sizes(o.tier)) {
+    for (bool shared : {true, false}) {
+      bench::CorpusSpec spec{};
+      spec.triangles = triangles;
+      spec.shared = shared;
+      bench::CorpusFile const file = corpus(o, spec);
+      // The serial mapped loader shows the hash map alone; the parallel one its
+      // sharded version.
+      for (Loader const& loader : {kLoaders[1], kLoaders[2]}) {
+        run_load(report, "dedup", loader, file, spec, "corners", static_cast<double>(file.corners));
+      }
+    }
+  }
+}
+
+// ---- GPU suites ---------------------------------------------------------------
+
+bool init_headless(gfx::Context& ctx) {
+  try {
+    gfx::ContextCreateInfo ci{};
+    ci.enable_validation = false; // measuring, not debugging
+    ci.enable_debug_utils = false;
+    ctx.init(ci);
+    return true;
+  } catch (std::exception const& e) {
+    std::fprintf(stderr, "GPU suites skipped: headless init failed: %s\n", e.what());
+    ctx.shutdown();
+    return false;
+  }
+}
+
+// Everything a mesh upload moves: vertex data in the uploaded format plus
+// indices at the chosen width.
+double upload_bytes(gfx::Mesh const& mesh) {
+  std::size_t const vertex_size = (mesh.vertex_format() == gfx::VertexFormat::Quantized)
+    ? sizeof(gfx::VertexQuantized) : sizeof(gfx::Vertex);
+  std::size_t const index_size = (mesh.index_type() == VK_INDEX_TYPE_UINT16) ? 2U : 4U;
+  return static_cast<double>(mesh.vertex_count()) * static_cast<double>(vertex_size) +
+    static_cast<double>(mesh.index_count()) * static_cast<double>(index_size);
+}
+
+// Mesh::init_from_data through the staging ring to device-local memory, until
+// the copy has finished on the GPU. Quantized includes the encode on the CPU.
+void suite_upload(Options const& o, gfx::Context& ctx, bench::Report& report) {
+  for (std::uint64_t triangles : sizes(o.tier)) {
+    if (triangles > 10000000U) {
+      continue; // a 50M mesh does not fit every device; 10M covers the large-copy regime
+    }
+
+    bench::CorpusSpec spec{};
+    spec.triangles = triangles;
+    bench::CorpusFile const file = corpus(o, spec);
+    assets::ObjIndexedMesh const om = assets::ObjLoader::load_parallel(file.path);
+
+    for (gfx::VertexFormat format : {gfx::VertexFormat::Float32, gfx::VertexFormat::Quantized}) {
+      double bytes = 0.0;
+      std::vector<double> samples;
+      double const start = bench::now_ms();
+      while (samples.size() < 200U && (samples.size() < 3U || bench::now_ms() - start < 1000.0)) {
+        gfx::Mesh mesh{};
+        double const t0 = bench::now_ms();
+        mesh.init_from_data(ctx, ctx.uploader(), om.vertices, om.indices, format);
+        ctx.uploader().wait(ctx, ctx.uploader().flush(ctx));
+        samples.push_back(bench::now_ms() - t0);
+
+        bytes = upload_bytes(mesh);
+        mesh.shutdown(ctx);
+      }
+
+      bench::Result r{};
+      r.suite = "upload";
+      r.name = std::string((format == gfx::VertexFormat::Quantized) ? "quantized/" : "float32/") +
+        bench::corpus_name(spec);
+      r.params = {{"triangles", static_cast<double>(file.triangles)},
+                  {"vertices", static_cast<double>(om.vertices.size())},
+                  {"quantized", (format == gfx::VertexFormat::Quantized) ? 1.0 : 0.0}};
+      r.stats = bench::summarize(samples);
+      r.bytes = bytes;
+      r.items = static_cast<double>(file.triangles);
+      r.item_unit = "triangles";
+      report.add(r);
+    }
+  }
+}
+
+constexpr gfx::FramePacing kFramePacing{3, false};
+constexpr std::uint32_t kWarmupFrames = 30;
+
+// Instances on a square grid filling [-10, 10] in x/z, whatever their number.
+std::vector<glm::mat4> grid_instances(std::uint32_t count) {
+  std::uint32_t side = 1;
+  while (side * side < count) {
+    ++side;
+  }
+  float const cell = 20.0f / static_cast<float>(side);
+  float const scale = cell * 0.4f; // meshes span [-1, 1]
+
+  std::vector<glm::mat4> out;
+  out.reserve(count);
+  for (std::uint32_t i = 0; i < count; ++i) {
+    glm::vec3 const pos(-10.0f + (static_cast<float>(i % side) + 0.5f) * cell,
+                        0.0f,
+                        -10.0f + (static_cast<float>(i / side) + 0.5f) * cell);
+    out.push_back(glm::scale(glm::translate(glm::mat4(1.0f), pos), glm::vec3(scale)));
+  }
+  return out;
+}
+
+struct FrameConfig {
+  std::uint32_t draws = 1;
+  std::uint32_t instances = 1; // per draw
+  bool readback = false;
+};
+
+// Steady-state interval between offscreen frames (the slot wait included, so
+// it is whichever of CPU recording and GPU execution is slower).
+void run_frames(gfx::Context& ctx, std::span<gfx::Mesh const> meshes, FrameConfig const& fc, bench::Report& report) {
+  gfx::OffscreenTarget target{};
+  gfx::Depth depth{};
+  gfx::Pipeline pl{};
+  gfx::Renderer rd{};
+
+  gfx::OffscreenConfig oc{};
+  oc.image_count = kFramePacing.frames_in_flight;
+  oc.readback = fc.readback;
+  target.init(ctx, oc);
+  depth.init(ctx, target.extent());
+
+  gfx::PipelineState state{};
+  state.vert_spv_path = app::shader_vert_path();
+  state.frag_spv_path = app::shader_frag_path();
+  pl.init(ctx, target, depth.format(), state);
+  rd.init(ctx, target, pl, depth, 1, kFramePacing);
+
+  math::Camera cam{};
+  cam.set_perspective(60.0f * 3.1415926535f / 180.0f, 0.1f, 100.0f);
+  cam.set_look_at(glm::vec3(0.0f, 14.0f, 18.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+  double readback_bytes = 0.0;
+  target.set_readback_handler([&](gfx::Readback const& r) {
+    readback_bytes = static_cast<double>(r.row_pitch) * static_cast<double>(r.extent.height);
+  });
+
+  // Each draw gets its own slice of the grid, cycling through the meshes.
+  std::vector<glm::mat4> const models = grid_instances(fc.draws * fc.instances);
+  gfx::DrawList list{};
+  for (std::uint32_t d = 0; d < fc.draws; ++d) {
+    list.add(meshes[d % meshes.size()],
+             std::span<glm::mat4 const>(models).subspan(static_cast<std::size_t>(d) * fc.instances, fc.instances));
+  }
+
+  for (std::uint32_t i = 0; i < kWarmupFrames; ++i) {
+    (void)rd.draw_frame(ctx, target, pl, list, cam, depth);
+  }
+  std::vector<double> samples = bench::measure([&]() { (void)rd.draw_frame(ctx, target, pl, list, cam, depth); },
+                                               100, 2000, 2.0);
+  rd.finish(ctx, target);
+
+  bench::Result r{};
+  r.suite = "frame";
+  r.name = "d" + std::to_string(fc.draws) + "_i" + std::to_string(fc.instances) + (fc.readback ? "_readback" : "");
+  r.params = {{"draws", static_cast<double>(fc.draws)},
+              {"instances", static_cast<double>(fc.instances)},
+              {"readback", fc.readback ? 1.0 : 0.0},
+              {"width", static_cast<double>(target.extent().width)},
+              {"height", static_cast<double>(target.extent().height)}};
+  r.stats = bench::summarize(samples);
+  r.bytes = readback_bytes;
+  r.items = 1.0;
+  r.item_unit = "frames";
+  report.add(r);
+
+  rd.shutdown(ctx);
+  pl.shutdown(ctx);
+  depth.shutdown(ctx);
+  target.shutdown(ctx);
+}
+
+void suite_frame(Options const& o, gfx::Context& ctx, bench::Report& report) {
+  // Small meshes, so the sweep measures per-draw and per-instance cost more
+  // than raster throughput.
+  std::vector<gfx::Mesh> meshes;
+  for (std::uint64_t triangles : {200U, 500U, 1000U}) {
+    bench::CorpusSpec spec{};
+    spec.triangles = triangles;
+    assets::ObjIndexedMesh const om = assets::ObjLoader::load_mapped(corpus(o, spec).path);
+    meshes.emplace_back();
+    meshes.back().init_from_data(ctx, ctx.uploader(), om.vertices, om.indices);
+  }
+  ctx.uploader().wait(ctx, ctx.uploader().flush(ctx));
+
+  std::vector<std::uint32_t> const draw_counts = (o.tier == Tier::Quick)
+    ? std::vector<std::uint32_t>{1, 100} : std::vector<std::uint32_t>{1, 10, 100, 1000};
+  std::vector<std::uint32_t> const instance_counts = (o.tier == Tier::Quick)
+    ? std::vector<std::uint32_t>{1, 256} : std::vector<std::uint32_t>{1, 16, 256};
+
+  try {
+    for (std::uint32_t draws : draw_counts) {
+      for (std::uint32_t instances : instance_counts) {
+        run_frames(ctx, meshes, FrameConfig{draws, instances, false}, report);
+      }
+    }
+    // What the headless app pays on top: a full-frame copy to the host each frame.
+    run_frames(ctx, meshes, FrameConfig{100, 16, true}, report);
+  } catch (...) {
+    for (gfx::Mesh& m : meshes) {
+      m.shutdown(ctx);
+    }
+    throw;
+  }
+
+  for (gfx::Mesh& m : meshes) {
+    m.shutdown(ctx);
+  }
+}
+
+Options parse_args(int argc, char** argv) {
+  char const* const usage =
+    "usage: bench [--quick | --full] [--suite loader|dedup|upload|frame]... "
+    "[--out file.jsonl] [--tag name] [--corpus-dir dir]";
+
+  Options o{};
+  for (int i = 1; i < argc; ++i) {
+    char const* arg = argv[i];
+    bool const has_value = (i + 1) < argc;
+    if (std::strcmp(arg, "--quick") == 0) {
+      o.tier = Tier::Quick;
+    } else if (std::strcmp(arg, "--full") == 0) {
+      o.tier = Tier::Full;
+    } else if (std::strcmp(arg, "--suite") == 0 && has_value) {
+      o.suites.emplace_back(argv[++i]);
+    } else if (std::strcmp(arg, "--out") == 0 && has_value) {
+      o.out_path = argv[++i];
+    } else if (std::strcmp(arg, "--tag") == 0 && has_value) {
+      o.tag = argv[++i];
+    } else if (std::strcmp(arg, "--corpus-dir") == 0 && has_value) {
+      o.corpus_dir = argv[++i];
+    } else {
+      app::die(usage);
+    }
+  }
+
+  for (std::string const& s : o.suites) {
+    if (s != "loader" && s != "dedup" && s != "upload" && s != "frame") {
+      app::die(usage);
+    }
+  }
+  return o;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options const o = parse_args(argc, argv);
+
+  std::FILE* out = stdout;
+  if (!o.out_path.empty()) {
+    out = std::fopen(o.out_path.c_str(), "w");
+    if (out == nullptr) {
+      app::die("bench: cannot open the output file");
+    }
+  }
+
+  bench::Report report(out, o.tag);
+  int status = EXIT_SUCCESS;
+
+  try {
+    if (wants(o, "loader")) {
+      suite_loader(o, report);
+    }
+    if (wants(o, "dedup")) {
+      suite_dedup(o, report);
+    }
+
+    if (wants(o, "upload") || wants(o, "frame")) {
+      gfx::Context ctx{};
+      if (init_headless(ctx)) {
+        try {
+          if (wants(o, "upload")) {
+            suite_upload(o, ctx, report);
+          }
+          if (wants(o, "frame")) {
+            suite_frame(o, ctx, report);
+          }
+        } catch (...) {
+          ctx.shutdown();
+          throw;
+        }
+        ctx.shutdown();
+      }
+    }
+  } catch (std::exception const& e) {
+    std::fprintf(stderr, "bench failed: %s\n", e.what());
+    status = EXIT_FAILURE;
+  }
+
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  return status;
+}
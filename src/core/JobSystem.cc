@@ -0,0 +1,456 @@
+#include "core/JobSystem.h"
+
+#include "core/Profile.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace core {
+
+namespace detail {
+
+// A submitted task; heap-allocated and deleted once it has run.
+struct Job {
+  JobSystem::Task task;
+  JobCounter* counter = nullptr;
+};
+
+// One parallel_for call. The caller and its helper jobs claim chunk indices
+// from `next`, so a thread only ever runs chunks of this range. Helpers may be
+// popped after the caller has returned; they hold the range by shared_ptr and
+// only reach `fn` through a chunk they claimed.
+struct Range {
+  void (*body)(void const*, std::size_t, std::size_t) = nullptr;
+  void const* fn = nullptr;
+  std::size_t count = 0;
+  std::size_t chunks = 0;
+  std::atomic<std::size_t> next{0};      // next chunk to claim
+  std::atomic<std::size_t> remaining{0}; // chunks not yet finished
+
+  std::mutex mutex; // guards `first`
+  std::exception_ptr first;
+
+  // Runs chunks until none are left to claim.
+  void run() {
+    for (;;) {
+      std::size_t const c = next.fetch_add(1, std::memory_order_relaxed);
+      if (c >= chunks) {
+        return;
+      }
+      try {
+        body(fn, count * c / chunks, count * (c + 1U) / chunks);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!first) {
+          first = std::current_exception();
+        }
+      }
+      remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+};
+
+} // namespace detail
+
+namespace {
+
+using detail::Job;
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+
+// Chunks per thread for parallel_for, so a slow chunk is balanced by the other
+// threads claiming more.
+constexpr std::size_t kChunksPerThread = 4;
+
+void run_task(JobSystem::Task const& task) {
+  try {
+    task();
+  } catch (std::exception const& e) {
+    std::fprintf(stderr, "JobSystem: job failed: %s\n", e.what());
+  } catch (...) {
+    std::fprintf(stderr, "JobSystem: job failed\n");
+  }
+}
+
+void pin_to_core(std::uint32_t core) {
+#if defined(_WIN32)
+  (void)SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << (core % (sizeof(DWORD_PTR) * 8U)));
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)core;
+#endif
+}
+
+// Chase-Lev work-stealing deque (Lê et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models"), fixed capacity. The owner pushes and
+// pops at the bottom; any thread may steal from the top.
+class WorkDeque {
+public:
+  static constexpr std::int64_t kCapacity = 4096;
+
+public:
+  // Owner only. False when full; the caller falls back to the shared queue.
+  bool push(Job* job) {
+    std::int64_t const b = bottom_.load(std::memory_order_relaxed);
+    std::int64_t const t = top_.load(std::memory_order_acquire);
+    if (b - t >= kCapacity) {
+      return false;
+    }
+    slots_[b & kMask].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only; newest first.
+  Job* pop() {
+    std::int64_t const b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    Job* job = slots_[b & kMask].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last one: race the thieves for it.
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        job = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  // Any thread; oldest first.
+  Job* steal() {
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t const b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    Job* const job = slots_[t & kMask].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr; // lost to the owner or another thief
+    }
+    return job;
+  }
+
+private:
+  static constexpr std::int64_t kMask = kCapacity - 1;
+
+  alignas(64) std::atomic<std::int64_t> top_{0};
+  alignas(64) std::atomic<std::int64_t> bottom_{0};
+  std::atomic<Job*> slots_[kCapacity]{};
+};
+
+} // namespace
+
+struct JobSystem::Impl {
+  struct Worker {
+    WorkDeque deque;
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  bool pin_threads = true;
+
+  // Jobs from threads outside the pool, and overflow from full deques.
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Job*> shared;
+  std::atomic<std::size_t> shared_count{0};
+  bool stop = false;
+
+  // Bumped on every push; a worker only sleeps if it has not moved since the
+  // worker last found nothing to do.
+  std::atomic<std::uint64_t> epoch{0};
+  std::atomic<std::uint32_t> sleepers{0};
+
+  static inline thread_local Impl* current = nullptr; // pool of the calling worker thread
+  static inline thread_local std::uint32_t current_index = 0;
+  static inline thread_local std::uint32_t steal_seed = 0;
+
+  bool on_worker() const { return current == this; }
+
+  void push(Job* job) {
+    if (!on_worker() || !workers[current_index]->deque.push(job)) {
+      std::lock_guard<std::mutex> lock(mutex);
+      shared.push_back(job);
+      shared_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_seq_cst) > 0U) {
+      std::lock_guard<std::mutex> lock(mutex);
+      wake.notify_one();
+    }
+  }
+
+  Job* find() {
+    if (on_worker()) {
+      if (Job* job = workers[current_index]->deque.pop()) {
+        return job;
+      }
+    }
+
+    if (shared_count.load(std::memory_order_relaxed) > 0U) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!shared.empty()) {
+        Job* const job = shared.front();
+        shared.pop_front();
+        shared_count.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+      }
+    }
+
+    // Start at a different victim each time so thieves spread out.
+    std::uint32_t const n = static_cast<std::uint32_t>(workers.size());
+    steal_seed = steal_seed * 1664525U + 1013904223U;
+    std::uint32_t const start = (n > 0U) ? (steal_seed >> 16U) % n : 0U;
+    for (std::uint32_t i = 0; i < n; ++i) {
+      std::uint32_t const victim = (start + i) % n;
+      if (on_worker() && victim == current_index) {
+        continue;
+      }
+      if (Job* job = workers[victim]->deque.steal()) {
+        return job;
+      }
+    }
+    return nullptr;
+  }
+
+  // The decrement that reaches zero happens under the counter's mutex, and
+  // wait() takes it once more before returning, so a waiter never destroys a
+  // counter this is still touching.
+  void finish(JobCounter& counter) {
+    std::vector<Job*> ready;
+    {
+      std::lock_guard<std::mutex> lock(counter.mutex_);
+      if (counter.pending_.fetch_sub(1, std::memory_order_acq_rel) == 1U) {
+        ready.swap(counter.continuations_);
+      }
+    }
+    for (Job* job : ready) {
+      push(job);
+    }
+  }
+
+  void execute(Job* job) {
+    run_task(job->task);
+
+    JobCounter* const counter = job->counter;
+    delete job;
+    if (counter != nullptr) {
+      finish(*counter);
+    }
+  }
+
+  bool run_one() {
+    Job* const job = find();
+    if (job == nullptr) {
+      return false;
+    }
+    execute(job);
+    return true;
+  }
+
+  void loop(std::uint32_t index) {
+    CORE_THREAD_NAME("job worker");
+    current = this;
+    current_index = index;
+    steal_seed = index + 1U;
+    if (pin_threads) {
+      pin_to_core((index + 1U) % std::max(1U, std::thread::hardware_concurrency()));
+    }
+
+    for (;;) {
+      std::uint64_t const seen = epoch.load(std::memory_order_seq_cst);
+      if (run_one()) {
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex);
+      if (stop) {
+        return;
+      }
+      sleepers.fetch_add(1, std::memory_order_seq_cst);
+      wake.wait(lock, [&] { return stop || epoch.load(std::memory_order_seq_cst) != seen; });
+      sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+  }
+};
+
+JobSystem::~JobSystem() {
+}
+
+JobSystem::JobSystem(JobSystem&& other) noexcept {
+  *this = std::move(other);
+}
+
+JobSystem& JobSystem::operator=(JobSystem&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  impl_ = other.impl_;
+  other.impl_ = nullptr;
+
+  return *this;
+}
+
+void JobSystem::init(JobSystemConfig const& config) {
+  if (impl_ != nullptr) {
+    fail("JobSystem::init called twice");
+  }
+
+  std::uint32_t threads = config.threads;
+  if (threads == 0U) {
+    threads = std::max(2U, std::thread::hardware_concurrency()) - 1U;
+  }
+
+  impl_ = new (std::nothrow) Impl();
+  if (impl_ == nullptr) {
+    fail("JobSystem: allocation failed");
+  }
+  impl_->pin_threads = config.pin_threads;
+
+  // Every deque exists before any thread can steal from it.
+  impl_->workers.reserve(threads);
+  for (std::uint32_t i = 0; i < threads; ++i) {
+    impl_->workers.push_back(std::make_unique<Impl::Worker>());
+  }
+  for (std::uint32_t i = 0; i < threads; ++i) {
+    impl_->workers[i]->thread = std::thread([impl = impl_, i] { impl->loop(i); });
+  }
+}
+
+void JobSystem::shutdown() {
+  if (impl_ == nullptr) {
+    return;
+  }
+
+  // Workers drain everything reachable before they see `stop`.
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->stop = true;
+  }
+  impl_->wake.notify_all();
+  for (auto& w : impl_->workers) {
+    w->thread.join();
+  }
+  while (impl_->run_one()) {
+  }
+
+  delete impl_;
+  impl_ = nullptr;
+}
+
+std::uint32_t JobSystem::thread_count() const {
+  return (impl_ != nullptr) ? static_cast<std::uint32_t>(impl_->workers.size()) : 0U;
+}
+
+void JobSystem::submit(Task task, JobCounter* counter, JobCounter* after) {
+  if (impl_ == nullptr) {
+    run_task(task);
+    return;
+  }
+
+  Job* job = new (std::nothrow) Job();
+  if (job == nullptr) {
+    fail("JobSystem: allocation failed");
+  }
+  job->task = std::move(task);
+  job->counter = counter;
+  if (counter != nullptr) {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (after != nullptr) {
+    std::lock_guard<std::mutex> lock(after->mutex_);
+    if (!after->done()) {
+      after->continuations_.push_back(job);
+      return;
+    }
+  }
+  impl_->push(job);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+  while (!counter.done()) {
+    std::this_thread::yield();
+  }
+  std::lock_guard<std::mutex> lock(counter.mutex_);
+}
+
+void JobSystem::run_range(std::size_t count, std::size_t grain, RangeFn body, void const* fn) {
+  if (count == 0U) {
+    return;
+  }
+
+  grain = std::max<std::size_t>(grain, 1U);
+  std::size_t chunks = (count + grain - 1U) / grain;
+  chunks = std::min(chunks, (std::size_t{thread_count()} + 1U) * kChunksPerThread);
+  if (impl_ == nullptr || chunks <= 1U) {
+    body(fn, 0, count);
+    return;
+  }
+
+  auto range = std::make_shared<detail::Range>();
+  range->body = body;
+  range->fn = fn;
+  range->count = count;
+  range->chunks = chunks;
+  range->remaining.store(chunks, std::memory_order_relaxed);
+
+  // Helpers only claim chunks of this range; one that starts late finds none
+  // left and returns at once.
+  std::size_t const helpers = std::min<std::size_t>(chunks - 1U, thread_count());
+  for (std::size_t i = 0; i < helpers; ++i) {
+    submit([range] { range->run(); });
+  }
+
+  // Claim chunks here too, then wait only for chunks other threads are still
+  // running. Unrelated jobs never run on this thread.
+  range->run();
+  while (range->remaining.load(std::memory_order_acquire) != 0U) {
+    std::this_thread::yield();
+  }
+
+  if (range->first) {
+    std::rethrow_exception(range->first);
+  }
+}
+
+} // namespace core
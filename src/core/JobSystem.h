@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace core {
+
+class JobSystem;
+
+namespace detail {
+struct Job;
+} // namespace detail
+
+// Jobs still to finish in a group. Every job submitted with a counter keeps it
+// non-zero until it has run. A counter may be reused once it is back at zero,
+// and destroyed after JobSystem::wait().
+class JobCounter {
+public:
+  JobCounter() = default;
+  ~JobCounter() = default;
+
+  JobCounter(JobCounter const&) = delete;
+  JobCounter& operator=(JobCounter const&) = delete;
+
+  bool done() const { return pending_.load(std::memory_order_acquire) == 0U; }
+
+private:
+  friend class JobSystem;
+
+  std::atomic<std::uint32_t> pending_{0};
+  std::mutex mutex_;                        // guards continuations_ and the final decrement
+  std::vector<detail::Job*> continuations_; // submitted with this counter as `after`
+};
+
+struct JobSystemConfig {
+  std::uint32_t threads = 0; // workers; 0 = one per hardware thread, minus the caller's
+  bool pin_threads = true;   // worker i runs on core i + 1; core 0 is left to the main thread
+};
+
+// Fixed pool of workers shared by the whole engine, so parallel loading,
+// recording and background compiles split the cores between them instead of
+// each spawning its own threads.
+//
+// Each worker owns a Chase-Lev deque: it pushes and pops its own jobs at the
+// bottom, idle workers steal from the top. Jobs submitted from other threads go
+// through one shared queue. A thread in parallel_for() helps only with that
+// call's own chunks, so a frame that splits work never picks up a background
+// job (a pipeline compile, texture IO) from the queues.
+class JobSystem {
+public:
+  using Task = std::function<void()>;
+
+public:
+  JobSystem() = default;
+  ~JobSystem();
+
+  JobSystem(JobSystem const&) = delete;
+  JobSystem& operator=(JobSystem const&) = delete;
+
+  JobSystem(JobSystem&& other) noexcept;
+  JobSystem& operator=(JobSystem&& other) noexcept;
+
+  void init(JobSystemConfig const& config = {});
+
+  // Runs every job already queued, then joins the workers. Submitting after
+  // this is not allowed.
+  void shutdown();
+
+  // Workers, excluding threads that call parallel_for().
+  std::uint32_t thread_count() const;
+
+  // Queues `task` from any thread. With `counter`, the counter stays non-zero
+  // until the task has run; with `after`, the task does not start before
+  // `after` is done. Exceptions are reported on stderr and dropped. Without
+  // init() the task runs inline.
+  void submit(Task task, JobCounter* counter = nullptr, JobCounter* after = nullptr);
+
+  // Returns once `counter` is zero. Only the workers run the counted jobs, so
+  // call it from outside the pool (e.g. on shutdown), never from inside a job.
+  void wait(JobCounter& counter);
+
+  // Calls fn(begin, end) over [0, count) in chunks of at least `grain` items,
+  // on the workers and the calling thread, and returns once all have finished.
+  // The calling thread can finish every chunk alone, so nested calls and busy
+  // workers only cost parallelism, never progress.
+  // Rethrows the first exception a chunk threw. Without init() it runs
+  // fn(0, count) inline.
+  template <class Fn>
+  void parallel_for(std::size_t count, std::size_t grain, Fn const& fn) {
+    run_range(count, grain, [](void const* f, std::size_t begin, std::size_t end) {
+      (*static_cast<Fn const*>(f))(begin, end);
+    }, &fn);
+  }
+
+private:
+  using RangeFn = void (*)(void const* fn, std::size_t begin, std::size_t end);
+
+  void run_range(std::size_t count, std::size_t grain, RangeFn body, void const* fn);
+
+private:
+  struct Impl;
+  Impl* impl_ = nullptr; // owned; worker threads point into it
+};
+
+} // namespace core
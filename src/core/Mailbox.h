@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace core {
+
+// Single-producer, single-consumer triple buffer that always hands the consumer
+// the newest published value. Neither side ever waits: the producer owns one
+// slot, the consumer another, and the third is swapped through an atomic index
+// on publish() / acquire(). Values the consumer never picked up are overwritten.
+//
+//   producer:  box.write_slot() = next;  box.publish();
+//   consumer:  box.acquire();            use(box.read_slot());
+//
+// read_slot() stays valid and unchanged until the consumer's next acquire().
+template <typename T>
+class Mailbox {
+public:
+  // Every slot starts as `initial`, so read_slot() is usable before the first
+  // publish().
+  explicit Mailbox(T const& initial = T{}) : slots_{Slot{initial}, Slot{initial}, Slot{initial}} {}
+
+  Mailbox(Mailbox const&) = delete;
+  Mailbox& operator=(Mailbox const&) = delete;
+
+  // Producer side.
+  T& write_slot() { return slots_[write_].value; }
+  void publish() {
+    write_ = shared_.exchange(write_ | kFresh, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  // Consumer side. Returns false, keeping the current slot, when nothing was
+  // published since the last call.
+  bool acquire() {
+    if ((shared_.load(std::memory_order_relaxed) & kFresh) == 0U) {
+      return false;
+    }
+    read_ = shared_.exchange(read_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+  T const& read_slot() const { return slots_[read_].value; }
+
+private:
+  static constexpr std::uint32_t kIndexMask = 0x3U;
+  static constexpr std::uint32_t kFresh = 0x4U; // shared slot holds an unread value
+
+  // Own cache lines, so the two threads only share `shared_`.
+  struct alignas(64) Slot {
+    T value;
+  };
+
+  Slot slots_[3];
+  alignas(64) std::atomic<std::uint32_t> shared_{1};
+  alignas(64) std::uint32_t write_ = 0; // producer only
+  alignas(64) std::uint32_t read_ = 2;  // consumer only
+};
+
+} // namespace core
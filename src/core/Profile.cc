@@ -0,0 +1,256 @@
+#include "core/Profile.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace core::profile {
+
+namespace {
+
+constexpr std::size_t kRingSize = 8192;  // zones kept per thread
+constexpr std::size_t kMarkRingSize = 1024; // frame marks kept per thread
+
+struct Event {
+  char const* name = nullptr;
+  std::uint64_t start_ns = 0;
+  std::uint64_t end_ns = 0;
+  std::uint32_t depth = 0;
+  ZoneKind kind = ZoneKind::Work;
+};
+
+// One ring entry. The exporter reads slots while their owner may overwrite
+// them, so every field is a relaxed atomic; `written` tells it which reads to
+// keep.
+struct EventSlot {
+  std::atomic<char const*> name{nullptr};
+  std::atomic<std::uint64_t> start_ns{0};
+  std::atomic<std::uint64_t> end_ns{0};
+  std::atomic<std::uint32_t> depth{0};
+  std::atomic<ZoneKind> kind{ZoneKind::Work};
+
+  void store(Event const& e) {
+    name.store(e.name, std::memory_order_relaxed);
+    start_ns.store(e.start_ns, std::memory_order_relaxed);
+    end_ns.store(e.end_ns, std::memory_order_relaxed);
+    depth.store(e.depth, std::memory_order_relaxed);
+    kind.store(e.kind, std::memory_order_relaxed);
+  }
+
+  Event load() const {
+    return Event{name.load(std::memory_order_relaxed),
+                 start_ns.load(std::memory_order_relaxed),
+                 end_ns.load(std::memory_order_relaxed),
+                 depth.load(std::memory_order_relaxed),
+                 kind.load(std::memory_order_relaxed)};
+  }
+};
+
+// Written only by its thread; `written` publishes each event to the exporter.
+struct ThreadRing {
+  EventSlot events[kRingSize];
+  std::atomic<std::uint64_t> written{0};
+
+  std::atomic<std::uint64_t> marks[kMarkRingSize]{}; // same seqlock as `events`
+  std::atomic<std::uint64_t> marks_written{0};
+
+  std::atomic<char const*> name{nullptr};
+  std::uint32_t tid = 0;
+
+  // Owner thread only.
+  std::uint32_t depth = 0;
+  std::uint32_t wait_depth = 0;
+  std::uint64_t frame_start_ns = 0;
+  std::uint64_t frame_wait_ns = 0;
+  FrameStats last{};
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadRing>> rings; // rings outlive their threads
+};
+
+// Never destroyed: threads still running during static destruction keep
+// writing into their rings.
+Registry& registry() {
+  static Registry* r = new Registry();
+  return *r;
+}
+
+ThreadRing& this_thread_ring() {
+  thread_local ThreadRing* ring = nullptr;
+  if (ring == nullptr) {
+    auto owned = std::make_unique<ThreadRing>();
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    owned->tid = static_cast<std::uint32_t>(reg.rings.size());
+    ring = owned.get();
+    reg.rings.push_back(std::move(owned));
+  }
+  return *ring;
+}
+
+std::uint64_t const g_origin_ns = now_ns();
+
+double to_us(std::uint64_t ns) {
+  return static_cast<double>(ns - g_origin_ns) * 1e-3;
+}
+
+std::string json_string(char const* s) {
+  std::string out = "\"";
+  for (char const* c = s; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+    }
+    out += *c;
+  }
+  out += '"';
+  return out;
+}
+
+} // namespace
+
+std::uint64_t now_ns() {
+  return static_cast<std::uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+FrameStats last_frame() {
+  return this_thread_ring().last;
+}
+
+void set_thread_name(char const* name) {
+  this_thread_ring().name.store(name, std::memory_order_release);
+}
+
+void frame_mark() {
+  ThreadRing& r = this_thread_ring();
+  std::uint64_t const now = now_ns();
+
+  if (r.frame_start_ns != 0U) {
+    r.last.frame_ns = now - r.frame_start_ns;
+    r.last.wait_ns = r.frame_wait_ns;
+    ++r.last.frame_number;
+  }
+  r.frame_start_ns = now;
+  r.frame_wait_ns = 0;
+
+  std::uint64_t const n = r.marks_written.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  r.marks[n % kMarkRingSize].store(now, std::memory_order_relaxed);
+  r.marks_written.store(n + 1U, std::memory_order_release);
+}
+
+Zone::Zone(char const* name, ZoneKind kind) noexcept
+  : name_(name), start_ns_(0), kind_(kind) {
+  ThreadRing& r = this_thread_ring();
+  ++r.depth;
+  if (kind_ == ZoneKind::Wait) {
+    ++r.wait_depth;
+  }
+  start_ns_ = now_ns();
+}
+
+Zone::~Zone() {
+  std::uint64_t const end = now_ns();
+  ThreadRing& r = this_thread_ring();
+  --r.depth;
+
+  if (kind_ == ZoneKind::Wait && --r.wait_depth == 0U) {
+    r.frame_wait_ns += end - start_ns_;
+  }
+
+  // Seqlock: the slot holds event n - kRingSize, which the exporter drops once
+  // it sees written >= n. The fence keeps the overwrite from becoming visible
+  // before that count.
+  std::uint64_t const n = r.written.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  r.events[n % kRingSize].store(Event{name_, start_ns_, end, r.depth, kind_});
+  r.written.store(n + 1U, std::memory_order_release);
+}
+
+bool write_chrome_trace(std::string const& path) {
+  std::ofstream ofs(path, std::ios::trunc);
+  if (!ofs) {
+    return false;
+  }
+
+  char num[96];
+  bool first = true;
+  auto const separator = [&]() {
+    ofs << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  std::vector<Event> copy;
+  copy.reserve(kRingSize);
+  std::vector<std::uint64_t> marks;
+  marks.reserve(kMarkRingSize);
+
+  for (auto const& ring : reg.rings) {
+    ThreadRing const& r = *ring;
+
+    char const* const name = r.name.load(std::memory_order_acquire);
+    separator();
+    ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << r.tid
+        << ",\"args\":{\"name\":" << json_string(name != nullptr ? name : "thread") << "}}";
+
+    // Copy, then drop whatever the owner may have overwritten meanwhile: slot i
+    // is intact while fewer than i + kRingSize events have been published.
+    std::uint64_t const end = r.written.load(std::memory_order_acquire);
+    std::uint64_t const begin = (end > kRingSize) ? end - kRingSize : 0U;
+    copy.clear();
+    for (std::uint64_t i = begin; i < end; ++i) {
+      copy.push_back(r.events[i % kRingSize].load());
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    std::uint64_t const after = r.written.load(std::memory_order_relaxed);
+
+    for (std::uint64_t i = begin; i < end; ++i) {
+      if (after >= i + kRingSize) {
+        continue;
+      }
+      Event const& e = copy[static_cast<std::size_t>(i - begin)];
+      separator();
+      std::snprintf(num, sizeof(num), "\"ts\":%.3f,\"dur\":%.3f", to_us(e.start_ns), static_cast<double>(e.end_ns - e.start_ns) * 1e-3);
+      ofs << "{\"name\":" << json_string(e.name) << ",\"cat\":\"" << (e.kind == ZoneKind::Wait ? "wait" : "cpu")
+          << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << r.tid << "," << num << "}";
+    }
+
+    // Frame marks the same way.
+    std::uint64_t const marks_end = r.marks_written.load(std::memory_order_acquire);
+    std::uint64_t const marks_begin = (marks_end > kMarkRingSize) ? marks_end - kMarkRingSize : 0U;
+    marks.clear();
+    for (std::uint64_t i = marks_begin; i < marks_end; ++i) {
+      marks.push_back(r.marks[i % kMarkRingSize].load(std::memory_order_relaxed));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    std::uint64_t const marks_after = r.marks_written.load(std::memory_order_relaxed);
+
+    for (std::uint64_t i = marks_begin; i < marks_end; ++i) {
+      if (marks_after >= i + kMarkRingSize) {
+        continue;
+      }
+      separator();
+      std::snprintf(num, sizeof(num), "\"ts\":%.3f", to_us(marks[static_cast<std::size_t>(i - marks_begin)]));
+      ofs << "{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":" << r.tid << "," << num << "}";
+    }
+  }
+
+  ofs << "\n]}\n";
+  ofs.flush();
+  return static_cast<bool>(ofs);
+}
+
+} // namespace core::profile
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// CPU instrumentation zones.
+//
+//   CORE_ZONE("record");          time the enclosing scope
+//   CORE_WAIT_ZONE("fence wait"); same, but counted as waiting (see FrameStats)
+//   CORE_FRAME_MARK();            end of a frame on the calling thread
+//   CORE_THREAD_NAME("worker");   label for the trace
+//
+// With CORE_PROFILE=0 (the default; CMake option ENABLE_PROFILING) every macro
+// expands to nothing. With CORE_PROFILE=1 each thread appends zones to its own
+// fixed-size ring, a single-producer buffer that needs no locks or allocation
+// once the thread has registered; the oldest zones are overwritten. With
+// CORE_PROFILE_TRACY=1 as well, zones and frame marks also go to Tracy.
+//
+// Zone names must outlive the process (string literals).
+
+#ifndef CORE_PROFILE
+#define CORE_PROFILE 0
+#endif
+
+#ifndef CORE_PROFILE_TRACY
+#define CORE_PROFILE_TRACY 0
+#endif
+
+#if CORE_PROFILE && CORE_PROFILE_TRACY
+#include <tracy/Tracy.hpp>
+#endif
+
+namespace core::profile {
+
+// Nanoseconds on a steady clock; only differences mean anything.
+std::uint64_t now_ns();
+
+// The calling thread's last CORE_FRAME_MARK() interval. `wait_ns` is the time
+// spent in outermost wait zones, so a frame where it dominates was waiting on
+// the GPU or the display rather than the CPU.
+struct FrameStats {
+  std::uint64_t frame_ns = 0;
+  std::uint64_t wait_ns = 0;
+  std::uint64_t frame_number = 0;
+};
+
+FrameStats last_frame();
+
+void set_thread_name(char const* name);
+void frame_mark();
+
+// All threads' rings plus frame marks as Chrome trace-event JSON (loads in
+// chrome://tracing and Perfetto). Threads may keep running; a zone overwritten
+// while it is being copied is dropped.
+bool write_chrome_trace(std::string const& path);
+
+enum class ZoneKind : std::uint8_t { Work, Wait };
+
+class Zone {
+public:
+  explicit Zone(char const* name, ZoneKind kind = ZoneKind::Work) noexcept;
+  ~Zone();
+
+  Zone(Zone const&) = delete;
+  Zone& operator=(Zone const&) = delete;
+
+private:
+  char const* name_;
+  std::uint64_t start_ns_;
+  ZoneKind kind_;
+};
+
+} // namespace core::profile
+
+#define CORE_PROFILE_CONCAT_(a, b) a##b
+#define CORE_PROFILE_CONCAT(a, b) CORE_PROFILE_CONCAT_(a, b)
+
+#if CORE_PROFILE && CORE_PROFILE_TRACY
+#define CORE_ZONE(name)                                                  \
+  ::core::profile::Zone CORE_PROFILE_CONCAT(core_zone_, __LINE__)(name); \
+  ZoneScopedN(name)
+#define CORE_WAIT_ZONE(name)                                                                                \
+  ::core::profile::Zone CORE_PROFILE_CONCAT(core_zone_, __LINE__)(name, ::core::profile::ZoneKind::Wait); \
+  ZoneScopedNC(name, 0xB03030)
+#define CORE_FRAME_MARK()          \
+  do {                             \
+    ::core::profile::frame_mark(); \
+    FrameMark;                     \
+  } while (false)
+#define CORE_THREAD_NAME(name)              \
+  do {                                      \
+    ::core::profile::set_thread_name(name); \
+    tracy::SetThreadName(name);             \
+  } while (false)
+#elif CORE_PROFILE
+#define CORE_ZONE(name) ::core::profile::Zone CORE_PROFILE_CONCAT(core_zone_, __LINE__)(name)
+#define CORE_WAIT_ZONE(name) \
+  ::core::profile::Zone CORE_PROFILE_CONCAT(core_zone_, __LINE__)(name, ::core::profile::ZoneKind::Wait)
+#define CORE_FRAME_MARK() ::core::profile::frame_mark()
+#define CORE_THREAD_NAME(name) ::core::profile::set_thread_name(name)
+#else
+#define CORE_ZONE(name) static_cast<void>(0)
+#define CORE_WAIT_ZONE(name) static_cast<void>(0)
+#define CORE_FRAME_MARK() static_cast<void>(0)
+#define CORE_THREAD_NAME(name) static_cast<void>(0)
+#endif
@@ -0,0 +1,387 @@
+#include "gfx/Allocator.h"
+
+#include "gfx/Context.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize a) {
+  return (a <= 1U) ? v : ((v + a - 1U) / a) * a;
+}
+
+} // namespace
+
+Allocator::~Allocator() {
+}
+
+void Allocator::init(Context const& ctx, VkDeviceSize block_size) {
+  if (block_size == 0U) {
+    fail("Allocator::init: block_size == 0");
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  vkGetPhysicalDeviceMemoryProperties(ctx.physical_device(), &memory_props_);
+
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(ctx.physical_device(), &props);
+  max_allocation_count_ = props.limits.maxMemoryAllocationCount;
+  atom_size_ = (props.limits.nonCoherentAtomSize > 0U) ? props.limits.nonCoherentAtomSize : 1U;
+
+  block_size_ = block_size;
+  pools_.clear();
+  stats_ = {};
+}
+
+void Allocator::shutdown(Context const& ctx) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (auto& pool : pools_) {
+    for (auto& block : pool.blocks) {
+      if (block.memory != VK_NULL_HANDLE) {
+        free_memory(ctx, block.memory, block.mapped);
+        block.memory = VK_NULL_HANDLE;
+        block.mapped = nullptr;
+      }
+    }
+  }
+  pools_.clear();
+
+  if (stats_.allocation_count != 0U) {
+    // Resources that outlive the allocator leak their memory until vkDestroyDevice.
+    std::fprintf(stderr, "Allocator: %u allocation(s) still alive at shutdown\n", stats_.allocation_count);
+  }
+  stats_ = {};
+}
+
+Allocation Allocator::allocate_buffer(Context const& ctx, VkBuffer buffer, AllocationCreateInfo const& info) {
+  VkMemoryRequirements req{};
+  vkGetBufferMemoryRequirements(ctx.device(), buffer, &req);
+
+  Allocation a = allocate(ctx, req, info, ResourceKind::Buffer);
+  vk_check(vkBindBufferMemory(ctx.device(), buffer, a.memory, a.offset), "vkBindBufferMemory");
+  return a;
+}
+
+Allocation Allocator::allocate_image(Context const& ctx, VkImage image, AllocationCreateInfo const& info) {
+  VkMemoryRequirements req{};
+  vkGetImageMemoryRequirements(ctx.device(), image, &req);
+
+  Allocation a = allocate(ctx, req, info, ResourceKind::Image);
+  vk_check(vkBindImageMemory(ctx.device(), image, a.memory, a.offset), "vkBindImageMemory");
+  return a;
+}
+
+Allocation Allocator::allocate(Context const& ctx,
+                               VkMemoryRequirements const& base_req,
+                               AllocationCreateInfo const& info,
+                               ResourceKind kind) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::uint32_t const memory_type = find_memory_type(base_req.memoryTypeBits, info.required, info.preferred);
+  bool const non_coherent = is_non_coherent(memory_type);
+
+  // Whole atoms, so flush ranges can be widened without leaving the allocation.
+  VkMemoryRequirements const req = non_coherent
+    ? VkMemoryRequirements{align_up(base_req.size, atom_size_), std::max(base_req.alignment, atom_size_), base_req.memoryTypeBits}
+    : base_req;
+
+  if (info.dedicated || req.size > block_size_ / 2U) {
+    Allocation a = allocate_dedicated(ctx, req.size, memory_type);
+    a.coherent = !non_coherent;
+    return a;
+  }
+
+  std::uint32_t const pool_index = find_or_create_pool(memory_type, kind, info.strategy);
+  Pool& pool = pools_[pool_index];
+
+  Allocation a{};
+  a.size = req.size;
+  a.pool = pool_index;
+  a.coherent = !non_coherent;
+
+  for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(pool.blocks.size()); ++i) {
+    Block& block = pool.blocks[i];
+    if (block.memory == VK_NULL_HANDLE) {
+      continue;
+    }
+    VkDeviceSize offset = 0;
+    if (try_allocate_from(block, pool.strategy, req, offset)) {
+      a.memory = block.memory;
+      a.offset = offset;
+      a.block = i;
+      break;
+    }
+  }
+
+  if (a.memory == VK_NULL_HANDLE) {
+    // reuse an empty slot before growing the block list
+    std::uint32_t slot = static_cast<std::uint32_t>(pool.blocks.size());
+    for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(pool.blocks.size()); ++i) {
+      if (pool.blocks[i].memory == VK_NULL_HANDLE) {
+        slot = i;
+        break;
+      }
+    }
+    if (slot == pool.blocks.size()) {
+      pool.blocks.emplace_back();
+    }
+
+    Block& block = pool.blocks[slot];
+    block.memory = allocate_memory(ctx, block_size_, memory_type, &block.mapped);
+    block.size = block_size_;
+    block.ranges.init(block_size_);
+    block.linear_head = 0;
+    block.live = 0;
+    ++stats_.block_count;
+    stats_.bytes_reserved += block_size_;
+
+    VkDeviceSize offset = 0;
+    if (!try_allocate_from(block, pool.strategy, req, offset)) {
+      fail("Allocator: fresh block cannot hold allocation");
+    }
+    a.memory = block.memory;
+    a.offset = offset;
+    a.block = slot;
+  }
+
+  Block const& block = pool.blocks[a.block];
+  a.mapped = (block.mapped != nullptr) ? static_cast<char*>(block.mapped) + a.offset : nullptr;
+
+  ++stats_.allocation_count;
+  stats_.bytes_used += a.size;
+  return a;
+}
+
+bool Allocator::try_allocate_from(Block& block,
+                                  AllocationStrategy strategy,
+                                  VkMemoryRequirements const& req,
+                                  VkDeviceSize& out_offset) {
+  if (strategy == AllocationStrategy::Linear) {
+    VkDeviceSize const offset = align_up(block.linear_head, req.alignment);
+    if (offset + req.size > block.size) {
+      return false;
+    }
+    block.linear_head = offset + req.size;
+    ++block.live;
+    out_offset = offset;
+    return true;
+  }
+
+  std::uint64_t const offset = block.ranges.allocate(req.size, req.alignment);
+  if (offset == RangeAllocator::kInvalidOffset) {
+    return false;
+  }
+  ++block.live;
+  out_offset = offset;
+  return true;
+}
+
+Allocation Allocator::allocate_dedicated(Context const& ctx, VkDeviceSize size, std::uint32_t memory_type) {
+  Allocation a{};
+  a.memory = allocate_memory(ctx, size, memory_type, &a.mapped);
+  a.offset = 0;
+  a.size = size;
+  a.pool = UINT32_MAX;
+  a.block = UINT32_MAX;
+
+  ++stats_.dedicated_count;
+  ++stats_.allocation_count;
+  stats_.bytes_reserved += size;
+  stats_.bytes_used += size;
+  return a;
+}
+
+void Allocator::free(Context const& ctx, Allocation& allocation) {
+  if (!allocation.valid()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (allocation.pool == UINT32_MAX) {
+    free_memory(ctx, allocation.memory, allocation.mapped);
+    --stats_.dedicated_count;
+    stats_.bytes_reserved -= allocation.size;
+  } else {
+    if (allocation.pool >= pools_.size() || allocation.block >= pools_[allocation.pool].blocks.size()) {
+      fail("Allocator::free: allocation does not belong to this allocator");
+    }
+
+    Pool& pool = pools_[allocation.pool];
+    Block& block = pool.blocks[allocation.block];
+
+    if (pool.strategy == AllocationStrategy::FreeList) {
+      block.ranges.free(allocation.offset, allocation.size);
+    }
+    --block.live;
+
+    if (block.live == 0U) {
+      block.linear_head = 0;
+
+      // keep one empty block per pool around to avoid allocate/free churn
+      std::uint32_t empty_blocks = 0;
+      for (auto const& b : pool.blocks) {
+        if (b.memory != VK_NULL_HANDLE && b.live == 0U) {
+          ++empty_blocks;
+        }
+      }
+      if (empty_blocks > 1U) {
+        free_memory(ctx, block.memory, block.mapped);
+        stats_.bytes_reserved -= block.size;
+        --stats_.block_count;
+        block = Block{};
+      }
+    }
+  }
+
+  --stats_.allocation_count;
+  stats_.bytes_used -= allocation.size;
+  allocation = Allocation{};
+}
+
+VkMappedMemoryRange Allocator::mapped_range(Allocation const& allocation, VkDeviceSize offset, VkDeviceSize size) const {
+  if (offset > allocation.size) {
+    fail("Allocator: mapped range out of bounds");
+  }
+  VkDeviceSize const end = (size == VK_WHOLE_SIZE) ? allocation.size : offset + size;
+  if (end > allocation.size) {
+    fail("Allocator: mapped range out of bounds");
+  }
+
+  // Atom-aligned allocations keep the widened range inside this one.
+  VkDeviceSize const begin = allocation.offset + (offset / atom_size_) * atom_size_;
+
+  VkMappedMemoryRange r{};
+  r.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  r.memory = allocation.memory;
+  r.offset = begin;
+  r.size = std::min(align_up(allocation.offset + end, atom_size_), allocation.offset + allocation.size) - begin;
+  return r;
+}
+
+void Allocator::flush(Context const& ctx, Allocation const& allocation, VkDeviceSize offset, VkDeviceSize size) const {
+  if (allocation.coherent || allocation.mapped == nullptr || size == 0U) {
+    return;
+  }
+  VkMappedMemoryRange const r = mapped_range(allocation, offset, size);
+  vk_check(vkFlushMappedMemoryRanges(ctx.device(), 1, &r), "vkFlushMappedMemoryRanges");
+}
+
+void Allocator::invalidate(Context const& ctx, Allocation const& allocation, VkDeviceSize offset, VkDeviceSize size) const {
+  if (allocation.coherent || allocation.mapped == nullptr || size == 0U) {
+    return;
+  }
+  VkMappedMemoryRange const r = mapped_range(allocation, offset, size);
+  vk_check(vkInvalidateMappedMemoryRanges(ctx.device(), 1, &r), "vkInvalidateMappedMemoryRanges");
+}
+
+AllocatorStats Allocator::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::uint32_t Allocator::find_memory_type(std::uint32_t type_bits, VkMemoryPropertyFlags props) const {
+  for (std::uint32_t i = 0; i < memory_props_.memoryTypeCount; ++i) {
+    bool const type_ok = ((type_bits & (1u << i)) != 0u);
+    bool const props_ok = ((memory_props_.memoryTypes[i].propertyFlags & props) == props);
+    if (type_ok && props_ok) {
+      return i;
+    }
+  }
+
+  fail("No suitable memory type found.");
+}
+
+std::uint32_t Allocator::find_memory_type(std::uint32_t type_bits,
+                                          VkMemoryPropertyFlags required,
+                                          VkMemoryPropertyFlags preferred) const {
+  if (preferred != 0U) {
+    for (std::uint32_t i = 0; i < memory_props_.memoryTypeCount; ++i) {
+      VkMemoryPropertyFlags const want = required | preferred;
+      if ((type_bits & (1u << i)) != 0u && (memory_props_.memoryTypes[i].propertyFlags & want) == want) {
+        return i;
+      }
+    }
+  }
+  return find_memory_type(type_bits, required);
+}
+
+bool Allocator::is_non_coherent(std::uint32_t memory_type) const {
+  VkMemoryPropertyFlags const flags = memory_props_.memoryTypes[memory_type].propertyFlags;
+  return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0u && (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0u;
+}
+
+std::uint32_t Allocator::find_or_create_pool(std::uint32_t memory_type, ResourceKind kind, AllocationStrategy strategy) {
+  for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(pools_.size()); ++i) {
+    Pool const& p = pools_[i];
+    if (p.memory_type == memory_type && p.kind == kind && p.strategy == strategy) {
+      return i;
+    }
+  }
+
+  Pool p{};
+  p.memory_type = memory_type;
+  p.kind = kind;
+  p.strategy = strategy;
+  pools_.push_back(std::move(p));
+  return static_cast<std::uint32_t>(pools_.size() - 1U);
+}
+
+VkDeviceMemory Allocator::allocate_memory(Context const& ctx, VkDeviceSize size, std::uint32_t memory_type, void** out_mapped) {
+  if (max_allocation_count_ != 0U && stats_.device_allocations >= max_allocation_count_) {
+    fail("Allocator: maxMemoryAllocationCount reached");
+  }
+
+  VkMemoryAllocateInfo mai{};
+  mai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  mai.allocationSize = size;
+  mai.memoryTypeIndex = memory_type;
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  vk_check(vkAllocateMemory(ctx.device(), &mai, nullptr, &memory), "vkAllocateMemory");
+  ++stats_.device_allocations;
+
+  *out_mapped = nullptr;
+  bool const host_visible =
+    (memory_props_.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0u;
+  if (host_visible) {
+    VkResult const r = vkMapMemory(ctx.device(), memory, 0, VK_WHOLE_SIZE, 0, out_mapped);
+    if (r != VK_SUCCESS) {
+      vkFreeMemory(ctx.device(), memory, nullptr);
+      --stats_.device_allocations;
+      vk_check(r, "vkMapMemory(Allocator)");
+    }
+  }
+
+  return memory;
+}
+
+void Allocator::free_memory(Context const& ctx, VkDeviceMemory memory, void* mapped) {
+  if (mapped != nullptr) {
+    vkUnmapMemory(ctx.device(), memory);
+  }
+  vkFreeMemory(ctx.device(), memory, nullptr);
+  --stats_.device_allocations;
+}
+
+} // namespace gfx
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "gfx/RangeAllocator.h"
+
+namespace gfx {
+
+class Context;
+
+enum class AllocationStrategy : std::uint8_t {
+  FreeList, // general purpose; freed ranges are reused
+  Linear,   // bump pointer; the block is rewound once all of its ranges are freed
+};
+
+struct AllocationCreateInfo {
+  VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  // Taken on top of `required` when some memory type has them, e.g. HOST_CACHED
+  // for readbacks or HOST_COHERENT to make flushes free.
+  VkMemoryPropertyFlags preferred = 0;
+  AllocationStrategy strategy = AllocationStrategy::FreeList;
+  bool dedicated = false; // own VkDeviceMemory (render targets, very large resources)
+};
+
+struct Allocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void* mapped = nullptr; // persistent mapping for HOST_VISIBLE memory, else nullptr
+  // False for HOST_VISIBLE memory without HOST_COHERENT: host writes need
+  // flush() before the GPU reads them, GPU writes invalidate() before the host does.
+  bool coherent = true;
+
+  std::uint32_t pool = UINT32_MAX;  // UINT32_MAX -> dedicated
+  std::uint32_t block = UINT32_MAX;
+
+  bool valid() const { return memory != VK_NULL_HANDLE; }
+};
+
+struct AllocatorStats {
+  std::uint32_t device_allocations = 0; // live vkAllocateMemory calls
+  std::uint32_t block_count = 0;
+  std::uint32_t dedicated_count = 0;
+  std::uint32_t allocation_count = 0;
+  VkDeviceSize bytes_reserved = 0;
+  VkDeviceSize bytes_used = 0;
+};
+
+// Sub-allocates device memory out of large per-memory-type blocks.
+// Buffers and images come from separate pools so bufferImageGranularity never applies.
+// Thread-safe; HOST_VISIBLE blocks are mapped once for their whole lifetime.
+// Non-coherent allocations are aligned to nonCoherentAtomSize, so flushing one
+// never touches a neighbour.
+class Allocator {
+public:
+  static constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024ull * 1024ull;
+
+public:
+  Allocator() = default;
+  ~Allocator();
+
+  Allocator(Allocator const&) = delete;
+  Allocator& operator=(Allocator const&) = delete;
+
+  void init(Context const& ctx, VkDeviceSize block_size = kDefaultBlockSize);
+  void shutdown(Context const& ctx);
+
+  // Allocate + bind.
+  Allocation allocate_buffer(Context const& ctx, VkBuffer buffer, AllocationCreateInfo const& info);
+  Allocation allocate_image(Context const& ctx, VkImage image, AllocationCreateInfo const& info);
+
+  void free(Context const& ctx, Allocation& allocation);
+
+  // [offset, offset + size) of `allocation`, widened to whole atoms; VK_WHOLE_SIZE
+  // runs to the allocation's end. No-ops for coherent memory.
+  void flush(Context const& ctx, Allocation const& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+  void invalidate(Context const& ctx, Allocation const& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+  VkDeviceSize non_coherent_atom_size() const { return atom_size_; }
+
+  AllocatorStats stats() const;
+
+private:
+  enum class ResourceKind : std::uint8_t { Buffer, Image };
+
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    RangeAllocator ranges{};     // FreeList
+    VkDeviceSize linear_head = 0; // Linear
+    std::uint32_t live = 0;
+  };
+
+  struct Pool {
+    std::uint32_t memory_type = UINT32_MAX;
+    ResourceKind kind = ResourceKind::Buffer;
+    AllocationStrategy strategy = AllocationStrategy::FreeList;
+    std::vector<Block> blocks; // empty slots keep memory == VK_NULL_HANDLE
+  };
+
+  Allocation allocate(Context const& ctx,
+                      VkMemoryRequirements const& req,
+                      AllocationCreateInfo const& info,
+                      ResourceKind kind);
+
+  Allocation allocate_dedicated(Context const& ctx, VkDeviceSize size, std::uint32_t memory_type);
+  bool try_allocate_from(Block& block, AllocationStrategy strategy, VkMemoryRequirements const& req, VkDeviceSize& out_offset);
+
+  std::uint32_t find_memory_type(std::uint32_t type_bits, VkMemoryPropertyFlags props) const;
+  std::uint32_t find_memory_type(std::uint32_t type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const;
+  bool is_non_coherent(std::uint32_t memory_type) const;
+  VkMappedMemoryRange mapped_range(Allocation const& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+  std::uint32_t find_or_create_pool(std::uint32_t memory_type, ResourceKind kind, AllocationStrategy strategy);
+
+  VkDeviceMemory allocate_memory(Context const& ctx, VkDeviceSize size, std::uint32_t memory_type, void** out_mapped);
+  void free_memory(Context const& ctx, VkDeviceMemory memory, void* mapped);
+
+private:
+  mutable std::mutex mutex_;
+
+  VkPhysicalDeviceMemoryProperties memory_props_{};
+  std::uint32_t max_allocation_count_ = 0;
+  VkDeviceSize atom_size_ = 1;
+  VkDeviceSize block_size_ = kDefaultBlockSize;
+
+  std::vector<Pool> pools_;
+  AllocatorStats stats_{};
+};
+
+} // namespace gfx
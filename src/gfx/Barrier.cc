@@ -0,0 +1,89 @@
+#include "gfx/Barrier.h"
+
+namespace gfx {
+
+namespace {
+
+constexpr VkAccessFlags kWriteAccess =
+    VK_ACCESS_SHADER_WRITE_BIT
+  | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+  | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+  | VK_ACCESS_TRANSFER_WRITE_BIT
+  | VK_ACCESS_HOST_WRITE_BIT
+  | VK_ACCESS_MEMORY_WRITE_BIT;
+
+} // namespace
+
+ImageUse color_attachment_use() {
+  return ImageUse{VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                  VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+}
+
+ImageUse depth_attachment_use() {
+  return ImageUse{VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+}
+
+ImageUse present_use() {
+  // Presentation itself is ordered by the semaphore. The stage is the one the
+  // acquire semaphore is waited at, so the next frame's barrier out of this
+  // use chains behind that wait instead of racing the presentation engine.
+  return ImageUse{VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0};
+}
+
+ImageUse transfer_src_use() {
+  return ImageUse{VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+}
+
+ImageUse transfer_dst_use() {
+  return ImageUse{VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+}
+
+ImageUse fragment_sampled_use() {
+  return ImageUse{VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT};
+}
+
+ImageUse compute_sampled_use() {
+  return ImageUse{VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT};
+}
+
+ImageUse compute_storage_use() {
+  return ImageUse{VK_IMAGE_LAYOUT_GENERAL,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+}
+
+void transition_image(VkCommandBuffer cb,
+                      VkImage image,
+                      VkImageAspectFlags aspect,
+                      ImageUse& tracked,
+                      ImageUse const& next,
+                      bool discard) {
+  bool const writes = ((tracked.access | next.access) & kWriteAccess) != 0U;
+  if (!discard && !writes && tracked.layout == next.layout) {
+    tracked = next;
+    return;
+  }
+
+  VkImageMemoryBarrier b{};
+  b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  b.srcAccessMask = tracked.access & kWriteAccess; // only writes need making available
+  b.dstAccessMask = next.access;
+  b.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : tracked.layout;
+  b.newLayout = next.layout;
+  b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  b.image = image;
+  b.subresourceRange.aspectMask = aspect;
+  b.subresourceRange.baseMipLevel = 0;
+  b.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+  b.subresourceRange.baseArrayLayer = 0;
+  b.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+  vkCmdPipelineBarrier(cb, tracked.stage, next.stage, 0, 0, nullptr, 0, nullptr, 1, &b);
+  tracked = next;
+}
+
+} // namespace gfx
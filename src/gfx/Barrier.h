@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace gfx {
+
+// How an image was last used, or is about to be: its layout plus the stages and
+// accesses a barrier has to order against.
+struct ImageUse {
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkPipelineStageFlags stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  VkAccessFlags access = 0;
+};
+
+ImageUse color_attachment_use();
+ImageUse depth_attachment_use();
+ImageUse present_use();
+ImageUse transfer_src_use();
+ImageUse transfer_dst_use();
+ImageUse fragment_sampled_use();
+ImageUse compute_sampled_use();
+ImageUse compute_storage_use(); // GENERAL, read and written by compute
+
+// Records the barrier that takes `image` from `tracked` to `next`, then sets
+// `tracked = next`. With `discard` the old contents are dropped (oldLayout
+// UNDEFINED) but the previous use is still waited for, e.g. a cleared
+// attachment that an earlier frame wrote. Read-after-read in the same layout
+// needs no barrier and records nothing.
+void transition_image(VkCommandBuffer cb,
+                      VkImage image,
+                      VkImageAspectFlags aspect,
+                      ImageUse& tracked,
+                      ImageUse const& next,
+                      bool discard = false);
+
+} // namespace gfx
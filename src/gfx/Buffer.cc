@@ -21,21 +21,6 @@ void vk_check(VkResult r, char const* what) {
   }
 }
 
-uint32_t find_memory_type(Context const& ctx, uint32_t type_bits, VkMemoryPropertyFlags props) {
-  VkPhysicalDeviceMemoryProperties mem{};
-  vkGetPhysicalDeviceMemoryProperties(ctx.physical_device(), &mem);
-
-  for (uint32_t i = 0; i < mem.memoryTypeCount; ++i) {
-    bool const type_ok = ((type_bits & (1u << i)) != 0u);
-    bool const props_ok = ((mem.memoryTypes[i].propertyFlags & props) == props);
-    if (type_ok && props_ok) {
-      return i;
-    }
-  }
-
-  fail("No suitable memory type found.");
-}
-
 } // namespace
 
 Buffer::~Buffer() {
@@ -51,11 +36,11 @@ Buffer& Buffer::operator=(Buffer&& other) noexcept {
   }
 
   buffer_ = other.buffer_;
-  memory_ = other.memory_;
+  allocation_ = other.allocation_;
   size_ = other.size_;
 
   other.buffer_ = VK_NULL_HANDLE;
-  other.memory_ = VK_NULL_HANDLE;
+  other.allocation_ = Allocation{};
   other.size_ = 0;
 
   return *this;
@@ -65,6 +50,15 @@ void Buffer::init(Context const& ctx,
                   VkDeviceSize size,
                   VkBufferUsageFlags usage,
                   VkMemoryPropertyFlags memory_props) {
+  AllocationCreateInfo alloc{};
+  alloc.required = memory_props;
+  init(ctx, size, usage, alloc);
+}
+
+void Buffer::init(Context const& ctx,
+                  VkDeviceSize size,
+                  VkBufferUsageFlags usage,
+                  AllocationCreateInfo const& alloc) {
   if (size == 0) {
     fail("Buffer::init: size == 0");
   }
@@ -77,16 +71,7 @@ void Buffer::init(Context const& ctx,
 
   vk_check(vkCreateBuffer(ctx.device(), &bci, nullptr, &buffer_), "vkCreateBuffer");
 
-  VkMemoryRequirements req{};
-  vkGetBufferMemoryRequirements(ctx.device(), buffer_, &req);
-
-  VkMemoryAllocateInfo mai{};
-  mai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  mai.allocationSize = req.size;
-  mai.memoryTypeIndex = find_memory_type(ctx, req.memoryTypeBits, memory_props);
-
-  vk_check(vkAllocateMemory(ctx.device(), &mai, nullptr, &memory_), "vkAllocateMemory");
-  vk_check(vkBindBufferMemory(ctx.device(), buffer_, memory_, 0), "vkBindBufferMemory");
+  allocation_ = ctx.allocator().allocate_buffer(ctx, buffer_, alloc);
 
   size_ = size;
 }
@@ -96,9 +81,8 @@ void Buffer::shutdown(Context const& ctx) {
     vkDestroyBuffer(ctx.device(), buffer_, nullptr);
     buffer_ = VK_NULL_HANDLE;
   }
-  if (memory_ != VK_NULL_HANDLE) {
-    vkFreeMemory(ctx.device(), memory_, nullptr);
-    memory_ = VK_NULL_HANDLE;
+  if (allocation_.valid()) {
+    ctx.allocator().free(ctx, allocation_);
   }
   size_ = 0;
 }
@@ -111,11 +95,25 @@ void Buffer::upload(Context const& ctx, void const* data, std::size_t size, std:
     fail("Buffer::upload: out of range");
   }
 
-  void* mapped = nullptr;
-  vk_check(vkMapMemory(ctx.device(), memory_, static_cast<VkDeviceSize>(offset), static_cast<VkDeviceSize>(size), 0, &mapped),
-           "vkMapMemory");
-  std::memcpy(mapped, data, size);
-  vkUnmapMemory(ctx.device(), memory_);
+  if (allocation_.mapped == nullptr) {
+    fail("Buffer::upload: buffer is not host-visible");
+  }
+
+  // Host-visible blocks stay mapped for the allocator's lifetime.
+  std::memcpy(static_cast<char*>(allocation_.mapped) + offset, data, size);
+  flush(ctx, static_cast<VkDeviceSize>(offset), static_cast<VkDeviceSize>(size));
+}
+
+void Buffer::flush(Context const& ctx, VkDeviceSize offset, VkDeviceSize size) const {
+  if (allocation_.valid()) {
+    ctx.allocator().flush(ctx, allocation_, offset, size);
+  }
+}
+
+void Buffer::invalidate(Context const& ctx, VkDeviceSize offset, VkDeviceSize size) const {
+  if (allocation_.valid()) {
+    ctx.allocator().invalidate(ctx, allocation_, offset, size);
+  }
 }
 
 void Buffer::init_device_local_with_staging(Context const& ctx,
@@ -130,34 +128,14 @@ void Buffer::init_device_local_with_staging(Context const& ctx,
     fail("init_device_local_with_staging: size == 0");
   }
 
-  // 1) staging buffer (host-visible)
-  Buffer staging{};
-  staging.init(ctx,
-               static_cast<VkDeviceSize>(size_bytes),
-               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-  staging.upload(ctx, data, size_bytes);
-
-  // 2) device-local destination
   // Must include TRANSFER_DST for vkCmdCopyBuffer.
   init(ctx,
        static_cast<VkDeviceSize>(size_bytes),
        usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  // 3) copy
-  VkCommandBuffer cb = uploader.begin(ctx);
-
-  VkBufferCopy region{};
-  region.srcOffset = 0;
-  region.dstOffset = 0;
-  region.size = static_cast<VkDeviceSize>(size_bytes);
-  vkCmdCopyBuffer(cb, staging.handle(), handle(), 1, &region);
-
-  uploader.end_and_submit(ctx, cb);
-
-  // 4) staging cleanup
-  staging.shutdown(ctx);
+  // Staged through the uploader's ring; visible after the next flush().
+  uploader.enqueue_buffer(ctx, handle(), 0, data, size_bytes);
 }
 
 } // namespace gfx
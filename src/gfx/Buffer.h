@@ -5,6 +5,8 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "gfx/Allocator.h"
+
 namespace gfx {
 
 class Context;
@@ -26,12 +28,27 @@ public:
             VkBufferUsageFlags usage,
             VkMemoryPropertyFlags memory_props);
 
+  void init(Context const& ctx,
+            VkDeviceSize size,
+            VkBufferUsageFlags usage,
+            AllocationCreateInfo const& alloc);
+
   void shutdown(Context const& ctx);
 
-  // For HOST_VISIBLE buffers.
+  // For HOST_VISIBLE buffers: copies into the persistent mapping and flushes
+  // the range if the memory is not coherent.
   void upload(Context const& ctx, void const* data, std::size_t size, std::size_t offset = 0);
 
-  // Helper: create DEVICE_LOCAL buffer and fill it via staging + vkCmdCopyBuffer.
+  // After writing through mapped(): makes [offset, offset + size) visible to
+  // the GPU. Free on coherent memory.
+  void flush(Context const& ctx, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+  // Before reading GPU writes through mapped() (after the fence). Free on
+  // coherent memory.
+  void invalidate(Context const& ctx, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+  // Helper: create DEVICE_LOCAL buffer and enqueue its contents on the uploader.
+  // The copy is submitted with the uploader's next flush().
   void init_device_local_with_staging(Context const& ctx,
                                       Upload& uploader,
                                       void const* data,
@@ -41,9 +58,14 @@ public:
   VkBuffer handle() const { return buffer_; }
   VkDeviceSize size() const { return size_; }
 
+  // Persistent mapping of HOST_VISIBLE buffers, else nullptr. Lets callers write
+  // in place instead of building a temporary for upload().
+  void* mapped() const { return allocation_.mapped; }
+  bool coherent() const { return allocation_.coherent; }
+
 private:
   VkBuffer buffer_ = VK_NULL_HANDLE;
-  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  Allocation allocation_{};
   VkDeviceSize size_ = 0;
 };
 
@@ -0,0 +1,109 @@
+#include "gfx/ComputePipeline.h"
+
+#include "gfx/Context.h"
+#include "gfx/Shader.h"
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+} // namespace
+
+ComputePipeline::~ComputePipeline() {
+}
+
+ComputePipeline::ComputePipeline(ComputePipeline&& other) noexcept {
+  *this = std::move(other);
+}
+
+ComputePipeline& ComputePipeline::operator=(ComputePipeline&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  set_layout_ = other.set_layout_;
+  pipeline_layout_ = other.pipeline_layout_;
+  pipeline_ = other.pipeline_;
+
+  other.set_layout_ = VK_NULL_HANDLE;
+  other.pipeline_layout_ = VK_NULL_HANDLE;
+  other.pipeline_ = VK_NULL_HANDLE;
+
+  return *this;
+}
+
+void ComputePipeline::init(Context const& ctx,
+                           std::string const& comp_spv_path,
+                           std::span<VkDescriptorSetLayoutBinding const> bindings,
+                           std::uint32_t push_constant_size) {
+  if (pipeline_ != VK_NULL_HANDLE) {
+    fail("ComputePipeline::init called twice");
+  }
+
+  VkDescriptorSetLayoutCreateInfo dslci{};
+  dslci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  dslci.bindingCount = static_cast<uint32_t>(bindings.size());
+  dslci.pBindings = bindings.data();
+
+  vk_check(vkCreateDescriptorSetLayout(ctx.device(), &dslci, nullptr, &set_layout_), "vkCreateDescriptorSetLayout");
+
+  VkPushConstantRange pcr{};
+  pcr.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pcr.offset = 0;
+  pcr.size = push_constant_size;
+
+  VkPipelineLayoutCreateInfo plci{};
+  plci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  plci.setLayoutCount = 1;
+  plci.pSetLayouts = &set_layout_;
+  plci.pushConstantRangeCount = (push_constant_size > 0U) ? 1U : 0U;
+  plci.pPushConstantRanges = (push_constant_size > 0U) ? &pcr : nullptr;
+
+  vk_check(vkCreatePipelineLayout(ctx.device(), &plci, nullptr, &pipeline_layout_), "vkCreatePipelineLayout");
+
+  VkShaderModule comp = create_shader_module(ctx, comp_spv_path);
+
+  VkComputePipelineCreateInfo cpci{};
+  cpci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  cpci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  cpci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  cpci.stage.module = comp;
+  cpci.stage.pName = "main";
+  cpci.layout = pipeline_layout_;
+
+  VkResult const r = vkCreateComputePipelines(ctx.device(), ctx.pipeline_cache(), 1, &cpci, nullptr, &pipeline_);
+  vkDestroyShaderModule(ctx.device(), comp, nullptr);
+  vk_check(r, "vkCreateComputePipelines");
+}
+
+void ComputePipeline::shutdown(Context const& ctx) {
+  if (pipeline_ != VK_NULL_HANDLE) {
+    vkDestroyPipeline(ctx.device(), pipeline_, nullptr);
+    pipeline_ = VK_NULL_HANDLE;
+  }
+  if (pipeline_layout_ != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(ctx.device(), pipeline_layout_, nullptr);
+    pipeline_layout_ = VK_NULL_HANDLE;
+  }
+  if (set_layout_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(ctx.device(), set_layout_, nullptr);
+    set_layout_ = VK_NULL_HANDLE;
+  }
+}
+
+} // namespace gfx
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace gfx {
+
+class Context;
+
+// One compute shader with a single descriptor set (set 0) and an optional push
+// constant block visible to the compute stage.
+class ComputePipeline {
+public:
+  ComputePipeline() = default;
+  ~ComputePipeline();
+
+  ComputePipeline(ComputePipeline const&) = delete;
+  ComputePipeline& operator=(ComputePipeline const&) = delete;
+
+  ComputePipeline(ComputePipeline&& other) noexcept;
+  ComputePipeline& operator=(ComputePipeline&& other) noexcept;
+
+  void init(Context const& ctx,
+            std::string const& comp_spv_path,
+            std::span<VkDescriptorSetLayoutBinding const> bindings,
+            std::uint32_t push_constant_size);
+
+  void shutdown(Context const& ctx);
+
+  VkPipeline pipeline() const { return pipeline_; }
+  VkPipelineLayout pipeline_layout() const { return pipeline_layout_; }
+  VkDescriptorSetLayout set_layout() const { return set_layout_; }
+
+private:
+  VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+};
+
+} // namespace gfx
@@ -1,6 +1,8 @@
 #include "gfx/Context.h"
 
+#include "gfx/Allocator.h"
 #include "gfx/GlfwVulkan.h"
+#include "gfx/PipelineCache.h"
 #include "gfx/Upload.h"
 
 #include <cstdio>
@@ -101,9 +103,11 @@ VkDebugUtilsMessengerCreateInfoEXT make_debug_messenger_create_info() {
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphics;
   std::optional<uint32_t> present;
+  std::optional<uint32_t> transfer; // transfer-capable, no graphics
 
-  bool complete() const {
-    return graphics.has_value() && present.has_value();
+  // Headless contexts need no present family.
+  bool complete(bool need_present) const {
+    return graphics.has_value() && (present.has_value() || !need_present);
   }
 };
 
@@ -138,18 +142,35 @@ QueueFamilyIndices find_queue_families(VkPhysicalDevice pd, VkSurfaceKHR surface
       indices.graphics = i;
     }
 
-    VkBool32 present_support = VK_FALSE;
-    vk_check(vkGetPhysicalDeviceSurfaceSupportKHR(pd, i, surface, &present_support), "vkGetPhysicalDeviceSurfaceSupportKHR");
+    if (surface != VK_NULL_HANDLE) {
+      VkBool32 present_support = VK_FALSE;
+      vk_check(vkGetPhysicalDeviceSurfaceSupportKHR(pd, i, surface, &present_support), "vkGetPhysicalDeviceSurfaceSupportKHR");
 
-    if (present_support == VK_TRUE) {
-      indices.present = i;
+      if (present_support == VK_TRUE) {
+        indices.present = i;
+      }
     }
 
-    if (indices.complete()) {
+    if (indices.complete(surface != VK_NULL_HANDLE)) {
       break;
     }
   }
 
+  // Prefer a pure DMA family (no graphics/compute), otherwise any non-graphics family that can copy.
+  for (uint32_t i = 0; i < count; ++i) {
+    VkQueueFlags const f = props[i].queueFlags;
+    if ((f & VK_QUEUE_TRANSFER_BIT) == 0U || (f & VK_QUEUE_GRAPHICS_BIT) != 0U || props[i].queueCount == 0U) {
+      continue;
+    }
+    if ((f & VK_QUEUE_COMPUTE_BIT) == 0U) {
+      indices.transfer = i;
+      break;
+    }
+    if (!indices.transfer.has_value()) {
+      indices.transfer = i;
+    }
+  }
+
   return indices;
 }
 
@@ -177,9 +198,25 @@ Context& Context::operator=(Context&& other) noexcept {
   device_ = other.device_;
   graphics_queue_ = other.graphics_queue_;
   present_queue_ = other.present_queue_;
+  transfer_queue_ = other.transfer_queue_;
   graphics_queue_family_ = other.graphics_queue_family_;
   present_queue_family_ = other.present_queue_family_;
+  transfer_queue_family_ = other.transfer_queue_family_;
+  indirect_draws_ = other.indirect_draws_;
+  draw_indexed_indirect_count_ = other.draw_indexed_indirect_count_;
+  begin_rendering_ = other.begin_rendering_;
+  end_rendering_ = other.end_rendering_;
+  wait_for_present_ = other.wait_for_present_;
+  pipeline_statistics_ = other.pipeline_statistics_;
+  inherited_queries_ = other.inherited_queries_;
+  bc_textures_ = other.bc_textures_;
+  astc_textures_ = other.astc_textures_;
+  memory_budget_ = other.memory_budget_;
+  timestamp_period_ = other.timestamp_period_;
+  timestamp_valid_bits_ = other.timestamp_valid_bits_;
+  allocator_ = other.allocator_;
   upload_ = other.upload_;
+  pipeline_cache_ = other.pipeline_cache_;
 
   other.instance_ = VK_NULL_HANDLE;
   other.debug_messenger_ = VK_NULL_HANDLE;
@@ -188,9 +225,25 @@ Context& Context::operator=(Context&& other) noexcept {
   other.device_ = VK_NULL_HANDLE;
   other.graphics_queue_ = VK_NULL_HANDLE;
   other.present_queue_ = VK_NULL_HANDLE;
+  other.transfer_queue_ = VK_NULL_HANDLE;
   other.graphics_queue_family_ = UINT32_MAX;
   other.present_queue_family_ = UINT32_MAX;
+  other.transfer_queue_family_ = UINT32_MAX;
+  other.indirect_draws_ = false;
+  other.draw_indexed_indirect_count_ = nullptr;
+  other.begin_rendering_ = nullptr;
+  other.end_rendering_ = nullptr;
+  other.wait_for_present_ = nullptr;
+  other.pipeline_statistics_ = false;
+  other.inherited_queries_ = false;
+  other.bc_textures_ = false;
+  other.astc_textures_ = false;
+  other.memory_budget_ = false;
+  other.timestamp_period_ = 0.0f;
+  other.timestamp_valid_bits_ = 0;
+  other.allocator_ = nullptr;
   other.upload_ = nullptr;
+  other.pipeline_cache_ = nullptr;
 
   return *this;
 }
@@ -203,17 +256,36 @@ void Context::init(GLFWwindow* window, ContextCreateInfo const& info) {
   create_instance(window, info);
   setup_debug(info);
   create_surface(window);
-  pick_physical_device();
+  pick_physical_device(info);
   create_device(info);
 
   // must be after device creation
+  create_allocator();
   create_uploader();
+  create_pipeline_cache(info);
+}
+
+void Context::init(ContextCreateInfo const& info) {
+  create_instance(nullptr, info);
+  setup_debug(info);
+  pick_physical_device(info);
+  create_device(info);
+
+  create_allocator();
+  create_uploader();
+  create_pipeline_cache(info);
 }
 
 void Context::shutdown() {
+  // every pipeline must be destroyed by now; writes the cache file
+  destroy_pipeline_cache();
+
   // uploader uses device/queue -> destroy before vkDestroyDevice
   destroy_uploader();
 
+  // every Buffer/Image must be shut down by now
+  destroy_allocator();
+
   if (device_ != VK_NULL_HANDLE) {
     vkDestroyDevice(device_, nullptr);
     device_ = VK_NULL_HANDLE;
@@ -222,8 +294,22 @@ void Context::shutdown() {
   physical_device_ = VK_NULL_HANDLE;
   graphics_queue_ = VK_NULL_HANDLE;
   present_queue_ = VK_NULL_HANDLE;
+  transfer_queue_ = VK_NULL_HANDLE;
   graphics_queue_family_ = UINT32_MAX;
   present_queue_family_ = UINT32_MAX;
+  transfer_queue_family_ = UINT32_MAX;
+  indirect_draws_ = false;
+  draw_indexed_indirect_count_ = nullptr;
+  begin_rendering_ = nullptr;
+  end_rendering_ = nullptr;
+  wait_for_present_ = nullptr;
+  pipeline_statistics_ = false;
+  inherited_queries_ = false;
+  bc_textures_ = false;
+  astc_textures_ = false;
+  memory_budget_ = false;
+  timestamp_period_ = 0.0f;
+  timestamp_valid_bits_ = 0;
 
   if (surface_ != VK_NULL_HANDLE && instance_ != VK_NULL_HANDLE) {
     vkDestroySurfaceKHR(instance_, surface_, nullptr);
@@ -241,6 +327,27 @@ void Context::shutdown() {
   }
 }
 
+void Context::create_allocator() {
+  if (allocator_ != nullptr) {
+    fail("Context::create_allocator called twice");
+  }
+  allocator_ = new (std::nothrow) Allocator();
+  if (allocator_ == nullptr) {
+    fail("Context: Allocator allocation failed");
+  }
+  allocator_->init(*this);
+}
+
+void Context::destroy_allocator() {
+  if (allocator_ != nullptr) {
+    if (device_ != VK_NULL_HANDLE) {
+      allocator_->shutdown(*this);
+    }
+    delete allocator_;
+    allocator_ = nullptr;
+  }
+}
+
 void Context::create_uploader() {
   if (upload_ != nullptr) {
     fail("Context::create_uploader called twice");
@@ -262,20 +369,50 @@ void Context::destroy_uploader() {
   }
 }
 
-void Context::create_instance(GLFWwindow* window, ContextCreateInfo const& info) {
-  (void)window;
-
-  if (glfwVulkanSupported() == GLFW_FALSE) {
-    fail("glfwVulkanSupported() == false");
+void Context::create_pipeline_cache(ContextCreateInfo const& info) {
+  if (pipeline_cache_ != nullptr) {
+    fail("Context::create_pipeline_cache called twice");
+  }
+  pipeline_cache_ = new (std::nothrow) PipelineCache();
+  if (pipeline_cache_ == nullptr) {
+    fail("Context: PipelineCache allocation failed");
+  }
+  pipeline_cache_->init(*this, info.pipeline_cache_path);
+  if (pipeline_cache_->loaded_from_disk()) {
+    std::fprintf(stderr, "Pipeline cache loaded: %s\n", info.pipeline_cache_path.c_str());
   }
+}
 
-  uint32_t glfw_ext_count = 0;
-  char const** glfw_exts = glfwGetRequiredInstanceExtensions(&glfw_ext_count);
-  if (glfw_exts == nullptr || glfw_ext_count == 0U) {
-    fail("glfwGetRequiredInstanceExtensions() failed");
+void Context::destroy_pipeline_cache() {
+  if (pipeline_cache_ != nullptr) {
+    if (device_ != VK_NULL_HANDLE) {
+      pipeline_cache_->shutdown(*this);
+    }
+    delete pipeline_cache_;
+    pipeline_cache_ = nullptr;
   }
+}
+
+VkPipelineCache Context::pipeline_cache() const {
+  return (pipeline_cache_ != nullptr) ? pipeline_cache_->handle() : VK_NULL_HANDLE;
+}
+
+void Context::create_instance(GLFWwindow* window, ContextCreateInfo const& info) {
+  std::vector<char const*> instance_exts;
+
+  // Surface extensions only for a window; headless needs none.
+  if (window != nullptr) {
+    if (glfwVulkanSupported() == GLFW_FALSE) {
+      fail("glfwVulkanSupported() == false");
+    }
 
-  std::vector<char const*> instance_exts(glfw_exts, glfw_exts + glfw_ext_count);
+    uint32_t glfw_ext_count = 0;
+    char const** glfw_exts = glfwGetRequiredInstanceExtensions(&glfw_ext_count);
+    if (glfw_exts == nullptr || glfw_ext_count == 0U) {
+      fail("glfwGetRequiredInstanceExtensions() failed");
+    }
+    instance_exts.assign(glfw_exts, glfw_exts + glfw_ext_count);
+  }
 
   // portability enumeration (MoltenVK/macOS)
   if (!has_extension(instance_exts, "VK_KHR_portability_enumeration")) {
@@ -333,7 +470,7 @@ void Context::create_surface(GLFWwindow* window) {
   vk_check(glfwCreateWindowSurface(instance_, window, nullptr, &surface_), "glfwCreateWindowSurface");
 }
 
-void Context::pick_physical_device() {
+void Context::pick_physical_device(ContextCreateInfo const& info) {
   uint32_t count = 0;
   vk_check(vkEnumeratePhysicalDevices(instance_, &count, nullptr), "vkEnumeratePhysicalDevices(count)");
   if (count == 0U) {
@@ -343,26 +480,35 @@ void Context::pick_physical_device() {
   std::vector<VkPhysicalDevice> devices(count);
   vk_check(vkEnumeratePhysicalDevices(instance_, &count, devices.data()), "vkEnumeratePhysicalDevices(list)");
 
+  bool const presents = surface_ != VK_NULL_HANDLE;
   for (auto pd : devices) {
     auto const qf = find_queue_families(pd, surface_);
-    if (!qf.complete()) {
+    if (!qf.complete(presents)) {
       continue;
     }
-    if (!has_device_extension(pd, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+    if (presents && !has_device_extension(pd, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
       continue;
     }
     physical_device_ = pd;
     graphics_queue_family_ = qf.graphics.value();
-    present_queue_family_ = qf.present.value();
+    present_queue_family_ = presents ? qf.present.value() : UINT32_MAX;
+    transfer_queue_family_ = (info.use_transfer_queue && qf.transfer.has_value())
+      ? qf.transfer.value()
+      : graphics_queue_family_;
     return;
   }
 
-  fail("No suitable physical device found (need graphics+present and VK_KHR_swapchain)");
+  fail(presents ? "No suitable physical device found (need graphics+present and VK_KHR_swapchain)"
+                : "No suitable physical device found (need a graphics queue)");
 }
 
 void Context::create_device(ContextCreateInfo const& info) {
+  bool const presents = surface_ != VK_NULL_HANDLE;
+
   std::vector<char const*> device_exts;
-  device_exts.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  if (presents) {
+    device_exts.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  }
 
   {
     constexpr char const* kPortabilitySubsetExt = "VK_KHR_portability_subset";
@@ -373,7 +519,10 @@ void Context::create_device(ContextCreateInfo const& info) {
 
   float const prio = 1.0f;
 
-  std::unordered_set<uint32_t> unique_qf{graphics_queue_family_, present_queue_family_};
+  std::unordered_set<uint32_t> unique_qf{graphics_queue_family_, transfer_queue_family_};
+  if (presents) {
+    unique_qf.insert(present_queue_family_);
+  }
 
   std::vector<VkDeviceQueueCreateInfo> qcis;
   qcis.reserve(unique_qf.size());
@@ -386,10 +535,94 @@ void Context::create_device(ContextCreateInfo const& info) {
     qcis.push_back(qci);
   }
 
+  bool const has_draw_indirect_count =
+    has_device_extension(physical_device_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  if (has_draw_indirect_count) {
+    device_exts.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+
+  // Budget and usage per heap, for texture residency.
+  bool const has_memory_budget = has_device_extension(physical_device_, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (has_memory_budget) {
+    device_exts.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+
+  // The instance targets 1.1, so dynamic rendering always goes through the
+  // extension and its dependencies, even on 1.3 drivers.
+  bool const has_dynamic_rendering = info.use_dynamic_rendering &&
+    has_device_extension(physical_device_, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+    has_device_extension(physical_device_, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+    has_device_extension(physical_device_, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+
+  // Frame pacing: present ids to name each present, present wait to block on them.
+  bool const has_present_wait = presents && info.use_present_wait &&
+    has_device_extension(physical_device_, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+    has_device_extension(physical_device_, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering{};
+  dynamic_rendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  VkPhysicalDevicePresentIdFeaturesKHR present_id{};
+  present_id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  VkPhysicalDevicePresentWaitFeaturesKHR present_wait{};
+  present_wait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+  VkPhysicalDeviceFeatures2 supported2{};
+  supported2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  {
+    void** next = &supported2.pNext;
+    if (has_dynamic_rendering) {
+      *next = &dynamic_rendering;
+      next = &dynamic_rendering.pNext;
+    }
+    if (has_present_wait) {
+      *next = &present_id;
+      present_id.pNext = &present_wait;
+    }
+  }
+  vkGetPhysicalDeviceFeatures2(physical_device_, &supported2);
+  VkPhysicalDeviceFeatures const& supported = supported2.features;
+
+  bool const use_dynamic_rendering = has_dynamic_rendering && dynamic_rendering.dynamicRendering == VK_TRUE;
+  if (use_dynamic_rendering) {
+    device_exts.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+    device_exts.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+    device_exts.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+  }
+
+  bool const use_present_wait = has_present_wait && present_id.presentId == VK_TRUE && present_wait.presentWait == VK_TRUE;
+  if (use_present_wait) {
+    device_exts.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    device_exts.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  }
+
   VkPhysicalDeviceFeatures features{};
+  features.multiDrawIndirect = supported.multiDrawIndirect;
+  features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+  features.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+  features.inheritedQueries = supported.inheritedQueries;
+  features.textureCompressionBC = supported.textureCompressionBC;
+  features.textureCompressionASTC_LDR = supported.textureCompressionASTC_LDR;
+
+  // Re-link the chain with only the features being enabled.
+  void* enabled_chain = nullptr;
+  {
+    void** next = &enabled_chain;
+    dynamic_rendering.pNext = nullptr;
+    present_id.pNext = nullptr;
+    present_wait.pNext = nullptr;
+    if (use_dynamic_rendering) {
+      *next = &dynamic_rendering;
+      next = &dynamic_rendering.pNext;
+    }
+    if (use_present_wait) {
+      *next = &present_id;
+      present_id.pNext = &present_wait;
+    }
+  }
 
   VkDeviceCreateInfo dci{};
   dci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  dci.pNext = enabled_chain;
   dci.queueCreateInfoCount = static_cast<uint32_t>(qcis.size());
   dci.pQueueCreateInfos = qcis.data();
   dci.pEnabledFeatures = &features;
@@ -405,11 +638,87 @@ void Context::create_device(ContextCreateInfo const& info) {
   vk_check(vkCreateDevice(physical_device_, &dci, nullptr, &device_), "vkCreateDevice");
 
   vkGetDeviceQueue(device_, graphics_queue_family_, 0, &graphics_queue_);
-  vkGetDeviceQueue(device_, present_queue_family_, 0, &present_queue_);
+  if (presents) {
+    vkGetDeviceQueue(device_, present_queue_family_, 0, &present_queue_);
+  }
+  vkGetDeviceQueue(device_, transfer_queue_family_, 0, &transfer_queue_);
+
+  indirect_draws_ = (features.multiDrawIndirect == VK_TRUE) && (features.drawIndirectFirstInstance == VK_TRUE);
+  pipeline_statistics_ = features.pipelineStatisticsQuery == VK_TRUE;
+  inherited_queries_ = features.inheritedQueries == VK_TRUE;
+  bc_textures_ = features.textureCompressionBC == VK_TRUE;
+  astc_textures_ = features.textureCompressionASTC_LDR == VK_TRUE;
+  memory_budget_ = has_memory_budget;
+  if (has_draw_indirect_count) {
+    draw_indexed_indirect_count_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+      vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+  }
+  if (use_dynamic_rendering) {
+    begin_rendering_ = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+      vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR"));
+    end_rendering_ = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+      vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR"));
+    if (begin_rendering_ == nullptr || end_rendering_ == nullptr) {
+      begin_rendering_ = nullptr;
+      end_rendering_ = nullptr;
+    }
+  }
+  if (use_present_wait) {
+    wait_for_present_ = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+      vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR"));
+  }
 
   VkPhysicalDeviceProperties props{};
   vkGetPhysicalDeviceProperties(physical_device_, &props);
-  std::fprintf(stderr, "Selected GPU: %s\n", props.deviceName);
+  timestamp_period_ = props.limits.timestampPeriod;
+  {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &count, families.data());
+    timestamp_valid_bits_ = families.at(graphics_queue_family_).timestampValidBits;
+  }
+
+  std::fprintf(stderr, presents ? "Selected GPU: %s\n" : "Selected GPU: %s (headless)\n", props.deviceName);
+  if (has_dedicated_transfer_queue()) {
+    std::fprintf(stderr, "Dedicated transfer queue family: %u\n", transfer_queue_family_);
+  }
+  if (supports_dynamic_rendering()) {
+    std::fprintf(stderr, "Dynamic rendering enabled\n");
+  }
+  if (supports_present_wait()) {
+    std::fprintf(stderr, "Present wait enabled\n");
+  }
+}
+
+MemoryBudget Context::device_local_budget() const {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+  budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  VkPhysicalDeviceMemoryProperties2 props{};
+  props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  props.pNext = memory_budget_ ? &budget : nullptr;
+  vkGetPhysicalDeviceMemoryProperties2(physical_device_, &props);
+
+  MemoryBudget b{};
+  VkDeviceSize heap_total = 0;
+  for (uint32_t i = 0; i < props.memoryProperties.memoryHeapCount; ++i) {
+    VkMemoryHeap const& heap = props.memoryProperties.memoryHeaps[i];
+    if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0U) {
+      continue;
+    }
+    heap_total += heap.size;
+    if (memory_budget_) {
+      b.budget += budget.heapBudget[i];
+      b.usage += budget.heapUsage[i];
+    }
+  }
+
+  if (!memory_budget_) {
+    b.budget = heap_total / 5U * 4U;
+    b.usage = (allocator_ != nullptr) ? allocator_->stats().bytes_reserved : 0U;
+  }
+  return b;
 }
 
 } // namespace gfx
@@ -3,16 +3,29 @@
 #include <vulkan/vulkan.h>
 
 #include <cstdint>
+#include <string>
 
 struct GLFWwindow;
 
 namespace gfx {
 
+class Allocator;
+class PipelineCache;
 class Upload;
 
 struct ContextCreateInfo {
   bool enable_validation = true;
   bool enable_debug_utils = true;
+  bool use_transfer_queue = true; // route Upload through a transfer-only family when present
+  std::string pipeline_cache_path;  // persisted across runs; empty keeps it in memory
+  bool use_dynamic_rendering = true; // VK_KHR_dynamic_rendering when the device has it
+  bool use_present_wait = true;      // VK_KHR_present_id + VK_KHR_present_wait when the device has them
+};
+
+// Device-local memory of this process, summed over the DEVICE_LOCAL heaps.
+struct MemoryBudget {
+  VkDeviceSize budget = 0; // what the process can use before the driver starts evicting
+  VkDeviceSize usage = 0;
 };
 
 class Context {
@@ -27,32 +40,94 @@ public:
   Context& operator=(Context&& other) noexcept;
 
   void init(GLFWwindow* window, ContextCreateInfo const& info);
+
+  // Headless: no window, surface or VK_KHR_swapchain, and GLFW need not be
+  // initialized. Any device with a graphics queue qualifies; render into an
+  // OffscreenTarget instead of a Swapchain.
+  void init(ContextCreateInfo const& info);
+
   void shutdown();
 
+  bool headless() const { return device_ != VK_NULL_HANDLE && surface_ == VK_NULL_HANDLE; }
+
   VkInstance instance() const { return instance_; }
   VkSurfaceKHR surface() const { return surface_; }
   VkPhysicalDevice physical_device() const { return physical_device_; }
   VkDevice device() const { return device_; }
 
   VkQueue graphics_queue() const { return graphics_queue_; }
-  VkQueue present_queue() const { return present_queue_; }
+  VkQueue present_queue() const { return present_queue_; } // VK_NULL_HANDLE when headless
+
+  // Aliases the graphics queue when there is no dedicated transfer family.
+  VkQueue transfer_queue() const { return transfer_queue_; }
 
   uint32_t graphics_queue_family() const { return graphics_queue_family_; }
   uint32_t present_queue_family() const { return present_queue_family_; }
+  uint32_t transfer_queue_family() const { return transfer_queue_family_; }
+
+  bool has_dedicated_transfer_queue() const { return transfer_queue_family_ != graphics_queue_family_; }
+
+  // GPU-driven draws: multiDrawIndirect + drawIndirectFirstInstance, both enabled
+  // when the device has them. The count variant comes from VK_KHR_draw_indirect_count
+  // and is nullptr without it.
+  bool supports_indirect_draws() const { return indirect_draws_; }
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmd_draw_indexed_indirect_count() const { return draw_indexed_indirect_count_; }
+
+  // Render without VkRenderPass / VkFramebuffer objects (VK_KHR_dynamic_rendering,
+  // core in Vulkan 1.3). Both entry points are nullptr without it.
+  bool supports_dynamic_rendering() const { return begin_rendering_ != nullptr; }
+  PFN_vkCmdBeginRenderingKHR cmd_begin_rendering() const { return begin_rendering_; }
+  PFN_vkCmdEndRenderingKHR cmd_end_rendering() const { return end_rendering_; }
+
+  // Present ids and vkWaitForPresentKHR, for frame pacing and display latency.
+  // The entry point is nullptr without them.
+  bool supports_present_wait() const { return wait_for_present_ != nullptr; }
+  PFN_vkWaitForPresentKHR wait_for_present() const { return wait_for_present_; }
+
+  // Queries for GpuProfiler. Timestamps need non-zero valid bits on the graphics
+  // family; timestamp_period() is nanoseconds per tick. Pipeline statistics
+  // active across vkCmdExecuteCommands also need inherited queries.
+  bool supports_timestamps() const { return timestamp_valid_bits_ != 0U; }
+  float timestamp_period() const { return timestamp_period_; }
+  uint32_t timestamp_valid_bits() const { return timestamp_valid_bits_; }
+  bool supports_pipeline_statistics() const { return pipeline_statistics_; }
+  bool supports_inherited_queries() const { return inherited_queries_; }
+
+  // Block-compressed sampled formats; enabled when the device has them.
+  bool supports_bc_textures() const { return bc_textures_; }
+  bool supports_astc_textures() const { return astc_textures_; }
+
+  // VK_EXT_memory_budget reports the driver's budget and usage, other heaps'
+  // tenants included. Without it the budget is 80% of the heaps and the usage
+  // what Allocator has reserved.
+  bool supports_memory_budget() const { return memory_budget_; }
+  MemoryBudget device_local_budget() const;
+
+  // Internally synchronized; reachable from const Context like the device handle itself.
+  Allocator& allocator() const { return *allocator_; }
 
   Upload& uploader() { return *upload_; }
   Upload const& uploader() const { return *upload_; }
 
+  // Pass to every vkCreate*Pipelines call. Written back to disk by shutdown().
+  VkPipelineCache pipeline_cache() const;
+
 private:
   void create_instance(GLFWwindow* window, ContextCreateInfo const& info);
   void setup_debug(ContextCreateInfo const& info);
   void create_surface(GLFWwindow* window);
-  void pick_physical_device();
+  void pick_physical_device(ContextCreateInfo const& info);
   void create_device(ContextCreateInfo const& info);
 
+  void create_allocator();
+  void destroy_allocator();
+
   void create_uploader();
   void destroy_uploader();
 
+  void create_pipeline_cache(ContextCreateInfo const& info);
+  void destroy_pipeline_cache();
+
 private:
   VkInstance instance_ = VK_NULL_HANDLE;
   VkDebugUtilsMessengerEXT debug_messenger_ = VK_NULL_HANDLE;
@@ -63,11 +138,29 @@ private:
 
   VkQueue graphics_queue_ = VK_NULL_HANDLE;
   VkQueue present_queue_ = VK_NULL_HANDLE;
+  VkQueue transfer_queue_ = VK_NULL_HANDLE;
 
   uint32_t graphics_queue_family_ = UINT32_MAX;
   uint32_t present_queue_family_ = UINT32_MAX;
-
+  uint32_t transfer_queue_family_ = UINT32_MAX;
+
+  bool indirect_draws_ = false;
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count_ = nullptr;
+  PFN_vkCmdBeginRenderingKHR begin_rendering_ = nullptr;
+  PFN_vkCmdEndRenderingKHR end_rendering_ = nullptr;
+  PFN_vkWaitForPresentKHR wait_for_present_ = nullptr;
+
+  bool pipeline_statistics_ = false;
+  bool inherited_queries_ = false;
+  bool bc_textures_ = false;
+  bool astc_textures_ = false;
+  bool memory_budget_ = false;
+  float timestamp_period_ = 0.0f;
+  uint32_t timestamp_valid_bits_ = 0;
+
+  Allocator* allocator_ = nullptr; // owned
   Upload* upload_ = nullptr; // owned
+  PipelineCache* pipeline_cache_ = nullptr; // owned
 };
 
 } // namespace gfx
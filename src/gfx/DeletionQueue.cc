@@ -0,0 +1,55 @@
+#include "gfx/DeletionQueue.h"
+
+#include <stdexcept>
+#include <utility>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+
+} // namespace
+
+DeletionQueue::~DeletionQueue() {
+}
+
+DeletionQueue::DeletionQueue(DeletionQueue&& other) noexcept {
+  *this = std::move(other);
+}
+
+DeletionQueue& DeletionQueue::operator=(DeletionQueue&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  entries_ = std::move(other.entries_);
+  other.entries_.clear();
+
+  return *this;
+}
+
+void DeletionQueue::push(std::uint64_t serial, Deleter deleter) {
+  if (!entries_.empty() && serial < entries_.back().serial) {
+    fail("DeletionQueue::push: serial went backwards");
+  }
+  entries_.push_back(Entry{serial, std::move(deleter)});
+}
+
+void DeletionQueue::collect(Context const& ctx, std::uint64_t completed) {
+  while (!entries_.empty() && entries_.front().serial <= completed) {
+    Deleter deleter = std::move(entries_.front().deleter);
+    entries_.pop_front();
+    deleter(ctx);
+  }
+}
+
+void DeletionQueue::flush(Context const& ctx) {
+  while (!entries_.empty()) {
+    Deleter deleter = std::move(entries_.front().deleter);
+    entries_.pop_front();
+    deleter(ctx);
+  }
+}
+
+} // namespace gfx
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace gfx {
+
+class Context;
+
+// Destruction deferred until the GPU is done with a resource. Each entry is
+// tagged with a serial, typically the number of frames submitted when it was
+// retired; collect() runs every entry whose serial has completed, oldest first.
+class DeletionQueue {
+public:
+  using Deleter = std::function<void(Context const&)>;
+
+public:
+  DeletionQueue() = default;
+  ~DeletionQueue();
+
+  DeletionQueue(DeletionQueue const&) = delete;
+  DeletionQueue& operator=(DeletionQueue const&) = delete;
+
+  DeletionQueue(DeletionQueue&& other) noexcept;
+  DeletionQueue& operator=(DeletionQueue&& other) noexcept;
+
+  // `serial` must not be lower than that of an earlier push.
+  void push(std::uint64_t serial, Deleter deleter);
+
+  // Runs the entries with serial <= `completed`.
+  void collect(Context const& ctx, std::uint64_t completed);
+
+  // Runs everything; the caller guarantees the device is idle.
+  void flush(Context const& ctx);
+
+  std::size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+private:
+  struct Entry {
+    std::uint64_t serial = 0;
+    Deleter deleter;
+  };
+
+  std::deque<Entry> entries_; // serial order
+};
+
+} // namespace gfx
@@ -1,9 +1,11 @@
 #include "gfx/Depth.h"
 
 #include "gfx/Context.h"
+#include "gfx/DeletionQueue.h"
 #include "gfx/Image.h"
 #include "gfx/Swapchain.h"
 
+#include <cstdint>
 #include <new>
 #include <stdexcept>
 #include <string>
@@ -23,13 +25,13 @@ void vk_check(VkResult r, char const* what) {
   }
 }
 
-bool has_stencil(VkFormat fmt) {
+} // namespace
+
+bool format_has_stencil(VkFormat fmt) {
   return (fmt == VK_FORMAT_D32_SFLOAT_S8_UINT)
       || (fmt == VK_FORMAT_D24_UNORM_S8_UINT);
 }
 
-} // namespace
-
 Depth::~Depth() {
 }
 
@@ -44,9 +46,11 @@ Depth& Depth::operator=(Depth&& other) noexcept {
 
   image_ = other.image_;
   format_ = other.format_;
+  sampled_ = other.sampled_;
 
   other.image_ = nullptr;
   other.format_ = VK_FORMAT_UNDEFINED;
+  other.sampled_ = false;
 
   return *this;
 }
@@ -72,27 +76,37 @@ VkFormat Depth::pick_format(Context const& ctx) const {
 }
 
 void Depth::init(Context const& ctx, Swapchain const& sc) {
+  init(ctx, sc.extent());
+}
+
+void Depth::init(Context const& ctx, VkExtent2D extent) {
   if (image_ != nullptr) {
     fail("Depth::init called twice");
   }
 
   format_ = pick_format(ctx);
 
+  // A combined depth/stencil view cannot be sampled, so only depth-only formats
+  // get the sampled usage.
+  VkFormatProperties props{};
+  vkGetPhysicalDeviceFormatProperties(ctx.physical_device(), format_, &props);
+  sampled_ = !format_has_stencil(format_) && (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0u;
+
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  if (sampled_) {
+    usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+  }
+
   image_ = new (std::nothrow) Image();
   if (image_ == nullptr) {
     fail("Depth: allocation failed");
   }
 
-  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
-  if (has_stencil(format_)) {
-    aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
-  }
-
   image_->init_2d(ctx,
-                  sc.extent(),
+                  extent,
                   format_,
-                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                  aspect);
+                  usage,
+                  aspect());
 }
 
 void Depth::shutdown(Context const& ctx) {
@@ -102,10 +116,35 @@ void Depth::shutdown(Context const& ctx) {
     image_ = nullptr;
   }
   format_ = VK_FORMAT_UNDEFINED;
+  sampled_ = false;
+}
+
+void Depth::recreate(Context const& ctx, Swapchain const& sc, DeletionQueue& retired, std::uint64_t serial) {
+  if (image_ != nullptr) {
+    Image* const old = image_;
+    image_ = nullptr;
+    retired.push(serial, [old](Context const& c) {
+      old->shutdown(c);
+      delete old;
+    });
+  }
+  init(ctx, sc);
+}
+
+VkImage Depth::image() const {
+  return (image_ != nullptr) ? image_->image() : VK_NULL_HANDLE;
 }
 
 VkImageView Depth::view() const {
   return (image_ != nullptr) ? image_->view() : VK_NULL_HANDLE;
 }
 
+VkExtent2D Depth::extent() const {
+  return (image_ != nullptr) ? image_->extent() : VkExtent2D{};
+}
+
+VkImageAspectFlags Depth::aspect() const {
+  return format_has_stencil(format_) ? (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT) : VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
 } // namespace gfx
@@ -2,12 +2,17 @@
 
 #include <vulkan/vulkan.h>
 
+#include <cstdint>
+
 namespace gfx {
 
 class Context;
+class DeletionQueue;
 class Image;
 class Swapchain;
 
+bool format_has_stencil(VkFormat format);
+
 class Depth {
 public:
   Depth() = default;
@@ -20,10 +25,22 @@ public:
   Depth& operator=(Depth&& other) noexcept;
 
   void init(Context const& ctx, Swapchain const& sc);
+  void init(Context const& ctx, VkExtent2D extent); // offscreen targets
   void shutdown(Context const& ctx);
 
+  // New image at the swapchain's extent; the old one goes to `retired` under
+  // `serial` instead of being destroyed while frames in flight still use it.
+  void recreate(Context const& ctx, Swapchain const& sc, DeletionQueue& retired, std::uint64_t serial);
+
   VkFormat format() const { return format_; }
+  VkImage image() const;
   VkImageView view() const;
+  VkExtent2D extent() const;
+  VkImageAspectFlags aspect() const; // depth, plus stencil for combined formats
+
+  // The view can be sampled (depth-only format with sampling support), e.g. to
+  // build a DepthPyramid from it.
+  bool sampled() const { return sampled_; }
 
 private:
   VkFormat pick_format(Context const& ctx) const;
@@ -31,6 +48,7 @@ private:
 private:
   Image* image_ = nullptr;
   VkFormat format_ = VK_FORMAT_UNDEFINED;
+  bool sampled_ = false;
 };
 
 } // namespace gfx
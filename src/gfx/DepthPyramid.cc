@@ -0,0 +1,284 @@
+#include "gfx/DepthPyramid.h"
+
+#include "gfx/Context.h"
+#include "gfx/DeletionQueue.h"
+#include "gfx/Depth.h"
+#include "gfx/Image.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+// depth_pyramid.comp push constants.
+struct ReducePush {
+  std::uint32_t src_size[2];
+  std::uint32_t dst_size[2];
+};
+
+// Rounds down, like Vulkan's mip chain: level i of the pyramid image is
+// mip_extent(extent, i), and level 0 is mip_extent(depth extent, 1).
+VkExtent2D mip_extent(VkExtent2D e, std::uint32_t level) {
+  return VkExtent2D{std::max(1U, e.width >> level), std::max(1U, e.height >> level)};
+}
+
+} // namespace
+
+DepthPyramid::~DepthPyramid() {
+}
+
+DepthPyramid::DepthPyramid(DepthPyramid&& other) noexcept {
+  *this = std::move(other);
+}
+
+DepthPyramid& DepthPyramid::operator=(DepthPyramid&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  reduce_ = std::move(other.reduce_);
+  sampler_ = other.sampler_;
+  image_ = other.image_;
+  level_views_ = std::move(other.level_views_);
+  descriptor_pool_ = other.descriptor_pool_;
+  level_sets_ = std::move(other.level_sets_);
+  extent_ = other.extent_;
+  depth_extent_ = other.depth_extent_;
+  use_ = other.use_;
+
+  other.sampler_ = VK_NULL_HANDLE;
+  other.image_ = nullptr;
+  other.level_views_.clear();
+  other.descriptor_pool_ = VK_NULL_HANDLE;
+  other.level_sets_.clear();
+  other.extent_ = VkExtent2D{};
+  other.depth_extent_ = VkExtent2D{};
+  other.use_ = ImageUse{};
+
+  return *this;
+}
+
+void DepthPyramid::init(Context const& ctx, std::string const& reduce_spv_path, Depth const& depth) {
+  if (image_ != nullptr) {
+    fail("DepthPyramid::init called twice");
+  }
+  if (!depth.sampled()) {
+    fail("DepthPyramid: depth buffer cannot be sampled");
+  }
+
+  VkDescriptorSetLayoutBinding bindings[2]{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  reduce_.init(ctx, reduce_spv_path, bindings, static_cast<std::uint32_t>(sizeof(ReducePush)));
+
+  // texelFetch only; filtering and addressing never apply.
+  VkSamplerCreateInfo sci{};
+  sci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sci.magFilter = VK_FILTER_NEAREST;
+  sci.minFilter = VK_FILTER_NEAREST;
+  sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sci.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sci.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sci.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sci.maxLod = VK_LOD_CLAMP_NONE;
+  vk_check(vkCreateSampler(ctx.device(), &sci, nullptr, &sampler_), "vkCreateSampler(depth pyramid)");
+
+  create_levels(ctx, depth);
+}
+
+void DepthPyramid::create_levels(Context const& ctx, Depth const& depth) {
+  depth_extent_ = depth.extent();
+  extent_ = mip_extent(depth_extent_, 1);
+
+  std::uint32_t levels = 1;
+  for (std::uint32_t side = std::max(extent_.width, extent_.height); side > 1U; side /= 2U) {
+    ++levels;
+  }
+
+  image_ = new (std::nothrow) Image();
+  if (image_ == nullptr) {
+    fail("DepthPyramid: allocation failed");
+  }
+  image_->init_2d(ctx,
+                  extent_,
+                  VK_FORMAT_R32_SFLOAT,
+                  VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                  VK_IMAGE_ASPECT_COLOR_BIT,
+                  levels);
+
+  // Storage views cover a single level each.
+  level_views_.assign(levels, VK_NULL_HANDLE);
+  for (std::uint32_t i = 0; i < levels; ++i) {
+    VkImageViewCreateInfo vci{};
+    vci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    vci.image = image_->image();
+    vci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    vci.format = VK_FORMAT_R32_SFLOAT;
+    vci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    vci.subresourceRange.baseMipLevel = i;
+    vci.subresourceRange.levelCount = 1;
+    vci.subresourceRange.baseArrayLayer = 0;
+    vci.subresourceRange.layerCount = 1;
+    vk_check(vkCreateImageView(ctx.device(), &vci, nullptr, &level_views_[i]), "vkCreateImageView(depth pyramid level)");
+  }
+
+  VkDescriptorPoolSize pool_sizes[2]{};
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_sizes[0].descriptorCount = levels;
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  pool_sizes[1].descriptorCount = levels;
+
+  VkDescriptorPoolCreateInfo dpci{};
+  dpci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  dpci.maxSets = levels;
+  dpci.poolSizeCount = 2;
+  dpci.pPoolSizes = pool_sizes;
+  vk_check(vkCreateDescriptorPool(ctx.device(), &dpci, nullptr, &descriptor_pool_), "vkCreateDescriptorPool(depth pyramid)");
+
+  std::vector<VkDescriptorSetLayout> const layouts(levels, reduce_.set_layout());
+  VkDescriptorSetAllocateInfo ai{};
+  ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  ai.descriptorPool = descriptor_pool_;
+  ai.descriptorSetCount = levels;
+  ai.pSetLayouts = layouts.data();
+  level_sets_.assign(levels, VK_NULL_HANDLE);
+  vk_check(vkAllocateDescriptorSets(ctx.device(), &ai, level_sets_.data()), "vkAllocateDescriptorSets(depth pyramid)");
+
+  std::vector<VkDescriptorImageInfo> infos(2U * levels);
+  std::vector<VkWriteDescriptorSet> writes(2U * levels);
+  for (std::uint32_t i = 0; i < levels; ++i) {
+    VkDescriptorImageInfo& src = infos[2U * i];
+    src.sampler = sampler_;
+    src.imageView = (i == 0U) ? depth.view() : level_views_[i - 1U];
+    src.imageLayout = (i == 0U) ? compute_sampled_use().layout : compute_storage_use().layout;
+
+    VkDescriptorImageInfo& dst = infos[2U * i + 1U];
+    dst.imageView = level_views_[i];
+    dst.imageLayout = compute_storage_use().layout;
+
+    for (std::uint32_t b = 0; b < 2U; ++b) {
+      VkWriteDescriptorSet& w = writes[2U * i + b];
+      w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      w.dstSet = level_sets_[i];
+      w.dstBinding = b;
+      w.descriptorCount = 1;
+      w.descriptorType = (b == 0U) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      w.pImageInfo = &infos[2U * i + b];
+    }
+  }
+  vkUpdateDescriptorSets(ctx.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+  use_ = ImageUse{};
+}
+
+void DepthPyramid::shutdown(Context const& ctx) {
+  if (descriptor_pool_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(ctx.device(), descriptor_pool_, nullptr);
+    descriptor_pool_ = VK_NULL_HANDLE;
+  }
+  level_sets_.clear();
+  for (VkImageView v : level_views_) {
+    vkDestroyImageView(ctx.device(), v, nullptr);
+  }
+  level_views_.clear();
+  if (image_ != nullptr) {
+    image_->shutdown(ctx);
+    delete image_;
+    image_ = nullptr;
+  }
+
+  if (sampler_ != VK_NULL_HANDLE) {
+    vkDestroySampler(ctx.device(), sampler_, nullptr);
+    sampler_ = VK_NULL_HANDLE;
+  }
+  reduce_.shutdown(ctx);
+
+  extent_ = VkExtent2D{};
+  depth_extent_ = VkExtent2D{};
+  use_ = ImageUse{};
+}
+
+void DepthPyramid::recreate(Context const& ctx, Depth const& depth, DeletionQueue& retired, std::uint64_t serial) {
+  if (image_ == nullptr) {
+    fail("DepthPyramid::recreate before init");
+  }
+
+  retired.push(serial, [image = image_, views = std::move(level_views_), pool = descriptor_pool_](Context const& c) {
+    vkDestroyDescriptorPool(c.device(), pool, nullptr);
+    for (VkImageView v : views) {
+      vkDestroyImageView(c.device(), v, nullptr);
+    }
+    image->shutdown(c);
+    delete image;
+  });
+  image_ = nullptr;
+  level_views_.clear();
+  descriptor_pool_ = VK_NULL_HANDLE;
+  level_sets_.clear();
+
+  create_levels(ctx, depth);
+}
+
+void DepthPyramid::record_build(VkCommandBuffer cb, Depth const& depth, ImageUse& depth_use) {
+  if (image_ == nullptr) {
+    fail("DepthPyramid::record_build before init");
+  }
+
+  transition_image(cb, depth.image(), depth.aspect(), depth_use, compute_sampled_use());
+  // Every level is rewritten; the barrier only waits for last frame's readers.
+  transition_image(cb, image_->image(), VK_IMAGE_ASPECT_COLOR_BIT, use_, compute_storage_use(), true);
+
+  vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, reduce_.pipeline());
+
+  VkExtent2D src = depth_extent_;
+  for (std::size_t i = 0; i < level_sets_.size(); ++i) {
+    VkExtent2D const dst = mip_extent(extent_, static_cast<std::uint32_t>(i));
+    if (i > 0U) {
+      // Level i - 1 is written before level i reads it.
+      transition_image(cb, image_->image(), VK_IMAGE_ASPECT_COLOR_BIT, use_, compute_storage_use());
+    }
+
+    ReducePush push{};
+    push.src_size[0] = src.width;
+    push.src_size[1] = src.height;
+    push.dst_size[0] = dst.width;
+    push.dst_size[1] = dst.height;
+
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, reduce_.pipeline_layout(), 0, 1, &level_sets_[i], 0, nullptr);
+    vkCmdPushConstants(cb, reduce_.pipeline_layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkCmdDispatch(cb, (dst.width + kGroupSize - 1U) / kGroupSize, (dst.height + kGroupSize - 1U) / kGroupSize, 1);
+
+    src = dst;
+  }
+
+  transition_image(cb, image_->image(), VK_IMAGE_ASPECT_COLOR_BIT, use_, compute_storage_use());
+}
+
+VkImageView DepthPyramid::view() const {
+  return (image_ != nullptr) ? image_->view() : VK_NULL_HANDLE;
+}
+
+} // namespace gfx
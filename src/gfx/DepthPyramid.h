@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gfx/Barrier.h"
+#include "gfx/ComputePipeline.h"
+
+namespace gfx {
+
+class Context;
+class DeletionQueue;
+class Depth;
+class Image;
+
+// Hierarchical-Z pyramid of a depth buffer, for occlusion culling. Level 0 is
+// half the depth's resolution and every further level halves again (rounded
+// down, as Vulkan sizes mips) down to 1x1; each texel holds the farthest depth
+// of the depth pixels it covers. Depth pixel p falls into texel p >> (level + 1),
+// clamped to the last texel, which also covers the row / column an odd side
+// leaves over. A footprint of at most 2^(level + 1) pixels therefore touches at
+// most 2x2 texels of that level.
+//
+// The pyramid stays in GENERAL; sample it with texelFetch, it has no filtering.
+class DepthPyramid {
+public:
+  static constexpr std::uint32_t kGroupSize = 8; // local_size_x/y in depth_pyramid.comp
+
+public:
+  DepthPyramid() = default;
+  ~DepthPyramid();
+
+  DepthPyramid(DepthPyramid const&) = delete;
+  DepthPyramid& operator=(DepthPyramid const&) = delete;
+
+  DepthPyramid(DepthPyramid&& other) noexcept;
+  DepthPyramid& operator=(DepthPyramid&& other) noexcept;
+
+  // `depth` must be Depth::sampled().
+  void init(Context const& ctx, std::string const& reduce_spv_path, Depth const& depth);
+  void shutdown(Context const& ctx);
+
+  bool initialized() const { return image_ != nullptr; }
+
+  // Rebuilds for the depth's current image (after Depth::recreate); the old
+  // pyramid goes to `retired` under `serial`.
+  void recreate(Context const& ctx, Depth const& depth, DeletionQueue& retired, std::uint64_t serial);
+
+  // Outside a render pass. Moves `depth` (last used as `depth_use`) to a
+  // sampled layout, writes every level and leaves the pyramid readable by
+  // later compute work.
+  void record_build(VkCommandBuffer cb, Depth const& depth, ImageUse& depth_use);
+
+  VkImageView view() const; // all levels
+  VkExtent2D extent() const { return extent_; } // level 0
+  std::uint32_t levels() const { return static_cast<std::uint32_t>(level_views_.size()); }
+
+private:
+  void create_levels(Context const& ctx, Depth const& depth);
+
+private:
+  ComputePipeline reduce_{};
+  VkSampler sampler_ = VK_NULL_HANDLE;
+
+  // Recreated with the depth buffer.
+  Image* image_ = nullptr; // owned
+  std::vector<VkImageView> level_views_;
+  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSet> level_sets_; // level i reads level i - 1 (the depth for 0)
+  VkExtent2D extent_{};
+  VkExtent2D depth_extent_{};
+
+  ImageUse use_{};
+};
+
+} // namespace gfx
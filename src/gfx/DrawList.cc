@@ -0,0 +1,110 @@
+#include "gfx/DrawList.h"
+
+#include "gfx/Mesh.h"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+DrawItem level0_item(Mesh const& mesh, VkPipeline pipeline, VkDescriptorSet material, std::uint32_t first_instance) {
+  DrawItem item{};
+  item.mesh = &mesh;
+  item.pipeline = pipeline;
+  item.material = material;
+  item.first_instance = first_instance;
+  item.first_index = mesh.lod(0).first_index;
+  item.index_count = mesh.lod(0).index_count;
+  item.select_lod = mesh.lod_count() > 1U;
+  return item;
+}
+
+} // namespace
+
+void DrawList::clear() {
+  items_.clear();
+  instances_.clear();
+  pipeline_ = VK_NULL_HANDLE;
+  material_ = VK_NULL_HANDLE;
+}
+
+void DrawList::add(Mesh const& mesh, glm::mat4 const& model) {
+  add(mesh, std::span<glm::mat4 const>(&model, 1));
+}
+
+void DrawList::add(Mesh const& mesh, std::span<glm::mat4 const> models) {
+  if (models.empty()) {
+    return;
+  }
+
+  DrawItem item = level0_item(mesh, pipeline_, material_, static_cast<std::uint32_t>(instances_.size()));
+  item.instance_count = static_cast<std::uint32_t>(models.size());
+  items_.push_back(item);
+
+  instances_.insert(instances_.end(), models.begin(), models.end());
+}
+
+void DrawList::add(Mesh const& mesh, std::span<glm::mat4 const> models, std::span<std::uint64_t const> visible) {
+  DrawItem item = level0_item(mesh, pipeline_, material_, static_cast<std::uint32_t>(instances_.size()));
+
+  for (std::size_t w = 0; w < visible.size(); ++w) {
+    std::uint64_t bits = visible[w];
+    while (bits != 0U) {
+      std::size_t const i = w * 64U + static_cast<std::size_t>(std::countr_zero(bits));
+      bits &= bits - 1U;
+      if (i < models.size()) {
+        instances_.push_back(models[i]);
+      }
+    }
+  }
+
+  item.instance_count = static_cast<std::uint32_t>(instances_.size()) - item.first_instance;
+  if (item.instance_count > 0U) {
+    items_.push_back(item);
+  }
+}
+
+void DrawList::add(Mesh const& mesh, glm::mat4 const& model, std::span<IndexRange const> ranges) {
+  if (ranges.empty()) {
+    return;
+  }
+
+  DrawItem item{};
+  item.mesh = &mesh;
+  item.pipeline = pipeline_;
+  item.material = material_;
+  item.first_instance = static_cast<std::uint32_t>(instances_.size());
+  item.instance_count = 1;
+  instances_.push_back(model);
+
+  for (IndexRange const& r : ranges) {
+    item.first_index = r.first_index;
+    item.index_count = r.index_count;
+    items_.push_back(item);
+  }
+}
+
+void DrawList::add(Mesh const& mesh, std::span<glm::mat4 const> models, IndexRange range) {
+  if (models.empty() || range.index_count == 0U) {
+    return;
+  }
+
+  DrawItem item{};
+  item.mesh = &mesh;
+  item.pipeline = pipeline_;
+  item.material = material_;
+  item.first_instance = static_cast<std::uint32_t>(instances_.size());
+  item.instance_count = static_cast<std::uint32_t>(models.size());
+  item.first_index = range.first_index;
+  item.index_count = range.index_count;
+  items_.push_back(item);
+
+  instances_.insert(instances_.end(), models.begin(), models.end());
+}
+
+} // namespace gfx
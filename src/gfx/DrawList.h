@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace gfx {
+
+class Mesh;
+
+// One instanced draw of indices [first_index, first_index + index_count) of
+// `mesh`: `instance_count` matrices starting at `first_instance` in the owning
+// list's instance array. `select_lod` items cover the mesh's level 0 and let
+// the renderer swap in a coarser level per instance.
+struct DrawItem {
+  Mesh const* mesh = nullptr;
+  VkPipeline pipeline = VK_NULL_HANDLE; // VK_NULL_HANDLE: the Pipeline passed to draw_frame
+  VkDescriptorSet material = VK_NULL_HANDLE; // set 1; VK_NULL_HANDLE: the renderer's default
+  std::uint32_t first_instance = 0;
+  std::uint32_t instance_count = 0;
+  std::uint32_t first_index = 0;
+  std::uint32_t index_count = 0;
+  bool select_lod = false;
+};
+
+// A contiguous run of a mesh's index buffer.
+struct IndexRange {
+  std::uint32_t first_index = 0;
+  std::uint32_t index_count = 0;
+};
+
+// What the renderer draws in a frame. Built on the CPU each frame; all instance
+// matrices are packed into one array so they land in a single instance buffer.
+// Meshes must outlive the frame they are drawn in.
+class DrawList {
+public:
+  void clear();
+
+  // Pipeline for the items added from now on, e.g. a PipelineRegistry variant
+  // built against the draw_frame Pipeline. VK_NULL_HANDLE (the default, and
+  // after clear()) uses that Pipeline itself.
+  void set_pipeline(VkPipeline pipeline) { pipeline_ = pipeline; }
+
+  // Material set for the items added from now on; VK_NULL_HANDLE (the default,
+  // and after clear()) uses Renderer::set_default_material().
+  void set_material(VkDescriptorSet material) { material_ = material; }
+
+  // Whole-mesh adds draw level 0, subject to the renderer's LOD selection.
+  void add(Mesh const& mesh, glm::mat4 const& model);
+  void add(Mesh const& mesh, std::span<glm::mat4 const> models);
+
+  // Only the models whose bit is set in `visible` (math::cull_spheres / cull_aabbs
+  // output, one bit per model).
+  void add(Mesh const& mesh, std::span<glm::mat4 const> models, std::span<std::uint64_t const> visible);
+
+  // One instance drawn as several index ranges (e.g. the clusters that survived
+  // culling); the items share the instance.
+  void add(Mesh const& mesh, glm::mat4 const& model, std::span<IndexRange const> ranges);
+
+  // Every model drawn with exactly `range` (e.g. an already selected LOD).
+  void add(Mesh const& mesh, std::span<glm::mat4 const> models, IndexRange range);
+
+  bool empty() const { return items_.empty(); }
+
+  std::span<DrawItem const> items() const { return items_; }
+  std::span<glm::mat4 const> instances() const { return instances_; }
+
+private:
+  std::vector<DrawItem> items_;
+  std::vector<glm::mat4> instances_;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+  VkDescriptorSet material_ = VK_NULL_HANDLE;
+};
+
+} // namespace gfx
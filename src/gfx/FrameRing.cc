@@ -0,0 +1,134 @@
+#include "gfx/FrameRing.h"
+
+#include "gfx/Context.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize a) {
+  return (a <= 1U) ? v : ((v + a - 1U) / a) * a;
+}
+
+} // namespace
+
+FrameRing::~FrameRing() {
+}
+
+FrameRing::FrameRing(FrameRing&& other) noexcept {
+  *this = std::move(other);
+}
+
+FrameRing& FrameRing::operator=(FrameRing&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  buffer_ = std::move(other.buffer_);
+  frame_capacity_ = other.frame_capacity_;
+  alignment_ = other.alignment_;
+  frames_ = other.frames_;
+  frame_begin_ = other.frame_begin_;
+  head_ = other.head_;
+
+  other.frame_capacity_ = 0;
+  other.alignment_ = 1;
+  other.frames_ = 0;
+  other.frame_begin_ = 0;
+  other.head_ = 0;
+
+  return *this;
+}
+
+void FrameRing::init(Context const& ctx, VkDeviceSize frame_capacity, std::uint32_t frames, VkBufferUsageFlags usage) {
+  if (buffer_.handle() != VK_NULL_HANDLE) {
+    fail("FrameRing::init called twice");
+  }
+  if (frame_capacity == 0U || frames == 0U) {
+    fail("FrameRing::init: frame_capacity and frames must be > 0");
+  }
+
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(ctx.physical_device(), &props);
+
+  // Every slice offset must be valid as a dynamic offset for each usage, and on
+  // non-coherent memory whole atoms keep frames' flushes apart.
+  alignment_ = 1;
+  if ((usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) != 0U) {
+    alignment_ = std::max(alignment_, props.limits.minUniformBufferOffsetAlignment);
+  }
+  if ((usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) != 0U) {
+    alignment_ = std::max(alignment_, props.limits.minStorageBufferOffsetAlignment);
+  }
+  alignment_ = std::max(alignment_, ctx.allocator().non_coherent_atom_size());
+
+  frame_capacity_ = align_up(frame_capacity, alignment_);
+  frames_ = frames;
+
+  VkDeviceSize const total = frame_capacity_ * frames;
+  if (total > UINT32_MAX) {
+    fail("FrameRing::init: " + std::to_string(total) + " bytes do not fit 32-bit dynamic offsets");
+  }
+
+  // Read by the GPU every draw: device-local when the host can map it
+  // (resizable BAR / UMA), and coherent so flush() costs nothing. Dedicated, so
+  // a small ring does not pin a whole block of the scarce BAR heap.
+  AllocationCreateInfo alloc{};
+  alloc.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  alloc.preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  alloc.dedicated = true;
+  buffer_.init(ctx, total, usage, alloc);
+
+  frame_begin_ = 0;
+  head_ = 0;
+}
+
+void FrameRing::shutdown(Context const& ctx) {
+  buffer_.shutdown(ctx);
+  frame_capacity_ = 0;
+  alignment_ = 1;
+  frames_ = 0;
+  frame_begin_ = 0;
+  head_ = 0;
+}
+
+void FrameRing::begin_frame(std::uint32_t frame) {
+  if (frame >= frames_) {
+    fail("FrameRing::begin_frame: frame out of range");
+  }
+  frame_begin_ = frame_capacity_ * frame;
+  head_ = frame_begin_;
+}
+
+FrameSlice FrameRing::allocate(std::size_t size) {
+  VkDeviceSize const offset = head_;
+  VkDeviceSize const end = offset + align_up(static_cast<VkDeviceSize>(size), alignment_);
+  if (end > frame_begin_ + frame_capacity_) {
+    fail("FrameRing: frame region full (" + std::to_string(frame_capacity_) + " bytes per frame)");
+  }
+  head_ = end;
+
+  FrameSlice s{};
+  s.data = static_cast<char*>(buffer_.mapped()) + offset;
+  s.buffer = buffer_.handle();
+  s.offset = static_cast<std::uint32_t>(offset);
+  s.size = static_cast<std::uint32_t>(size);
+  return s;
+}
+
+void FrameRing::flush(Context const& ctx) const {
+  if (head_ != frame_begin_) {
+    buffer_.flush(ctx, frame_begin_, head_ - frame_begin_);
+  }
+}
+
+} // namespace gfx
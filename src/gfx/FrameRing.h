@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "gfx/Buffer.h"
+
+namespace gfx {
+
+class Context;
+
+// A sub-range of this frame's ring region, written through `data`. Bind it as
+// a dynamic UNIFORM_BUFFER / STORAGE_BUFFER with `offset` as the dynamic offset
+// (the descriptor's own offset 0), or as a plain range of `buffer`.
+struct FrameSlice {
+  void* data = nullptr;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  std::uint32_t offset = 0;
+  std::uint32_t size = 0;
+};
+
+// Per-frame transient GPU data (globals, lights, per-draw constants) from one
+// persistently mapped buffer split into `frames` equal regions. begin_frame()
+// rewinds the frame's region once its fence has signalled, allocate() bumps a
+// pointer, flush() makes the frame's writes visible before submit (free on
+// coherent memory). Nothing in the frame loop allocates memory or maps.
+class FrameRing {
+public:
+  FrameRing() = default;
+  ~FrameRing();
+
+  FrameRing(FrameRing const&) = delete;
+  FrameRing& operator=(FrameRing const&) = delete;
+
+  FrameRing(FrameRing&& other) noexcept;
+  FrameRing& operator=(FrameRing&& other) noexcept;
+
+  // `frame_capacity` bytes per frame, rounded up to the slice alignment.
+  void init(Context const& ctx,
+            VkDeviceSize frame_capacity,
+            std::uint32_t frames,
+            VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  void shutdown(Context const& ctx);
+
+  // Call after the frame's fence wait; earlier slices of `frame` are then free.
+  void begin_frame(std::uint32_t frame);
+
+  // `size` bytes at the dynamic-offset alignment of the buffer's usages. Throws
+  // when the frame's region is full (raise frame_capacity).
+  FrameSlice allocate(std::size_t size);
+
+  template <typename T>
+  FrameSlice push(T const& value) {
+    FrameSlice s = allocate(sizeof(T));
+    std::memcpy(s.data, &value, sizeof(T));
+    return s;
+  }
+
+  // Everything allocated since begin_frame(); once per frame, before submit.
+  void flush(Context const& ctx) const;
+
+  VkBuffer buffer() const { return buffer_.handle(); }
+  VkDeviceSize frame_capacity() const { return frame_capacity_; }
+  VkDeviceSize alignment() const { return alignment_; }
+
+  // Bytes handed out this frame; for sizing frame_capacity.
+  VkDeviceSize used() const { return head_ - frame_begin_; }
+
+private:
+  Buffer buffer_{};
+  VkDeviceSize frame_capacity_ = 0;
+  VkDeviceSize alignment_ = 1;
+  std::uint32_t frames_ = 0;
+
+  VkDeviceSize frame_begin_ = 0; // current frame's region
+  VkDeviceSize head_ = 0;
+};
+
+} // namespace gfx
@@ -0,0 +1,371 @@
+#include "gfx/GeometryPool.h"
+
+#include "gfx/Context.h"
+#include "gfx/Upload.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+std::size_t stride_of(VertexFormat format) {
+  return (format == VertexFormat::Quantized) ? sizeof(VertexQuantized) : sizeof(Vertex);
+}
+
+// Doubles `capacity` until `needed` more elements fit next to `used`.
+std::uint32_t grown(std::uint32_t capacity, std::uint64_t used, std::uint64_t needed) {
+  std::uint64_t c = capacity;
+  while (c - used < needed) {
+    c *= 2U;
+  }
+  if (c > UINT32_MAX) {
+    fail("GeometryPool: capacity exceeds 32-bit offsets");
+  }
+  return static_cast<std::uint32_t>(c);
+}
+
+} // namespace
+
+GeometryPool::~GeometryPool() {
+}
+
+GeometryPool::GeometryPool(GeometryPool&& other) noexcept {
+  *this = std::move(other);
+}
+
+GeometryPool& GeometryPool::operator=(GeometryPool&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  config_ = other.config_;
+  stride_ = other.stride_;
+  vertices_ = std::move(other.vertices_);
+  indices_ = std::move(other.indices_);
+  vertex_ranges_ = std::move(other.vertex_ranges_);
+  index_ranges_ = std::move(other.index_ranges_);
+  slots_ = std::move(other.slots_);
+  free_slots_ = std::move(other.free_slots_);
+  pending_ = std::move(other.pending_);
+  generation_ = other.generation_;
+  compactions_ = other.compactions_;
+  narrow_ = std::move(other.narrow_);
+
+  other.config_ = GeometryPoolConfig{};
+  other.stride_ = 0;
+  other.vertex_ranges_ = RangeAllocator{};
+  other.index_ranges_ = RangeAllocator{};
+  other.slots_.clear();
+  other.free_slots_.clear();
+  other.pending_.clear();
+  other.generation_ = 0;
+  other.compactions_ = 0;
+  other.narrow_.clear();
+
+  return *this;
+}
+
+void GeometryPool::init(Context const& ctx, GeometryPoolConfig const& config) {
+  if (vertices_.handle() != VK_NULL_HANDLE) {
+    fail("GeometryPool::init called twice");
+  }
+  if (config.vertex_capacity == 0U || config.index_capacity == 0U) {
+    fail("GeometryPool::init: capacities must be > 0");
+  }
+  if (config.index_type != VK_INDEX_TYPE_UINT16 && config.index_type != VK_INDEX_TYPE_UINT32) {
+    fail("GeometryPool::init: index_type must be UINT16 or UINT32");
+  }
+
+  config_ = config;
+  stride_ = stride_of(config.format);
+
+  create_buffers(ctx, config.vertex_capacity, config.index_capacity, vertices_, indices_);
+  vertex_ranges_.init(config.vertex_capacity);
+  index_ranges_.init(config.index_capacity);
+
+  slots_.clear();
+  free_slots_.clear();
+  pending_.clear();
+  generation_ = 0;
+  compactions_ = 0;
+}
+
+void GeometryPool::shutdown(Context const& ctx) {
+  std::uint32_t live = 0;
+  for (Slot const& s : slots_) {
+    live += s.live ? 1U : 0U;
+  }
+  if (live != 0U) {
+    // Their meshes now point at destroyed buffers.
+    std::fprintf(stderr, "GeometryPool: %u mesh(es) still allocated at shutdown\n", live);
+  }
+
+  indices_.shutdown(ctx);
+  vertices_.shutdown(ctx);
+  vertex_ranges_ = RangeAllocator{};
+  index_ranges_ = RangeAllocator{};
+  slots_.clear();
+  free_slots_.clear();
+  pending_.clear();
+  narrow_.clear();
+  stride_ = 0;
+  config_ = GeometryPoolConfig{};
+}
+
+std::size_t GeometryPool::index_size() const {
+  return (config_.index_type == VK_INDEX_TYPE_UINT16) ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+}
+
+void GeometryPool::create_buffers(Context const& ctx,
+                                  std::uint32_t vertex_capacity,
+                                  std::uint32_t index_capacity,
+                                  Buffer& vertices,
+                                  Buffer& indices) const {
+  // Large and long-lived; TRANSFER_SRC for compaction, STORAGE for compute
+  // passes that read geometry directly.
+  AllocationCreateInfo alloc{};
+  alloc.required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  alloc.dedicated = true;
+
+  VkBufferUsageFlags const common =
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  vertices.init(ctx, VkDeviceSize{vertex_capacity} * stride_, common | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, alloc);
+  indices.init(ctx, VkDeviceSize{index_capacity} * index_size(), common | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, alloc);
+}
+
+GeometryPool::Handle GeometryPool::allocate(Context const& ctx,
+                                            Upload& uploader,
+                                            void const* vertex_data,
+                                            std::uint32_t vertex_count,
+                                            std::span<std::uint32_t const> indices) {
+  if (vertices_.handle() == VK_NULL_HANDLE) {
+    fail("GeometryPool::allocate: not initialized");
+  }
+  if (vertex_data == nullptr || vertex_count == 0U || indices.empty()) {
+    fail("GeometryPool::allocate: empty vertices/indices");
+  }
+  if (config_.index_type == VK_INDEX_TYPE_UINT16 && vertex_count > (1U << 16)) {
+    fail("GeometryPool::allocate: " + std::to_string(vertex_count) + " vertices do not fit a UINT16 pool");
+  }
+  // Indices are relative to the mesh's vertex_offset; one past its vertices
+  // would read another mesh's (or wrap when narrowed).
+  for (std::uint32_t const index : indices) {
+    if (index >= vertex_count) {
+      fail("GeometryPool::allocate: index " + std::to_string(index) + " out of range for " +
+           std::to_string(vertex_count) + " vertices");
+    }
+  }
+
+  std::uint64_t const index_count = indices.size();
+  if (vertex_ranges_.largest_free() < vertex_count || index_ranges_.largest_free() < index_count) {
+    // Repacking closes the holes; grow as well if the free total is short too.
+    rebuild(ctx,
+            uploader,
+            grown(static_cast<std::uint32_t>(vertex_ranges_.capacity()), vertex_ranges_.used(), vertex_count),
+            grown(static_cast<std::uint32_t>(index_ranges_.capacity()), index_ranges_.used(), index_count));
+  }
+
+  std::uint64_t const first_vertex = vertex_ranges_.allocate(vertex_count);
+  std::uint64_t const first_index = index_ranges_.allocate(index_count);
+  if (first_vertex == RangeAllocator::kInvalidOffset || first_index == RangeAllocator::kInvalidOffset) {
+    fail("GeometryPool::allocate: no room after rebuild");
+  }
+
+  uploader.enqueue_buffer(ctx, vertices_.handle(), first_vertex * stride_, vertex_data,
+                          static_cast<std::size_t>(vertex_count) * stride_);
+  if (config_.index_type == VK_INDEX_TYPE_UINT16) {
+    // Staged right away, so the scratch copy is free for the next mesh.
+    narrow_.resize(indices.size());
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      narrow_[i] = static_cast<std::uint16_t>(indices[i]);
+    }
+    uploader.enqueue_buffer(ctx, indices_.handle(), first_index * sizeof(std::uint16_t), narrow_.data(),
+                            narrow_.size() * sizeof(std::uint16_t));
+  } else {
+    uploader.enqueue_buffer(ctx, indices_.handle(), first_index * sizeof(std::uint32_t), indices.data(),
+                            indices.size() * sizeof(std::uint32_t));
+  }
+
+  Handle handle = kInvalidHandle;
+  if (!free_slots_.empty()) {
+    handle = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    handle = static_cast<Handle>(slots_.size());
+    slots_.emplace_back();
+  }
+
+  Slot& s = slots_[handle];
+  s.range.vertex_offset = static_cast<std::int32_t>(first_vertex);
+  s.range.vertex_count = vertex_count;
+  s.range.first_index = static_cast<std::uint32_t>(first_index);
+  s.range.index_count = static_cast<std::uint32_t>(index_count);
+  s.live = true;
+  return handle;
+}
+
+void GeometryPool::release(Handle handle, std::uint64_t serial) {
+  if (handle >= slots_.size() || !slots_[handle].live) {
+    fail("GeometryPool::release: bad handle");
+  }
+
+  // The handle is free right away; only the ranges wait for the GPU. Waiting
+  // longer is harmless, so a lower serial joins the newest entry's.
+  Slot& s = slots_[handle];
+  if (!pending_.empty()) {
+    serial = std::max(serial, pending_.back().serial);
+  }
+  pending_.push_back(PendingRelease{serial, s.range});
+  s = Slot{};
+  free_slots_.push_back(handle);
+}
+
+void GeometryPool::collect(std::uint64_t completed) {
+  while (!pending_.empty() && pending_.front().serial <= completed) {
+    GeometryRange const& r = pending_.front().range;
+    vertex_ranges_.free(static_cast<std::uint64_t>(r.vertex_offset), r.vertex_count);
+    index_ranges_.free(r.first_index, r.index_count);
+    pending_.pop_front();
+  }
+}
+
+bool GeometryPool::fragmented(std::size_t max_free_ranges) const {
+  auto const check = [max_free_ranges](RangeAllocator const& r) {
+    std::uint64_t const free = r.capacity() - r.used();
+    return r.free_range_count() > max_free_ranges || (free > 0U && r.largest_free() * 2U < free);
+  };
+  return check(vertex_ranges_) || check(index_ranges_);
+}
+
+bool GeometryPool::compact(Context const& ctx, Upload& uploader, std::size_t max_free_ranges) {
+  if (!fragmented(max_free_ranges)) {
+    return false;
+  }
+  rebuild(ctx,
+          uploader,
+          static_cast<std::uint32_t>(vertex_ranges_.capacity()),
+          static_cast<std::uint32_t>(index_ranges_.capacity()));
+  return true;
+}
+
+void GeometryPool::rebuild(Context const& ctx,
+                           Upload& uploader,
+                           std::uint32_t vertex_capacity,
+                           std::uint32_t index_capacity) {
+  Buffer vertices{};
+  Buffer indices{};
+  create_buffers(ctx, vertex_capacity, index_capacity, vertices, indices);
+
+  RangeAllocator vertex_ranges{};
+  RangeAllocator index_ranges{};
+  vertex_ranges.init(vertex_capacity);
+  index_ranges.init(index_capacity);
+
+  // A fresh free list hands out ranges back to back, so this packs.
+  std::vector<VkBufferCopy> vertex_copies;
+  std::vector<VkBufferCopy> index_copies;
+  std::vector<GeometryRange> moved(slots_.size());
+  for (std::size_t i = 0; i < slots_.size(); ++i) {
+    if (!slots_[i].live) {
+      continue;
+    }
+    GeometryRange const& r = slots_[i].range;
+    std::uint64_t const v = vertex_ranges.allocate(r.vertex_count);
+    std::uint64_t const x = index_ranges.allocate(r.index_count);
+
+    vertex_copies.push_back(VkBufferCopy{static_cast<VkDeviceSize>(r.vertex_offset) * stride_,
+                                         v * stride_,
+                                         VkDeviceSize{r.vertex_count} * stride_});
+    index_copies.push_back(VkBufferCopy{VkDeviceSize{r.first_index} * index_size(),
+                                        x * index_size(),
+                                        VkDeviceSize{r.index_count} * index_size()});
+
+    moved[i] = r;
+    moved[i].vertex_offset = static_cast<std::int32_t>(v);
+    moved[i].first_index = static_cast<std::uint32_t>(x);
+  }
+
+  // Queued uploads must land in the old buffers before they go, live meshes or
+  // not. Frames in flight may still read them, and the upload fence does not
+  // cover those when uploads run on a dedicated transfer queue. Once idle, no
+  // pending release is read either; their ranges are simply not carried over.
+  uploader.wait(ctx, uploader.flush(ctx));
+  vk_check(vkDeviceWaitIdle(ctx.device()), "vkDeviceWaitIdle");
+  pending_.clear();
+
+  if (!vertex_copies.empty()) {
+    VkCommandBuffer cb = uploader.begin(ctx);
+    vkCmdCopyBuffer(cb, vertices_.handle(), vertices.handle(),
+                    static_cast<std::uint32_t>(vertex_copies.size()), vertex_copies.data());
+    vkCmdCopyBuffer(cb, indices_.handle(), indices.handle(),
+                    static_cast<std::uint32_t>(index_copies.size()), index_copies.data());
+
+    VkMemoryBarrier b{};
+    b.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    b.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    b.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &b, 0, nullptr, 0, nullptr);
+    uploader.end_and_submit(ctx, cb);
+  }
+
+  vertices_.shutdown(ctx);
+  indices_.shutdown(ctx);
+  vertices_ = std::move(vertices);
+  indices_ = std::move(indices);
+  vertex_ranges_ = std::move(vertex_ranges);
+  index_ranges_ = std::move(index_ranges);
+
+  for (std::size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i].live) {
+      slots_[i].range = moved[i];
+    }
+  }
+  ++generation_;
+  ++compactions_;
+}
+
+void GeometryPool::bind(VkCommandBuffer cb) const {
+  VkBuffer const vb = vertices_.handle();
+  VkDeviceSize const zero = 0;
+  vkCmdBindVertexBuffers(cb, 0, 1, &vb, &zero);
+  vkCmdBindIndexBuffer(cb, indices_.handle(), 0, config_.index_type);
+}
+
+GeometryPoolStats GeometryPool::stats() const {
+  GeometryPoolStats s{};
+  for (Slot const& slot : slots_) {
+    s.meshes += slot.live ? 1U : 0U;
+  }
+  s.vertices_used = vertex_ranges_.used();
+  s.indices_used = index_ranges_.used();
+  s.vertex_capacity = static_cast<std::uint32_t>(vertex_ranges_.capacity());
+  s.index_capacity = static_cast<std::uint32_t>(index_ranges_.capacity());
+  s.free_ranges = vertex_ranges_.free_range_count() + index_ranges_.free_range_count();
+  s.pending_releases = pending_.size();
+  s.compactions = compactions_;
+  return s;
+}
+
+} // namespace gfx
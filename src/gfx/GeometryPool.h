@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+#include "gfx/Buffer.h"
+#include "gfx/RangeAllocator.h"
+#include "gfx/Vertex.h"
+
+namespace gfx {
+
+class Context;
+class Upload;
+
+struct GeometryPoolConfig {
+  VertexFormat format = VertexFormat::Float32; // every mesh in the pool is stored this way
+  // UINT16 halves index bandwidth but limits each mesh to 65536 vertices
+  // (indices are relative to the mesh's vertex_offset).
+  VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+  std::uint32_t vertex_capacity = 1U << 20; // vertices; grows by doubling
+  std::uint32_t index_capacity = 1U << 22;  // indices; grows by doubling
+};
+
+// Where one mesh lives in the pool's buffers, in elements. Pass vertex_offset
+// and first_index (plus the LOD's own first index) to vkCmdDrawIndexed.
+struct GeometryRange {
+  std::int32_t vertex_offset = 0;
+  std::uint32_t vertex_count = 0;
+  std::uint32_t first_index = 0;
+  std::uint32_t index_count = 0;
+};
+
+struct GeometryPoolStats {
+  std::uint32_t meshes = 0;
+  std::uint64_t vertices_used = 0;
+  std::uint64_t indices_used = 0;
+  std::uint32_t vertex_capacity = 0;
+  std::uint32_t index_capacity = 0;
+  std::size_t free_ranges = 0; // vertex + index free-list entries; 2 when packed
+  std::size_t pending_releases = 0; // released, waiting for collect()
+  std::uint32_t compactions = 0;
+};
+
+// All meshes of one vertex format in one vertex buffer and one index buffer,
+// so a frame binds them once and indirect draws can address any mesh. Ranges
+// come from RangeAllocator free lists (best fit, coalesced on release).
+//
+// Frames in flight may still draw a released mesh, so its ranges only return
+// to the free lists once collect() is passed a completed serial at or past the
+// one it was released under (Renderer::submitted_frames() / completed_frames()).
+//
+// Released ranges leave holes; compact() (and an allocate() that only fits
+// after closing them) repacks every live mesh into fresh buffers with one GPU
+// copy and bumps generation(). Handles stay valid across it; only the offsets
+// behind range() move. Growing works the same way. Both wait for the device to
+// go idle, which also settles every pending release, so call them between
+// frames (loading / unloading), never while recording.
+class GeometryPool {
+public:
+  using Handle = std::uint32_t;
+  static constexpr Handle kInvalidHandle = UINT32_MAX;
+
+public:
+  GeometryPool() = default;
+  ~GeometryPool();
+
+  GeometryPool(GeometryPool const&) = delete;
+  GeometryPool& operator=(GeometryPool const&) = delete;
+
+  GeometryPool(GeometryPool&& other) noexcept;
+  GeometryPool& operator=(GeometryPool&& other) noexcept;
+
+  void init(Context const& ctx, GeometryPoolConfig const& config = {});
+  // Every handle must have been released (or is leaked with the buffers).
+  void shutdown(Context const& ctx);
+
+  // `vertex_data` holds `vertex_count` vertices already in the pool's format;
+  // `indices` are relative to the mesh's first vertex; throws if one is not
+  // below `vertex_count`. Copies go through the uploader's staging ring and
+  // land with its next flush().
+  Handle allocate(Context const& ctx,
+                  Upload& uploader,
+                  void const* vertex_data,
+                  std::uint32_t vertex_count,
+                  std::span<std::uint32_t const> indices);
+  // `serial` is the last frame that may draw the mesh; 0 when none is in flight.
+  void release(Handle handle, std::uint64_t serial);
+
+  // Frees the ranges of releases with serial <= `completed`. Once a frame,
+  // after the renderer's fence wait, and before loading new meshes.
+  void collect(std::uint64_t completed);
+
+  // Repacks when the free lists are fragmented: more than `max_free_ranges`
+  // holes, or no single hole holding half the free space. Returns true if it did.
+  bool compact(Context const& ctx, Upload& uploader, std::size_t max_free_ranges = 16);
+
+  GeometryRange const& range(Handle handle) const { return slots_[handle].range; }
+
+  // One bind for every mesh in the pool (binding 0 and the index buffer).
+  void bind(VkCommandBuffer cb) const;
+
+  VkBuffer vertex_buffer() const { return vertices_.handle(); }
+  VkBuffer index_buffer() const { return indices_.handle(); }
+  VkIndexType index_type() const { return config_.index_type; }
+  VertexFormat vertex_format() const { return config_.format; }
+  std::size_t vertex_stride() const { return stride_; }
+
+  // Incremented whenever ranges move; compare to notice stale copies.
+  std::uint64_t generation() const { return generation_; }
+
+  GeometryPoolStats stats() const;
+
+private:
+  struct Slot {
+    GeometryRange range{};
+    bool live = false;
+  };
+
+  struct PendingRelease {
+    std::uint64_t serial = 0;
+    GeometryRange range{};
+  };
+
+  std::size_t index_size() const;
+  bool fragmented(std::size_t max_free_ranges) const;
+
+  // Packs every live range into new buffers of the given capacities.
+  void rebuild(Context const& ctx, Upload& uploader, std::uint32_t vertex_capacity, std::uint32_t index_capacity);
+
+  void create_buffers(Context const& ctx, std::uint32_t vertex_capacity, std::uint32_t index_capacity,
+                      Buffer& vertices, Buffer& indices) const;
+
+private:
+  GeometryPoolConfig config_{};
+  std::size_t stride_ = 0;
+
+  Buffer vertices_{};
+  Buffer indices_{};
+  RangeAllocator vertex_ranges_{};
+  RangeAllocator index_ranges_{};
+
+  std::vector<Slot> slots_;
+  std::vector<Handle> free_slots_;
+  std::deque<PendingRelease> pending_; // serial order
+  std::uint64_t generation_ = 0;
+  std::uint32_t compactions_ = 0;
+
+  std::vector<std::uint16_t> narrow_; // reused when narrowing to UINT16
+};
+
+} // namespace gfx
@@ -0,0 +1,422 @@
+#include "gfx/GpuProfiler.h"
+
+#include "gfx/Context.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+constexpr VkQueryPipelineStatisticFlags kStatisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+  | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+  | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+  | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+  | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+  | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+// Nearest rank on sorted samples.
+double percentile(std::vector<double> const& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  std::size_t const rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+  return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1U)) - 1U];
+}
+
+// Scope names are identifiers in practice; quotes and backslashes are all
+// that could break the JSON.
+std::string json_string(char const* s) {
+  std::string out = "\"";
+  for (char const* c = s; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+    }
+    out += *c;
+  }
+  out += '"';
+  return out;
+}
+
+} // namespace
+
+GpuProfiler::~GpuProfiler() {
+}
+
+GpuProfiler::GpuProfiler(GpuProfiler&& other) noexcept {
+  *this = std::move(other);
+}
+
+GpuProfiler& GpuProfiler::operator=(GpuProfiler&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  frames_ = std::move(other.frames_);
+  current_ = other.current_;
+  open_depth_ = other.open_depth_;
+  frame_number_ = other.frame_number_;
+  ms_per_tick_ = other.ms_per_tick_;
+  tick_mask_ = other.tick_mask_;
+  statistics_ = other.statistics_;
+  readback_ = std::move(other.readback_);
+  series_ = std::move(other.series_);
+  trace_ = std::move(other.trace_);
+  trace_origin_ = other.trace_origin_;
+  have_origin_ = other.have_origin_;
+  last_statistics_ = other.last_statistics_;
+
+  other.frames_.clear();
+  other.current_ = nullptr;
+  other.open_depth_ = 0;
+  other.frame_number_ = 0;
+  other.statistics_ = false;
+  other.series_.clear();
+  other.trace_.clear();
+  other.have_origin_ = false;
+
+  return *this;
+}
+
+void GpuProfiler::init(Context const& ctx, std::uint32_t frames_in_flight) {
+  if (!frames_.empty()) {
+    fail("GpuProfiler::init called twice");
+  }
+  if (frames_in_flight == 0U) {
+    fail("GpuProfiler::init: frames_in_flight == 0");
+  }
+  if (!ctx.supports_timestamps()) {
+    std::fprintf(stderr, "GpuProfiler: graphics queue has no timestamps; profiling disabled\n");
+    return;
+  }
+
+  ms_per_tick_ = static_cast<double>(ctx.timestamp_period()) * 1e-6;
+  tick_mask_ = (ctx.timestamp_valid_bits() >= 64U) ? ~std::uint64_t{0} : ((std::uint64_t{1} << ctx.timestamp_valid_bits()) - 1U);
+  statistics_ = ctx.supports_pipeline_statistics();
+
+  frames_.resize(frames_in_flight);
+  for (Frame& f : frames_) {
+    VkQueryPoolCreateInfo ci{};
+    ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    ci.queryCount = 2U * kMaxScopes;
+    vk_check(vkCreateQueryPool(ctx.device(), &ci, nullptr, &f.timestamps), "vkCreateQueryPool(timestamps)");
+
+    if (statistics_) {
+      VkQueryPoolCreateInfo si{};
+      si.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      si.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+      si.queryCount = 1;
+      si.pipelineStatistics = kStatisticFlags;
+      vk_check(vkCreateQueryPool(ctx.device(), &si, nullptr, &f.statistics), "vkCreateQueryPool(statistics)");
+    }
+
+    f.scopes.reserve(kMaxScopes);
+  }
+
+  readback_.resize(2U * 2U * kMaxScopes);
+}
+
+void GpuProfiler::shutdown(Context const& ctx) {
+  for (Frame& f : frames_) {
+    if (f.timestamps != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(ctx.device(), f.timestamps, nullptr);
+    }
+    if (f.statistics != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(ctx.device(), f.statistics, nullptr);
+    }
+  }
+  frames_.clear();
+  current_ = nullptr;
+  open_depth_ = 0;
+  frame_number_ = 0;
+  statistics_ = false;
+  readback_.clear();
+  series_.clear();
+  trace_.clear();
+  have_origin_ = false;
+  last_statistics_ = Statistics{};
+}
+
+void GpuProfiler::begin_frame(Context const& ctx, VkCommandBuffer cb, std::uint32_t frame) {
+  current_ = nullptr;
+  if (frames_.empty()) {
+    return;
+  }
+
+  Frame& f = frames_.at(frame);
+  if (f.recorded) {
+    collect(ctx, f);
+  }
+
+  vkCmdResetQueryPool(cb, f.timestamps, 0, 2U * kMaxScopes);
+  if (f.statistics != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(cb, f.statistics, 0, 1);
+  }
+
+  f.scopes.clear();
+  f.number = frame_number_++;
+  f.recorded = true;
+  f.statistics_used = false;
+  current_ = &f;
+  open_depth_ = 0;
+}
+
+std::uint32_t GpuProfiler::begin_scope(VkCommandBuffer cb, char const* name) {
+  if (current_ == nullptr || current_->scopes.size() >= kMaxScopes) {
+    return kNoScope;
+  }
+
+  std::uint32_t const index = static_cast<std::uint32_t>(current_->scopes.size());
+  vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current_->timestamps, 2U * index);
+  current_->scopes.push_back(Scope{name, open_depth_++, false});
+  return index;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer cb, std::uint32_t scope) {
+  if (current_ == nullptr || scope >= current_->scopes.size() || current_->scopes[scope].closed) {
+    return;
+  }
+
+  // Bottom of pipe: the timestamp lands once everything before it has finished.
+  vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current_->timestamps, 2U * scope + 1U);
+  current_->scopes[scope].closed = true;
+  --open_depth_;
+}
+
+void GpuProfiler::begin_statistics(VkCommandBuffer cb) {
+  if (current_ == nullptr || current_->statistics == VK_NULL_HANDLE || current_->statistics_used) {
+    return;
+  }
+  vkCmdBeginQuery(cb, current_->statistics, 0, 0);
+  current_->statistics_used = true;
+}
+
+void GpuProfiler::end_statistics(VkCommandBuffer cb) {
+  if (current_ == nullptr || !current_->statistics_used) {
+    return;
+  }
+  vkCmdEndQuery(cb, current_->statistics, 0);
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::statistic_flags() const {
+  return statistics_ ? kStatisticFlags : 0U;
+}
+
+void GpuProfiler::collect(Context const& ctx, Frame& f) {
+  f.recorded = false;
+
+  TraceFrame tf{};
+  tf.number = f.number;
+
+  std::uint32_t const queries = 2U * static_cast<std::uint32_t>(f.scopes.size());
+  if (queries != 0U) {
+    // Without WAIT this returns VK_NOT_READY if any query is missing; the
+    // available ones are still written, flagged per query.
+    VkResult const r = vkGetQueryPoolResults(ctx.device(),
+                                             f.timestamps,
+                                             0,
+                                             queries,
+                                             readback_.size() * sizeof(std::uint64_t),
+                                             readback_.data(),
+                                             2U * sizeof(std::uint64_t),
+                                             VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (r != VK_SUCCESS && r != VK_NOT_READY) {
+      vk_check(r, "vkGetQueryPoolResults(timestamps)");
+    }
+
+    auto const tick = [this](std::uint32_t query, std::uint64_t& out) {
+      out = readback_[2U * query];
+      return readback_[2U * query + 1U] != 0U;
+    };
+
+    std::uint64_t frame_start = 0;
+    bool const have_start = tick(0, frame_start);
+    if (have_start && !have_origin_) {
+      trace_origin_ = frame_start;
+      have_origin_ = true;
+    }
+    if (have_start) {
+      tf.gpu_start_ms = static_cast<double>((frame_start - trace_origin_) & tick_mask_) * ms_per_tick_;
+    }
+
+    for (std::uint32_t i = 0; i < f.scopes.size(); ++i) {
+      Scope const& s = f.scopes[i];
+      std::uint64_t begin = 0;
+      std::uint64_t end = 0;
+      if (!s.closed || !have_start || !tick(2U * i, begin) || !tick(2U * i + 1U, end)) {
+        continue;
+      }
+
+      TraceScope ts{};
+      ts.name = s.name;
+      ts.depth = s.depth;
+      ts.start_ms = static_cast<double>((begin - frame_start) & tick_mask_) * ms_per_tick_;
+      ts.duration_ms = static_cast<double>((end - begin) & tick_mask_) * ms_per_tick_;
+      tf.scopes.push_back(ts);
+      add_sample(s.name, ts.duration_ms);
+    }
+  }
+
+  if (f.statistics_used) {
+    std::uint64_t values[kStatisticCount + 1U]{};
+    VkResult const r = vkGetQueryPoolResults(ctx.device(),
+                                             f.statistics,
+                                             0,
+                                             1,
+                                             sizeof(values),
+                                             values,
+                                             sizeof(values),
+                                             VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (r != VK_SUCCESS && r != VK_NOT_READY) {
+      vk_check(r, "vkGetQueryPoolResults(statistics)");
+    }
+    if (values[kStatisticCount] != 0U) {
+      std::memcpy(tf.statistics.values, values, sizeof(tf.statistics.values));
+      tf.statistics.valid = true;
+      last_statistics_ = tf.statistics;
+    }
+  }
+
+  if (trace_.size() == kTraceFrames) {
+    trace_.pop_front();
+  }
+  trace_.push_back(std::move(tf));
+}
+
+void GpuProfiler::add_sample(char const* name, double ms) {
+  auto it = std::find_if(series_.begin(), series_.end(), [name](Series const& s) {
+    return s.name == name || std::strcmp(s.name, name) == 0;
+  });
+  if (it == series_.end()) {
+    series_.push_back(Series{name, {}});
+    it = series_.end() - 1;
+  }
+
+  if (it->samples.size() == kHistory) {
+    it->samples.pop_front();
+  }
+  it->samples.push_back(ms);
+}
+
+std::vector<GpuProfiler::ScopeStats> GpuProfiler::scope_stats() const {
+  std::vector<ScopeStats> out;
+  out.reserve(series_.size());
+
+  std::vector<double> sorted;
+  for (Series const& s : series_) {
+    sorted.assign(s.samples.begin(), s.samples.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    ScopeStats st{};
+    st.name = s.name;
+    st.last_ms = s.samples.empty() ? 0.0 : s.samples.back();
+    st.p50_ms = percentile(sorted, 0.50);
+    st.p95_ms = percentile(sorted, 0.95);
+    st.p99_ms = percentile(sorted, 0.99);
+    st.samples = sorted.size();
+    out.push_back(std::move(st));
+  }
+  return out;
+}
+
+char const* GpuProfiler::statistic_name(std::uint32_t statistic) {
+  switch (statistic) {
+    case InputVertices: return "input_vertices";
+    case InputPrimitives: return "input_primitives";
+    case VertexInvocations: return "vertex_invocations";
+    case ClippingPrimitives: return "clipping_primitives";
+    case FragmentInvocations: return "fragment_invocations";
+    case ComputeInvocations: return "compute_invocations";
+    default: return "unknown";
+  }
+}
+
+bool GpuProfiler::write_csv(std::string const& path) const {
+  std::ofstream ofs(path, std::ios::trunc);
+  if (!ofs) {
+    return false;
+  }
+
+  char line[256];
+  ofs << "frame,name,depth,start_ms,duration_ms,count\n";
+  for (TraceFrame const& tf : trace_) {
+    for (TraceScope const& ts : tf.scopes) {
+      std::snprintf(line, sizeof(line), "%llu,%s,%u,%.4f,%.4f,\n",
+                    static_cast<unsigned long long>(tf.number), ts.name, ts.depth, ts.start_ms, ts.duration_ms);
+      ofs << line;
+    }
+    if (tf.statistics.valid) {
+      for (std::uint32_t i = 0; i < kStatisticCount; ++i) {
+        std::snprintf(line, sizeof(line), "%llu,%s,,,,%llu\n",
+                      static_cast<unsigned long long>(tf.number), statistic_name(i),
+                      static_cast<unsigned long long>(tf.statistics.values[i]));
+        ofs << line;
+      }
+    }
+  }
+
+  ofs.flush();
+  return static_cast<bool>(ofs);
+}
+
+bool GpuProfiler::write_json(std::string const& path) const {
+  std::ofstream ofs(path, std::ios::trunc);
+  if (!ofs) {
+    return false;
+  }
+
+  // Trace event format: complete events ("X") per scope on one GPU track,
+  // counters ("C") for the statistics. Times are in microseconds.
+  char num[128];
+  bool first = true;
+  auto const separator = [&]() {
+    ofs << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (TraceFrame const& tf : trace_) {
+    for (TraceScope const& ts : tf.scopes) {
+      separator();
+      std::snprintf(num, sizeof(num), "\"ts\":%.3f,\"dur\":%.3f", (tf.gpu_start_ms + ts.start_ms) * 1000.0, ts.duration_ms * 1000.0);
+      ofs << "{\"name\":" << json_string(ts.name) << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0," << num
+          << ",\"args\":{\"frame\":" << tf.number << "}}";
+    }
+    if (tf.statistics.valid) {
+      separator();
+      std::snprintf(num, sizeof(num), "\"ts\":%.3f", tf.gpu_start_ms * 1000.0);
+      ofs << "{\"name\":\"pipeline statistics\",\"ph\":\"C\",\"pid\":0," << num << ",\"args\":{";
+      for (std::uint32_t i = 0; i < kStatisticCount; ++i) {
+        ofs << (i == 0U ? "" : ",") << json_string(statistic_name(i)) << ":" << tf.statistics.values[i];
+      }
+      ofs << "}}";
+    }
+  }
+  ofs << "\n]}\n";
+
+  ofs.flush();
+  return static_cast<bool>(ofs);
+}
+
+} // namespace gfx
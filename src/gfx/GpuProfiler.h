@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace gfx {
+
+class Context;
+
+// GPU timings for named scopes of the frame command buffer, plus one pipeline
+// statistics query over the whole frame. Each frame in flight has its own query
+// pools; begin_frame() reads back the results of the last frame that used the
+// slot, which its fence has already released, so nothing ever waits on the GPU.
+//
+// Per scope the last kHistory frames feed rolling percentiles; the last
+// kTraceFrames are kept for export as CSV or as a Chrome trace (JSON, loads in
+// chrome://tracing and Perfetto).
+class GpuProfiler {
+public:
+  static constexpr std::uint32_t kMaxScopes = 32;   // per frame
+  static constexpr std::size_t kHistory = 240;      // samples behind the percentiles
+  static constexpr std::size_t kTraceFrames = 600;  // frames kept for export
+  static constexpr std::uint32_t kStatisticCount = 6;
+  static constexpr std::uint32_t kNoScope = ~0U;
+
+  struct ScopeStats {
+    std::string name;
+    double last_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    std::size_t samples = 0;
+  };
+
+  // Order of the values in Statistics::values; see statistic_name().
+  enum Statistic : std::uint32_t {
+    InputVertices,
+    InputPrimitives,
+    VertexInvocations,
+    ClippingPrimitives,
+    FragmentInvocations,
+    ComputeInvocations,
+  };
+
+  struct Statistics {
+    std::uint64_t values[kStatisticCount]{};
+    bool valid = false;
+  };
+
+public:
+  GpuProfiler() = default;
+  ~GpuProfiler();
+
+  GpuProfiler(GpuProfiler const&) = delete;
+  GpuProfiler& operator=(GpuProfiler const&) = delete;
+
+  GpuProfiler(GpuProfiler&& other) noexcept;
+  GpuProfiler& operator=(GpuProfiler&& other) noexcept;
+
+  // Degrades to a no-op on devices without timestamps; statistics need
+  // Context::supports_pipeline_statistics() as well.
+  void init(Context const& ctx, std::uint32_t frames_in_flight);
+  void shutdown(Context const& ctx);
+
+  bool enabled() const { return !frames_.empty(); }
+  bool has_statistics() const { return statistics_; }
+
+  // First thing in frame `frame`'s command buffer, once its fence has signalled.
+  // Collects the slot's previous results and resets its queries.
+  void begin_frame(Context const& ctx, VkCommandBuffer cb, std::uint32_t frame);
+
+  // Scopes nest and must close in the same frame. `name` must outlive the
+  // profiler (a string literal). Returns kNoScope once kMaxScopes are open.
+  std::uint32_t begin_scope(VkCommandBuffer cb, char const* name);
+  void end_scope(VkCommandBuffer cb, std::uint32_t scope);
+
+  // Outside any render pass. With secondaries executed in between, the caller
+  // has to inherit the query (statistic_flags()) and needs inherited queries.
+  void begin_statistics(VkCommandBuffer cb);
+  void end_statistics(VkCommandBuffer cb);
+  VkQueryPipelineStatisticFlags statistic_flags() const;
+
+  std::vector<ScopeStats> scope_stats() const;
+  Statistics const& last_statistics() const { return last_statistics_; }
+  static char const* statistic_name(std::uint32_t statistic);
+
+  // Frame, scope name, start and duration (ms from the frame's first
+  // timestamp); statistics follow as rows with a count instead of times.
+  bool write_csv(std::string const& path) const;
+  bool write_json(std::string const& path) const;
+
+private:
+  struct Scope {
+    char const* name = nullptr;
+    std::uint32_t depth = 0;
+    bool closed = false;
+  };
+
+  struct Frame {
+    VkQueryPool timestamps = VK_NULL_HANDLE; // 2 per scope: begin, end
+    VkQueryPool statistics = VK_NULL_HANDLE;
+    std::vector<Scope> scopes;
+    std::uint64_t number = 0;
+    bool recorded = false;        // submitted since the last readback
+    bool statistics_used = false;
+  };
+
+  struct TraceScope {
+    char const* name = nullptr;
+    std::uint32_t depth = 0;
+    double start_ms = 0.0;
+    double duration_ms = 0.0;
+  };
+
+  struct TraceFrame {
+    std::uint64_t number = 0;
+    double gpu_start_ms = 0.0; // first timestamp, relative to the first traced frame
+    std::vector<TraceScope> scopes;
+    Statistics statistics{};
+  };
+
+  struct Series {
+    char const* name = nullptr;
+    std::deque<double> samples; // ms, oldest first
+  };
+
+  void collect(Context const& ctx, Frame& f);
+  void add_sample(char const* name, double ms);
+
+private:
+  std::vector<Frame> frames_;
+  Frame* current_ = nullptr;
+  std::uint32_t open_depth_ = 0;
+  std::uint64_t frame_number_ = 0;
+
+  double ms_per_tick_ = 0.0;
+  std::uint64_t tick_mask_ = 0;
+  bool statistics_ = false;
+
+  std::vector<std::uint64_t> readback_; // scratch: value + availability per query
+  std::vector<Series> series_;
+  std::deque<TraceFrame> trace_;
+  std::uint64_t trace_origin_ = 0; // first frame's first tick
+  bool have_origin_ = false;
+  Statistics last_statistics_{};
+};
+
+} // namespace gfx
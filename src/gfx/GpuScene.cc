@@ -0,0 +1,664 @@
+#include "gfx/GpuScene.h"
+
+#include "gfx/Barrier.h"
+#include "gfx/Context.h"
+#include "gfx/DepthPyramid.h"
+#include "gfx/Mesh.h"
+#include "gfx/Pipeline.h"
+#include "gfx/Vertex.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+// cull.comp push constants.
+struct CullPush {
+  float view_proj[16]; // frustum planes are extracted in the shader
+  float eye_scale[4];  // eye position, LOD error scale (0 keeps level 0)
+  float viewport[2];
+  std::uint32_t object_count;
+  std::uint32_t compact;
+  std::uint32_t phase; // CullPhase
+  std::uint32_t pad[3];
+};
+
+static_assert(sizeof(CullPush) <= 128, "CullPush exceeds the guaranteed push constant size");
+
+constexpr VkDeviceSize kCommandStride = sizeof(VkDrawIndexedIndirectCommand);
+
+constexpr std::uint32_t kBufferBindings = 6; // cull.comp bindings 0-5; 6 is the pyramid
+
+// How cull.comp reads the pyramid, DepthPyramid's or the stand-in.
+ImageUse pyramid_read_use() {
+  return ImageUse{VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT};
+}
+
+AllocationCreateInfo host_visible() {
+  AllocationCreateInfo a{};
+  a.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  return a;
+}
+
+void memory_barrier(VkCommandBuffer cb,
+                    VkPipelineStageFlags src_stages,
+                    VkAccessFlags src_access,
+                    VkPipelineStageFlags dst_stages,
+                    VkAccessFlags dst_access) {
+  VkMemoryBarrier b{};
+  b.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  b.srcAccessMask = src_access;
+  b.dstAccessMask = dst_access;
+  vkCmdPipelineBarrier(cb, src_stages, dst_stages, 0, 1, &b, 0, nullptr, 0, nullptr);
+}
+
+} // namespace
+
+GpuScene::~GpuScene() {
+}
+
+GpuScene::GpuScene(GpuScene&& other) noexcept {
+  *this = std::move(other);
+}
+
+GpuScene& GpuScene::operator=(GpuScene&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  max_objects_ = other.max_objects_;
+  max_meshes_ = other.max_meshes_;
+  compact_ = other.compact_;
+  cull_ = std::move(other.cull_);
+  descriptor_pool_ = other.descriptor_pool_;
+  descriptor_sets_ = std::move(other.descriptor_sets_);
+  no_pyramid_ = std::move(other.no_pyramid_);
+  pyramid_sampler_ = other.pyramid_sampler_;
+  no_pyramid_ready_ = other.no_pyramid_ready_;
+  transforms_ = std::move(other.transforms_);
+  objects_gpu_ = std::move(other.objects_gpu_);
+  batches_gpu_ = std::move(other.batches_gpu_);
+  commands_ = std::move(other.commands_);
+  counts_ = std::move(other.counts_);
+  visibility_ = std::move(other.visibility_);
+  staging_ = std::move(other.staging_);
+  meshes_ = std::move(other.meshes_);
+  batches_ = std::move(other.batches_);
+  objects_ = std::move(other.objects_);
+  transforms_cpu_ = std::move(other.transforms_cpu_);
+  dirty_ = std::move(other.dirty_);
+  is_dirty_ = std::move(other.is_dirty_);
+  layout_dirty_ = other.layout_dirty_;
+
+  other.max_objects_ = 0;
+  other.max_meshes_ = 0;
+  other.compact_ = false;
+  other.descriptor_pool_ = VK_NULL_HANDLE;
+  other.descriptor_sets_.clear();
+  other.pyramid_sampler_ = VK_NULL_HANDLE;
+  other.no_pyramid_ready_ = false;
+  other.staging_.clear();
+  other.meshes_.clear();
+  other.batches_.clear();
+  other.objects_.clear();
+  other.transforms_cpu_.clear();
+  other.dirty_.clear();
+  other.is_dirty_.clear();
+  other.layout_dirty_ = false;
+
+  return *this;
+}
+
+void GpuScene::init(Context const& ctx,
+                    std::string const& cull_spv_path,
+                    std::uint32_t max_objects,
+                    std::uint32_t max_meshes,
+                    std::uint32_t frames_in_flight) {
+  if (descriptor_pool_ != VK_NULL_HANDLE) {
+    fail("GpuScene::init called twice");
+  }
+  if (max_objects == 0U || max_meshes == 0U || frames_in_flight == 0U) {
+    fail("GpuScene::init: zero capacity");
+  }
+  if (!ctx.supports_indirect_draws()) {
+    fail("GpuScene: device lacks multiDrawIndirect / drawIndirectFirstInstance");
+  }
+
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(ctx.physical_device(), &props);
+  if (max_objects > props.limits.maxDrawIndirectCount) {
+    fail("GpuScene: max_objects exceeds maxDrawIndirectCount");
+  }
+
+  max_objects_ = max_objects;
+  max_meshes_ = max_meshes;
+  compact_ = ctx.cmd_draw_indexed_indirect_count() != nullptr;
+
+  VkDescriptorSetLayoutBinding bindings[kBufferBindings + 1U]{};
+  for (std::uint32_t i = 0; i <= kBufferBindings; ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = (i < kBufferBindings) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                                       : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  cull_.init(ctx, cull_spv_path, bindings, static_cast<std::uint32_t>(sizeof(CullPush)));
+
+  VkDeviceSize const transform_bytes = VkDeviceSize{max_objects} * sizeof(glm::mat4);
+  VkDeviceSize const object_bytes = VkDeviceSize{max_objects} * sizeof(ObjectRef);
+  VkDeviceSize const batch_bytes = VkDeviceSize{max_meshes} * sizeof(BatchGpu);
+
+  transforms_.init(ctx,
+                   transform_bytes,
+                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  objects_gpu_.init(ctx,
+                    object_bytes,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  batches_gpu_.init(ctx,
+                    batch_bytes,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  commands_.init(ctx,
+                 VkDeviceSize{max_objects} * kCommandStride,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  counts_.init(ctx,
+               VkDeviceSize{max_meshes} * sizeof(std::uint32_t),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  visibility_.init(ctx,
+                   VkDeviceSize{max_objects} * sizeof(std::uint32_t),
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  no_pyramid_.init_2d(ctx,
+                      VkExtent2D{1, 1},
+                      VK_FORMAT_R32_SFLOAT,
+                      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                      VK_IMAGE_ASPECT_COLOR_BIT);
+
+  // texelFetch only.
+  VkSamplerCreateInfo sci{};
+  sci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sci.magFilter = VK_FILTER_NEAREST;
+  sci.minFilter = VK_FILTER_NEAREST;
+  sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sci.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sci.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sci.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sci.maxLod = VK_LOD_CLAMP_NONE;
+  vk_check(vkCreateSampler(ctx.device(), &sci, nullptr, &pyramid_sampler_), "vkCreateSampler(cull)");
+
+  // Worst case is a full relayout.
+  staging_.resize(frames_in_flight);
+  for (auto& s : staging_) {
+    s.init(ctx, transform_bytes + object_bytes + batch_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, host_visible());
+  }
+
+  create_descriptors(ctx);
+
+  meshes_.reserve(max_meshes);
+  batches_.reserve(max_meshes);
+  objects_.reserve(max_objects);
+  transforms_cpu_.reserve(max_objects);
+  is_dirty_.reserve(max_objects);
+}
+
+void GpuScene::create_descriptors(Context const& ctx) {
+  std::uint32_t const sets = 2U * static_cast<std::uint32_t>(staging_.size());
+
+  VkDescriptorPoolSize pool_sizes[2]{};
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  pool_sizes[0].descriptorCount = kBufferBindings * sets;
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_sizes[1].descriptorCount = sets;
+
+  VkDescriptorPoolCreateInfo dpci{};
+  dpci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  dpci.maxSets = sets;
+  dpci.poolSizeCount = 2;
+  dpci.pPoolSizes = pool_sizes;
+
+  vk_check(vkCreateDescriptorPool(ctx.device(), &dpci, nullptr, &descriptor_pool_), "vkCreateDescriptorPool");
+
+  std::vector<VkDescriptorSetLayout> const layouts(sets, cull_.set_layout());
+
+  VkDescriptorSetAllocateInfo ai{};
+  ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  ai.descriptorPool = descriptor_pool_;
+  ai.descriptorSetCount = sets;
+  ai.pSetLayouts = layouts.data();
+
+  descriptor_sets_.assign(sets, VK_NULL_HANDLE);
+  vk_check(vkAllocateDescriptorSets(ctx.device(), &ai, descriptor_sets_.data()), "vkAllocateDescriptorSets");
+
+  // Binding order matches cull.comp.
+  Buffer const* buffers[kBufferBindings] = {&transforms_, &objects_gpu_, &batches_gpu_, &commands_, &counts_, &visibility_};
+
+  VkDescriptorBufferInfo infos[kBufferBindings]{};
+  for (std::uint32_t i = 0; i < kBufferBindings; ++i) {
+    infos[i].buffer = buffers[i]->handle();
+    infos[i].offset = 0;
+    infos[i].range = VK_WHOLE_SIZE;
+  }
+
+  VkDescriptorImageInfo pyramid{};
+  pyramid.sampler = pyramid_sampler_;
+  pyramid.imageView = no_pyramid_.view();
+  pyramid.imageLayout = pyramid_read_use().layout;
+
+  for (VkDescriptorSet const set : descriptor_sets_) {
+    VkWriteDescriptorSet writes[kBufferBindings + 1U]{};
+    for (std::uint32_t i = 0; i <= kBufferBindings; ++i) {
+      writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[i].dstSet = set;
+      writes[i].dstBinding = i;
+      writes[i].descriptorCount = 1;
+      if (i < kBufferBindings) {
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &infos[i];
+      } else {
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[i].pImageInfo = &pyramid;
+      }
+    }
+    vkUpdateDescriptorSets(ctx.device(), kBufferBindings + 1U, writes, 0, nullptr);
+  }
+}
+
+void GpuScene::clear_no_pyramid(VkCommandBuffer cb) {
+  ImageUse use{};
+  transition_image(cb, no_pyramid_.image(), VK_IMAGE_ASPECT_COLOR_BIT, use, transfer_dst_use(), true);
+
+  VkClearColorValue far{};
+  far.float32[0] = 1.0f;
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = 1;
+  range.layerCount = 1;
+  vkCmdClearColorImage(cb, no_pyramid_.image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &far, 1, &range);
+
+  transition_image(cb, no_pyramid_.image(), VK_IMAGE_ASPECT_COLOR_BIT, use, pyramid_read_use());
+  no_pyramid_ready_ = true;
+}
+
+void GpuScene::shutdown(Context const& ctx) {
+  for (auto& s : staging_) {
+    s.shutdown(ctx);
+  }
+  staging_.clear();
+
+  visibility_.shutdown(ctx);
+  counts_.shutdown(ctx);
+  commands_.shutdown(ctx);
+  batches_gpu_.shutdown(ctx);
+  objects_gpu_.shutdown(ctx);
+  transforms_.shutdown(ctx);
+
+  if (descriptor_pool_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(ctx.device(), descriptor_pool_, nullptr);
+    descriptor_pool_ = VK_NULL_HANDLE;
+  }
+  descriptor_sets_.clear();
+
+  if (pyramid_sampler_ != VK_NULL_HANDLE) {
+    vkDestroySampler(ctx.device(), pyramid_sampler_, nullptr);
+    pyramid_sampler_ = VK_NULL_HANDLE;
+  }
+  no_pyramid_.shutdown(ctx);
+  no_pyramid_ready_ = false;
+
+  cull_.shutdown(ctx);
+
+  meshes_.clear();
+  batches_.clear();
+  objects_.clear();
+  transforms_cpu_.clear();
+  dirty_.clear();
+  is_dirty_.clear();
+  layout_dirty_ = false;
+  max_objects_ = 0;
+  max_meshes_ = 0;
+  compact_ = false;
+}
+
+std::uint32_t GpuScene::add_mesh(Mesh const& mesh) {
+  if (meshes_.size() >= max_meshes_) {
+    fail("GpuScene::add_mesh: capacity exceeded");
+  }
+  if (!meshes_.empty() && mesh.vertex_format() != meshes_.front()->vertex_format()) {
+    fail("GpuScene::add_mesh: mixed vertex formats");
+  }
+
+  PositionDequant const& dq = mesh.position_dequant();
+  BoundingSphere const& bs = mesh.bounds();
+
+  static_assert(sizeof(BatchGpu::lods) / sizeof(LodGpu) == Mesh::kMaxLods, "BatchGpu::lods must match Mesh::kMaxLods");
+
+  BatchGpu b{};
+  for (int a = 0; a < 3; ++a) {
+    b.sphere[a] = (bs.center[a] - dq.bias[a]) / dq.scale[a];
+    b.inv_scale[a] = 1.0f / dq.scale[a];
+  }
+  b.sphere[3] = bs.radius;
+  b.inv_scale[3] = 0.0f;
+  b.lod_count = mesh.lod_count();
+  for (std::uint32_t l = 0; l < mesh.lod_count(); ++l) {
+    b.lods[l] = LodGpu{mesh.first_index() + mesh.lod(l).first_index,
+                       mesh.lod(l).index_count,
+                       mesh.lod(l).error,
+                       mesh.vertex_offset()};
+  }
+
+  meshes_.push_back(&mesh);
+  batches_.push_back(b);
+  layout_dirty_ = true;
+
+  return static_cast<std::uint32_t>(meshes_.size() - 1U);
+}
+
+std::uint32_t GpuScene::add_object(std::uint32_t mesh, glm::mat4 const& model) {
+  if (mesh >= meshes_.size()) {
+    fail("GpuScene::add_object: bad mesh id");
+  }
+  if (objects_.size() >= max_objects_) {
+    fail("GpuScene::add_object: capacity exceeded");
+  }
+
+  objects_.push_back(ObjectRef{mesh, 0U});
+  transforms_cpu_.push_back(model * dequant_matrix(meshes_[mesh]->position_dequant()));
+  is_dirty_.push_back(0U);
+  layout_dirty_ = true;
+
+  return static_cast<std::uint32_t>(objects_.size() - 1U);
+}
+
+void GpuScene::set_transform(std::uint32_t object, glm::mat4 const& model) {
+  if (object >= objects_.size()) {
+    fail("GpuScene::set_transform: bad object id");
+  }
+
+  Mesh const& mesh = *meshes_[objects_[object].batch];
+  transforms_cpu_[object] = model * dequant_matrix(mesh.position_dequant());
+
+  if (is_dirty_[object] == 0U) {
+    is_dirty_[object] = 1U;
+    dirty_.push_back(object);
+  }
+}
+
+void GpuScene::relayout() {
+  // Commands are grouped by mesh; each object gets a fixed slot in its group.
+  for (auto& b : batches_) {
+    b.object_count = 0;
+  }
+  for (auto const& o : objects_) {
+    ++batches_[o.batch].object_count;
+  }
+
+  std::uint32_t first = 0;
+  for (auto& b : batches_) {
+    b.first_command = first;
+    first += b.object_count;
+  }
+
+  std::vector<std::uint32_t> fill(batches_.size(), 0U);
+  for (auto& o : objects_) {
+    o.slot = batches_[o.batch].first_command + fill[o.batch]++;
+  }
+}
+
+void GpuScene::refresh_geometry() {
+  for (std::size_t m = 0; m < meshes_.size(); ++m) {
+    Mesh const& mesh = *meshes_[m];
+    BatchGpu& b = batches_[m];
+    for (std::uint32_t l = 0; l < b.lod_count; ++l) {
+      std::uint32_t const first = mesh.first_index() + mesh.lod(l).first_index;
+      std::int32_t const offset = mesh.vertex_offset();
+      if (b.lods[l].first_index != first || b.lods[l].vertex_offset != offset) {
+        b.lods[l].first_index = first;
+        b.lods[l].vertex_offset = offset;
+        layout_dirty_ = true;
+      }
+    }
+  }
+}
+
+void GpuScene::record_update(Context const& ctx, VkCommandBuffer cb, std::uint32_t frame) {
+  (void)ctx;
+
+  if (!no_pyramid_ready_) {
+    clear_no_pyramid(cb);
+  }
+
+  refresh_geometry();
+  if (!layout_dirty_ && dirty_.empty()) {
+    return;
+  }
+
+  Buffer& staging = staging_.at(frame);
+  auto* base = static_cast<unsigned char*>(staging.mapped());
+  VkDeviceSize cursor = 0;
+
+  std::vector<VkBufferCopy> transform_regions;
+  VkBufferCopy object_region{};
+  VkBufferCopy batch_region{};
+
+  if (layout_dirty_) {
+    relayout();
+
+    VkDeviceSize const tb = transforms_cpu_.size() * sizeof(glm::mat4);
+    VkDeviceSize const ob = objects_.size() * sizeof(ObjectRef);
+    VkDeviceSize const bb = batches_.size() * sizeof(BatchGpu);
+
+    if (tb > 0U) {
+      std::memcpy(base + cursor, transforms_cpu_.data(), static_cast<std::size_t>(tb));
+      transform_regions.push_back(VkBufferCopy{cursor, 0, tb});
+      cursor += tb;
+    }
+    if (ob > 0U) {
+      std::memcpy(base + cursor, objects_.data(), static_cast<std::size_t>(ob));
+      object_region = VkBufferCopy{cursor, 0, ob};
+      cursor += ob;
+    }
+    std::memcpy(base + cursor, batches_.data(), static_cast<std::size_t>(bb));
+    batch_region = VkBufferCopy{cursor, 0, bb};
+    cursor += bb;
+  } else {
+    // Coalesce consecutive ids into one region each.
+    std::sort(dirty_.begin(), dirty_.end());
+    std::size_t i = 0;
+    while (i < dirty_.size()) {
+      std::size_t j = i + 1U;
+      while (j < dirty_.size() && dirty_[j] == dirty_[j - 1U] + 1U) {
+        ++j;
+      }
+
+      VkDeviceSize const bytes = (j - i) * sizeof(glm::mat4);
+      std::memcpy(base + cursor, &transforms_cpu_[dirty_[i]], static_cast<std::size_t>(bytes));
+      transform_regions.push_back(VkBufferCopy{cursor, VkDeviceSize{dirty_[i]} * sizeof(glm::mat4), bytes});
+      cursor += bytes;
+      i = j;
+    }
+  }
+
+  for (std::uint32_t const id : dirty_) {
+    is_dirty_[id] = 0U;
+  }
+  dirty_.clear();
+
+  // Earlier frames may still be reading these buffers, and their Late cull
+  // writing the visibility cleared below.
+  memory_barrier(cb,
+                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_SHADER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                 VK_ACCESS_TRANSFER_WRITE_BIT);
+
+  if (!transform_regions.empty()) {
+    vkCmdCopyBuffer(cb,
+                    staging.handle(),
+                    transforms_.handle(),
+                    static_cast<uint32_t>(transform_regions.size()),
+                    transform_regions.data());
+  }
+  if (layout_dirty_) {
+    if (object_region.size > 0U) {
+      vkCmdCopyBuffer(cb, staging.handle(), objects_gpu_.handle(), 1, &object_region);
+    }
+    vkCmdCopyBuffer(cb, staging.handle(), batches_gpu_.handle(), 1, &batch_region);
+    // Ids are stable, but new objects would start from garbage; one frame of
+    // drawing everything in Late is cheaper than tracking which ones are new.
+    vkCmdFillBuffer(cb, visibility_.handle(), 0, VK_WHOLE_SIZE, 0U);
+    layout_dirty_ = false;
+  }
+
+  memory_barrier(cb,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                 VK_ACCESS_TRANSFER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void GpuScene::record_cull(Context const& ctx,
+                           VkCommandBuffer cb,
+                           std::uint32_t frame,
+                           CullView const& view,
+                           CullPhase phase,
+                           DepthPyramid const* pyramid) {
+  if (objects_.empty()) {
+    return;
+  }
+  if (phase == CullPhase::Late && pyramid == nullptr) {
+    fail("GpuScene::record_cull: Late needs a depth pyramid");
+  }
+
+  VkDescriptorSet const set = descriptor_sets_.at(2U * frame + ((phase == CullPhase::Late) ? 1U : 0U));
+
+  // The pyramid is recreated with the depth buffer, so Late's binding is
+  // rewritten every frame. Its fence has signalled, so no earlier frame uses it.
+  if (phase == CullPhase::Late) {
+    VkDescriptorImageInfo ii{};
+    ii.sampler = pyramid_sampler_;
+    ii.imageView = pyramid->view();
+    ii.imageLayout = pyramid_read_use().layout;
+
+    VkWriteDescriptorSet w{};
+    w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    w.dstSet = set;
+    w.dstBinding = kBufferBindings;
+    w.descriptorCount = 1;
+    w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    w.pImageInfo = &ii;
+    vkUpdateDescriptorSets(ctx.device(), 1, &w, 0, nullptr);
+  }
+
+  // The previous indirect draws (last frame's, or Early's) may still read
+  // commands/counts; the previous Late wrote the visibility read here.
+  memory_barrier(cb,
+                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_SHADER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  if (compact_) {
+    vkCmdFillBuffer(cb, counts_.handle(), 0, VK_WHOLE_SIZE, 0U);
+    memory_barrier(cb,
+                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                   VK_ACCESS_TRANSFER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  CullPush push{};
+  std::memcpy(push.view_proj, &view.view_proj[0][0], sizeof(push.view_proj));
+  push.eye_scale[0] = view.eye.x;
+  push.eye_scale[1] = view.eye.y;
+  push.eye_scale[2] = view.eye.z;
+  push.eye_scale[3] = view.lod_error_scale;
+  push.viewport[0] = static_cast<float>(view.viewport.width);
+  push.viewport[1] = static_cast<float>(view.viewport.height);
+  push.object_count = object_count();
+  push.compact = compact_ ? 1U : 0U;
+  push.phase = static_cast<std::uint32_t>(phase);
+
+  vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, cull_.pipeline());
+  vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, cull_.pipeline_layout(), 0, 1, &set, 0, nullptr);
+  vkCmdPushConstants(cb, cull_.pipeline_layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+  vkCmdDispatch(cb, (push.object_count + kCullGroupSize - 1U) / kCullGroupSize, 1, 1);
+
+  memory_barrier(cb,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_SHADER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                 VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+void GpuScene::record_draws(Context const& ctx, VkCommandBuffer cb) const {
+  if (objects_.empty()) {
+    return;
+  }
+
+  // firstInstance in each command is the object id, which indexes this buffer.
+  VkBuffer const transforms = transforms_.handle();
+  VkDeviceSize const zero = 0;
+  vkCmdBindVertexBuffers(cb, kInstanceBinding, 1, &transforms, &zero);
+
+  PFN_vkCmdDrawIndexedIndirectCountKHR const draw_count = ctx.cmd_draw_indexed_indirect_count();
+
+  // Pooled meshes share buffers; commands carry their offsets.
+  VkBuffer bound_vb = VK_NULL_HANDLE;
+  VkBuffer bound_ib = VK_NULL_HANDLE;
+  for (std::size_t b = 0; b < batches_.size(); ++b) {
+    BatchGpu const& batch = batches_[b];
+    if (batch.object_count == 0U) {
+      continue;
+    }
+
+    Mesh const& mesh = *meshes_[b];
+    VkBuffer const vb = mesh.vertex_buffer();
+    if (vb != bound_vb) {
+      vkCmdBindVertexBuffers(cb, 0, 1, &vb, &zero);
+      bound_vb = vb;
+    }
+    VkBuffer const ib = mesh.index_buffer();
+    if (ib != bound_ib) {
+      vkCmdBindIndexBuffer(cb, ib, 0, mesh.index_type());
+      bound_ib = ib;
+    }
+
+    VkDeviceSize const offset = VkDeviceSize{batch.first_command} * kCommandStride;
+    if (compact_) {
+      draw_count(cb,
+                 commands_.handle(),
+                 offset,
+                 counts_.handle(),
+                 b * sizeof(std::uint32_t),
+                 batch.object_count,
+                 static_cast<uint32_t>(kCommandStride));
+    } else {
+      vkCmdDrawIndexedIndirect(cb, commands_.handle(), offset, batch.object_count, static_cast<uint32_t>(kCommandStride));
+    }
+  }
+}
+
+} // namespace gfx
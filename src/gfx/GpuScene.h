@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "gfx/Buffer.h"
+#include "gfx/ComputePipeline.h"
+#include "gfx/Image.h"
+
+namespace gfx {
+
+class Context;
+class DepthPyramid;
+class Mesh;
+
+// Which objects one record_cull() draws. Occlusion culling runs Early, draws,
+// builds a DepthPyramid from that depth, then runs Late and draws again into
+// the same attachments.
+enum class CullPhase : std::uint8_t {
+  All,   // frustum only; every object in view
+  Early, // frustum only; objects Late found visible last frame
+  Late,  // frustum and pyramid; visible objects Early skipped, and records
+         // visibility for the next frame
+};
+
+struct CullView {
+  glm::mat4 view_proj{1.0f};
+  glm::vec3 eye{0.0f};
+  float lod_error_scale = 0.0f; // Camera::projection_scale over the pixel threshold; 0 = level 0
+  VkExtent2D viewport{};        // the depth buffer's, for Late's footprints
+};
+
+// GPU-resident scene for indirect drawing. Objects (one instance of a mesh each)
+// live in device-local buffers; a compute pass culls them against the frustum and
+// writes one VkDrawIndexedIndirectCommand per visible object, grouped by mesh, so
+// the CPU issues one indirect draw per mesh no matter how many objects there are.
+// The same pass picks each object's LOD (see Renderer::select_lod) and, with a
+// DepthPyramid, drops objects hidden behind what was already drawn.
+//
+// Changes are staged on the CPU and copied by the frame that records them
+// (record_update), which keeps them ordered against frames still in flight.
+// Adding meshes or objects relayouts the whole scene on the next update;
+// set_transform only moves the touched matrices.
+class GpuScene {
+public:
+  static constexpr std::uint32_t kCullGroupSize = 64; // matches local_size_x in cull.comp
+
+public:
+  GpuScene() = default;
+  ~GpuScene();
+
+  GpuScene(GpuScene const&) = delete;
+  GpuScene& operator=(GpuScene const&) = delete;
+
+  GpuScene(GpuScene&& other) noexcept;
+  GpuScene& operator=(GpuScene&& other) noexcept;
+
+  // Requires Context::supports_indirect_draws(). Without the draw-count extension
+  // culled objects are drawn as zero-instance commands instead of being compacted.
+  void init(Context const& ctx,
+            std::string const& cull_spv_path,
+            std::uint32_t max_objects,
+            std::uint32_t max_meshes,
+            std::uint32_t frames_in_flight);
+  void shutdown(Context const& ctx);
+
+  // Meshes must outlive the scene. All meshes need the same vertex format, the
+  // one the drawing pipeline was built for. Meshes from one GeometryPool share
+  // their buffer binds in record_draws().
+  std::uint32_t add_mesh(Mesh const& mesh);
+  std::uint32_t add_object(std::uint32_t mesh, glm::mat4 const& model);
+  void set_transform(std::uint32_t object, glm::mat4 const& model);
+
+  std::uint32_t object_count() const { return static_cast<std::uint32_t>(objects_.size()); }
+  std::uint32_t mesh_count() const { return static_cast<std::uint32_t>(meshes_.size()); }
+
+  // Outside a render pass, in this order. `frame` selects the staging buffer
+  // and descriptor set and must only be reused after that frame's fence has
+  // signalled. Late needs `pyramid`, built after the Early draws.
+  void record_update(Context const& ctx, VkCommandBuffer cb, std::uint32_t frame);
+  void record_cull(Context const& ctx,
+                   VkCommandBuffer cb,
+                   std::uint32_t frame,
+                   CullView const& view,
+                   CullPhase phase = CullPhase::All,
+                   DepthPyramid const* pyramid = nullptr);
+
+  // Inside the render pass with the mesh pipeline and its frame set bound. Binds
+  // the transform buffer as the instance binding.
+  void record_draws(Context const& ctx, VkCommandBuffer cb) const;
+
+private:
+  struct ObjectRef {
+    std::uint32_t batch;
+    std::uint32_t slot; // fixed command slot, used when not compacting
+  };
+
+  // std430 layouts of cull.comp's Lod and Batch.
+  struct LodGpu {
+    std::uint32_t first_index; // absolute, includes the mesh's pool offset
+    std::uint32_t index_count;
+    float error;
+    std::int32_t vertex_offset;
+  };
+
+  struct BatchGpu {
+    float sphere[4];    // center in stored-position space, object-space radius
+    float inv_scale[4]; // 1 / dequant scale, recovers the model's scale from the folded matrix
+    std::uint32_t first_command;
+    std::uint32_t object_count;
+    std::uint32_t lod_count;
+    std::uint32_t pad;
+    LodGpu lods[4]; // Mesh::kMaxLods
+  };
+
+  void relayout();
+  // Pool compaction moves meshes; re-reads their offsets and marks the layout
+  // dirty when any changed.
+  void refresh_geometry();
+  void create_descriptors(Context const& ctx);
+  // Stand-in for binding 6 until a pyramid is bound; far depth everywhere.
+  void clear_no_pyramid(VkCommandBuffer cb);
+
+private:
+  std::uint32_t max_objects_ = 0;
+  std::uint32_t max_meshes_ = 0;
+  bool compact_ = false; // vkCmdDrawIndexedIndirectCount available
+
+  ComputePipeline cull_{};
+  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+  // Two per frame in flight: All / Early read the stand-in pyramid, Late the
+  // one it was given, rewritten as it is recorded.
+  std::vector<VkDescriptorSet> descriptor_sets_;
+
+  Image no_pyramid_{}; // 1x1, cleared to 1.0 by the first record_update
+  VkSampler pyramid_sampler_ = VK_NULL_HANDLE;
+  bool no_pyramid_ready_ = false;
+
+  Buffer transforms_{}; // mat4 per object, model * dequant; instance binding + cull input
+  Buffer objects_gpu_{};
+  Buffer batches_gpu_{};
+  Buffer commands_{};
+  Buffer counts_{};
+  Buffer visibility_{}; // uint per object, written by Late
+  std::vector<Buffer> staging_; // per frame in flight, host-visible
+
+  std::vector<Mesh const*> meshes_;
+  std::vector<BatchGpu> batches_;
+  std::vector<ObjectRef> objects_;
+  std::vector<glm::mat4> transforms_cpu_;
+
+  std::vector<std::uint32_t> dirty_;
+  std::vector<std::uint8_t> is_dirty_;
+  bool layout_dirty_ = false;
+};
+
+} // namespace gfx
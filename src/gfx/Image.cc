@@ -19,21 +19,6 @@ void vk_check(VkResult r, char const* what) {
   }
 }
 
-uint32_t find_memory_type(Context const& ctx, uint32_t type_bits, VkMemoryPropertyFlags props) {
-  VkPhysicalDeviceMemoryProperties mem{};
-  vkGetPhysicalDeviceMemoryProperties(ctx.physical_device(), &mem);
-
-  for (uint32_t i = 0; i < mem.memoryTypeCount; ++i) {
-    bool const type_ok = ((type_bits & (1u << i)) != 0u);
-    bool const props_ok = ((mem.memoryTypes[i].propertyFlags & props) == props);
-    if (type_ok && props_ok) {
-      return i;
-    }
-  }
-
-  fail("No suitable memory type found for image.");
-}
-
 } // namespace
 
 Image::~Image() {
@@ -49,16 +34,18 @@ Image& Image::operator=(Image&& other) noexcept {
   }
 
   image_ = other.image_;
-  memory_ = other.memory_;
+  allocation_ = other.allocation_;
   view_ = other.view_;
   format_ = other.format_;
   extent_ = other.extent_;
+  mip_levels_ = other.mip_levels_;
 
   other.image_ = VK_NULL_HANDLE;
-  other.memory_ = VK_NULL_HANDLE;
+  other.allocation_ = Allocation{};
   other.view_ = VK_NULL_HANDLE;
   other.format_ = VK_FORMAT_UNDEFINED;
   other.extent_ = {};
+  other.mip_levels_ = 0;
 
   return *this;
 }
@@ -67,20 +54,25 @@ void Image::init_2d(Context const& ctx,
                     VkExtent2D extent,
                     VkFormat format,
                     VkImageUsageFlags usage,
-                    VkImageAspectFlags aspect) {
+                    VkImageAspectFlags aspect,
+                    std::uint32_t mip_levels) {
   if (extent.width == 0U || extent.height == 0U) {
     fail("Image::init_2d: invalid extent");
   }
+  if (mip_levels == 0U) {
+    fail("Image::init_2d: mip_levels must be > 0");
+  }
 
   extent_ = extent;
   format_ = format;
+  mip_levels_ = mip_levels;
 
   VkImageCreateInfo ici{};
   ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   ici.imageType = VK_IMAGE_TYPE_2D;
   ici.format = format;
   ici.extent = VkExtent3D{extent.width, extent.height, 1};
-  ici.mipLevels = 1;
+  ici.mipLevels = mip_levels;
   ici.arrayLayers = 1;
   ici.samples = VK_SAMPLE_COUNT_1_BIT;
   ici.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -90,16 +82,12 @@ void Image::init_2d(Context const& ctx,
 
   vk_check(vkCreateImage(ctx.device(), &ici, nullptr, &image_), "vkCreateImage");
 
-  VkMemoryRequirements req{};
-  vkGetImageMemoryRequirements(ctx.device(), image_, &req);
-
-  VkMemoryAllocateInfo mai{};
-  mai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  mai.allocationSize = req.size;
-  mai.memoryTypeIndex = find_memory_type(ctx, req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  // Attachments are recreated on resize; keep them out of the shared blocks.
+  AllocationCreateInfo alloc{};
+  alloc.required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  alloc.dedicated = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0u;
 
-  vk_check(vkAllocateMemory(ctx.device(), &mai, nullptr, &memory_), "vkAllocateMemory(image)");
-  vk_check(vkBindImageMemory(ctx.device(), image_, memory_, 0), "vkBindImageMemory");
+  allocation_ = ctx.allocator().allocate_image(ctx, image_, alloc);
 
   VkImageViewCreateInfo vci{};
   vci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -108,7 +96,7 @@ void Image::init_2d(Context const& ctx,
   vci.format = format;
   vci.subresourceRange.aspectMask = aspect;
   vci.subresourceRange.baseMipLevel = 0;
-  vci.subresourceRange.levelCount = 1;
+  vci.subresourceRange.levelCount = mip_levels;
   vci.subresourceRange.baseArrayLayer = 0;
   vci.subresourceRange.layerCount = 1;
 
@@ -124,12 +112,12 @@ void Image::shutdown(Context const& ctx) {
     vkDestroyImage(ctx.device(), image_, nullptr);
     image_ = VK_NULL_HANDLE;
   }
-  if (memory_ != VK_NULL_HANDLE) {
-    vkFreeMemory(ctx.device(), memory_, nullptr);
-    memory_ = VK_NULL_HANDLE;
+  if (allocation_.valid()) {
+    ctx.allocator().free(ctx, allocation_);
   }
   format_ = VK_FORMAT_UNDEFINED;
   extent_ = {};
+  mip_levels_ = 0;
 }
 
 } // namespace gfx
@@ -4,6 +4,8 @@
 
 #include <cstdint>
 
+#include "gfx/Allocator.h"
+
 namespace gfx {
 
 class Context;
@@ -19,11 +21,13 @@ public:
   Image(Image&& other) noexcept;
   Image& operator=(Image&& other) noexcept;
 
+  // The view covers all `mip_levels`; their contents are undefined until uploaded.
   void init_2d(Context const& ctx,
                VkExtent2D extent,
                VkFormat format,
                VkImageUsageFlags usage,
-               VkImageAspectFlags aspect);
+               VkImageAspectFlags aspect,
+               std::uint32_t mip_levels = 1);
 
   void shutdown(Context const& ctx);
 
@@ -31,14 +35,16 @@ public:
   VkImageView view() const { return view_; }
   VkFormat format() const { return format_; }
   VkExtent2D extent() const { return extent_; }
+  std::uint32_t mip_levels() const { return mip_levels_; }
 
 private:
   VkImage image_ = VK_NULL_HANDLE;
-  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  Allocation allocation_{};
   VkImageView view_ = VK_NULL_HANDLE;
 
   VkFormat format_ = VK_FORMAT_UNDEFINED;
   VkExtent2D extent_{};
+  std::uint32_t mip_levels_ = 0;
 };
 
 } // namespace gfx
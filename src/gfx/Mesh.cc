@@ -2,11 +2,16 @@
 
 #include "gfx/Buffer.h"
 #include "gfx/Context.h"
+#include "gfx/GeometryPool.h"
 #include "gfx/Upload.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <new>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -19,6 +24,33 @@ namespace {
 [[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
 [[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
 
+// Centered on the AABB; not minimal, but one pass and stable under reordering.
+BoundingSphere bounding_sphere(std::span<Vertex const> vertices) {
+  float lo[3] = {vertices[0].pos[0], vertices[0].pos[1], vertices[0].pos[2]};
+  float hi[3] = {lo[0], lo[1], lo[2]};
+  for (Vertex const& v : vertices) {
+    for (int a = 0; a < 3; ++a) {
+      lo[a] = std::min(lo[a], v.pos[a]);
+      hi[a] = std::max(hi[a], v.pos[a]);
+    }
+  }
+
+  BoundingSphere b{};
+  for (int a = 0; a < 3; ++a) {
+    b.center[a] = 0.5f * (lo[a] + hi[a]);
+  }
+
+  float r2 = 0.0f;
+  for (Vertex const& v : vertices) {
+    float const dx = v.pos[0] - b.center[0];
+    float const dy = v.pos[1] - b.center[1];
+    float const dz = v.pos[2] - b.center[2];
+    r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+  }
+  b.radius = std::sqrt(r2);
+  return b;
+}
+
 } // namespace
 
 struct Mesh::Impl {
@@ -39,12 +71,27 @@ Mesh& Mesh::operator=(Mesh&& other) noexcept {
   }
 
   impl_ = other.impl_;
+  pool_ = other.pool_;
+  handle_ = other.handle_;
   vertex_count_ = other.vertex_count_;
   index_count_ = other.index_count_;
+  index_type_ = other.index_type_;
+  vertex_format_ = other.vertex_format_;
+  dequant_ = other.dequant_;
+  bounds_ = other.bounds_;
+  std::copy(std::begin(other.lods_), std::end(other.lods_), std::begin(lods_));
+  lod_count_ = other.lod_count_;
 
   other.impl_ = nullptr;
+  other.pool_ = nullptr;
+  other.handle_ = GeometryPool::kInvalidHandle;
   other.vertex_count_ = 0;
   other.index_count_ = 0;
+  other.index_type_ = VK_INDEX_TYPE_UINT32;
+  other.vertex_format_ = VertexFormat::Float32;
+  other.dequant_ = PositionDequant{};
+  other.bounds_ = BoundingSphere{};
+  other.lod_count_ = 0;
 
   return *this;
 }
@@ -53,32 +100,113 @@ void Mesh::init_from_data(Context const& ctx,
                           Upload& uploader,
                           std::vector<Vertex> const& vertices,
                           std::vector<Index> const& indices) {
-  if (impl_ != nullptr) {
+  init_from_data(ctx, uploader, std::span<Vertex const>(vertices), std::span<Index const>(indices));
+}
+
+void Mesh::init_common(std::span<Vertex const> vertices,
+                       std::span<Index const> indices,
+                       VertexFormat format,
+                       std::span<MeshLod const> lods) {
+  if (impl_ != nullptr || pool_ != nullptr) {
     fail("Mesh::init_from_data called twice");
   }
   if (vertices.empty() || indices.empty()) {
     fail("Mesh::init_from_data: empty vertices/indices");
   }
+  if (lods.size() > kMaxLods) {
+    fail("Mesh::init_from_data: too many LOD levels");
+  }
+  for (MeshLod const& l : lods) {
+    if (l.index_count == 0U || l.first_index > indices.size() || l.index_count > indices.size() - l.first_index) {
+      fail("Mesh::init_from_data: LOD range outside the index buffer");
+    }
+  }
+
+  vertex_count_ = static_cast<std::uint32_t>(vertices.size());
+  index_count_ = static_cast<std::uint32_t>(indices.size());
+
+  if (lods.empty()) {
+    lods_[0] = MeshLod{0U, index_count_, 0.0f};
+    lod_count_ = 1;
+  } else {
+    std::copy(lods.begin(), lods.end(), std::begin(lods_));
+    lod_count_ = static_cast<std::uint32_t>(lods.size());
+  }
+
+  vertex_format_ = format;
+  dequant_ = PositionDequant{};
+  bounds_ = bounding_sphere(vertices);
+}
+
+void Mesh::init_from_data(Context const& ctx,
+                          Upload& uploader,
+                          std::span<Vertex const> vertices,
+                          std::span<Index const> indices,
+                          VertexFormat format,
+                          std::span<MeshLod const> lods) {
+  init_common(vertices, indices, format, lods);
 
   impl_ = new (std::nothrow) Impl();
   if (impl_ == nullptr) {
     fail("Mesh: allocation failed");
   }
 
-  vertex_count_ = static_cast<std::uint32_t>(vertices.size());
-  index_count_ = static_cast<std::uint32_t>(indices.size());
+  if (format == VertexFormat::Quantized) {
+    // Encoded copy only lives until it is in the staging ring.
+    std::vector<VertexQuantized> encoded;
+    dequant_ = quantize_vertices(vertices, encoded);
+    impl_->vb.init_device_local_with_staging(ctx,
+                                             uploader,
+                                             encoded.data(),
+                                             encoded.size() * sizeof(VertexQuantized),
+                                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  } else {
+    impl_->vb.init_device_local_with_staging(ctx,
+                                             uploader,
+                                             vertices.data(),
+                                             vertices.size() * sizeof(Vertex),
+                                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  }
 
-  impl_->vb.init_device_local_with_staging(ctx,
-                                           uploader,
-                                           vertices.data(),
-                                           vertices.size() * sizeof(Vertex),
-                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-
-  impl_->ib.init_device_local_with_staging(ctx,
-                                           uploader,
-                                           indices.data(),
-                                           indices.size() * sizeof(Index),
-                                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  if (vertices.size() <= (std::size_t{1} << 16)) {
+    // Half the index bandwidth; the narrowed copy only lives until it is staged.
+    std::vector<std::uint16_t> narrow(indices.size());
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      narrow[i] = static_cast<std::uint16_t>(indices[i]);
+    }
+    index_type_ = VK_INDEX_TYPE_UINT16;
+    impl_->ib.init_device_local_with_staging(ctx,
+                                             uploader,
+                                             narrow.data(),
+                                             narrow.size() * sizeof(std::uint16_t),
+                                             VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  } else {
+    index_type_ = VK_INDEX_TYPE_UINT32;
+    impl_->ib.init_device_local_with_staging(ctx,
+                                             uploader,
+                                             indices.data(),
+                                             indices.size() * sizeof(Index),
+                                             VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  }
+}
+
+void Mesh::init_from_data(Context const& ctx,
+                          Upload& uploader,
+                          GeometryPool& pool,
+                          std::span<Vertex const> vertices,
+                          std::span<Index const> indices,
+                          std::span<MeshLod const> lods) {
+  init_common(vertices, indices, pool.vertex_format(), lods);
+
+  if (vertex_format_ == VertexFormat::Quantized) {
+    std::vector<VertexQuantized> encoded;
+    dequant_ = quantize_vertices(vertices, encoded);
+    handle_ = pool.allocate(ctx, uploader, encoded.data(), vertex_count_, indices);
+  } else {
+    handle_ = pool.allocate(ctx, uploader, vertices.data(), vertex_count_, indices);
+  }
+  pool_ = &pool;
+  index_type_ = pool.index_type();
 }
 
 void Mesh::init_quad(Context const& ctx, Upload& uploader) {
@@ -98,23 +226,47 @@ void Mesh::init_quad(Context const& ctx, Upload& uploader) {
   init_from_data(ctx, uploader, v, idx);
 }
 
-void Mesh::shutdown(Context const& ctx) {
+void Mesh::shutdown(Context const& ctx, std::uint64_t serial) {
   if (impl_ != nullptr) {
     impl_->ib.shutdown(ctx);
     impl_->vb.shutdown(ctx);
     delete impl_;
     impl_ = nullptr;
   }
+  if (pool_ != nullptr) {
+    pool_->release(handle_, serial);
+    pool_ = nullptr;
+    handle_ = GeometryPool::kInvalidHandle;
+  }
   vertex_count_ = 0;
   index_count_ = 0;
+  index_type_ = VK_INDEX_TYPE_UINT32;
+  vertex_format_ = VertexFormat::Float32;
+  dequant_ = PositionDequant{};
+  bounds_ = BoundingSphere{};
+  lod_count_ = 0;
 }
 
 VkBuffer Mesh::vertex_buffer() const {
+  if (pool_ != nullptr) {
+    return pool_->vertex_buffer();
+  }
   return (impl_ != nullptr) ? impl_->vb.handle() : VK_NULL_HANDLE;
 }
 
 VkBuffer Mesh::index_buffer() const {
+  if (pool_ != nullptr) {
+    return pool_->index_buffer();
+  }
   return (impl_ != nullptr) ? impl_->ib.handle() : VK_NULL_HANDLE;
 }
 
+std::int32_t Mesh::vertex_offset() const {
+  return (pool_ != nullptr) ? pool_->range(handle_).vertex_offset : 0;
+}
+
+std::uint32_t Mesh::first_index() const {
+  return (pool_ != nullptr) ? pool_->range(handle_).first_index : 0U;
+}
+
 } // namespace gfx
@@ -2,58 +2,37 @@
 
 #include <vulkan/vulkan.h>
 
-#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <vector>
 
+#include "assets/ObjLoader.h"
+#include "gfx/Vertex.h"
+
 namespace gfx {
 
 class Context;
 class Buffer;
+class GeometryPool;
 class Upload;
 
-struct Vertex {
-  float pos[3];
-  float normal[3];
-  float uv[2];
-
-  static VkVertexInputBindingDescription binding_description() {
-    VkVertexInputBindingDescription b{};
-    b.binding = 0;
-    b.stride = static_cast<uint32_t>(sizeof(Vertex));
-    b.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    return b;
-  }
-
-  static void attribute_descriptions(VkVertexInputAttributeDescription out[3]) {
-    VkVertexInputAttributeDescription a0{};
-    a0.location = 0;
-    a0.binding = 0;
-    a0.format = VK_FORMAT_R32G32B32_SFLOAT;
-    a0.offset = static_cast<uint32_t>(offsetof(Vertex, pos));
-
-    VkVertexInputAttributeDescription a1{};
-    a1.location = 1;
-    a1.binding = 0;
-    a1.format = VK_FORMAT_R32G32B32_SFLOAT;
-    a1.offset = static_cast<uint32_t>(offsetof(Vertex, normal));
-
-    VkVertexInputAttributeDescription a2{};
-    a2.location = 2;
-    a2.binding = 0;
-    a2.format = VK_FORMAT_R32G32_SFLOAT;
-    a2.offset = static_cast<uint32_t>(offsetof(Vertex, uv));
-
-    out[0] = a0;
-    out[1] = a1;
-    out[2] = a2;
-  }
+// Object-space bounds of the source (unquantized) positions.
+struct BoundingSphere {
+  float center[3] = {0.0f, 0.0f, 0.0f};
+  float radius = 0.0f;
 };
 
+// One level of detail: a range of the mesh's index buffer over the shared
+// vertices, and how far (object space) it may deviate from level 0. The loader's
+// type, so LOD tables from build_lods() and the cache are passed as they are.
+using MeshLod = assets::MeshLod;
+
 class Mesh {
 public:
   using Index = std::uint32_t;
 
+  static constexpr std::uint32_t kMaxLods = 4;
+
 public:
   Mesh() = default;
   ~Mesh();
@@ -69,22 +48,80 @@ public:
                       std::vector<Vertex> const& vertices,
                       std::vector<Index> const& indices);
 
+  // Data is copied into the uploader's staging ring before this returns, so the
+  // spans may point into a mapped file or a buffer that is released right after.
+  // Quantized meshes are encoded here; draw them with a Quantized pipeline.
+  // `lods` index into `indices`, finest first; empty means one level covering
+  // every index.
+  void init_from_data(Context const& ctx,
+                      Upload& uploader,
+                      std::span<Vertex const> vertices,
+                      std::span<Index const> indices,
+                      VertexFormat format = VertexFormat::Float32,
+                      std::span<MeshLod const> lods = {});
+
+  // Same, but the data goes into `pool`, which must outlive the mesh and store
+  // `format`. The mesh is then a handle: draws bind the pool's buffers once and
+  // add vertex_offset() / first_index() to their ranges.
+  void init_from_data(Context const& ctx,
+                      Upload& uploader,
+                      GeometryPool& pool,
+                      std::span<Vertex const> vertices,
+                      std::span<Index const> indices,
+                      std::span<MeshLod const> lods = {});
+
   void init_quad(Context const& ctx, Upload& uploader);
-  void shutdown(Context const& ctx);
+  // Pooled meshes hand their ranges back under `serial`, the last frame that
+  // may draw them (Renderer::submitted_frames()); see GeometryPool::release.
+  void shutdown(Context const& ctx, std::uint64_t serial = 0);
 
+  // The pool's buffers for pooled meshes.
   VkBuffer vertex_buffer() const;
   VkBuffer index_buffer() const;
 
+  // Where the mesh starts in those buffers; 0 for standalone meshes. Looked up
+  // on each call, since pool compaction moves them.
+  std::int32_t vertex_offset() const;
+  std::uint32_t first_index() const;
+  GeometryPool const* pool() const { return pool_; }
+
   std::uint32_t vertex_count() const { return vertex_count_; }
   std::uint32_t index_count() const { return index_count_; }
-  VkIndexType index_type() const { return VK_INDEX_TYPE_UINT32; }
+  // Standalone: UINT16 whenever every vertex is addressable with 16 bits.
+  // Pooled: the pool's index type.
+  VkIndexType index_type() const { return index_type_; }
+
+  VertexFormat vertex_format() const { return vertex_format_; }
+  PositionDequant const& position_dequant() const { return dequant_; }
+  BoundingSphere const& bounds() const { return bounds_; }
+
+  std::uint32_t lod_count() const { return lod_count_; }
+  MeshLod const& lod(std::uint32_t level) const { return lods_[level]; }
+
+private:
+  // Validation and everything but the GPU data.
+  void init_common(std::span<Vertex const> vertices,
+                   std::span<Index const> indices,
+                   VertexFormat format,
+                   std::span<MeshLod const> lods);
 
 private:
   struct Impl;
   Impl* impl_ = nullptr;
 
+  GeometryPool* pool_ = nullptr; // not owned
+  std::uint32_t handle_ = UINT32_MAX;
+
   std::uint32_t vertex_count_ = 0;
   std::uint32_t index_count_ = 0;
+  VkIndexType index_type_ = VK_INDEX_TYPE_UINT32;
+
+  VertexFormat vertex_format_ = VertexFormat::Float32;
+  PositionDequant dequant_{};
+  BoundingSphere bounds_{};
+
+  MeshLod lods_[kMaxLods]{};
+  std::uint32_t lod_count_ = 0;
 };
 
 } // namespace gfx
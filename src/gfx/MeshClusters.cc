@@ -0,0 +1,80 @@
+#include "gfx/MeshClusters.h"
+
+#include "math/Frustum.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+float determinant3(glm::mat4 const& m) {
+  return m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2])
+       - m[1][0] * (m[0][1] * m[2][2] - m[2][1] * m[0][2])
+       + m[2][0] * (m[0][1] * m[1][2] - m[1][1] * m[0][2]);
+}
+
+} // namespace
+
+void MeshClusters::clear() {
+  ranges_.clear();
+  spheres_.clear();
+  cones_.clear();
+  visible_.clear();
+}
+
+void MeshClusters::add(IndexRange range,
+                       glm::vec3 const& center,
+                       float radius,
+                       glm::vec3 const& cone_axis,
+                       float cone_cutoff) {
+  ranges_.push_back(range);
+  spheres_.push_back(center, radius);
+  cones_.push_back(glm::vec4(cone_axis.x, cone_axis.y, cone_axis.z, cone_cutoff));
+}
+
+void MeshClusters::cull(glm::mat4 const& view_proj,
+                        glm::mat4 const& model,
+                        glm::vec3 const& eye,
+                        std::vector<IndexRange>& out) {
+  out.clear();
+  if (ranges_.empty()) {
+    return;
+  }
+
+  // Planes extracted from view_proj * model are the frustum in object space.
+  math::cull_spheres(math::Frustum::from_view_proj(view_proj * model), spheres_, visible_);
+
+  // Back-facing is affine invariant, so the cone test also runs in object space.
+  // A mirroring model flips the winding; skip the test rather than invert it.
+  bool const cones = determinant3(model) > 0.0f;
+  glm::vec4 const e = glm::inverse(model) * glm::vec4(eye, 1.0f);
+  glm::vec3 const local_eye(e.x, e.y, e.z);
+
+  for (std::size_t i = 0; i < ranges_.size(); ++i) {
+    if (!math::is_visible(visible_, i)) {
+      continue;
+    }
+
+    if (cones) {
+      glm::vec4 const& cone = cones_[i];
+      glm::vec3 const d(spheres_.x[i] - local_eye.x, spheres_.y[i] - local_eye.y, spheres_.z[i] - local_eye.z);
+      float const len = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+      if (d.x * cone.x + d.y * cone.y + d.z * cone.z >= cone.w * len + spheres_.r[i]) {
+        continue;
+      }
+    }
+
+    IndexRange const& r = ranges_[i];
+    if (!out.empty() && out.back().first_index + out.back().index_count == r.first_index) {
+      out.back().index_count += r.index_count;
+    } else {
+      out.push_back(r);
+    }
+  }
+}
+
+} // namespace gfx
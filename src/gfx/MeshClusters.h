@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "gfx/DrawList.h"
+#include "math/Cull.h"
+
+namespace gfx {
+
+// CPU culling data for the clusters of one mesh, in object space: the bounding
+// sphere and normal cone of each contiguous index range (see assets::Meshlet).
+class MeshClusters {
+public:
+  void clear();
+  void add(IndexRange range,
+           glm::vec3 const& center,
+           float radius,
+           glm::vec3 const& cone_axis,
+           float cone_cutoff);
+
+  std::size_t size() const { return ranges_.size(); }
+
+  // Ranges of the clusters of an instance placed by `model` that may be visible
+  // to a camera at `eye` with `view_proj`. Tests run in object space, so nothing
+  // is transformed per cluster; surviving neighbours are merged into one range.
+  void cull(glm::mat4 const& view_proj,
+            glm::mat4 const& model,
+            glm::vec3 const& eye,
+            std::vector<IndexRange>& out);
+
+private:
+  std::vector<IndexRange> ranges_;
+  math::SphereSoA spheres_{};
+  std::vector<glm::vec4> cones_; // xyz axis, w cutoff
+  std::vector<std::uint64_t> visible_; // scratch
+};
+
+} // namespace gfx
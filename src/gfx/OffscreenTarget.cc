@@ -0,0 +1,186 @@
+#include "gfx/OffscreenTarget.h"
+
+#include "gfx/Context.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+std::size_t texel_size(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+      return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return 8;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return 16;
+    default:
+      fail("OffscreenTarget: unsupported color format " + std::to_string(static_cast<int>(format)));
+  }
+}
+
+// The CPU reads every byte of a readback; uncached memory makes that crawl, so
+// prefer a cached type among those the buffer allows.
+AllocationCreateInfo readback_memory() {
+  AllocationCreateInfo a{};
+  a.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  a.preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  return a;
+}
+
+} // namespace
+
+OffscreenTarget::~OffscreenTarget() {
+}
+
+OffscreenTarget::OffscreenTarget(OffscreenTarget&& other) noexcept {
+  *this = std::move(other);
+}
+
+OffscreenTarget& OffscreenTarget::operator=(OffscreenTarget&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  config_ = other.config_;
+  row_pitch_ = other.row_pitch_;
+  color_ = std::move(other.color_);
+  images_ = std::move(other.images_);
+  image_views_ = std::move(other.image_views_);
+  readback_ = std::move(other.readback_);
+  pending_ = std::move(other.pending_);
+  on_readback_ = std::move(other.on_readback_);
+
+  other.config_ = OffscreenConfig{};
+  other.row_pitch_ = 0;
+  other.color_.clear();
+  other.images_.clear();
+  other.image_views_.clear();
+  other.readback_.clear();
+  other.pending_.clear();
+  other.on_readback_ = nullptr;
+
+  return *this;
+}
+
+void OffscreenTarget::init(Context const& ctx, OffscreenConfig const& config) {
+  if (!color_.empty()) {
+    fail("OffscreenTarget::init called twice");
+  }
+  if (config.image_count == 0U) {
+    fail("OffscreenTarget::init: image_count == 0");
+  }
+
+  VkFormatProperties props{};
+  vkGetPhysicalDeviceFormatProperties(ctx.physical_device(), config.color_format, &props);
+  VkFormatFeatureFlags const needed = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+    (config.readback ? VK_FORMAT_FEATURE_TRANSFER_SRC_BIT : 0U);
+  if ((props.optimalTilingFeatures & needed) != needed) {
+    fail("OffscreenTarget: color format cannot be rendered to (or copied from) on this device");
+  }
+
+  config_ = config;
+  row_pitch_ = static_cast<std::size_t>(config.extent.width) * texel_size(config.color_format);
+
+  VkImageUsageFlags const usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+    (config.readback ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0U);
+
+  color_.resize(config.image_count);
+  for (Image& image : color_) {
+    image.init_2d(ctx, config.extent, config.color_format, usage, VK_IMAGE_ASPECT_COLOR_BIT);
+    images_.push_back(image.image());
+    image_views_.push_back(image.view());
+  }
+
+  pending_.assign(config.image_count, 0U);
+  if (config.readback) {
+    AllocationCreateInfo const memory = readback_memory();
+    readback_.resize(config.image_count);
+    for (Buffer& b : readback_) {
+      b.init(ctx, static_cast<VkDeviceSize>(row_pitch_) * config.extent.height, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory);
+    }
+  }
+}
+
+void OffscreenTarget::shutdown(Context const& ctx) {
+  for (Buffer& b : readback_) {
+    b.shutdown(ctx);
+  }
+  for (Image& image : color_) {
+    image.shutdown(ctx);
+  }
+  readback_.clear();
+  color_.clear();
+  images_.clear();
+  image_views_.clear();
+  pending_.clear();
+  row_pitch_ = 0;
+  config_ = OffscreenConfig{};
+}
+
+void OffscreenTarget::record_readback(VkCommandBuffer cb, std::uint32_t image, std::uint64_t frame) {
+  if (!config_.readback) {
+    return;
+  }
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0; // tightly packed
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = VkExtent3D{config_.extent.width, config_.extent.height, 1};
+
+  Buffer const& dst = readback_.at(image);
+  vkCmdCopyImageToBuffer(cb, images_.at(image), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.handle(), 1, &region);
+
+  // The fence alone does not make the copy visible to host reads.
+  VkBufferMemoryBarrier b{};
+  b.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  b.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  b.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  b.buffer = dst.handle();
+  b.offset = 0;
+  b.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &b, 0, nullptr);
+
+  pending_.at(image) = frame;
+}
+
+void OffscreenTarget::complete(std::uint32_t image) {
+  std::uint64_t& frame = pending_.at(image);
+  if (frame == 0U) {
+    return;
+  }
+
+  if (on_readback_) {
+    Readback r{};
+    r.pixels = readback_.at(image).mapped();
+    r.row_pitch = row_pitch_;
+    r.extent = config_.extent;
+    r.format = config_.color_format;
+    r.frame = frame;
+    on_readback_(r);
+  }
+  frame = 0;
+}
+
+} // namespace gfx
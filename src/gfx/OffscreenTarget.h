@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "gfx/Buffer.h"
+#include "gfx/Image.h"
+
+namespace gfx {
+
+class Context;
+
+struct OffscreenConfig {
+  VkExtent2D extent{1280, 720};
+  VkFormat color_format = VK_FORMAT_R8G8B8A8_UNORM;
+  // One color image, and readback buffer, per frame in flight; must be at
+  // least Renderer::frames_in_flight().
+  std::uint32_t image_count = 2;
+  bool readback = true; // copy every frame to host memory
+};
+
+// A rendered frame in host memory. Rows are tightly packed; `pixels` is only
+// valid for the duration of the readback handler.
+struct Readback {
+  void const* pixels = nullptr;
+  std::size_t row_pitch = 0;
+  VkExtent2D extent{};
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  std::uint64_t frame = 0; // the renderer's frame number, from 1
+};
+
+// Color images rendered without a swapchain, for benchmarks and batch
+// rendering on machines without a display (see Context::init(info)). The
+// Renderer draws frame slot i into image i, so frames never wait on anything
+// but their own slot's fence.
+//
+// With readback, every frame ends with a copy into its slot's host-visible
+// buffer. The copy is handed to the readback handler once the slot's fence has
+// signalled, i.e. when the renderer comes back to the slot or in
+// Renderer::finish(): with two frames in flight the host reads frame N while
+// the GPU renders N + 1, and nothing stalls on the transfer.
+class OffscreenTarget {
+public:
+  using ReadbackFn = std::function<void(Readback const&)>;
+
+public:
+  OffscreenTarget() = default;
+  ~OffscreenTarget();
+
+  OffscreenTarget(OffscreenTarget const&) = delete;
+  OffscreenTarget& operator=(OffscreenTarget const&) = delete;
+
+  OffscreenTarget(OffscreenTarget&& other) noexcept;
+  OffscreenTarget& operator=(OffscreenTarget&& other) noexcept;
+
+  void init(Context const& ctx, OffscreenConfig const& config = {});
+  void shutdown(Context const& ctx);
+
+  // Runs on the thread calling Renderer::draw_frame(). Without a handler
+  // readbacks are still copied, then dropped.
+  void set_readback_handler(ReadbackFn handler) { on_readback_ = std::move(handler); }
+
+  OffscreenConfig const& config() const { return config_; }
+  VkFormat color_format() const { return config_.color_format; }
+  VkExtent2D extent() const { return config_.extent; }
+  std::uint32_t image_count() const { return static_cast<std::uint32_t>(images_.size()); }
+  bool readback() const { return config_.readback; }
+
+  std::vector<VkImage> const& images() const { return images_; }
+  std::vector<VkImageView> const& image_views() const { return image_views_; }
+
+  // For the Renderer. record_readback() copies `image`, which must be in
+  // TRANSFER_SRC_OPTIMAL, into its buffer as frame `frame`; complete() passes
+  // the last such copy to the handler once the GPU is done with it.
+  void record_readback(VkCommandBuffer cb, std::uint32_t image, std::uint64_t frame);
+  void complete(std::uint32_t image);
+
+private:
+  OffscreenConfig config_{};
+  std::size_t row_pitch_ = 0;
+
+  std::vector<Image> color_;
+  std::vector<VkImage> images_;
+  std::vector<VkImageView> image_views_;
+
+  std::vector<Buffer> readback_;           // per image, empty without readback
+  std::vector<std::uint64_t> pending_;     // per image: frame in the buffer, 0 for none
+
+  ReadbackFn on_readback_;
+};
+
+} // namespace gfx
@@ -1,12 +1,15 @@
 #include "gfx/Pipeline.h"
 
 #include "gfx/Context.h"
+#include "gfx/Depth.h"
 #include "gfx/Mesh.h"
+#include "gfx/Shader.h"
+#include "gfx/OffscreenTarget.h"
 #include "gfx/Swapchain.h"
 
 #include <cstddef>
 #include <cstdint>
-#include <fstream>
+#include <functional>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -25,28 +28,6 @@ void vk_check(VkResult r, char const* what) {
   }
 }
 
-std::vector<std::uint32_t> read_spirv(std::string const& path) {
-  std::ifstream ifs(path, std::ios::binary | std::ios::ate);
-  if (!ifs) {
-    fail(std::string("Failed to open SPIR-V file: ") + path);
-  }
-
-  std::streamsize const size = ifs.tellg();
-  if (size <= 0) {
-    fail(std::string("SPIR-V file is empty: ") + path);
-  }
-  if ((size % 4) != 0) {
-    fail(std::string("SPIR-V file size is not multiple of 4: ") + path);
-  }
-
-  std::vector<std::uint32_t> data(static_cast<std::size_t>(size / 4));
-  ifs.seekg(0, std::ios::beg);
-  if (!ifs.read(reinterpret_cast<char*>(data.data()), size)) {
-    fail(std::string("Failed to read SPIR-V file: ") + path);
-  }
-  return data;
-}
-
 } // namespace
 
 Pipeline::~Pipeline() {
@@ -61,85 +42,51 @@ Pipeline& Pipeline::operator=(Pipeline&& other) noexcept {
     return *this;
   }
 
-  render_pass_ = other.render_pass_;
+  target_ = other.target_;
+  frame_set_layout_ = other.frame_set_layout_;
+  material_set_layout_ = other.material_set_layout_;
   pipeline_layout_ = other.pipeline_layout_;
   pipeline_ = other.pipeline_;
+  state_ = std::move(other.state_);
 
-  other.render_pass_ = VK_NULL_HANDLE;
+  other.target_ = PipelineTarget{};
+  other.frame_set_layout_ = VK_NULL_HANDLE;
+  other.material_set_layout_ = VK_NULL_HANDLE;
   other.pipeline_layout_ = VK_NULL_HANDLE;
   other.pipeline_ = VK_NULL_HANDLE;
+  other.state_ = PipelineState{};
 
   return *this;
 }
 
-void Pipeline::init(Context const& ctx,
-                    Swapchain const& sc,
-                    VkFormat depth_format,
-                    std::string const& vert_spv_path,
-                    std::string const& frag_spv_path) {
-  // ---- Render pass (color + depth) ----
-  VkAttachmentDescription attachments[2]{};
-
-  attachments[0].format = sc.image_format();
-  attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-  attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  attachments[1].format = depth_format;
-  attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-  attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  VkAttachmentReference color_ref{};
-  color_ref.attachment = 0;
-  color_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  VkAttachmentReference depth_ref{};
-  depth_ref.attachment = 1;
-  depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass{};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &color_ref;
-  subpass.pDepthStencilAttachment = &depth_ref;
-
-  VkSubpassDependency dep{};
-  dep.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dep.dstSubpass = 0;
-  dep.srcStageMask =
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-    | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dep.dstStageMask =
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-    | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dep.srcAccessMask = 0;
-  dep.dstAccessMask =
-      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
-    | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-  VkRenderPassCreateInfo rpci{};
-  rpci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  rpci.attachmentCount = 2;
-  rpci.pAttachments = attachments;
-  rpci.subpassCount = 1;
-  rpci.pSubpasses = &subpass;
-  rpci.dependencyCount = 1;
-  rpci.pDependencies = &dep;
-
-  vk_check(vkCreateRenderPass(ctx.device(), &rpci, nullptr, &render_pass_), "vkCreateRenderPass");
+std::size_t PipelineStateHash::operator()(PipelineState const& s) const {
+  std::size_t h = std::hash<std::string>{}(s.vert_spv_path);
+  auto mix = [&h](std::size_t v) { h ^= v + static_cast<std::size_t>(0x9e3779b97f4a7c15ULL) + (h << 6) + (h >> 2); };
+  mix(std::hash<std::string>{}(s.frag_spv_path));
+  mix(static_cast<std::size_t>(s.vertex_format));
+  mix(static_cast<std::size_t>(s.cull_mode));
+  mix(static_cast<std::size_t>(s.polygon_mode));
+  mix(static_cast<std::size_t>(s.blend));
+  mix(static_cast<std::size_t>(s.depth_compare));
+  mix(s.depth_write ? 1U : 0U);
+  return h;
+}
 
+VkPipeline create_graphics_pipeline(Context const& ctx,
+                                    PipelineState const& state,
+                                    PipelineTarget const& target,
+                                    VkPipelineLayout layout,
+                                    VkPipeline parent,
+                                    VkPipelineCreateFlags flags) {
   // ---- Shader modules ----
-  VkShaderModule vert = create_shader_module(ctx, vert_spv_path);
-  VkShaderModule frag = create_shader_module(ctx, frag_spv_path);
+  VkShaderModule vert = create_shader_module(ctx, state.vert_spv_path);
+  VkShaderModule frag = VK_NULL_HANDLE;
+  try {
+    frag = create_shader_module(ctx, state.frag_spv_path);
+  } catch (...) {
+    vkDestroyShaderModule(ctx.device(), vert, nullptr);
+    throw;
+  }
 
   VkPipelineShaderStageCreateInfo stages[2]{};
   stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -152,16 +99,30 @@ void Pipeline::init(Context const& ctx,
   stages[1].module = frag;
   stages[1].pName = "main";
 
-  // ---- Vertex input (pos, normal, uv) ----
-  VkVertexInputBindingDescription binding = Vertex::binding_description();
-  VkVertexInputAttributeDescription attrs[3]{};
-  Vertex::attribute_descriptions(attrs);
+  // ---- Vertex input (pos, normal, uv; per-instance model matrix) ----
+  VkVertexInputBindingDescription bindings[2]{};
+  VkVertexInputAttributeDescription attrs[7]{};
+  bindings[0] = vertex_binding_description(state.vertex_format);
+  vertex_attribute_descriptions(state.vertex_format, attrs);
+
+  bindings[1].binding = kInstanceBinding;
+  bindings[1].stride = 16u * static_cast<uint32_t>(sizeof(float));
+  bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  // mat4 input occupies locations 3..6, one column each
+  for (std::uint32_t c = 0; c < 4U; ++c) {
+    VkVertexInputAttributeDescription& a = attrs[3U + c];
+    a.location = 3U + c;
+    a.binding = kInstanceBinding;
+    a.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    a.offset = c * 4u * static_cast<uint32_t>(sizeof(float));
+  }
 
   VkPipelineVertexInputStateCreateInfo vi{};
   vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vi.vertexBindingDescriptionCount = 1;
-  vi.pVertexBindingDescriptions = &binding;
-  vi.vertexAttributeDescriptionCount = 3;
+  vi.vertexBindingDescriptionCount = 2;
+  vi.pVertexBindingDescriptions = bindings;
+  vi.vertexAttributeDescriptionCount = 7;
   vi.pVertexAttributeDescriptions = attrs;
 
   VkPipelineInputAssemblyStateCreateInfo ia{};
@@ -178,8 +139,8 @@ void Pipeline::init(Context const& ctx,
   rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
   rs.depthClampEnable = VK_FALSE;
   rs.rasterizerDiscardEnable = VK_FALSE;
-  rs.polygonMode = VK_POLYGON_MODE_FILL;
-  rs.cullMode = VK_CULL_MODE_BACK_BIT;
+  rs.polygonMode = state.polygon_mode;
+  rs.cullMode = state.cull_mode;
   rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
   rs.depthBiasEnable = VK_FALSE;
   rs.lineWidth = 1.0f;
@@ -191,8 +152,8 @@ void Pipeline::init(Context const& ctx,
   VkPipelineDepthStencilStateCreateInfo ds_depth{};
   ds_depth.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
   ds_depth.depthTestEnable = VK_TRUE;
-  ds_depth.depthWriteEnable = VK_TRUE;
-  ds_depth.depthCompareOp = VK_COMPARE_OP_LESS;
+  ds_depth.depthWriteEnable = state.depth_write ? VK_TRUE : VK_FALSE;
+  ds_depth.depthCompareOp = state.depth_compare;
   ds_depth.depthBoundsTestEnable = VK_FALSE;
   ds_depth.stencilTestEnable = VK_FALSE;
 
@@ -202,7 +163,15 @@ void Pipeline::init(Context const& ctx,
     | VK_COLOR_COMPONENT_G_BIT
     | VK_COLOR_COMPONENT_B_BIT
     | VK_COLOR_COMPONENT_A_BIT;
-  cb_att.blendEnable = VK_FALSE;
+  cb_att.blendEnable = (state.blend != BlendMode::Opaque) ? VK_TRUE : VK_FALSE;
+  cb_att.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  cb_att.dstColorBlendFactor =
+      (state.blend == BlendMode::Additive) ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  cb_att.colorBlendOp = VK_BLEND_OP_ADD;
+  cb_att.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  cb_att.dstAlphaBlendFactor =
+      (state.blend == BlendMode::Additive) ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  cb_att.alphaBlendOp = VK_BLEND_OP_ADD;
 
   VkPipelineColorBlendStateCreateInfo cb{};
   cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -216,18 +185,6 @@ void Pipeline::init(Context const& ctx,
   ds.dynamicStateCount = static_cast<uint32_t>(sizeof(dynamics) / sizeof(dynamics[0]));
   ds.pDynamicStates = dynamics;
 
-  VkPushConstantRange pcr{};
-  pcr.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  pcr.offset = 0;
-  pcr.size = 16u * static_cast<uint32_t>(sizeof(float)); // mat4
-
-  VkPipelineLayoutCreateInfo plci{};
-  plci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  plci.pushConstantRangeCount = 1;
-  plci.pPushConstantRanges = &pcr;
-
-  vk_check(vkCreatePipelineLayout(ctx.device(), &plci, nullptr, &pipeline_layout_), "vkCreatePipelineLayout");
-
   VkGraphicsPipelineCreateInfo gpci{};
   gpci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
   gpci.stageCount = 2;
@@ -240,15 +197,170 @@ void Pipeline::init(Context const& ctx,
   gpci.pDepthStencilState = &ds_depth;
   gpci.pColorBlendState = &cb;
   gpci.pDynamicState = &ds;
-  gpci.layout = pipeline_layout_;
-  gpci.renderPass = render_pass_;
+  gpci.layout = layout;
+  gpci.renderPass = target.render_pass;
   gpci.subpass = 0;
 
-  vk_check(vkCreateGraphicsPipelines(ctx.device(), VK_NULL_HANDLE, 1, &gpci, nullptr, &pipeline_),
-           "vkCreateGraphicsPipelines");
+  VkPipelineRenderingCreateInfoKHR rendering{};
+  if (target.render_pass == VK_NULL_HANDLE) {
+    rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    rendering.colorAttachmentCount = 1;
+    rendering.pColorAttachmentFormats = &target.color_format;
+    rendering.depthAttachmentFormat = target.depth_format;
+    rendering.stencilAttachmentFormat = format_has_stencil(target.depth_format) ? target.depth_format : VK_FORMAT_UNDEFINED;
+    gpci.pNext = &rendering;
+  }
+  gpci.flags = flags;
+  if (parent != VK_NULL_HANDLE) {
+    gpci.flags |= VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+    gpci.basePipelineHandle = parent;
+    gpci.basePipelineIndex = -1;
+  }
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult const r = vkCreateGraphicsPipelines(ctx.device(), ctx.pipeline_cache(), 1, &gpci, nullptr, &pipeline);
 
   vkDestroyShaderModule(ctx.device(), frag, nullptr);
   vkDestroyShaderModule(ctx.device(), vert, nullptr);
+
+  vk_check(r, "vkCreateGraphicsPipelines");
+  return pipeline;
+}
+
+void Pipeline::init(Context const& ctx,
+                    Swapchain const& sc,
+                    VkFormat depth_format,
+                    std::string const& vert_spv_path,
+                    std::string const& frag_spv_path,
+                    VertexFormat vertex_format) {
+  PipelineState state{};
+  state.vert_spv_path = vert_spv_path;
+  state.frag_spv_path = frag_spv_path;
+  state.vertex_format = vertex_format;
+  init(ctx, sc, depth_format, state);
+}
+
+void Pipeline::init(Context const& ctx, Swapchain const& sc, VkFormat depth_format, PipelineState const& state) {
+  init(ctx, sc.image_format(), depth_format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, state);
+}
+
+void Pipeline::init(Context const& ctx, OffscreenTarget const& target, VkFormat depth_format, PipelineState const& state) {
+  init(ctx, target.color_format(), depth_format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, state);
+}
+
+void Pipeline::init(Context const& ctx,
+                    VkFormat color_format,
+                    VkFormat depth_format,
+                    VkImageLayout color_final_layout,
+                    PipelineState const& state) {
+  state_ = state;
+  target_.color_format = color_format;
+  target_.depth_format = depth_format;
+
+  if (!ctx.supports_dynamic_rendering()) {
+    create_render_pass(ctx, color_final_layout);
+  }
+
+  VkDescriptorSetLayoutBinding globals{};
+  globals.binding = 0;
+  globals.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  globals.descriptorCount = 1;
+  globals.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+  VkDescriptorSetLayoutCreateInfo dslci{};
+  dslci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  dslci.bindingCount = 1;
+  dslci.pBindings = &globals;
+
+  vk_check(vkCreateDescriptorSetLayout(ctx.device(), &dslci, nullptr, &frame_set_layout_),
+           "vkCreateDescriptorSetLayout");
+
+  VkDescriptorSetLayoutBinding base_color{};
+  base_color.binding = 0;
+  base_color.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  base_color.descriptorCount = 1;
+  base_color.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  dslci.pBindings = &base_color;
+  vk_check(vkCreateDescriptorSetLayout(ctx.device(), &dslci, nullptr, &material_set_layout_),
+           "vkCreateDescriptorSetLayout(material)");
+
+  VkDescriptorSetLayout const set_layouts[] = {frame_set_layout_, material_set_layout_};
+
+  VkPipelineLayoutCreateInfo plci{};
+  plci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  plci.setLayoutCount = 2;
+  plci.pSetLayouts = set_layouts;
+
+  vk_check(vkCreatePipelineLayout(ctx.device(), &plci, nullptr, &pipeline_layout_), "vkCreatePipelineLayout");
+
+  pipeline_ = create_graphics_pipeline(ctx,
+                                       state_,
+                                       target_,
+                                       pipeline_layout_,
+                                       VK_NULL_HANDLE,
+                                       VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT);
+}
+
+void Pipeline::create_render_pass(Context const& ctx, VkImageLayout color_final_layout) {
+  VkAttachmentDescription attachments[2]{};
+
+  attachments[0].format = target_.color_format;
+  attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[0].finalLayout = color_final_layout;
+
+  attachments[1].format = target_.depth_format;
+  attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference color_ref{};
+  color_ref.attachment = 0;
+  color_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depth_ref{};
+  depth_ref.attachment = 1;
+  depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &color_ref;
+  subpass.pDepthStencilAttachment = &depth_ref;
+
+  VkSubpassDependency dep{};
+  dep.srcSubpass = VK_SUBPASS_EXTERNAL;
+  dep.dstSubpass = 0;
+  dep.srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+    | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dep.dstStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+    | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dep.srcAccessMask = 0;
+  dep.dstAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+    | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  VkRenderPassCreateInfo rpci{};
+  rpci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  rpci.attachmentCount = 2;
+  rpci.pAttachments = attachments;
+  rpci.subpassCount = 1;
+  rpci.pSubpasses = &subpass;
+  rpci.dependencyCount = 1;
+  rpci.pDependencies = &dep;
+
+  vk_check(vkCreateRenderPass(ctx.device(), &rpci, nullptr, &target_.render_pass), "vkCreateRenderPass");
 }
 
 void Pipeline::shutdown(Context const& ctx) {
@@ -260,23 +372,18 @@ void Pipeline::shutdown(Context const& ctx) {
     vkDestroyPipelineLayout(ctx.device(), pipeline_layout_, nullptr);
     pipeline_layout_ = VK_NULL_HANDLE;
   }
-  if (render_pass_ != VK_NULL_HANDLE) {
-    vkDestroyRenderPass(ctx.device(), render_pass_, nullptr);
-    render_pass_ = VK_NULL_HANDLE;
+  if (frame_set_layout_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(ctx.device(), frame_set_layout_, nullptr);
+    frame_set_layout_ = VK_NULL_HANDLE;
   }
-}
-
-VkShaderModule Pipeline::create_shader_module(Context const& ctx, std::string const& path) {
-  auto const code = read_spirv(path);
-
-  VkShaderModuleCreateInfo ci{};
-  ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  ci.codeSize = code.size() * sizeof(std::uint32_t);
-  ci.pCode = code.data();
-
-  VkShaderModule m = VK_NULL_HANDLE;
-  vk_check(vkCreateShaderModule(ctx.device(), &ci, nullptr, &m), "vkCreateShaderModule");
-  return m;
+  if (material_set_layout_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(ctx.device(), material_set_layout_, nullptr);
+    material_set_layout_ = VK_NULL_HANDLE;
+  }
+  if (target_.render_pass != VK_NULL_HANDLE) {
+    vkDestroyRenderPass(ctx.device(), target_.render_pass, nullptr);
+  }
+  target_ = PipelineTarget{};
 }
 
 } // namespace gfx
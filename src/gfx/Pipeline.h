@@ -2,13 +2,71 @@
 
 #include <vulkan/vulkan.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
+#include "gfx/Vertex.h"
+
 namespace gfx {
 
 class Context;
+class OffscreenTarget;
 class Swapchain;
 
+// Binding 0 is the mesh's vertex buffer; binding 1 carries one model matrix per
+// instance (locations 3..6).
+constexpr std::uint32_t kInstanceBinding = 1;
+
+// set 0, binding 0: FrameGlobals uniform (view_proj), written once per frame.
+// A dynamic uniform buffer: the renderer binds each frame's ring slice by offset.
+struct FrameGlobals {
+  float view_proj[16];
+};
+
+enum class BlendMode : std::uint8_t {
+  Opaque,
+  Alpha,    // src * a + dst * (1 - a)
+  Additive, // src * a + dst
+};
+
+// Everything that tells one mesh pipeline from another. All of them share the
+// render pass and pipeline layout of the Pipeline they are built against.
+struct PipelineState {
+  std::string vert_spv_path;
+  std::string frag_spv_path;
+  VertexFormat vertex_format = VertexFormat::Float32; // the vertex shader must consume it
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL; // LINE / POINT need fillModeNonSolid
+  BlendMode blend = BlendMode::Opaque;
+  VkCompareOp depth_compare = VK_COMPARE_OP_LESS;
+  bool depth_write = true;
+
+  bool operator==(PipelineState const&) const = default;
+};
+
+struct PipelineStateHash {
+  std::size_t operator()(PipelineState const& s) const;
+};
+
+// What a pipeline draws into: a render pass, or with dynamic rendering only the
+// attachment formats.
+struct PipelineTarget {
+  VkRenderPass render_pass = VK_NULL_HANDLE; // VK_NULL_HANDLE: dynamic rendering
+  VkFormat color_format = VK_FORMAT_UNDEFINED;
+  VkFormat depth_format = VK_FORMAT_UNDEFINED;
+};
+
+// Compiles `state` against `target` / `layout`. With `parent` set the result
+// is a derivative of it (the parent must allow derivatives). Safe to call from
+// several threads at once; uses the context's pipeline cache.
+VkPipeline create_graphics_pipeline(Context const& ctx,
+                                    PipelineState const& state,
+                                    PipelineTarget const& target,
+                                    VkPipelineLayout layout,
+                                    VkPipeline parent = VK_NULL_HANDLE,
+                                    VkPipelineCreateFlags flags = 0);
+
 class Pipeline {
 public:
   Pipeline() = default;
@@ -20,26 +78,55 @@ public:
   Pipeline(Pipeline&& other) noexcept;
   Pipeline& operator=(Pipeline&& other) noexcept;
 
-  // vert/frag are SPIR-V paths.
+  // vert/frag are SPIR-V paths. The vertex shader must consume `vertex_format`.
   void init(Context const& ctx,
             Swapchain const& sc,
             VkFormat depth_format,
             std::string const& vert_spv_path,
-            std::string const& frag_spv_path);
+            std::string const& frag_spv_path,
+            VertexFormat vertex_format = VertexFormat::Float32);
+
+  // The pipeline allows derivatives, so PipelineRegistry variants can use it as
+  // their parent. With Context::supports_dynamic_rendering() no render pass is
+  // created and the pipeline targets the swapchain and depth formats directly.
+  void init(Context const& ctx, Swapchain const& sc, VkFormat depth_format, PipelineState const& state);
+
+  // Renders into `target`'s color format; the render pass, when there is one,
+  // leaves the color attachment in COLOR_ATTACHMENT_OPTIMAL instead of
+  // PRESENT_SRC, which a headless context cannot use.
+  void init(Context const& ctx, OffscreenTarget const& target, VkFormat depth_format, PipelineState const& state);
 
   void shutdown(Context const& ctx);
 
-  VkRenderPass render_pass() const { return render_pass_; }
+  // VK_NULL_HANDLE with dynamic rendering.
+  VkRenderPass render_pass() const { return target_.render_pass; }
+  PipelineTarget const& target() const { return target_; }
+  bool dynamic_rendering() const { return target_.render_pass == VK_NULL_HANDLE; }
+
   VkPipeline pipeline() const { return pipeline_; }
   VkPipelineLayout pipeline_layout() const { return pipeline_layout_; }
+  // Set 0: FrameGlobals. Set 1: the material, binding 0 the base color
+  // texture (TextureStreamer sets, or the renderer's white default).
+  VkDescriptorSetLayout frame_set_layout() const { return frame_set_layout_; }
+  VkDescriptorSetLayout material_set_layout() const { return material_set_layout_; }
+  VertexFormat vertex_format() const { return state_.vertex_format; }
+  PipelineState const& state() const { return state_; }
 
 private:
-  VkShaderModule create_shader_module(Context const& ctx, std::string const& path);
+  void init(Context const& ctx,
+            VkFormat color_format,
+            VkFormat depth_format,
+            VkImageLayout color_final_layout,
+            PipelineState const& state);
+  void create_render_pass(Context const& ctx, VkImageLayout color_final_layout);
 
 private:
-  VkRenderPass render_pass_ = VK_NULL_HANDLE;
+  PipelineTarget target_{};
+  VkDescriptorSetLayout frame_set_layout_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout material_set_layout_ = VK_NULL_HANDLE;
   VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
   VkPipeline pipeline_ = VK_NULL_HANDLE;
+  PipelineState state_{};
 };
 
 } // namespace gfx
@@ -0,0 +1,227 @@
+#include "gfx/PipelineCache.h"
+
+#include "gfx/Context.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+constexpr std::uint32_t kMagic = 0x31435047U; // "GPC1"
+constexpr std::uint32_t kVersion = 1;
+
+struct FileHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t vendor_id;
+  std::uint32_t device_id;
+  std::uint32_t driver_version;
+  std::uint8_t uuid[VK_UUID_SIZE];
+  std::uint32_t pad;
+  std::uint64_t data_size;
+  std::uint64_t data_hash;
+};
+
+static_assert(sizeof(FileHeader) == 56, "FileHeader layout changed; bump kVersion");
+
+std::uint64_t fnv1a(std::uint8_t const* data, std::size_t size) {
+  std::uint64_t h = 0xcbf29ce484222325ULL;
+  for (std::size_t i = 0; i < size; ++i) {
+    h ^= data[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+FileHeader header_for(VkPhysicalDeviceProperties const& props) {
+  FileHeader h{};
+  h.magic = kMagic;
+  h.version = kVersion;
+  h.vendor_id = props.vendorID;
+  h.device_id = props.deviceID;
+  h.driver_version = props.driverVersion;
+  std::memcpy(h.uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+  return h;
+}
+
+// The driver blob of `path` if every check passes, else empty.
+std::vector<std::uint8_t> read_valid_blob(std::string const& path, VkPhysicalDeviceProperties const& props) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) {
+    return {};
+  }
+
+  FileHeader h{};
+  if (!ifs.read(reinterpret_cast<char*>(&h), sizeof(h))) {
+    return {};
+  }
+
+  FileHeader const want = header_for(props);
+  if (h.magic != want.magic || h.version != want.version || h.vendor_id != want.vendor_id ||
+      h.device_id != want.device_id || h.driver_version != want.driver_version ||
+      std::memcmp(h.uuid, want.uuid, VK_UUID_SIZE) != 0) {
+    return {};
+  }
+
+  std::error_code ec;
+  auto const file_size = std::filesystem::file_size(path, ec);
+  if (ec || h.data_size < sizeof(VkPipelineCacheHeaderVersionOne) || h.data_size != file_size - sizeof(h)) {
+    return {};
+  }
+
+  std::vector<std::uint8_t> data(static_cast<std::size_t>(h.data_size));
+  if (!ifs.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size())) ||
+      fnv1a(data.data(), data.size()) != h.data_hash) {
+    return {};
+  }
+
+  // The driver's own header must agree too.
+  VkPipelineCacheHeaderVersionOne vk{};
+  std::memcpy(&vk, data.data(), sizeof(vk));
+  if (vk.headerSize < sizeof(vk) || vk.headerSize > data.size() ||
+      vk.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || vk.vendorID != props.vendorID ||
+      vk.deviceID != props.deviceID || std::memcmp(vk.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    return {};
+  }
+
+  return data;
+}
+
+} // namespace
+
+PipelineCache::~PipelineCache() = default;
+
+PipelineCache::PipelineCache(PipelineCache&& other) noexcept {
+  *this = std::move(other);
+}
+
+PipelineCache& PipelineCache::operator=(PipelineCache&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  cache_ = other.cache_;
+  path_ = std::move(other.path_);
+  loaded_ = other.loaded_;
+
+  other.cache_ = VK_NULL_HANDLE;
+  other.path_.clear();
+  other.loaded_ = false;
+
+  return *this;
+}
+
+void PipelineCache::init(Context const& ctx, std::string const& path) {
+  if (cache_ != VK_NULL_HANDLE) {
+    fail("PipelineCache::init called twice");
+  }
+
+  path_ = path;
+
+  std::vector<std::uint8_t> initial;
+  if (!path_.empty()) {
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(ctx.physical_device(), &props);
+    initial = read_valid_blob(path_, props);
+  }
+
+  VkPipelineCacheCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  ci.initialDataSize = initial.size();
+  ci.pInitialData = initial.empty() ? nullptr : initial.data();
+
+  VkResult r = vkCreatePipelineCache(ctx.device(), &ci, nullptr, &cache_);
+  if (r != VK_SUCCESS && !initial.empty()) {
+    // Rejected despite the checks; start cold rather than fail.
+    initial.clear();
+    ci.initialDataSize = 0;
+    ci.pInitialData = nullptr;
+    r = vkCreatePipelineCache(ctx.device(), &ci, nullptr, &cache_);
+  }
+  vk_check(r, "vkCreatePipelineCache");
+
+  loaded_ = !initial.empty();
+}
+
+void PipelineCache::shutdown(Context const& ctx) {
+  if (cache_ == VK_NULL_HANDLE) {
+    return;
+  }
+
+  if (!save(ctx)) {
+    std::fprintf(stderr, "PipelineCache: failed to write %s\n", path_.c_str());
+  }
+
+  vkDestroyPipelineCache(ctx.device(), cache_, nullptr);
+  cache_ = VK_NULL_HANDLE;
+  path_.clear();
+  loaded_ = false;
+}
+
+bool PipelineCache::save(Context const& ctx) const {
+  if (cache_ == VK_NULL_HANDLE || path_.empty()) {
+    return true;
+  }
+
+  std::size_t size = 0;
+  if (vkGetPipelineCacheData(ctx.device(), cache_, &size, nullptr) != VK_SUCCESS || size == 0U) {
+    return false;
+  }
+  std::vector<std::uint8_t> data(size);
+  if (vkGetPipelineCacheData(ctx.device(), cache_, &size, data.data()) != VK_SUCCESS) {
+    return false;
+  }
+  data.resize(size);
+
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(ctx.physical_device(), &props);
+  FileHeader h = header_for(props);
+  h.data_size = data.size();
+  h.data_hash = fnv1a(data.data(), data.size());
+
+  std::string const tmp = path_ + ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+      return false;
+    }
+    ofs.write(reinterpret_cast<char const*>(&h), sizeof(h));
+    ofs.write(reinterpret_cast<char const*>(data.data()), static_cast<std::streamsize>(data.size()));
+    ofs.flush();
+    if (!ofs) {
+      ofs.close();
+      std::error_code ec;
+      std::filesystem::remove(tmp, ec);
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp, path_, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+    return false;
+  }
+  return true;
+}
+
+} // namespace gfx
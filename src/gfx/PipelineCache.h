@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+namespace gfx {
+
+class Context;
+
+// One VkPipelineCache shared by every pipeline the context creates, persisted
+// between runs. The file is the driver's blob behind a small header of our own:
+//
+//   magic "GPC1" | version | vendorID | deviceID | driverVersion |
+//   pipelineCacheUUID[16] | data size | FNV-1a of the data | driver blob
+//
+// A file written by another device, driver or build of the driver, or one that
+// is truncated or corrupt, is ignored and the cache starts empty. Drivers are
+// not required to validate the blob themselves, so nothing unchecked reaches
+// vkCreatePipelineCache.
+class PipelineCache {
+public:
+  PipelineCache() = default;
+  ~PipelineCache();
+
+  PipelineCache(PipelineCache const&) = delete;
+  PipelineCache& operator=(PipelineCache const&) = delete;
+
+  PipelineCache(PipelineCache&& other) noexcept;
+  PipelineCache& operator=(PipelineCache&& other) noexcept;
+
+  // Empty `path` keeps the cache in memory only.
+  void init(Context const& ctx, std::string const& path);
+
+  // Writes the cache back (see save()) and destroys it. Failures to write are
+  // reported on stderr; the next run simply starts cold.
+  void shutdown(Context const& ctx);
+
+  // Atomic: written to `<path>.tmp`, then renamed over `path`. No-op without a path.
+  bool save(Context const& ctx) const;
+
+  VkPipelineCache handle() const { return cache_; }
+
+  // Whether init() found a usable file.
+  bool loaded_from_disk() const { return loaded_; }
+
+private:
+  VkPipelineCache cache_ = VK_NULL_HANDLE;
+  std::string path_;
+  bool loaded_ = false;
+};
+
+} // namespace gfx
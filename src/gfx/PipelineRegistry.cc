@@ -0,0 +1,280 @@
+#include "gfx/PipelineRegistry.h"
+
+#include "core/JobSystem.h"
+#include "core/Profile.h"
+#include "gfx/Context.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+
+constexpr std::size_t kVertexFormatCount = 2;
+
+std::size_t format_slot(VertexFormat f) {
+  return (f == VertexFormat::Quantized) ? 1U : 0U;
+}
+
+} // namespace
+
+struct PipelineRegistry::Impl {
+  enum class Status : std::uint8_t { Queued, Ready, Failed };
+
+  struct Entry {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    Status status = Status::Queued;
+  };
+
+  Context const* ctx = nullptr;
+  PipelineTarget target{};
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  VkPipeline base = VK_NULL_HANDLE;
+  PipelineState base_state{};
+
+  core::JobSystem* jobs = nullptr;
+  core::JobCounter running; // compile jobs in flight
+  std::uint32_t max_jobs = 1;
+
+  mutable std::mutex mutex;
+  std::unordered_map<PipelineState, Entry, PipelineStateHash> variants; // base excluded
+  std::deque<PipelineState> queue;
+  VkPipeline fallbacks[kVertexFormatCount]{};
+  std::uint32_t pending = 0;
+  std::uint32_t active = 0; // compile jobs submitted and not yet returned
+  bool stop = false;
+
+  VkPipeline compile(PipelineState const& state) const {
+    return create_graphics_pipeline(*ctx, state, target, layout, base);
+  }
+
+  // Caller holds `mutex`.
+  Entry& request(PipelineState const& state) {
+    auto [it, inserted] = variants.try_emplace(state);
+    if (inserted) {
+      queue.push_back(state);
+      ++pending;
+      launch();
+    }
+    return it->second;
+  }
+
+  // Caller holds `mutex`. Each job resubmits itself until the queue is empty,
+  // so a new one is only needed while fewer than max_jobs are running.
+  void launch() {
+    if (!stop && active < max_jobs) {
+      ++active;
+      jobs->submit([this] { drain(); }, &running);
+    }
+  }
+
+  // Caller holds `mutex`. A job that has finished its variant goes back to the
+  // end of the pool's queues, so other jobs get the worker between compiles.
+  void relaunch() {
+    if (!stop && !queue.empty()) {
+      jobs->submit([this] { drain(); }, &running);
+    } else {
+      --active;
+    }
+  }
+
+  // Caller holds `mutex`. A variant compiled twice (inline and by a worker)
+  // keeps the first result.
+  VkPipeline finish(PipelineState const& state, VkPipeline pipeline) {
+    Entry& e = variants[state];
+    if (e.status == Status::Ready) {
+      if (pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(ctx->device(), pipeline, nullptr);
+      }
+      return e.pipeline;
+    }
+    e.pipeline = pipeline;
+    e.status = (pipeline != VK_NULL_HANDLE) ? Status::Ready : Status::Failed;
+    return pipeline;
+  }
+
+  // Compiles one queued variant.
+  void drain() {
+    PipelineState state;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (stop || queue.empty()) {
+        --active;
+        return;
+      }
+      state = std::move(queue.front());
+      queue.pop_front();
+
+      if (variants[state].status == Status::Ready) {
+        --pending; // get() already needed it inline
+        relaunch();
+        return;
+      }
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    try {
+      CORE_ZONE("compile pipeline");
+      pipeline = compile(state);
+    } catch (std::exception const& e) {
+      // The fallback keeps being served for this state.
+      std::fprintf(stderr, "PipelineRegistry: variant failed: %s\n", e.what());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    VkPipeline const kept = finish(state, pipeline);
+    if (kept != VK_NULL_HANDLE && fallbacks[format_slot(state.vertex_format)] == VK_NULL_HANDLE) {
+      fallbacks[format_slot(state.vertex_format)] = kept;
+    }
+    --pending;
+    relaunch();
+  }
+};
+
+PipelineRegistry::~PipelineRegistry() {
+}
+
+PipelineRegistry::PipelineRegistry(PipelineRegistry&& other) noexcept {
+  *this = std::move(other);
+}
+
+PipelineRegistry& PipelineRegistry::operator=(PipelineRegistry&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  impl_ = other.impl_;
+  other.impl_ = nullptr;
+
+  return *this;
+}
+
+void PipelineRegistry::init(Context const& ctx, Pipeline const& base, core::JobSystem& jobs, std::uint32_t max_jobs) {
+  if (impl_ != nullptr) {
+    fail("PipelineRegistry::init called twice");
+  }
+  if (base.pipeline() == VK_NULL_HANDLE) {
+    fail("PipelineRegistry::init: base pipeline not initialized");
+  }
+  // Without workers a compile job would run inline, under the registry's lock.
+  if (jobs.thread_count() == 0U) {
+    fail("PipelineRegistry::init: job system not initialized");
+  }
+
+  impl_ = new (std::nothrow) Impl();
+  if (impl_ == nullptr) {
+    fail("PipelineRegistry: allocation failed");
+  }
+
+  impl_->ctx = &ctx;
+  impl_->target = base.target();
+  impl_->layout = base.pipeline_layout();
+  impl_->base = base.pipeline();
+  impl_->base_state = base.state();
+  impl_->fallbacks[format_slot(base.vertex_format())] = base.pipeline();
+  impl_->jobs = &jobs;
+  impl_->max_jobs = (max_jobs != 0U) ? max_jobs : jobs.thread_count();
+}
+
+void PipelineRegistry::shutdown(Context const& ctx) {
+  if (impl_ == nullptr) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->stop = true;
+    impl_->pending -= static_cast<std::uint32_t>(impl_->queue.size());
+    impl_->queue.clear();
+  }
+  impl_->jobs->wait(impl_->running);
+
+  for (auto& [state, entry] : impl_->variants) {
+    if (entry.pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(ctx.device(), entry.pipeline, nullptr);
+    }
+  }
+
+  delete impl_;
+  impl_ = nullptr;
+}
+
+VkPipeline PipelineRegistry::get(PipelineState const& state) {
+  if (impl_ == nullptr) {
+    fail("PipelineRegistry::get before init");
+  }
+
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  if (state == impl_->base_state) {
+    return impl_->base;
+  }
+
+  Impl::Entry const& e = impl_->request(state);
+  if (e.status == Impl::Status::Ready) {
+    return e.pipeline;
+  }
+
+  std::size_t const slot = format_slot(state.vertex_format);
+  if (impl_->fallbacks[slot] != VK_NULL_HANDLE) {
+    return impl_->fallbacks[slot];
+  }
+
+  // Nothing can draw this vertex format yet; pay for this one variant now.
+  lock.unlock();
+  VkPipeline const compiled = impl_->compile(state);
+  lock.lock();
+
+  VkPipeline const kept = impl_->finish(state, compiled);
+  if (impl_->fallbacks[slot] == VK_NULL_HANDLE) {
+    impl_->fallbacks[slot] = kept;
+  }
+  return kept;
+}
+
+void PipelineRegistry::prefetch(PipelineState const& state) {
+  if (impl_ == nullptr) {
+    fail("PipelineRegistry::prefetch before init");
+  }
+
+  std::lock_guard<std::mutex> lock(impl_->mutex);
+  if (state != impl_->base_state) {
+    impl_->request(state);
+  }
+}
+
+bool PipelineRegistry::ready(PipelineState const& state) const {
+  if (impl_ == nullptr) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(impl_->mutex);
+  if (state == impl_->base_state) {
+    return true;
+  }
+  auto const it = impl_->variants.find(state);
+  return it != impl_->variants.end() && it->second.status == Impl::Status::Ready;
+}
+
+std::uint32_t PipelineRegistry::pending() const {
+  if (impl_ == nullptr) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock(impl_->mutex);
+  return impl_->pending;
+}
+
+} // namespace gfx
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+#include "gfx/Pipeline.h"
+
+namespace core { class JobSystem; }
+
+namespace gfx {
+
+class Context;
+
+// Mesh pipeline variants keyed by PipelineState, compiled on demand as jobs on
+// the engine's JobSystem so a new material never stalls the frame that first
+// uses it.
+//
+// Every variant is a derivative of the base Pipeline and shares its target
+// (render pass or attachment formats) and layout, so switching between them
+// only needs vkCmdBindPipeline. Until a variant is ready, get() hands out a
+// fallback with the same vertex format: the base pipeline for its own format,
+// otherwise the first variant of that format, which is compiled synchronously
+// the one time it is needed.
+class PipelineRegistry {
+public:
+  PipelineRegistry() = default;
+  ~PipelineRegistry();
+
+  PipelineRegistry(PipelineRegistry const&) = delete;
+  PipelineRegistry& operator=(PipelineRegistry const&) = delete;
+
+  PipelineRegistry(PipelineRegistry&& other) noexcept;
+  PipelineRegistry& operator=(PipelineRegistry&& other) noexcept;
+
+  // `ctx`, `base` and `jobs` (initialized) must outlive the registry. At most
+  // `max_jobs` compiles run at once, so the rest of the pool stays free for
+  // frame work; 0 allows one per worker.
+  void init(Context const& ctx, Pipeline const& base, core::JobSystem& jobs, std::uint32_t max_jobs = 1);
+
+  // Waits for compiles in progress, drops queued ones and destroys every variant.
+  void shutdown(Context const& ctx);
+
+  // Never returns VK_NULL_HANDLE; throws if the synchronous fallback compile
+  // fails. Thread-safe.
+  VkPipeline get(PipelineState const& state);
+
+  // Queues `state` without waiting for it, e.g. when a material is loaded.
+  void prefetch(PipelineState const& state);
+
+  bool ready(PipelineState const& state) const;
+  std::uint32_t pending() const; // queued or compiling
+
+private:
+  struct Impl;
+  Impl* impl_ = nullptr; // owned; compile jobs point into it
+};
+
+} // namespace gfx
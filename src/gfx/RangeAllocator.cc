@@ -0,0 +1,132 @@
+#include "gfx/RangeAllocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+
+std::uint64_t align_up(std::uint64_t v, std::uint64_t a) {
+  return (a <= 1U) ? v : ((v + a - 1U) / a) * a;
+}
+
+} // namespace
+
+void RangeAllocator::init(std::uint64_t capacity) {
+  capacity_ = capacity;
+  reset();
+}
+
+void RangeAllocator::reset() {
+  free_.clear();
+  if (capacity_ != 0U) {
+    free_.push_back(Range{0, capacity_});
+  }
+  used_ = 0;
+}
+
+std::uint64_t RangeAllocator::allocate(std::uint64_t size, std::uint64_t alignment) {
+  if (size == 0U) {
+    fail("RangeAllocator::allocate: size == 0");
+  }
+
+  // best fit: smallest range that still holds the aligned request
+  std::size_t best = free_.size();
+  std::uint64_t best_waste = ~std::uint64_t{0};
+
+  for (std::size_t i = 0; i < free_.size(); ++i) {
+    Range const& r = free_[i];
+    std::uint64_t const aligned = align_up(r.offset, alignment);
+    std::uint64_t const pad = aligned - r.offset;
+    if (pad > r.size || r.size - pad < size) {
+      continue;
+    }
+    std::uint64_t const waste = r.size - size;
+    if (waste < best_waste) {
+      best = i;
+      best_waste = waste;
+      if (waste == 0U) {
+        break;
+      }
+    }
+  }
+
+  if (best == free_.size()) {
+    return kInvalidOffset;
+  }
+
+  Range const r = free_[best];
+  std::uint64_t const aligned = align_up(r.offset, alignment);
+  std::uint64_t const head = aligned - r.offset;
+  std::uint64_t const tail = r.size - head - size;
+
+  if (head != 0U && tail != 0U) {
+    free_[best].size = head;
+    free_.insert(free_.begin() + static_cast<std::ptrdiff_t>(best) + 1, Range{aligned + size, tail});
+  } else if (head != 0U) {
+    free_[best].size = head;
+  } else if (tail != 0U) {
+    free_[best] = Range{aligned + size, tail};
+  } else {
+    free_.erase(free_.begin() + static_cast<std::ptrdiff_t>(best));
+  }
+
+  used_ += size;
+  return aligned;
+}
+
+void RangeAllocator::free(std::uint64_t offset, std::uint64_t size) {
+  if (size == 0U) {
+    return;
+  }
+  if (offset + size > capacity_ || size > used_) {
+    fail("RangeAllocator::free: range out of bounds");
+  }
+
+  auto it = std::lower_bound(free_.begin(), free_.end(), offset,
+                             [](Range const& r, std::uint64_t o) { return r.offset < o; });
+
+  if (it != free_.end() && offset + size > it->offset) {
+    fail("RangeAllocator::free: double free / overlap");
+  }
+  if (it != free_.begin() && std::prev(it)->offset + std::prev(it)->size > offset) {
+    fail("RangeAllocator::free: double free / overlap");
+  }
+
+  it = free_.insert(it, Range{offset, size});
+
+  // merge with next
+  auto next = std::next(it);
+  if (next != free_.end() && it->offset + it->size == next->offset) {
+    it->size += next->size;
+    free_.erase(next);
+  }
+
+  // merge with previous
+  if (it != free_.begin()) {
+    auto prev = std::prev(it);
+    if (prev->offset + prev->size == it->offset) {
+      prev->size += it->size;
+      free_.erase(it);
+    }
+  }
+
+  used_ -= size;
+}
+
+std::uint64_t RangeAllocator::largest_free() const {
+  std::uint64_t best = 0;
+  for (auto const& r : free_) {
+    best = std::max(best, r.size);
+  }
+  return best;
+}
+
+} // namespace gfx
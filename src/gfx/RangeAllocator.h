@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gfx {
+
+// Free-list sub-allocator over an abstract [0, capacity) range.
+// Best-fit placement, free ranges are kept sorted and coalesced on release.
+// Units are up to the caller (bytes for device memory, elements for pools).
+class RangeAllocator {
+public:
+  static constexpr std::uint64_t kInvalidOffset = ~std::uint64_t{0};
+
+public:
+  RangeAllocator() = default;
+
+  void init(std::uint64_t capacity);
+  void reset();
+
+  // Returns kInvalidOffset if no free range can hold `size` at `alignment`.
+  std::uint64_t allocate(std::uint64_t size, std::uint64_t alignment = 1);
+  void free(std::uint64_t offset, std::uint64_t size);
+
+  std::uint64_t capacity() const { return capacity_; }
+  std::uint64_t used() const { return used_; }
+  std::uint64_t largest_free() const;
+  std::size_t free_range_count() const { return free_.size(); }
+  bool empty() const { return used_ == 0; }
+
+private:
+  struct Range {
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+  };
+
+  std::vector<Range> free_; // sorted by offset, never adjacent
+  std::uint64_t capacity_ = 0;
+  std::uint64_t used_ = 0;
+};
+
+} // namespace gfx
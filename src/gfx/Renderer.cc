@@ -1,17 +1,32 @@
 #include "gfx/Renderer.h"
 
+#include "core/JobSystem.h"
+#include "core/Profile.h"
+#include "gfx/Barrier.h"
+#include "gfx/Buffer.h"
 #include "gfx/Context.h"
 #include "gfx/Depth.h"
+#include "gfx/GpuProfiler.h"
+#include "gfx/GpuScene.h"
 #include "gfx/Mesh.h"
+#include "gfx/OffscreenTarget.h"
 #include "gfx/Pipeline.h"
 #include "gfx/Swapchain.h"
 #include "math/Camera.h"
+#include "math/Cull.h"
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -30,6 +45,65 @@ void vk_check(VkResult r, char const* what) {
   }
 }
 
+float aspect_ratio(VkExtent2D extent) {
+  return (extent.height != 0U)
+    ? (static_cast<float>(extent.width) / static_cast<float>(extent.height))
+    : 1.0f;
+}
+
+void check_vertex_formats(DrawList const& list, Pipeline const& pl) {
+  for (DrawItem const& item : list.items()) {
+    if (item.pipeline == VK_NULL_HANDLE && item.mesh->vertex_format() != pl.vertex_format()) {
+      fail("Renderer::draw_frame: mesh vertex format does not match pipeline");
+    }
+  }
+}
+
+// The profiler is optional; these keep the recorders free of null checks.
+std::uint32_t begin_scope(GpuProfiler* profiler, VkCommandBuffer cb, char const* name) {
+  return (profiler != nullptr) ? profiler->begin_scope(cb, name) : GpuProfiler::kNoScope;
+}
+
+void end_scope(GpuProfiler* profiler, VkCommandBuffer cb, std::uint32_t scope) {
+  if (profiler != nullptr) {
+    profiler->end_scope(cb, scope);
+  }
+}
+
+// Below this many world units the eye counts as touching the bounds.
+constexpr float kMinLodDistance = 1e-4f;
+
+// `error_scale` is pixels per object-space unit at distance 1 over the threshold.
+std::uint32_t pick_lod(Mesh const& mesh, glm::mat4 const& model, glm::vec3 const& eye, float error_scale) {
+  if (mesh.lod_count() <= 1U || !(error_scale > 0.0f)) {
+    return 0;
+  }
+
+  BoundingSphere const& b = mesh.bounds();
+  glm::vec3 center{};
+  float const scale = math::transform_sphere(model, glm::vec3(b.center[0], b.center[1], b.center[2]), 1.0f, center);
+
+  glm::vec3 const d = center - eye;
+  float const dist = std::max(std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z) - scale * b.radius, kMinLodDistance);
+  float const k = scale * error_scale / dist;
+
+  // Errors grow along the chain, so stop at the first level that is too coarse.
+  std::uint32_t level = 0;
+  for (std::uint32_t l = 1; l < mesh.lod_count(); ++l) {
+    if (mesh.lod(l).error * k > 1.0f) {
+      break;
+    }
+    level = l;
+  }
+  return level;
+}
+
+AllocationCreateInfo host_visible() {
+  AllocationCreateInfo a{};
+  a.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  return a;
+}
+
 } // namespace
 
 Renderer::~Renderer() {
@@ -47,32 +121,140 @@ Renderer& Renderer::operator=(Renderer&& other) noexcept {
   command_pool_ = other.command_pool_;
   command_buffers_ = std::move(other.command_buffers_);
   framebuffers_ = std::move(other.framebuffers_);
+  color_uses_ = std::move(other.color_uses_);
+  depth_use_ = other.depth_use_;
   image_available_ = std::move(other.image_available_);
   render_finished_ = std::move(other.render_finished_);
   in_flight_ = std::move(other.in_flight_);
+  descriptor_pool_ = other.descriptor_pool_;
+  frame_set_ = other.frame_set_;
+  white_texture_ = std::move(other.white_texture_);
+  white_sampler_ = other.white_sampler_;
+  white_material_ = other.white_material_;
+  default_material_ = other.default_material_;
+  frame_ring_ = std::move(other.frame_ring_);
+  instance_buffers_ = std::move(other.instance_buffers_);
+  record_threads_ = other.record_threads_;
+  jobs_ = other.jobs_;
+  record_pools_ = std::move(other.record_pools_);
+  secondaries_ = std::move(other.secondaries_);
+  single_ = std::move(other.single_);
+  lod_threshold_px_ = other.lod_threshold_px_;
+  resolved_ = std::move(other.resolved_);
+  for (std::uint32_t l = 0; l < Mesh::kMaxLods; ++l) {
+    lod_models_[l] = std::move(other.lod_models_[l]);
+  }
+  shared_ranges_ = std::move(other.shared_ranges_);
   frame_index_ = other.frame_index_;
+  submitted_frames_ = other.submitted_frames_;
+  completed_frames_ = other.completed_frames_;
+  for (std::uint32_t i = 0; i < kMaxFramesInFlight; ++i) {
+    slot_serials_[i] = other.slot_serials_[i];
+    globals_offsets_[i] = other.globals_offsets_[i];
+    other.slot_serials_[i] = 0;
+    other.globals_offsets_[i] = 0;
+  }
+  retired_ = std::move(other.retired_);
+  pacing_ = other.pacing_;
+  input_time_ = other.input_time_;
+  input_sampled_ = other.input_sampled_;
+  present_id_ = other.present_id_;
+  pending_presents_ = std::move(other.pending_presents_);
+  pending_swapchain_ = other.pending_swapchain_;
+  latency_ = other.latency_;
+  profiler_ = other.profiler_;
+  pyramid_ = std::move(other.pyramid_);
 
   other.command_pool_ = VK_NULL_HANDLE;
   other.command_buffers_.clear();
   other.framebuffers_.clear();
+  other.color_uses_.clear();
+  other.depth_use_ = ImageUse{};
   other.image_available_.clear();
   other.render_finished_.clear();
   other.in_flight_.clear();
+  other.descriptor_pool_ = VK_NULL_HANDLE;
+  other.frame_set_ = VK_NULL_HANDLE;
+  other.white_sampler_ = VK_NULL_HANDLE;
+  other.white_material_ = VK_NULL_HANDLE;
+  other.default_material_ = VK_NULL_HANDLE;
+  other.instance_buffers_.clear();
+  other.record_threads_ = 1;
+  other.jobs_ = nullptr;
+  other.record_pools_.clear();
+  other.secondaries_.clear();
+  other.single_.clear();
+  other.lod_threshold_px_ = 1.0f;
+  other.resolved_.clear();
   other.frame_index_ = 0;
+  other.submitted_frames_ = 0;
+  other.completed_frames_ = 0;
+  other.pacing_ = FramePacing{};
+  other.input_sampled_ = false;
+  other.present_id_ = 0;
+  other.pending_presents_.clear();
+  other.pending_swapchain_ = VK_NULL_HANDLE;
+  other.latency_ = PresentLatency{};
+  other.profiler_ = nullptr;
 
   return *this;
 }
 
-void Renderer::init(Context const& ctx, Swapchain const& sc, Pipeline const& pl, Depth const& depth) {
+void Renderer::init(Context const& ctx,
+                    Swapchain const& sc,
+                    Pipeline const& pl,
+                    Depth const& depth,
+                    std::uint32_t record_threads,
+                    FramePacing const& pacing) {
+  init_frames(ctx, pl, record_threads, pacing);
+  create_framebuffers(ctx, sc.image_views(), sc.extent(), pl, depth);
+}
+
+void Renderer::init(Context const& ctx,
+                    OffscreenTarget const& target,
+                    Pipeline const& pl,
+                    Depth const& depth,
+                    std::uint32_t record_threads,
+                    FramePacing const& pacing) {
+  if (target.image_count() < pacing.frames_in_flight) {
+    fail("Renderer::init: the offscreen target needs an image per frame in flight");
+  }
+  FramePacing unpaced = pacing;
+  unpaced.wait_for_present = false;
+
+  init_frames(ctx, pl, record_threads, unpaced);
+  create_framebuffers(ctx, target.image_views(), target.extent(), pl, depth);
+}
+
+void Renderer::init_frames(Context const& ctx,
+                           Pipeline const& pl,
+                           std::uint32_t record_threads,
+                           FramePacing const& pacing) {
+  if (pacing.frames_in_flight == 0U || pacing.frames_in_flight > kMaxFramesInFlight) {
+    fail("Renderer::init: frames_in_flight must be 1.." + std::to_string(kMaxFramesInFlight));
+  }
+  pacing_ = pacing;
+
+  if (record_threads == 0U) {
+    record_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  record_threads_ = record_threads;
+
   create_command_pool(ctx);
-  allocate_command_buffers(ctx, sc.images().size());
-  create_framebuffers(ctx, sc, pl, depth);
+  allocate_command_buffers(ctx, pacing_.frames_in_flight);
   create_sync(ctx);
+  create_frame_resources(ctx, pl);
+  create_record_pools(ctx);
+
 }
 
 void Renderer::shutdown(Context const& ctx) {
   vk_check(vkDeviceWaitIdle(ctx.device()), "vkDeviceWaitIdle");
+  retired_.flush(ctx);
 
+  pyramid_.shutdown(ctx);
+  destroy_record_pools(ctx);
+  destroy_frame_resources(ctx);
   destroy_sync(ctx);
   destroy_framebuffers(ctx);
   free_command_buffers(ctx);
@@ -82,7 +264,92 @@ void Renderer::shutdown(Context const& ctx) {
     command_pool_ = VK_NULL_HANDLE;
   }
 
+  record_threads_ = 1;
+  single_.clear();
+  resolved_.clear();
   frame_index_ = 0;
+  submitted_frames_ = 0;
+  completed_frames_ = 0;
+  for (auto& serial : slot_serials_) {
+    serial = 0;
+  }
+  input_sampled_ = false;
+  present_id_ = 0;
+  pending_presents_.clear();
+  pending_swapchain_ = VK_NULL_HANDLE;
+  latency_ = PresentLatency{};
+}
+
+bool Renderer::enable_occlusion_culling(Context const& ctx,
+                                        std::string const& pyramid_spv_path,
+                                        Pipeline const& pl,
+                                        Depth const& depth) {
+  if (pyramid_.initialized()) {
+    return true;
+  }
+  if (!pl.dynamic_rendering() || !depth.sampled()) {
+    return false;
+  }
+  pyramid_.init(ctx, pyramid_spv_path, depth);
+  return true;
+}
+
+void Renderer::wait_for_frame(Context const& ctx, Swapchain const& sc) {
+  if (in_flight_.empty()) {
+    fail("Renderer::wait_for_frame before init");
+  }
+
+  // Keep at most frames_in_flight presents queued ahead of the display.
+  if (pacing_.wait_for_present && present_id_ >= pacing_.frames_in_flight) {
+    CORE_WAIT_ZONE("present wait");
+    collect_presents(ctx, sc, present_id_ + 1U - pacing_.frames_in_flight);
+  }
+
+  VkFence const fence = in_flight_.at(frame_index_);
+  {
+    CORE_WAIT_ZONE("fence wait");
+    vk_check(vkWaitForFences(ctx.device(), 1, &fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+  }
+  completed_frames_ = slot_serials_[frame_index_];
+
+  input_time_ = glfwGetTime();
+  input_sampled_ = true;
+}
+
+void Renderer::collect_presents(Context const& ctx, Swapchain const& sc, std::uint64_t block_until) {
+  if (!ctx.supports_present_wait()) {
+    return;
+  }
+  if (pending_swapchain_ != sc.handle()) {
+    // Recreated: ids of the old swapchain can no longer be waited for.
+    pending_presents_.clear();
+    pending_swapchain_ = sc.handle();
+    return;
+  }
+
+  while (!pending_presents_.empty()) {
+    PendingPresent const p = pending_presents_.front();
+    std::uint64_t const timeout = (p.id <= block_until) ? kPresentWaitTimeoutNs : 0U;
+    VkResult const r = ctx.wait_for_present()(ctx.device(), sc.handle(), p.id, timeout);
+    if (r == VK_TIMEOUT) {
+      break; // not on screen yet; a blocking wait gives up rather than hang a hidden window
+    }
+
+    pending_presents_.pop_front();
+    if (r != VK_SUCCESS) {
+      // Out of date or lost; recreation follows and the ids go with it.
+      pending_presents_.clear();
+      break;
+    }
+    add_latency_sample((glfwGetTime() - p.input_time) * 1000.0, true);
+  }
+}
+
+void Renderer::add_latency_sample(double ms, bool to_display) {
+  latency_.last_ms = ms;
+  latency_.average_ms = (latency_.samples == 0U) ? ms : latency_.average_ms + (ms - latency_.average_ms) * kLatencySmoothing;
+  latency_.to_display = to_display;
+  ++latency_.samples;
 }
 
 void Renderer::create_command_pool(Context const& ctx) {
@@ -121,9 +388,9 @@ void Renderer::free_command_buffers(Context const& ctx) {
 }
 
 void Renderer::create_sync(Context const& ctx) {
-  image_available_.assign(kMaxFramesInFlight, VK_NULL_HANDLE);
-  render_finished_.assign(kMaxFramesInFlight, VK_NULL_HANDLE);
-  in_flight_.assign(kMaxFramesInFlight, VK_NULL_HANDLE);
+  image_available_.assign(pacing_.frames_in_flight, VK_NULL_HANDLE);
+  render_finished_.assign(pacing_.frames_in_flight, VK_NULL_HANDLE);
+  in_flight_.assign(pacing_.frames_in_flight, VK_NULL_HANDLE);
 
   VkSemaphoreCreateInfo sci{};
   sci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -132,7 +399,7 @@ void Renderer::create_sync(Context const& ctx) {
   fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  for (std::uint32_t i = 0; i < kMaxFramesInFlight; ++i) {
+  for (std::uint32_t i = 0; i < pacing_.frames_in_flight; ++i) {
     vk_check(vkCreateSemaphore(ctx.device(), &sci, nullptr, &image_available_[i]), "vkCreateSemaphore(image_available)");
     vk_check(vkCreateSemaphore(ctx.device(), &sci, nullptr, &render_finished_[i]), "vkCreateSemaphore(render_finished)");
     vk_check(vkCreateFence(ctx.device(), &fci, nullptr, &in_flight_[i]), "vkCreateFence(in_flight)");
@@ -163,19 +430,377 @@ void Renderer::destroy_sync(Context const& ctx) {
   image_available_.clear();
 }
 
-void Renderer::create_framebuffers(Context const& ctx, Swapchain const& sc, Pipeline const& pl, Depth const& depth) {
-  framebuffers_.assign(sc.image_views().size(), VK_NULL_HANDLE);
+void Renderer::create_frame_resources(Context const& ctx, Pipeline const& pl) {
+  VkDescriptorPoolSize pool_sizes[2]{};
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  pool_sizes[0].descriptorCount = 1;
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_sizes[1].descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo dpci{};
+  dpci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  dpci.maxSets = 2;
+  dpci.poolSizeCount = 2;
+  dpci.pPoolSizes = pool_sizes;
+
+  vk_check(vkCreateDescriptorPool(ctx.device(), &dpci, nullptr, &descriptor_pool_), "vkCreateDescriptorPool");
+
+  VkDescriptorSetLayout const layout = pl.frame_set_layout();
 
-  for (std::size_t i = 0; i < sc.image_views().size(); ++i) {
-    VkImageView attachments[] = {sc.image_views()[i], depth.view()};
+  VkDescriptorSetAllocateInfo ai{};
+  ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  ai.descriptorPool = descriptor_pool_;
+  ai.descriptorSetCount = 1;
+  ai.pSetLayouts = &layout;
+
+  vk_check(vkAllocateDescriptorSets(ctx.device(), &ai, &frame_set_), "vkAllocateDescriptorSets");
+
+  frame_ring_.init(ctx, kFrameRingCapacity, pacing_.frames_in_flight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+  // Written once: frames differ only in the dynamic offset.
+  VkDescriptorBufferInfo bi{};
+  bi.buffer = frame_ring_.buffer();
+  bi.offset = 0;
+  bi.range = sizeof(FrameGlobals);
+
+  VkWriteDescriptorSet w{};
+  w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  w.dstSet = frame_set_;
+  w.dstBinding = 0;
+  w.descriptorCount = 1;
+  w.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  w.pBufferInfo = &bi;
+
+  vkUpdateDescriptorSets(ctx.device(), 1, &w, 0, nullptr);
+
+  instance_buffers_.resize(pacing_.frames_in_flight);
+  for (Buffer& b : instance_buffers_) {
+    b.init(ctx, kMinInstanceCapacity * sizeof(glm::mat4), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, host_visible());
+  }
+
+  create_white_material(ctx, pl);
+}
+
+void Renderer::create_white_material(Context const& ctx, Pipeline const& pl) {
+  white_texture_.init_2d(ctx,
+                         VkExtent2D{1, 1},
+                         VK_FORMAT_R8G8B8A8_UNORM,
+                         VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                         VK_IMAGE_ASPECT_COLOR_BIT);
+
+  // A clear is all it needs; one blocking submit at init, no staging.
+  VkCommandBufferAllocateInfo cbai{};
+  cbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cbai.commandPool = command_pool_;
+  cbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cbai.commandBufferCount = 1;
+
+  VkCommandBuffer cb = VK_NULL_HANDLE;
+  vk_check(vkAllocateCommandBuffers(ctx.device(), &cbai, &cb), "vkAllocateCommandBuffers(white)");
+
+  VkCommandBufferBeginInfo bi{};
+  bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vk_check(vkBeginCommandBuffer(cb, &bi), "vkBeginCommandBuffer(white)");
+
+  ImageUse use{};
+  transition_image(cb, white_texture_.image(), VK_IMAGE_ASPECT_COLOR_BIT, use, transfer_dst_use(), true);
+
+  VkClearColorValue white{};
+  white.float32[0] = 1.0f;
+  white.float32[1] = 1.0f;
+  white.float32[2] = 1.0f;
+  white.float32[3] = 1.0f;
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = 1;
+  range.layerCount = 1;
+  vkCmdClearColorImage(cb, white_texture_.image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1, &range);
+
+  transition_image(cb, white_texture_.image(), VK_IMAGE_ASPECT_COLOR_BIT, use, fragment_sampled_use());
+  vk_check(vkEndCommandBuffer(cb), "vkEndCommandBuffer(white)");
+
+  VkSubmitInfo si{};
+  si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  si.commandBufferCount = 1;
+  si.pCommandBuffers = &cb;
+  VkResult r = vkQueueSubmit(ctx.graphics_queue(), 1, &si, VK_NULL_HANDLE);
+  if (r == VK_SUCCESS) {
+    r = vkQueueWaitIdle(ctx.graphics_queue());
+  }
+  vkFreeCommandBuffers(ctx.device(), command_pool_, 1, &cb);
+  vk_check(r, "vkQueueSubmit(white)");
+
+  VkSamplerCreateInfo sci{};
+  sci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sci.magFilter = VK_FILTER_NEAREST;
+  sci.minFilter = VK_FILTER_NEAREST;
+  sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sci.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sci.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sci.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  vk_check(vkCreateSampler(ctx.device(), &sci, nullptr, &white_sampler_), "vkCreateSampler(white)");
+
+  VkDescriptorSetLayout const layout = pl.material_set_layout();
+  VkDescriptorSetAllocateInfo ai{};
+  ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  ai.descriptorPool = descriptor_pool_;
+  ai.descriptorSetCount = 1;
+  ai.pSetLayouts = &layout;
+  vk_check(vkAllocateDescriptorSets(ctx.device(), &ai, &white_material_), "vkAllocateDescriptorSets(white)");
+
+  VkDescriptorImageInfo ii{};
+  ii.sampler = white_sampler_;
+  ii.imageView = white_texture_.view();
+  ii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkWriteDescriptorSet w{};
+  w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  w.dstSet = white_material_;
+  w.dstBinding = 0;
+  w.descriptorCount = 1;
+  w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  w.pImageInfo = &ii;
+  vkUpdateDescriptorSets(ctx.device(), 1, &w, 0, nullptr);
+}
+
+VkDescriptorSet Renderer::material_or_default(VkDescriptorSet material) const {
+  if (material != VK_NULL_HANDLE) {
+    return material;
+  }
+  return (default_material_ != VK_NULL_HANDLE) ? default_material_ : white_material_;
+}
+
+void Renderer::destroy_frame_resources(Context const& ctx) {
+  for (auto& b : instance_buffers_) {
+    b.shutdown(ctx);
+  }
+  instance_buffers_.clear();
+  frame_ring_.shutdown(ctx);
+
+  if (white_sampler_ != VK_NULL_HANDLE) {
+    vkDestroySampler(ctx.device(), white_sampler_, nullptr);
+    white_sampler_ = VK_NULL_HANDLE;
+  }
+  white_texture_.shutdown(ctx);
+  white_material_ = VK_NULL_HANDLE;
+  default_material_ = VK_NULL_HANDLE;
+
+  // The sets go with the pool.
+  if (descriptor_pool_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(ctx.device(), descriptor_pool_, nullptr);
+    descriptor_pool_ = VK_NULL_HANDLE;
+  }
+  frame_set_ = VK_NULL_HANDLE;
+}
+
+void Renderer::create_record_pools(Context const& ctx) {
+  if (record_threads_ <= 1U) {
+    return;
+  }
+
+  std::size_t const count = static_cast<std::size_t>(pacing_.frames_in_flight) * record_threads_;
+  record_pools_.assign(count, VK_NULL_HANDLE);
+  secondaries_.assign(count, VK_NULL_HANDLE);
+
+  // Transient: the whole pool is reset every time its frame comes around.
+  VkCommandPoolCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  ci.queueFamilyIndex = ctx.graphics_queue_family();
+  ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    vk_check(vkCreateCommandPool(ctx.device(), &ci, nullptr, &record_pools_[i]), "vkCreateCommandPool(record)");
+
+    VkCommandBufferAllocateInfo ai{};
+    ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    ai.commandPool = record_pools_[i];
+    ai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    ai.commandBufferCount = 1;
+
+    vk_check(vkAllocateCommandBuffers(ctx.device(), &ai, &secondaries_[i]), "vkAllocateCommandBuffers(secondary)");
+  }
+}
+
+void Renderer::destroy_record_pools(Context const& ctx) {
+  // Secondaries go with their pools.
+  for (auto& p : record_pools_) {
+    if (p != VK_NULL_HANDLE) {
+      vkDestroyCommandPool(ctx.device(), p, nullptr);
+      p = VK_NULL_HANDLE;
+    }
+  }
+  record_pools_.clear();
+  secondaries_.clear();
+}
+
+glm::mat4 Renderer::write_frame_globals(std::uint32_t frame,
+                                        VkExtent2D extent,
+                                        math::Camera const& cam) {
+  glm::mat4 const view_proj = cam.view_proj(aspect_ratio(extent));
+
+  FrameGlobals globals{};
+  std::memcpy(globals.view_proj, &view_proj[0][0], sizeof(globals.view_proj));
+  // Flushed with the rest of the ring right before submit.
+  globals_offsets_[frame] = frame_ring_.push(globals).offset;
+
+  return view_proj;
+}
+
+float Renderer::lod_error_scale(math::Camera const& cam, float viewport_height) const {
+  return (lod_threshold_px_ > 0.0f) ? cam.projection_scale(viewport_height) / lod_threshold_px_ : 0.0f;
+}
+
+std::uint32_t Renderer::select_lod(Mesh const& mesh,
+                                  glm::mat4 const& model,
+                                  math::Camera const& cam,
+                                  float viewport_height) const {
+  return pick_lod(mesh, model, cam.eye(), lod_error_scale(cam, viewport_height));
+}
+
+DrawList const& Renderer::resolve_lods(DrawList const& list, math::Camera const& cam, float viewport_height) {
+  std::span<DrawItem const> const items = list.items();
+  if (std::none_of(items.begin(), items.end(), [](DrawItem const& item) { return item.select_lod; })) {
+    return list;
+  }
+
+  float const error_scale = lod_error_scale(cam, viewport_height);
+  std::span<glm::mat4 const> const instances = list.instances();
+  resolved_.clear();
+
+  for (std::size_t i = 0; i < items.size();) {
+    DrawItem const& item = items[i];
+    std::span<glm::mat4 const> const models = instances.subspan(item.first_instance, item.instance_count);
+
+    resolved_.set_pipeline(item.pipeline);
+    resolved_.set_material(item.material);
+
+    if (item.select_lod) {
+      for (auto& bucket : lod_models_) {
+        bucket.clear();
+      }
+      for (glm::mat4 const& m : models) {
+        lod_models_[pick_lod(*item.mesh, m, cam.eye(), error_scale)].push_back(m);
+      }
+      for (std::uint32_t l = 0; l < item.mesh->lod_count(); ++l) {
+        MeshLod const& lod = item.mesh->lod(l);
+        resolved_.add(*item.mesh, lod_models_[l], IndexRange{lod.first_index, lod.index_count});
+      }
+      ++i;
+      continue;
+    }
+
+    // Consecutive ranges of one instance (surviving clusters) keep sharing it.
+    std::size_t end = i + 1U;
+    while (end < items.size() && !items[end].select_lod && items[end].first_instance == item.first_instance) {
+      ++end;
+    }
+    if (end - i > 1U) {
+      shared_ranges_.clear();
+      for (std::size_t j = i; j < end; ++j) {
+        shared_ranges_.push_back(IndexRange{items[j].first_index, items[j].index_count});
+      }
+      resolved_.add(*item.mesh, models.front(), shared_ranges_);
+    } else {
+      resolved_.add(*item.mesh, models, IndexRange{item.first_index, item.index_count});
+    }
+    i = end;
+  }
+
+  return resolved_;
+}
+
+void Renderer::write_instances(Context const& ctx, std::uint32_t frame, DrawList const& list) {
+  std::span<glm::mat4 const> const instances = list.instances();
+
+  Buffer& ib = instance_buffers_.at(frame);
+  std::size_t const needed = instances.size() * sizeof(glm::mat4);
+  if (needed > static_cast<std::size_t>(ib.size())) {
+    // This frame's fence has signalled, so nothing on the GPU still reads it.
+    std::size_t capacity = static_cast<std::size_t>(ib.size()) / sizeof(glm::mat4);
+    while (capacity < instances.size()) {
+      capacity *= 2U;
+    }
+    ib.shutdown(ctx);
+    ib.init(ctx, capacity * sizeof(glm::mat4), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, host_visible());
+  }
+
+  auto* dst = static_cast<glm::mat4*>(ib.mapped());
+  DrawItem const* prev = nullptr;
+  for (DrawItem const& item : list.items()) {
+    // Index ranges of one instance share its matrices; write them once.
+    bool const shared = prev != nullptr && prev->first_instance == item.first_instance;
+    prev = &item;
+    if (shared) {
+      continue;
+    }
+
+    glm::mat4* out = dst + item.first_instance;
+    glm::mat4 const* in = instances.data() + item.first_instance;
+
+    if (item.mesh->vertex_format() == VertexFormat::Float32) {
+      std::memcpy(out, in, item.instance_count * sizeof(glm::mat4));
+    } else {
+      glm::mat4 const dequant = dequant_matrix(item.mesh->position_dequant());
+      for (std::uint32_t i = 0; i < item.instance_count; ++i) {
+        out[i] = in[i] * dequant;
+      }
+    }
+  }
+}
+
+Renderer::FrameTarget Renderer::frame_target(Swapchain const& sc, std::uint32_t image) {
+  FrameTarget t{};
+  t.extent = sc.extent();
+  t.image = sc.images().at(image);
+  t.view = sc.image_views().at(image);
+  t.framebuffer = framebuffers_.empty() ? VK_NULL_HANDLE : framebuffers_.at(image);
+  t.use = &color_uses_.at(image);
+  t.final_use = present_use();
+  t.index = image;
+  return t;
+}
+
+Renderer::FrameTarget Renderer::frame_target(OffscreenTarget& target, std::uint32_t image) {
+  FrameTarget t{};
+  t.extent = target.extent();
+  t.image = target.images().at(image);
+  t.view = target.image_views().at(image);
+  t.framebuffer = framebuffers_.empty() ? VK_NULL_HANDLE : framebuffers_.at(image);
+  t.use = &color_uses_.at(image);
+  t.final_use = target.readback() ? transfer_src_use() : color_attachment_use();
+  t.readback = target.readback() ? &target : nullptr;
+  t.index = image;
+  return t;
+}
+
+void Renderer::create_framebuffers(Context const& ctx,
+                                   std::vector<VkImageView> const& views,
+                                   VkExtent2D extent,
+                                   Pipeline const& pl,
+                                   Depth const& depth) {
+  // New images start out undefined; a swapchain image's first use still has to
+  // wait for the acquire semaphore, like every later one (see present_use()).
+  color_uses_.assign(views.size(),
+                     ImageUse{VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0});
+  depth_use_ = ImageUse{};
+
+  if (pl.dynamic_rendering()) {
+    return;
+  }
+
+  framebuffers_.assign(views.size(), VK_NULL_HANDLE);
+
+  for (std::size_t i = 0; i < views.size(); ++i) {
+    VkImageView attachments[] = {views[i], depth.view()};
 
     VkFramebufferCreateInfo ci{};
     ci.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     ci.renderPass = pl.render_pass();
     ci.attachmentCount = 2;
     ci.pAttachments = attachments;
-    ci.width = sc.extent().width;
-    ci.height = sc.extent().height;
+    ci.width = extent.width;
+    ci.height = extent.height;
     ci.layers = 1;
 
     vk_check(vkCreateFramebuffer(ctx.device(), &ci, nullptr, &framebuffers_[i]), "vkCreateFramebuffer");
@@ -192,17 +817,180 @@ void Renderer::destroy_framebuffers(Context const& ctx) {
   framebuffers_.clear();
 }
 
-void Renderer::record_command_buffer(VkCommandBuffer cb,
-                                     Swapchain const& sc,
+void Renderer::record_command_buffer(Context const& ctx,
+                                     VkCommandBuffer cb,
+                                     FrameTarget const& target,
                                      Pipeline const& pl,
-                                     VkFramebuffer fb,
-                                     Mesh const& mesh,
-                                     math::Camera const& cam,
-                                     glm::mat4 const& model) {
+                                     Depth const& depth,
+                                     DrawList const& list,
+                                     std::uint32_t frame) {
+  std::size_t const draw_count = list.items().size();
+  std::uint32_t const slices = (jobs_ != nullptr)
+    ? static_cast<std::uint32_t>(std::min<std::size_t>(record_threads_, draw_count / kMinDrawsPerSecondary))
+    : 0U;
+
+  // A statistics query open across vkCmdExecuteCommands has to be inherited.
+  bool const statistics = (profiler_ != nullptr) && (slices <= 1U || ctx.supports_inherited_queries());
+
+  if (slices > 1U) {
+    // Each slice gets a contiguous run of draws and its own pool; no locking.
+    std::size_t const base = static_cast<std::size_t>(frame) * record_threads_;
+    auto const record_slice = [&](std::uint32_t s) {
+      CORE_ZONE("record slice");
+      VkCommandBuffer const sb = secondaries_[base + s];
+      vk_check(vkResetCommandPool(ctx.device(), record_pools_[base + s], 0), "vkResetCommandPool");
+
+      VkCommandBufferInheritanceRenderingInfoKHR rendering{};
+      rendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+      rendering.colorAttachmentCount = 1;
+      rendering.pColorAttachmentFormats = &pl.target().color_format;
+      rendering.depthAttachmentFormat = pl.target().depth_format;
+      rendering.stencilAttachmentFormat =
+        format_has_stencil(pl.target().depth_format) ? pl.target().depth_format : VK_FORMAT_UNDEFINED;
+      rendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+      VkCommandBufferInheritanceInfo inh{};
+      inh.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+      if (pl.dynamic_rendering()) {
+        inh.pNext = &rendering;
+      } else {
+        inh.renderPass = pl.render_pass();
+        inh.subpass = 0;
+        inh.framebuffer = target.framebuffer;
+      }
+      inh.pipelineStatistics = statistics ? profiler_->statistic_flags() : 0U;
+
+      VkCommandBufferBeginInfo sbi{};
+      sbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      sbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+      sbi.pInheritanceInfo = &inh;
+      vk_check(vkBeginCommandBuffer(sb, &sbi), "vkBeginCommandBuffer(secondary)");
+
+      std::size_t const first = draw_count * s / slices;
+      std::size_t const last = draw_count * (s + 1U) / slices;
+      record_draws(sb, target.extent, pl, list, frame, first, last);
+
+      vk_check(vkEndCommandBuffer(sb), "vkEndCommandBuffer(secondary)");
+    };
+    jobs_->parallel_for(slices, 1, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t s = begin; s < end; ++s) {
+        record_slice(static_cast<std::uint32_t>(s));
+      }
+    });
+  }
+
   VkCommandBufferBeginInfo bi{};
   bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   vk_check(vkBeginCommandBuffer(cb, &bi), "vkBeginCommandBuffer");
 
+  if (profiler_ != nullptr) {
+    profiler_->begin_frame(ctx, cb, frame);
+  }
+  std::uint32_t const frame_scope = begin_scope(profiler_, cb, "frame");
+  if (statistics) {
+    profiler_->begin_statistics(cb);
+  }
+
+  std::uint32_t const pass_scope = begin_scope(profiler_, cb, "main pass");
+  if (slices > 1U) {
+    begin_pass(ctx, cb, target, pl, depth, true);
+    vkCmdExecuteCommands(cb, slices, &secondaries_[static_cast<std::size_t>(frame) * record_threads_]);
+  } else {
+    begin_pass(ctx, cb, target, pl, depth, false);
+    record_draws(cb, target.extent, pl, list, frame, 0, draw_count);
+  }
+  end_pass(ctx, cb, target, pl);
+  end_scope(profiler_, cb, pass_scope);
+
+  if (statistics) {
+    profiler_->end_statistics(cb);
+  }
+  end_scope(profiler_, cb, frame_scope);
+  vk_check(vkEndCommandBuffer(cb), "vkEndCommandBuffer");
+}
+
+void Renderer::record_scene_command_buffer(Context const& ctx,
+                                           VkCommandBuffer cb,
+                                           FrameTarget const& target,
+                                           Pipeline const& pl,
+                                           Depth const& depth,
+                                           GpuScene& scene,
+                                           math::Camera const& cam,
+                                           glm::mat4 const& view_proj,
+                                           std::uint32_t frame) {
+  VkCommandBufferBeginInfo bi{};
+  bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  vk_check(vkBeginCommandBuffer(cb, &bi), "vkBeginCommandBuffer");
+
+  if (profiler_ != nullptr) {
+    profiler_->begin_frame(ctx, cb, frame);
+  }
+  std::uint32_t const frame_scope = begin_scope(profiler_, cb, "frame");
+  if (profiler_ != nullptr) {
+    profiler_->begin_statistics(cb);
+  }
+
+  // Upload and cull ahead of the render pass; GpuScene adds the barriers.
+  std::uint32_t scope = begin_scope(profiler_, cb, "upload");
+  scene.record_update(ctx, cb, frame);
+  end_scope(profiler_, cb, scope);
+
+  CullView view{};
+  view.view_proj = view_proj;
+  view.eye = cam.eye();
+  view.lod_error_scale = lod_error_scale(cam, static_cast<float>(target.extent.height));
+  view.viewport = target.extent;
+
+  bool const occlusion = pyramid_.initialized();
+
+  scope = begin_scope(profiler_, cb, "culling");
+  scene.record_cull(ctx, cb, frame, view, occlusion ? CullPhase::Early : CullPhase::All);
+  end_scope(profiler_, cb, scope);
+
+  scope = begin_scope(profiler_, cb, "main pass");
+  begin_pass(ctx, cb, target, pl, depth, false, occlusion ? PassPart::Early : PassPart::Whole);
+  bind_frame_state(cb, target.extent, pl, frame);
+  scene.record_draws(ctx, cb);
+  if (occlusion) {
+    ctx.cmd_end_rendering()(cb);
+  } else {
+    end_pass(ctx, cb, target, pl);
+  }
+  end_scope(profiler_, cb, scope);
+
+  if (occlusion) {
+    // Objects hidden behind what Early drew stay culled; the rest, new or
+    // uncovered since last frame, are drawn on top.
+    scope = begin_scope(profiler_, cb, "depth pyramid");
+    pyramid_.record_build(cb, depth, depth_use_);
+    end_scope(profiler_, cb, scope);
+
+    scope = begin_scope(profiler_, cb, "late culling");
+    scene.record_cull(ctx, cb, frame, view, CullPhase::Late, &pyramid_);
+    end_scope(profiler_, cb, scope);
+
+    scope = begin_scope(profiler_, cb, "late pass");
+    begin_pass(ctx, cb, target, pl, depth, false, PassPart::Late);
+    bind_frame_state(cb, target.extent, pl, frame);
+    scene.record_draws(ctx, cb);
+    end_pass(ctx, cb, target, pl);
+    end_scope(profiler_, cb, scope);
+  }
+
+  if (profiler_ != nullptr) {
+    profiler_->end_statistics(cb);
+  }
+  end_scope(profiler_, cb, frame_scope);
+  vk_check(vkEndCommandBuffer(cb), "vkEndCommandBuffer");
+}
+
+void Renderer::begin_pass(Context const& ctx,
+                          VkCommandBuffer cb,
+                          FrameTarget const& target,
+                          Pipeline const& pl,
+                          Depth const& depth,
+                          bool secondaries,
+                          PassPart part) {
   VkClearValue clears[2]{};
   clears[0].color.float32[0] = 0.05f;
   clears[0].color.float32[1] = 0.05f;
@@ -211,51 +999,165 @@ void Renderer::record_command_buffer(VkCommandBuffer cb,
   clears[1].depthStencil.depth = 1.0f;
   clears[1].depthStencil.stencil = 0;
 
-  VkRenderPassBeginInfo rpbi{};
-  rpbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  rpbi.renderPass = pl.render_pass();
-  rpbi.framebuffer = fb;
-  rpbi.renderArea.offset = {0, 0};
-  rpbi.renderArea.extent = sc.extent();
-  rpbi.clearValueCount = 2;
-  rpbi.pClearValues = clears;
+  if (!pl.dynamic_rendering()) {
+    if (part != PassPart::Whole) {
+      fail("Renderer::begin_pass: split passes need dynamic rendering");
+    }
+
+    VkRenderPassBeginInfo rpbi{};
+    rpbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpbi.renderPass = pl.render_pass();
+    rpbi.framebuffer = target.framebuffer;
+    rpbi.renderArea.offset = {0, 0};
+    rpbi.renderArea.extent = target.extent;
+    rpbi.clearValueCount = 2;
+    rpbi.pClearValues = clears;
+
+    vkCmdBeginRenderPass(cb, &rpbi, secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+    return;
+  }
+
+  // Cleared attachments discard their old contents; the barriers still wait
+  // for the previous frame's (or present's) use. Late keeps Early's.
+  bool const load = (part == PassPart::Late);
+  transition_image(cb, target.image, VK_IMAGE_ASPECT_COLOR_BIT, *target.use, color_attachment_use(), !load);
+  transition_image(cb, depth.image(), depth.aspect(), depth_use_, depth_attachment_use(), !load);
+
+  VkRenderingAttachmentInfoKHR color{};
+  color.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  color.imageView = target.view;
+  color.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  color.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+  color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  color.clearValue = clears[0];
+
+  VkRenderingAttachmentInfoKHR depth_att{};
+  depth_att.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  depth_att.imageView = depth.view();
+  depth_att.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depth_att.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depth_att.storeOp = (part == PassPart::Early) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_att.clearValue = clears[1];
+
+  VkRenderingInfoKHR ri{};
+  ri.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  ri.flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0U;
+  ri.renderArea.offset = {0, 0};
+  ri.renderArea.extent = target.extent;
+  ri.layerCount = 1;
+  ri.colorAttachmentCount = 1;
+  ri.pColorAttachments = &color;
+  ri.pDepthAttachment = &depth_att;
+  ri.pStencilAttachment = (depth.aspect() & VK_IMAGE_ASPECT_STENCIL_BIT) != 0U ? &depth_att : nullptr;
+
+  ctx.cmd_begin_rendering()(cb, &ri);
+}
+
+void Renderer::end_pass(Context const& ctx, VkCommandBuffer cb, FrameTarget const& target, Pipeline const& pl) {
+  if (!pl.dynamic_rendering()) {
+    vkCmdEndRenderPass(cb);
+    if (target.final_use.layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+      return; // the render pass itself moves the image to PRESENT_SRC
+    }
+    *target.use = color_attachment_use(); // offscreen render passes end here
+  } else {
+    ctx.cmd_end_rendering()(cb);
+  }
 
-  vkCmdBeginRenderPass(cb, &rpbi, VK_SUBPASS_CONTENTS_INLINE);
+  if (target.use->layout != target.final_use.layout) {
+    transition_image(cb, target.image, VK_IMAGE_ASPECT_COLOR_BIT, *target.use, target.final_use);
+  }
+  if (target.readback != nullptr) {
+    target.readback->record_readback(cb, target.index, submitted_frames_ + 1U);
+  }
+}
+
+void Renderer::bind_frame_state(VkCommandBuffer cb, VkExtent2D extent, Pipeline const& pl, std::uint32_t frame) const {
   vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pl.pipeline());
 
   VkViewport viewport{};
   viewport.x = 0.0f;
   viewport.y = 0.0f;
-  viewport.width = static_cast<float>(sc.extent().width);
-  viewport.height = static_cast<float>(sc.extent().height);
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
   vkCmdSetViewport(cb, 0, 1, &viewport);
 
   VkRect2D scissor{};
   scissor.offset = {0, 0};
-  scissor.extent = sc.extent();
+  scissor.extent = extent;
   vkCmdSetScissor(cb, 0, 1, &scissor);
 
-  float const aspect =
-    (sc.extent().height != 0U)
-      ? (static_cast<float>(sc.extent().width) / static_cast<float>(sc.extent().height))
-      : 1.0f;
+  vkCmdBindDescriptorSets(cb,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pl.pipeline_layout(),
+                          0,
+                          1,
+                          &frame_set_,
+                          1,
+                          &globals_offsets_[frame]);
+
+  VkDescriptorSet const material = material_or_default(VK_NULL_HANDLE);
+  vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pl.pipeline_layout(), 1, 1, &material, 0, nullptr);
+}
 
-  glm::mat4 const mvp = cam.mvp(aspect, model);
-  vkCmdPushConstants(cb, pl.pipeline_layout(), VK_SHADER_STAGE_VERTEX_BIT, 0, 16u * static_cast<uint32_t>(sizeof(float)), &mvp);
+void Renderer::record_draws(VkCommandBuffer cb,
+                            VkExtent2D extent,
+                            Pipeline const& pl,
+                            DrawList const& list,
+                            std::uint32_t frame,
+                            std::size_t first,
+                            std::size_t last) const {
+  bind_frame_state(cb, extent, pl, frame);
 
-  VkBuffer vb = mesh.vertex_buffer();
-  VkDeviceSize vb_offsets[] = {0};
-  vkCmdBindVertexBuffers(cb, 0, 1, &vb, vb_offsets);
+  if (first == last) {
+    return;
+  }
 
-  VkBuffer ib = mesh.index_buffer();
-  vkCmdBindIndexBuffer(cb, ib, 0, mesh.index_type());
+  // Instances are addressed with firstInstance, so binding 1 is bound once.
+  VkBuffer const instances = instance_buffers_.at(frame).handle();
+  VkDeviceSize const zero = 0;
+  vkCmdBindVertexBuffers(cb, kInstanceBinding, 1, &instances, &zero);
+
+  // Pooled meshes share buffers, so compare those rather than the mesh.
+  VkBuffer bound_vb = VK_NULL_HANDLE;
+  VkBuffer bound_ib = VK_NULL_HANDLE;
+  VkPipeline bound_pipeline = pl.pipeline();
+  VkDescriptorSet bound_material = material_or_default(VK_NULL_HANDLE);
+  for (std::size_t i = first; i < last; ++i) {
+    DrawItem const& item = list.items()[i];
+
+    VkPipeline const pipeline = (item.pipeline != VK_NULL_HANDLE) ? item.pipeline : pl.pipeline();
+    if (pipeline != bound_pipeline) {
+      vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+      bound_pipeline = pipeline;
+    }
 
-  vkCmdDrawIndexed(cb, mesh.index_count(), 1, 0, 0, 0);
+    VkDescriptorSet const material = material_or_default(item.material);
+    if (material != bound_material) {
+      vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pl.pipeline_layout(), 1, 1, &material, 0, nullptr);
+      bound_material = material;
+    }
 
-  vkCmdEndRenderPass(cb);
-  vk_check(vkEndCommandBuffer(cb), "vkEndCommandBuffer");
+    VkBuffer const vb = item.mesh->vertex_buffer();
+    if (vb != bound_vb) {
+      vkCmdBindVertexBuffers(cb, 0, 1, &vb, &zero);
+      bound_vb = vb;
+    }
+    VkBuffer const ib = item.mesh->index_buffer();
+    if (ib != bound_ib) {
+      vkCmdBindIndexBuffer(cb, ib, 0, item.mesh->index_type());
+      bound_ib = ib;
+    }
+
+    vkCmdDrawIndexed(cb,
+                     item.index_count,
+                     item.instance_count,
+                     item.mesh->first_index() + item.first_index,
+                     item.mesh->vertex_offset(),
+                     item.first_instance);
+  }
 }
 
 void Renderer::recreate_swapchain_dependent(Context const& ctx,
@@ -263,22 +1165,29 @@ void Renderer::recreate_swapchain_dependent(Context const& ctx,
                                             Swapchain& sc,
                                             Pipeline const& pl,
                                             Depth& depth) {
-  vk_check(vkDeviceWaitIdle(ctx.device()), "vkDeviceWaitIdle");
-
-  sc.recreate(ctx, window);
-
-  depth.shutdown(ctx);
-  depth.init(ctx, sc);
+  // No device wait: whatever the submitted frames still use is retired under
+  // the latest serial and destroyed once its fence has signalled.
+  std::uint64_t const serial = submitted_frames_;
+
+  sc.recreate(ctx, window, retired_, serial);
+  depth.recreate(ctx, sc, retired_, serial);
+
+  if (!framebuffers_.empty()) {
+    retired_.push(serial, [fbs = std::move(framebuffers_)](Context const& c) {
+      for (VkFramebuffer fb : fbs) {
+        if (fb != VK_NULL_HANDLE) {
+          vkDestroyFramebuffer(c.device(), fb, nullptr);
+        }
+      }
+    });
+    framebuffers_.clear();
+  }
 
-  destroy_framebuffers(ctx);
+  create_framebuffers(ctx, sc.image_views(), sc.extent(), pl, depth);
 
-  std::size_t const image_count = sc.images().size();
-  if (command_buffers_.size() != image_count) {
-    free_command_buffers(ctx);
-    allocate_command_buffers(ctx, image_count);
+  if (pyramid_.initialized()) {
+    pyramid_.recreate(ctx, depth, retired_, serial);
   }
-
-  create_framebuffers(ctx, sc, pl, depth);
 }
 
 bool Renderer::draw_frame(Context const& ctx,
@@ -287,25 +1196,176 @@ bool Renderer::draw_frame(Context const& ctx,
                           Pipeline const& pl,
                           Mesh const& mesh,
                           math::Camera const& cam,
-                          glm::mat4 const& model,
+                          std::span<glm::mat4 const> instances,
+                          Depth& depth) {
+  single_.clear();
+  single_.add(mesh, instances);
+  return draw_frame(ctx, window, sc, pl, single_, cam, depth);
+}
+
+bool Renderer::draw_frame(Context const& ctx,
+                          GLFWwindow* window,
+                          Swapchain& sc,
+                          Pipeline const& pl,
+                          DrawList const& list,
+                          math::Camera const& cam,
+                          Depth& depth) {
+  check_vertex_formats(list, pl);
+
+  return run_frame(ctx, window, sc, pl, depth, [&](VkCommandBuffer cb, std::uint32_t image) {
+    FrameTarget const target = frame_target(sc, image);
+    write_frame_globals(frame_index_, target.extent, cam);
+    DrawList const& drawn = resolve_lods(list, cam, static_cast<float>(target.extent.height));
+    write_instances(ctx, frame_index_, drawn);
+    record_command_buffer(ctx, cb, target, pl, depth, drawn, frame_index_);
+  });
+}
+
+bool Renderer::draw_frame(Context const& ctx,
+                          GLFWwindow* window,
+                          Swapchain& sc,
+                          Pipeline const& pl,
+                          GpuScene& scene,
+                          math::Camera const& cam,
                           Depth& depth) {
+  return run_frame(ctx, window, sc, pl, depth, [&](VkCommandBuffer cb, std::uint32_t image) {
+    FrameTarget const target = frame_target(sc, image);
+    glm::mat4 const view_proj = write_frame_globals(frame_index_, target.extent, cam);
+    record_scene_command_buffer(ctx, cb, target, pl, depth, scene, cam, view_proj, frame_index_);
+  });
+}
+
+std::uint64_t Renderer::draw_frame(Context const& ctx,
+                                   OffscreenTarget& target,
+                                   Pipeline const& pl,
+                                   DrawList const& list,
+                                   math::Camera const& cam,
+                                   Depth& depth) {
+  check_vertex_formats(list, pl);
+
+  return run_offscreen_frame(ctx, target, [&](VkCommandBuffer cb, std::uint32_t image) {
+    FrameTarget const t = frame_target(target, image);
+    write_frame_globals(frame_index_, t.extent, cam);
+    DrawList const& drawn = resolve_lods(list, cam, static_cast<float>(t.extent.height));
+    write_instances(ctx, frame_index_, drawn);
+    record_command_buffer(ctx, cb, t, pl, depth, drawn, frame_index_);
+  });
+}
+
+std::uint64_t Renderer::draw_frame(Context const& ctx,
+                                   OffscreenTarget& target,
+                                   Pipeline const& pl,
+                                   GpuScene& scene,
+                                   math::Camera const& cam,
+                                   Depth& depth) {
+  return run_offscreen_frame(ctx, target, [&](VkCommandBuffer cb, std::uint32_t image) {
+    FrameTarget const t = frame_target(target, image);
+    glm::mat4 const view_proj = write_frame_globals(frame_index_, t.extent, cam);
+    record_scene_command_buffer(ctx, cb, t, pl, depth, scene, cam, view_proj, frame_index_);
+  });
+}
+
+void Renderer::finish(Context const& ctx, OffscreenTarget& target) {
+  // Slots from the current one onwards were submitted oldest first.
+  for (std::uint32_t i = 0; i < pacing_.frames_in_flight; ++i) {
+    std::uint32_t const slot = (frame_index_ + i) % pacing_.frames_in_flight;
+    VkFence const fence = in_flight_.at(slot);
+    {
+      CORE_WAIT_ZONE("fence wait");
+      vk_check(vkWaitForFences(ctx.device(), 1, &fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+    }
+    target.complete(slot);
+  }
+  completed_frames_ = submitted_frames_;
+}
+
+std::uint64_t Renderer::run_offscreen_frame(Context const& ctx,
+                                            OffscreenTarget& target,
+                                            std::function<void(VkCommandBuffer, std::uint32_t)> const& record) {
+  CORE_ZONE("draw_frame");
+
+  VkFence const fence = in_flight_.at(frame_index_);
+  {
+    CORE_WAIT_ZONE("fence wait");
+    vk_check(vkWaitForFences(ctx.device(), 1, &fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+  }
+  completed_frames_ = slot_serials_[frame_index_];
+  retired_.collect(ctx, completed_frames_);
+  frame_ring_.begin_frame(frame_index_);
+
+  // The slot's previous copy is on the host now; hand it over before this
+  // frame's copy overwrites the buffer.
+  target.complete(frame_index_);
+
+  vk_check(vkResetFences(ctx.device(), 1, &fence), "vkResetFences");
+
+  VkCommandBuffer cb = command_buffers_.at(frame_index_);
+  vk_check(vkResetCommandBuffer(cb, 0), "vkResetCommandBuffer");
+  {
+    CORE_ZONE("record");
+    record(cb, frame_index_);
+  }
+
+  VkSubmitInfo si{};
+  si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  si.commandBufferCount = 1;
+  si.pCommandBuffers = &cb;
+
+  frame_ring_.flush(ctx);
+  {
+    CORE_ZONE("submit");
+    vk_check(vkQueueSubmit(ctx.graphics_queue(), 1, &si, fence), "vkQueueSubmit");
+  }
+  slot_serials_[frame_index_] = ++submitted_frames_;
+
+  frame_index_ = (frame_index_ + 1U) % pacing_.frames_in_flight;
+  return submitted_frames_;
+}
+
+bool Renderer::run_frame(Context const& ctx,
+                         GLFWwindow* window,
+                         Swapchain& sc,
+                         Pipeline const& pl,
+                         Depth& depth,
+                         std::function<void(VkCommandBuffer, std::uint32_t)> const& record) {
   if (window == nullptr) {
     fail("Renderer::draw_frame: window == nullptr");
   }
+  CORE_ZONE("draw_frame");
+
+  if (!input_sampled_) {
+    input_time_ = glfwGetTime();
+  }
+  input_sampled_ = false;
+  collect_presents(ctx, sc, 0);
 
   VkFence const fence = in_flight_.at(frame_index_);
-  vk_check(vkWaitForFences(ctx.device(), 1, &fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
-  vk_check(vkResetFences(ctx.device(), 1, &fence), "vkResetFences");
+  {
+    CORE_WAIT_ZONE("fence wait");
+    vk_check(vkWaitForFences(ctx.device(), 1, &fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+  }
+  completed_frames_ = slot_serials_[frame_index_];
+  retired_.collect(ctx, completed_frames_);
+  frame_ring_.begin_frame(frame_index_);
+
+  if (sc.needs_recreate()) {
+    // New present mode or image count.
+    recreate_swapchain_dependent(ctx, window, sc, pl, depth);
+  }
 
   uint32_t image_index = 0;
-  VkResult acq = vkAcquireNextImageKHR(
-    ctx.device(),
-    sc.handle(),
-    UINT64_MAX,
-    image_available_.at(frame_index_),
-    VK_NULL_HANDLE,
-    &image_index
-  );
+  VkResult acq = VK_SUCCESS;
+  {
+    CORE_WAIT_ZONE("acquire");
+    acq = vkAcquireNextImageKHR(
+      ctx.device(),
+      sc.handle(),
+      UINT64_MAX,
+      image_available_.at(frame_index_),
+      VK_NULL_HANDLE,
+      &image_index
+    );
+  }
 
   if (acq == VK_ERROR_OUT_OF_DATE_KHR) {
     recreate_swapchain_dependent(ctx, window, sc, pl, depth);
@@ -316,9 +1376,18 @@ bool Renderer::draw_frame(Context const& ctx,
     fail(std::string("vkAcquireNextImageKHR failed: ") + std::to_string(static_cast<int>(acq)));
   }
 
-  VkCommandBuffer cb = command_buffers_.at(static_cast<std::size_t>(image_index));
+  // Only reset once a submit is certain to follow: a fence left unsignalled by
+  // an early return would block this slot forever.
+  vk_check(vkResetFences(ctx.device(), 1, &fence), "vkResetFences");
+
+  // Per slot, not per image: an image can come back from acquire while the
+  // frame that last drew to it is still executing.
+  VkCommandBuffer cb = command_buffers_.at(frame_index_);
   vk_check(vkResetCommandBuffer(cb, 0), "vkResetCommandBuffer");
-  record_command_buffer(cb, sc, pl, framebuffers_.at(static_cast<std::size_t>(image_index)), mesh, cam, model);
+  {
+    CORE_ZONE("record");
+    record(cb, image_index);
+  }
 
   VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
@@ -332,7 +1401,12 @@ bool Renderer::draw_frame(Context const& ctx,
   si.signalSemaphoreCount = 1;
   si.pSignalSemaphores = &render_finished_.at(frame_index_);
 
-  vk_check(vkQueueSubmit(ctx.graphics_queue(), 1, &si, fence), "vkQueueSubmit");
+  frame_ring_.flush(ctx);
+  {
+    CORE_ZONE("submit");
+    vk_check(vkQueueSubmit(ctx.graphics_queue(), 1, &si, fence), "vkQueueSubmit");
+  }
+  slot_serials_[frame_index_] = ++submitted_frames_;
 
   VkPresentInfoKHR pi{};
   pi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -343,10 +1417,34 @@ bool Renderer::draw_frame(Context const& ctx,
   pi.pSwapchains = &sc_handle;
   pi.pImageIndices = &image_index;
 
-  VkResult pres = vkQueuePresentKHR(ctx.present_queue(), &pi);
+  std::uint64_t const present_id = present_id_ + 1U;
+  VkPresentIdKHR pid{};
+  pid.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+  pid.swapchainCount = 1;
+  pid.pPresentIds = &present_id;
+  if (ctx.supports_present_wait()) {
+    pi.pNext = &pid;
+  }
+
+  VkResult pres = VK_SUCCESS;
+  {
+    CORE_WAIT_ZONE("present"); // blocks under FIFO once the queue is full
+    pres = vkQueuePresentKHR(ctx.present_queue(), &pi);
+  }
+  present_id_ = present_id;
+  if (pres == VK_SUCCESS || pres == VK_SUBOPTIMAL_KHR) {
+    if (!ctx.supports_present_wait()) {
+      add_latency_sample((glfwGetTime() - input_time_) * 1000.0, false);
+    } else if (pending_swapchain_ == sc.handle()) {
+      if (pending_presents_.size() == kMaxPendingPresents) {
+        pending_presents_.pop_front(); // never displayed; stop tracking it
+      }
+      pending_presents_.push_back(PendingPresent{present_id, input_time_});
+    }
+  }
   if (pres == VK_ERROR_OUT_OF_DATE_KHR || pres == VK_SUBOPTIMAL_KHR || acq == VK_SUBOPTIMAL_KHR) {
     recreate_swapchain_dependent(ctx, window, sc, pl, depth);
-    frame_index_ = (frame_index_ + 1U) % kMaxFramesInFlight;
+    frame_index_ = (frame_index_ + 1U) % pacing_.frames_in_flight;
     return false;
   }
 
@@ -354,7 +1452,7 @@ bool Renderer::draw_frame(Context const& ctx,
     fail(std::string("vkQueuePresentKHR failed: ") + std::to_string(static_cast<int>(pres)));
   }
 
-  frame_index_ = (frame_index_ + 1U) % kMaxFramesInFlight;
+  frame_index_ = (frame_index_ + 1U) % pacing_.frames_in_flight;
   return true;
 }
 
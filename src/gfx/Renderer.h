@@ -2,13 +2,28 @@
 
 #include <vulkan/vulkan.h>
 
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 
+#include "gfx/Barrier.h"
+#include "gfx/Buffer.h"
+#include "gfx/DeletionQueue.h"
+#include "gfx/DepthPyramid.h"
+#include "gfx/DrawList.h"
+#include "gfx/FrameRing.h"
+#include "gfx/Image.h"
+#include "gfx/Mesh.h"
+
 struct GLFWwindow;
 
+namespace core { class JobSystem; }
 namespace math { class Camera; }
 
 namespace gfx {
@@ -16,10 +31,38 @@ namespace gfx {
 class Context;
 class Swapchain;
 class Pipeline;
-class Mesh;
 class Depth;
+class GpuProfiler;
+class GpuScene;
+class OffscreenTarget;
+
+// How far the CPU may run ahead of the display. One frame in flight with
+// present waits keeps every frame's input at most one refresh old; three or
+// more keep a throughput benchmark from ever waiting on the CPU.
+struct FramePacing {
+  std::uint32_t frames_in_flight = 2; // 1..Renderer::kMaxFramesInFlight
+  // With VK_KHR_present_wait, wait_for_frame() also blocks until no more than
+  // frames_in_flight presents are queued ahead of the display. Ignored without it.
+  bool wait_for_present = false;
+};
+
+// Input-to-present latency: from the input sample (wait_for_frame(), or the
+// start of draw_frame() without it) to the frame reaching the display. Without
+// present waits it is measured to the return of vkQueuePresentKHR instead and
+// `to_display` is false, which leaves out the compositor and scanout. Display
+// samples are taken when a wait returns; unpaced ones are polled once a frame
+// and may read up to a frame late.
+struct PresentLatency {
+  double last_ms = 0.0;
+  double average_ms = 0.0; // exponential, over roughly the last 30 frames
+  std::uint64_t samples = 0;
+  bool to_display = false;
+};
 
 class Renderer {
+public:
+  static constexpr std::uint32_t kMaxFramesInFlight = 4; // per-frame arrays are sized for this
+
 public:
   Renderer() = default;
   ~Renderer();
@@ -30,19 +73,155 @@ public:
   Renderer(Renderer&& other) noexcept;
   Renderer& operator=(Renderer&& other) noexcept;
 
-  void init(Context const& ctx, Swapchain const& sc, Pipeline const& pl, Depth const& depth);
+  // record_threads: 1 records every draw inline on the calling thread; N > 1 splits
+  // large draw lists into up to N secondary command buffers recorded as jobs on
+  // set_jobs() (the caller included); 0 picks one per hardware thread. Per-frame
+  // resources other systems keep (e.g. GpuScene) should be sized by
+  // frames_in_flight().
+  void init(Context const& ctx,
+            Swapchain const& sc,
+            Pipeline const& pl,
+            Depth const& depth,
+            std::uint32_t record_threads = 1,
+            FramePacing const& pacing = {});
+
+  // Headless: renders into `target` instead of a swapchain; it needs at least
+  // frames_in_flight images. Use the OffscreenTarget draw_frame() overloads.
+  // FramePacing::wait_for_present does not apply.
+  void init(Context const& ctx,
+            OffscreenTarget const& target,
+            Pipeline const& pl,
+            Depth const& depth,
+            std::uint32_t record_threads = 1,
+            FramePacing const& pacing = {});
+
+  // Readbacks still in flight are dropped; call finish() first to keep them.
   void shutdown(Context const& ctx);
 
+  std::uint32_t frames_in_flight() const { return pacing_.frames_in_flight; }
+  FramePacing const& pacing() const { return pacing_; }
+
+  // Frame serials for resources the CPU reuses while frames may still read them
+  // (e.g. GeometryPool::release): tag them with submitted_frames() and reuse
+  // them once completed_frames() has reached the tag.
+  std::uint64_t submitted_frames() const { return submitted_frames_; }
+  std::uint64_t completed_frames() const { return completed_frames_; }
+
+  // Call right before polling input. Blocks until the next frame can start (its
+  // slot's fence, plus the display with FramePacing::wait_for_present), so the
+  // input the following draw_frame() consumes is as fresh as the policy allows.
+  // Optional; draw_frame() waits for the slot itself.
+  void wait_for_frame(Context const& ctx, Swapchain const& sc);
+
+  PresentLatency const& latency() const { return latency_; }
+
+  // Times "frame", "main pass" and, for GpuScene frames, "upload" and "culling"
+  // (plus "depth pyramid", "late culling" and "late pass" with occlusion
+  // culling) on the GPU. Not owned; init it with frames_in_flight(). nullptr
+  // turns it off.
+  void set_profiler(GpuProfiler* profiler) { profiler_ = profiler; }
+
+  // Records secondary command buffers in parallel. Not owned; nullptr records
+  // every draw on the calling thread.
+  void set_jobs(core::JobSystem* jobs) { jobs_ = jobs; }
+
+  // GpuScene frames draw what was visible last frame, build a DepthPyramid from
+  // that depth, then draw whatever the pyramid does not hide. Needs dynamic
+  // rendering (the render pass path would need a second, loading pass) and a
+  // Depth::sampled() depth buffer; returns false, leaving frames frustum
+  // culled, without them.
+  bool enable_occlusion_culling(Context const& ctx,
+                                std::string const& pyramid_spv_path,
+                                Pipeline const& pl,
+                                Depth const& depth);
+  bool occlusion_culling() const { return pyramid_.initialized(); }
+
+  // Draws every item of `list`, one instanced draw each. Instance matrices are
+  // copied into this frame's instance buffer, so the list may be reused right away.
+  // Whole-mesh items of meshes with several LODs are drawn at select_lod().
+  bool draw_frame(Context const& ctx,
+                  GLFWwindow* window,
+                  Swapchain& sc,
+                  Pipeline const& pl,
+                  DrawList const& list,
+                  math::Camera const& cam,
+                  Depth& depth);
+
+  // Single mesh, one instance per model matrix.
   bool draw_frame(Context const& ctx,
                   GLFWwindow* window,
                   Swapchain& sc,
                   Pipeline const& pl,
                   Mesh const& mesh,
                   math::Camera const& cam,
-                  glm::mat4 const& model,
+                  std::span<glm::mat4 const> instances,
                   Depth& depth);
 
+  // GPU-driven: updates and culls `scene` on the GPU, then draws it with one
+  // indirect draw per mesh. `pl` must match the scene's vertex format.
+  bool draw_frame(Context const& ctx,
+                  GLFWwindow* window,
+                  Swapchain& sc,
+                  Pipeline const& pl,
+                  GpuScene& scene,
+                  math::Camera const& cam,
+                  Depth& depth);
+
+  // Offscreen: waits only for the frame slot, delivers the readback of the frame
+  // that last used it, then records and submits without presenting. As fast as
+  // the GPU allows; returns the frame's number (see Readback::frame).
+  std::uint64_t draw_frame(Context const& ctx,
+                           OffscreenTarget& target,
+                           Pipeline const& pl,
+                           DrawList const& list,
+                           math::Camera const& cam,
+                           Depth& depth);
+
+  std::uint64_t draw_frame(Context const& ctx,
+                           OffscreenTarget& target,
+                           Pipeline const& pl,
+                           GpuScene& scene,
+                           math::Camera const& cam,
+                           Depth& depth);
+
+  // Waits for every frame in flight and delivers their readbacks, oldest first.
+  void finish(Context const& ctx, OffscreenTarget& target);
+
+  // Coarsest level whose error projects to at most the LOD threshold in pixels,
+  // measured from the mesh's bounding sphere under `model`.
+  std::uint32_t select_lod(Mesh const& mesh,
+                           glm::mat4 const& model,
+                           math::Camera const& cam,
+                           float viewport_height) const;
+
+  // Material (Pipeline::material_set_layout()) for draw items without one and
+  // for GpuScene draws, e.g. a TextureStreamer set; VK_NULL_HANDLE restores the
+  // 1x1 white texture. Read when frames are recorded.
+  void set_default_material(VkDescriptorSet material) { default_material_ = material; }
+
+  // Screen-space error, in pixels, a coarser LOD may introduce. 0 keeps level 0.
+  void set_lod_threshold(float pixels) { lod_threshold_px_ = pixels; }
+  float lod_threshold() const { return lod_threshold_px_; }
+
 private:
+  // One frame's color attachment: a swapchain image or an offscreen one.
+  struct FrameTarget {
+    VkExtent2D extent{};
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE; // render pass path only
+    ImageUse* use = nullptr;                    // tracked across frames
+    ImageUse final_use{};                       // what end_pass() leaves it ready for
+    OffscreenTarget* readback = nullptr;        // copy to host after the pass
+    std::uint32_t index = 0;
+  };
+
+  FrameTarget frame_target(Swapchain const& sc, std::uint32_t image);
+  FrameTarget frame_target(OffscreenTarget& target, std::uint32_t image);
+
+  // Everything but the target-dependent framebuffers.
+  void init_frames(Context const& ctx, Pipeline const& pl, std::uint32_t record_threads, FramePacing const& pacing);
+
   void create_command_pool(Context const& ctx);
 
   void allocate_command_buffers(Context const& ctx, std::size_t count);
@@ -51,16 +230,107 @@ private:
   void create_sync(Context const& ctx);
   void destroy_sync(Context const& ctx);
 
-  void create_framebuffers(Context const& ctx, Swapchain const& sc, Pipeline const& pl, Depth const& depth);
+  void create_frame_resources(Context const& ctx, Pipeline const& pl);
+  void destroy_frame_resources(Context const& ctx);
+
+  // White texture and its set, out of descriptor_pool_; needs command_pool_.
+  void create_white_material(Context const& ctx, Pipeline const& pl);
+
+  VkDescriptorSet material_or_default(VkDescriptorSet material) const;
+
+  void create_record_pools(Context const& ctx);
+  void destroy_record_pools(Context const& ctx);
+
+  // Returns the view-projection it wrote.
+  glm::mat4 write_frame_globals(std::uint32_t frame,
+                                VkExtent2D extent,
+                                math::Camera const& cam);
+  void write_instances(Context const& ctx, std::uint32_t frame, DrawList const& list);
+
+  // Pixels per object-space unit at distance 1, over the threshold; 0 = level 0 only.
+  float lod_error_scale(math::Camera const& cam, float viewport_height) const;
+
+  // `list` with select_lod items split per chosen level, or `list` itself when
+  // nothing needs selecting. The result lives until the next call.
+  DrawList const& resolve_lods(DrawList const& list, math::Camera const& cam, float viewport_height);
+
+  void create_framebuffers(Context const& ctx,
+                           std::vector<VkImageView> const& views,
+                           VkExtent2D extent,
+                           Pipeline const& pl,
+                           Depth const& depth);
   void destroy_framebuffers(Context const& ctx);
 
-  void record_command_buffer(VkCommandBuffer cb,
-                            Swapchain const& sc,
-                            Pipeline const& pl,
-                            VkFramebuffer fb,
-                            Mesh const& mesh,
-                            math::Camera const& cam,
-                            glm::mat4 const& model);
+  void record_command_buffer(Context const& ctx,
+                             VkCommandBuffer cb,
+                             FrameTarget const& target,
+                             Pipeline const& pl,
+                             Depth const& depth,
+                             DrawList const& list,
+                             std::uint32_t frame);
+
+  void record_scene_command_buffer(Context const& ctx,
+                                   VkCommandBuffer cb,
+                                   FrameTarget const& target,
+                                   Pipeline const& pl,
+                                   Depth const& depth,
+                                   GpuScene& scene,
+                                   math::Camera const& cam,
+                                   glm::mat4 const& view_proj,
+                                   std::uint32_t frame);
+
+  // Occlusion-culled frames split the main pass in two around the pyramid.
+  enum class PassPart : std::uint8_t {
+    Whole, // clears both attachments, discards depth
+    Early, // clears both, keeps depth for the pyramid and Late; ends with
+           // cmd_end_rendering() instead of end_pass()
+    Late,  // loads both from Early
+  };
+
+  // Opens the pass on `target`: the render pass when `pl` has one, else
+  // vkCmdBeginRenderingKHR after moving both attachments into their attachment
+  // layouts. end_pass() leaves the image in target.final_use (ready to present,
+  // or to copy) and records the readback, if any. Only Whole has a render pass.
+  void begin_pass(Context const& ctx,
+                  VkCommandBuffer cb,
+                  FrameTarget const& target,
+                  Pipeline const& pl,
+                  Depth const& depth,
+                  bool secondaries,
+                  PassPart part = PassPart::Whole);
+  void end_pass(Context const& ctx, VkCommandBuffer cb, FrameTarget const& target, Pipeline const& pl);
+
+  // Pipeline, viewport, scissor, the frame's descriptor set and the default material.
+  void bind_frame_state(VkCommandBuffer cb, VkExtent2D extent, Pipeline const& pl, std::uint32_t frame) const;
+
+  // Frame state plus draws [first, last) of `list`; used for the primary and for
+  // each secondary slice.
+  void record_draws(VkCommandBuffer cb,
+                    VkExtent2D extent,
+                    Pipeline const& pl,
+                    DrawList const& list,
+                    std::uint32_t frame,
+                    std::size_t first,
+                    std::size_t last) const;
+
+  // Display times of finished presents, oldest first; `block_until` (0 for
+  // none) is waited for, the rest only polled.
+  void collect_presents(Context const& ctx, Swapchain const& sc, std::uint64_t block_until);
+  void add_latency_sample(double ms, bool to_display);
+
+  // Waits for the frame slot, acquires an image, calls `record` with the slot's
+  // command buffer and the image index, then submits and presents.
+  bool run_frame(Context const& ctx,
+                 GLFWwindow* window,
+                 Swapchain& sc,
+                 Pipeline const& pl,
+                 Depth& depth,
+                 std::function<void(VkCommandBuffer, std::uint32_t)> const& record);
+
+  // run_frame() without acquire and present; `record` gets the slot's image.
+  std::uint64_t run_offscreen_frame(Context const& ctx,
+                                    OffscreenTarget& target,
+                                    std::function<void(VkCommandBuffer, std::uint32_t)> const& record);
 
   void recreate_swapchain_dependent(Context const& ctx,
                                     GLFWwindow* window,
@@ -69,18 +339,87 @@ private:
                                     Depth& depth);
 
 private:
-  static constexpr std::uint32_t kMaxFramesInFlight = 2;
+  static constexpr std::size_t kMinInstanceCapacity = 1024;
+  static constexpr std::size_t kMinDrawsPerSecondary = 64; // below this, recording beats handoff
+  static constexpr std::uint64_t kPresentWaitTimeoutNs = 100'000'000; // paced wait gives up after 100 ms
+  static constexpr std::size_t kMaxPendingPresents = 8;
+  static constexpr double kLatencySmoothing = 2.0 / 31.0; // ~30-frame EMA
 
   VkCommandPool command_pool_ = VK_NULL_HANDLE;
-  std::vector<VkCommandBuffer> command_buffers_;
+  std::vector<VkCommandBuffer> command_buffers_; // per frame in flight
+
+  std::vector<VkFramebuffer> framebuffers_; // render pass path only
 
-  std::vector<VkFramebuffer> framebuffers_;
+  // Last known use of each swapchain (or offscreen) image and of the depth
+  // buffer, for the barriers of the dynamic rendering path.
+  std::vector<ImageUse> color_uses_;
+  ImageUse depth_use_{};
 
   std::vector<VkSemaphore> image_available_;
   std::vector<VkSemaphore> render_finished_;
   std::vector<VkFence> in_flight_;
 
+  // Per-frame uniforms come out of one ring region per frame in flight; the
+  // single descriptor set is bound at the frame's dynamic offset.
+  static constexpr VkDeviceSize kFrameRingCapacity = 64U * 1024U; // bytes per frame
+
+  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+  VkDescriptorSet frame_set_ = VK_NULL_HANDLE; // FrameGlobals, UNIFORM_BUFFER_DYNAMIC
+
+  // Set 1 for untextured draws: a 1x1 white image, cleared once at init.
+  Image white_texture_{};
+  VkSampler white_sampler_ = VK_NULL_HANDLE;
+  VkDescriptorSet white_material_ = VK_NULL_HANDLE;
+  VkDescriptorSet default_material_ = VK_NULL_HANDLE; // set_default_material(); not owned
+  FrameRing frame_ring_{};
+  std::uint32_t globals_offsets_[kMaxFramesInFlight]{}; // this frame's FrameGlobals slice
+
+  // Per frame in flight; reused once that frame's fence has signalled.
+  std::vector<Buffer> instance_buffers_; // mat4 per instance, grows on demand
+
+  // Multithreaded recording: one pool + secondary per (frame, thread), reset as a
+  // whole each frame. Indexed frame * record_threads_ + thread.
+  std::uint32_t record_threads_ = 1;
+  core::JobSystem* jobs_ = nullptr; // set_jobs(); not owned
+  std::vector<VkCommandPool> record_pools_;
+  std::vector<VkCommandBuffer> secondaries_;
+
+  DrawList single_{}; // backs the single-mesh draw_frame overload
+
+  float lod_threshold_px_ = 1.0f;
+  DrawList resolved_{}; // resolve_lods() output
+  std::vector<glm::mat4> lod_models_[Mesh::kMaxLods];
+  std::vector<IndexRange> shared_ranges_;
+
   std::uint32_t frame_index_ = 0;
+
+  FramePacing pacing_{};
+
+  // Input sample time of the frame being built, in glfwGetTime() seconds.
+  double input_time_ = 0.0;
+  bool input_sampled_ = false;
+
+  struct PendingPresent {
+    std::uint64_t id = 0;
+    double input_time = 0.0;
+  };
+  std::uint64_t present_id_ = 0; // last id handed to vkQueuePresentKHR
+  std::deque<PendingPresent> pending_presents_;
+  VkSwapchainKHR pending_swapchain_ = VK_NULL_HANDLE; // the ids above belong to it
+  PresentLatency latency_{};
+
+  GpuProfiler* profiler_ = nullptr; // not owned
+
+  DepthPyramid pyramid_{}; // enable_occlusion_culling(); follows the depth buffer
+
+  // Frames submitted so far, and per slot the count as of its last submit;
+  // once a slot's fence has signalled, everything up to its serial is done.
+  std::uint64_t submitted_frames_ = 0;
+  std::uint64_t slot_serials_[kMaxFramesInFlight]{};
+  std::uint64_t completed_frames_ = 0; // highest serial seen through a fence wait
+
+  // Swapchain-dependent resources replaced while frames were still in flight.
+  DeletionQueue retired_{};
 };
 
 } // namespace gfx
@@ -0,0 +1,62 @@
+#include "gfx/Shader.h"
+
+#include "gfx/Context.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+std::vector<std::uint32_t> read_spirv(std::string const& path) {
+  std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+  if (!ifs) {
+    fail(std::string("Failed to open SPIR-V file: ") + path);
+  }
+
+  std::streamsize const size = ifs.tellg();
+  if (size <= 0) {
+    fail(std::string("SPIR-V file is empty: ") + path);
+  }
+  if ((size % 4) != 0) {
+    fail(std::string("SPIR-V file size is not multiple of 4: ") + path);
+  }
+
+  std::vector<std::uint32_t> data(static_cast<std::size_t>(size / 4));
+  ifs.seekg(0, std::ios::beg);
+  if (!ifs.read(reinterpret_cast<char*>(data.data()), size)) {
+    fail(std::string("Failed to read SPIR-V file: ") + path);
+  }
+  return data;
+}
+
+} // namespace
+
+VkShaderModule create_shader_module(Context const& ctx, std::string const& spv_path) {
+  auto const code = read_spirv(spv_path);
+
+  VkShaderModuleCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  ci.codeSize = code.size() * sizeof(std::uint32_t);
+  ci.pCode = code.data();
+
+  VkShaderModule m = VK_NULL_HANDLE;
+  vk_check(vkCreateShaderModule(ctx.device(), &ci, nullptr, &m), "vkCreateShaderModule");
+  return m;
+}
+
+} // namespace gfx
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+namespace gfx {
+
+class Context;
+
+// Loads a SPIR-V file into a shader module. The caller destroys it, typically
+// right after the pipeline that uses it is created.
+VkShaderModule create_shader_module(Context const& ctx, std::string const& spv_path);
+
+} // namespace gfx
@@ -1,6 +1,7 @@
 #include "gfx/Swapchain.h"
 
 #include "gfx/Context.h"
+#include "gfx/DeletionQueue.h"
 #include "gfx/GlfwVulkan.h"
 
 #include <GLFW/glfw3.h>
@@ -76,13 +77,42 @@ VkSurfaceFormatKHR choose_surface_format(std::vector<VkSurfaceFormatKHR> const&
   return formats.front();
 }
 
-VkPresentModeKHR choose_present_mode(std::vector<VkPresentModeKHR> const& modes) {
-  // Always available: FIFO. Prefer MAILBOX if offered.
-  for (auto m : modes) {
-    if (m == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return m;
-    }
+char const* present_mode_name(VkPresentModeKHR m) {
+  switch (m) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+    default: return "other";
+  }
+}
+
+VkPresentModeKHR choose_present_mode(std::vector<VkPresentModeKHR> const& modes, PresentMode want) {
+  auto const offered = [&modes](VkPresentModeKHR m) {
+    return std::find(modes.begin(), modes.end(), m) != modes.end();
+  };
+
+  switch (want) {
+    case PresentMode::Immediate:
+      if (offered(VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+        return VK_PRESENT_MODE_IMMEDIATE_KHR;
+      }
+      [[fallthrough]];
+    case PresentMode::Mailbox:
+      if (offered(VK_PRESENT_MODE_MAILBOX_KHR)) {
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+      }
+      break;
+    case PresentMode::FifoRelaxed:
+      if (offered(VK_PRESENT_MODE_FIFO_RELAXED_KHR)) {
+        return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+      }
+      break;
+    case PresentMode::Fifo:
+      break;
   }
+
+  // Always available.
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -134,22 +164,29 @@ Swapchain& Swapchain::operator=(Swapchain&& other) noexcept {
   swapchain_ = other.swapchain_;
   image_format_ = other.image_format_;
   extent_ = other.extent_;
+  present_mode_ = other.present_mode_;
+  config_ = other.config_;
+  config_dirty_ = other.config_dirty_;
   images_ = std::move(other.images_);
   image_views_ = std::move(other.image_views_);
 
   other.swapchain_ = VK_NULL_HANDLE;
   other.image_format_ = VK_FORMAT_UNDEFINED;
   other.extent_ = {};
+  other.present_mode_ = VK_PRESENT_MODE_FIFO_KHR;
+  other.config_ = {};
+  other.config_dirty_ = false;
   other.images_.clear();
   other.image_views_.clear();
 
   return *this;
 }
 
-void Swapchain::init(Context const& ctx, GLFWwindow* window) {
+void Swapchain::init(Context const& ctx, GLFWwindow* window, SwapchainConfig const& config) {
   if (window == nullptr) {
     fail("Swapchain::init: window == nullptr");
   }
+  config_ = config;
   create_swapchain(ctx, window, VK_NULL_HANDLE);
   create_image_views(ctx);
 }
@@ -165,9 +202,18 @@ void Swapchain::shutdown(Context const& ctx) {
   images_.clear();
   image_format_ = VK_FORMAT_UNDEFINED;
   extent_ = {};
+  present_mode_ = VK_PRESENT_MODE_FIFO_KHR;
+  config_dirty_ = false;
+}
+
+void Swapchain::set_config(SwapchainConfig const& config) {
+  if (config.present_mode != config_.present_mode || config.image_count != config_.image_count) {
+    config_ = config;
+    config_dirty_ = true;
+  }
 }
 
-void Swapchain::recreate(Context const& ctx, GLFWwindow* window) {
+void Swapchain::recreate(Context const& ctx, GLFWwindow* window, DeletionQueue& retired, std::uint64_t serial) {
   if (window == nullptr) {
     fail("Swapchain::recreate: window == nullptr");
   }
@@ -182,26 +228,37 @@ void Swapchain::recreate(Context const& ctx, GLFWwindow* window) {
     }
   } while (w <= 0 || h <= 0);
 
-  vk_check(vkDeviceWaitIdle(ctx.device()), "vkDeviceWaitIdle");
+  VkSwapchainKHR const old = swapchain_;
+  std::vector<VkImageView> old_views = std::move(image_views_);
+  image_views_.clear();
 
-  destroy_image_views(ctx);
+  // The old swapchain is retired by this call even if creation fails, so it is
+  // queued before anything can throw.
+  retired.push(serial, [old, views = std::move(old_views)](Context const& c) {
+    for (VkImageView v : views) {
+      if (v != VK_NULL_HANDLE) {
+        vkDestroyImageView(c.device(), v, nullptr);
+      }
+    }
+    if (old != VK_NULL_HANDLE) {
+      vkDestroySwapchainKHR(c.device(), old, nullptr);
+    }
+  });
 
-  VkSwapchainKHR old = swapchain_;
+  swapchain_ = VK_NULL_HANDLE;
+  config_dirty_ = false;
   create_swapchain(ctx, window, old);
   create_image_views(ctx);
-
-  if (old != VK_NULL_HANDLE) {
-    vkDestroySwapchainKHR(ctx.device(), old, nullptr);
-  }
 }
 
 void Swapchain::create_swapchain(Context const& ctx, GLFWwindow* window, VkSwapchainKHR old_swapchain) {
   auto const support = query_swapchain_support(ctx.physical_device(), ctx.surface());
   auto const surface_format = choose_surface_format(support.formats);
-  auto const present_mode = choose_present_mode(support.present_modes);
+  auto const present_mode = choose_present_mode(support.present_modes, config_.present_mode);
   auto const chosen_extent = choose_extent(window, support.caps);
 
-  uint32_t image_count = support.caps.minImageCount + 1U;
+  uint32_t image_count = (config_.image_count != 0U) ? config_.image_count : support.caps.minImageCount + 1U;
+  image_count = std::max(image_count, support.caps.minImageCount);
   if (support.caps.maxImageCount != 0U && image_count > support.caps.maxImageCount) {
     image_count = support.caps.maxImageCount;
   }
@@ -239,6 +296,7 @@ void Swapchain::create_swapchain(Context const& ctx, GLFWwindow* window, VkSwapc
   swapchain_ = new_swapchain;
   image_format_ = surface_format.format;
   extent_ = chosen_extent;
+  present_mode_ = present_mode;
 
   uint32_t actual_count = 0;
   vk_check(vkGetSwapchainImagesKHR(ctx.device(), swapchain_, &actual_count, nullptr), "vkGetSwapchainImagesKHR(count)");
@@ -246,8 +304,8 @@ void Swapchain::create_swapchain(Context const& ctx, GLFWwindow* window, VkSwapc
   images_.resize(actual_count);
   vk_check(vkGetSwapchainImagesKHR(ctx.device(), swapchain_, &actual_count, images_.data()), "vkGetSwapchainImagesKHR(list)");
 
-  std::fprintf(stderr, "Swapchain: images=%u, extent=%ux%u\n",
-               actual_count, extent_.width, extent_.height);
+  std::fprintf(stderr, "Swapchain: images=%u, extent=%ux%u, present=%s\n",
+               actual_count, extent_.width, extent_.height, present_mode_name(present_mode_));
 }
 
 void Swapchain::create_image_views(Context const& ctx) {
@@ -10,6 +10,22 @@ struct GLFWwindow;
 namespace gfx {
 
 class Context;
+class DeletionQueue;
+
+// Presentation policy, resolved against what the surface offers.
+//   Fifo        vsync, always available; queues up to the image count
+//   FifoRelaxed vsync, but a late frame tears instead of waiting a full refresh
+//   Mailbox     vsync without blocking; the newest frame replaces a queued one
+//   Immediate   no vsync, lowest latency, tears
+// A mode the surface lacks falls back along: Immediate -> Mailbox -> Fifo,
+// FifoRelaxed -> Fifo.
+enum class PresentMode : std::uint8_t { Fifo, FifoRelaxed, Mailbox, Immediate };
+
+struct SwapchainConfig {
+  PresentMode present_mode = PresentMode::Mailbox;
+  // 0 asks for minImageCount + 1; clamped to what the surface allows.
+  std::uint32_t image_count = 0;
+};
 
 class Swapchain {
 public:
@@ -22,13 +38,23 @@ public:
   Swapchain(Swapchain&& other) noexcept;
   Swapchain& operator=(Swapchain&& other) noexcept;
 
-  void init(Context const& ctx, GLFWwindow* window);
+  void init(Context const& ctx, GLFWwindow* window, SwapchainConfig const& config = {});
   void shutdown(Context const& ctx);
 
-  // Minimal entry point for later: call when framebuffer size changes.
-  void recreate(Context const& ctx, GLFWwindow* window);
+  // Call when the framebuffer size changes or presentation reports
+  // out-of-date/suboptimal. Does not wait for the device: the old swapchain is
+  // passed as oldSwapchain, and it and its views go to `retired` under
+  // `serial`, to be destroyed once the frames that may still use them are done.
+  // Blocks only while the window is minimized.
+  void recreate(Context const& ctx, GLFWwindow* window, DeletionQueue& retired, std::uint64_t serial);
+
+  // Takes effect at the next recreate(); needs_recreate() says one is due.
+  void set_config(SwapchainConfig const& config);
+  SwapchainConfig const& config() const { return config_; }
+  bool needs_recreate() const { return config_dirty_; }
 
   VkSwapchainKHR handle() const { return swapchain_; }
+  VkPresentModeKHR present_mode() const { return present_mode_; } // as resolved
   VkFormat image_format() const { return image_format_; }
   VkExtent2D extent() const { return extent_; }
 
@@ -44,6 +70,10 @@ private:
   VkSwapchainKHR swapchain_ = VK_NULL_HANDLE;
   VkFormat image_format_ = VK_FORMAT_UNDEFINED;
   VkExtent2D extent_{};
+  VkPresentModeKHR present_mode_ = VK_PRESENT_MODE_FIFO_KHR;
+
+  SwapchainConfig config_{};
+  bool config_dirty_ = false;
 
   std::vector<VkImage> images_;
   std::vector<VkImageView> image_views_;
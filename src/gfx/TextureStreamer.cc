@@ -0,0 +1,711 @@
+#include "gfx/TextureStreamer.h"
+
+#include "assets/TextureCache.h"
+#include "core/JobSystem.h"
+#include "core/Profile.h"
+#include "gfx/Context.h"
+#include "gfx/DeletionQueue.h"
+#include "gfx/Image.h"
+#include "gfx/Upload.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+[[noreturn]] void fail(char const* msg) { throw std::runtime_error(msg); }
+[[noreturn]] void fail(std::string const& msg) { throw std::runtime_error(msg); }
+
+void vk_check(VkResult r, char const* what) {
+  if (r != VK_SUCCESS) {
+    fail(std::string("Vulkan error: ") + what + " (" + std::to_string(static_cast<int>(r)) + ")");
+  }
+}
+
+constexpr std::uint32_t kNotResident = UINT32_MAX;
+
+// enqueue_image copies a level into staging in one piece, so a level has to fit
+// the ring with room to spare for everyone else's uploads.
+constexpr VkDeviceSize kMaxLevelBytes = Upload::kDefaultStagingSize / 4U;
+
+VkFormat to_vk_format(assets::TextureFormat f) {
+  switch (f) {
+  case assets::TextureFormat::RGBA8_UNORM: return VK_FORMAT_R8G8B8A8_UNORM;
+  case assets::TextureFormat::RGBA8_SRGB: return VK_FORMAT_R8G8B8A8_SRGB;
+  case assets::TextureFormat::BC7_UNORM: return VK_FORMAT_BC7_UNORM_BLOCK;
+  case assets::TextureFormat::BC7_SRGB: return VK_FORMAT_BC7_SRGB_BLOCK;
+  case assets::TextureFormat::ASTC_4x4_UNORM: return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+  case assets::TextureFormat::ASTC_4x4_SRGB: return VK_FORMAT_ASTC_4x4_SRGB_BLOCK;
+  }
+  return VK_FORMAT_UNDEFINED;
+}
+
+bool format_supported(Context const& ctx, assets::TextureFormat f) {
+  switch (f) {
+  case assets::TextureFormat::BC7_UNORM:
+  case assets::TextureFormat::BC7_SRGB: return ctx.supports_bc_textures();
+  case assets::TextureFormat::ASTC_4x4_UNORM:
+  case assets::TextureFormat::ASTC_4x4_SRGB: return ctx.supports_astc_textures();
+  default: return true;
+  }
+}
+
+// First level of the tail: the finest one within `tail_size` on both sides, or
+// the coarsest level if the file stops short of that.
+std::uint32_t tail_first(assets::TextureCache const& cache, std::uint32_t tail_size) {
+  std::uint32_t const levels = cache.level_count();
+  for (std::uint32_t l = 0; l < levels; ++l) {
+    assets::TextureCache::Level const& lv = cache.level(l);
+    if (lv.width <= tail_size && lv.height <= tail_size) {
+      return l;
+    }
+  }
+  return levels - 1U;
+}
+
+VkDeviceSize range_bytes(assets::TextureCache const& cache, std::uint32_t first) {
+  VkDeviceSize bytes = 0;
+  for (std::uint32_t l = first; l < cache.level_count(); ++l) {
+    bytes += cache.level(l).size;
+  }
+  return bytes;
+}
+
+} // namespace
+
+struct TextureStreamer::Impl {
+  enum class State : std::uint8_t { Free, Opening, Ready, Failed };
+  enum class JobKind : std::uint8_t { Open, Prefetch };
+
+  struct Texture {
+    State state = State::Free;
+    std::uint64_t load_id = 0; // matches worker results to this load of the slot
+    float priority = 1.0f;
+    bool released = false; // freed once its upload completes
+
+    std::shared_ptr<assets::TextureCache const> cache; // shared with workers
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    std::uint32_t levels = 0;
+    std::uint32_t tail_first = 0;
+    std::uint32_t min_first = 0;  // finest level a staging copy can hold
+    std::uint32_t prefetched = 0; // pages of [prefetched, levels) were touched
+    bool prefetch_queued = false;
+    std::uint32_t target = 0; // first level the budget allows
+
+    Image* image = nullptr; // owned; levels [resident_first, levels)
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    std::uint32_t resident_first = kNotResident;
+
+    Image* pending = nullptr; // owned; levels [pending_first, levels), uploading
+    std::uint32_t pending_first = 0;
+    UploadTicket ticket{};
+  };
+
+  struct Job {
+    JobKind kind = JobKind::Open;
+    Handle handle = kInvalidHandle;
+    std::uint64_t load_id = 0;
+    std::uint32_t first = 0;
+    std::string path;                                  // Open
+    std::shared_ptr<assets::TextureCache const> cache; // Prefetch
+  };
+
+  struct Result {
+    JobKind kind = JobKind::Open;
+    Handle handle = kInvalidHandle;
+    std::uint64_t load_id = 0;
+    std::uint32_t first = 0;
+    std::shared_ptr<assets::TextureCache const> cache;
+    bool ok = true;
+    std::string error;
+  };
+
+  TextureStreamerConfig config{};
+  VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+
+  // Main thread only.
+  std::vector<Texture> textures; // indexed by Handle
+  std::vector<Handle> free_handles;
+  std::vector<Handle> order; // plan() scratch, priority order
+  std::vector<Result> applying;
+  DeletionQueue retired; // serial = Renderer::submitted_frames() when retired
+  std::uint64_t next_load_id = 1;
+  std::uint64_t updates = 0;
+  std::uint64_t submitted = 0; // as passed to the current update()
+  VkDeviceSize budget_bytes = 0;
+  VkDeviceSize resident_bytes = 0;
+  std::uint64_t evictions = 0;
+  std::uint64_t uploaded_bytes = 0;
+  std::uint32_t uploads_in_flight = 0;
+
+  core::JobSystem* jobs = nullptr;
+  core::JobCounter running; // worker jobs in flight
+
+  // Shared with the jobs.
+  mutable std::mutex mutex;
+  std::deque<Job> queue;
+  std::vector<Result> done;
+  std::uint32_t pending_jobs = 0; // queued, running, or done but not applied
+  std::uint32_t active = 0;       // worker jobs submitted and not yet returned
+  bool stop = false;
+
+  void push_job(Job job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(job));
+    ++pending_jobs;
+    if (!stop && active < std::max(1U, config.max_jobs)) {
+      ++active;
+      jobs->submit([this] { drain(); }, &running);
+    }
+  }
+
+  // Runs one queued job, then goes back to the end of the pool's queues while
+  // more are waiting, so other jobs get the worker in between.
+  void drain() {
+    Job job;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (stop || queue.empty()) {
+        --active;
+        return;
+      }
+      job = std::move(queue.front());
+      queue.pop_front();
+    }
+
+    Result r{};
+    r.kind = job.kind;
+    r.handle = job.handle;
+    r.load_id = job.load_id;
+    r.first = job.first;
+    try {
+      if (job.kind == JobKind::Open) {
+        CORE_ZONE("open texture");
+        auto cache = std::make_shared<assets::TextureCache>();
+        if (cache->open(job.path)) {
+          cache->prefetch(tail_first(*cache, config.tail_size));
+          r.cache = std::move(cache);
+        } else {
+          r.ok = false;
+          r.error = "missing, stale or malformed texture file";
+        }
+      } else {
+        CORE_ZONE("prefetch texture");
+        job.cache->prefetch(job.first);
+      }
+    } catch (std::exception const& e) {
+      r.ok = false;
+      r.error = e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    done.push_back(std::move(r));
+    if (!stop && !queue.empty()) {
+      jobs->submit([this] { drain(); }, &running);
+    } else {
+      --active;
+    }
+  }
+
+  // Hands image and set to the deletion queue; frames in flight may still
+  // sample them.
+  void retire(Image*& image, VkDescriptorSet& set) {
+    if (image == nullptr) {
+      return;
+    }
+    Image* old = image;
+    VkDescriptorSet const old_set = set;
+    VkDescriptorPool const p = pool;
+    retired.push(submitted, [old, old_set, p](Context const& c) {
+      if (old_set != VK_NULL_HANDLE) {
+        vkFreeDescriptorSets(c.device(), p, 1, &old_set);
+      }
+      old->shutdown(c);
+      delete old;
+    });
+    image = nullptr;
+    set = VK_NULL_HANDLE;
+  }
+
+  void free_slot(Handle h) {
+    Texture& t = textures[h];
+    retire(t.image, t.set);
+    t = Texture{};
+    free_handles.push_back(h);
+  }
+
+  VkDescriptorSet allocate_set(Context const& ctx, Image const& image) const {
+    VkDescriptorSetAllocateInfo ai{};
+    ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    ai.descriptorPool = pool;
+    ai.descriptorSetCount = 1;
+    ai.pSetLayouts = &layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    vk_check(vkAllocateDescriptorSets(ctx.device(), &ai, &set), "vkAllocateDescriptorSets(texture)");
+
+    VkDescriptorImageInfo ii{};
+    ii.sampler = sampler;
+    ii.imageView = image.view();
+    ii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet w{};
+    w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    w.dstSet = set;
+    w.dstBinding = 0;
+    w.descriptorCount = 1;
+    w.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    w.pImageInfo = &ii;
+    vkUpdateDescriptorSets(ctx.device(), 1, &w, 0, nullptr);
+    return set;
+  }
+
+  void apply_results(Context const& ctx) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      applying.swap(done);
+      pending_jobs -= static_cast<std::uint32_t>(applying.size());
+    }
+
+    for (Result& r : applying) {
+      Texture& t = textures[r.handle];
+      if (t.state == State::Free || t.load_id != r.load_id) {
+        continue; // released in the meantime
+      }
+
+      if (r.kind == JobKind::Prefetch) {
+        t.prefetched = std::min(t.prefetched, r.first);
+        t.prefetch_queued = false;
+        continue;
+      }
+
+      if (r.ok && !format_supported(ctx, r.cache->format())) {
+        r.ok = false;
+        r.error = "compressed format not supported by the device";
+      }
+      if (!r.ok) {
+        std::fprintf(stderr, "TextureStreamer: texture %u failed: %s\n", r.handle, r.error.c_str());
+        t.state = State::Failed;
+        continue;
+      }
+
+      t.cache = std::move(r.cache);
+      t.format = to_vk_format(t.cache->format());
+      t.levels = t.cache->level_count();
+      t.tail_first = tail_first(*t.cache, config.tail_size);
+      t.min_first = t.tail_first;
+      while (t.min_first > 0U && t.cache->level(t.min_first - 1U).size <= kMaxLevelBytes) {
+        --t.min_first;
+      }
+      t.prefetched = t.tail_first;
+      t.target = t.tail_first;
+      t.state = State::Ready;
+    }
+    applying.clear();
+  }
+
+  void complete_uploads(Context const& ctx, Upload& uploader) {
+    for (Handle h = 0; h < textures.size(); ++h) {
+      Texture& t = textures[h];
+      if (t.pending == nullptr || !uploader.is_complete(ctx, t.ticket)) {
+        continue;
+      }
+
+      retire(t.image, t.set);
+      t.image = t.pending;
+      t.resident_first = t.pending_first;
+      t.pending = nullptr;
+      t.set = allocate_set(ctx, *t.image);
+      --uploads_in_flight;
+
+      if (t.released) {
+        free_slot(h);
+      }
+    }
+  }
+
+  void refresh_budget(Context const& ctx) {
+    if (config.budget != 0U) {
+      budget_bytes = config.budget;
+      return;
+    }
+
+    // Everything else the process holds stays where it is; the textures get a
+    // share of the rest.
+    MemoryBudget const mb = ctx.device_local_budget();
+    VkDeviceSize const others = (mb.usage > resident_bytes) ? mb.usage - resident_bytes : 0U;
+    VkDeviceSize const avail = (mb.budget > others) ? mb.budget - others : 0U;
+    budget_bytes = static_cast<VkDeviceSize>(static_cast<double>(avail) * static_cast<double>(config.budget_fraction));
+  }
+
+  // Tails are always counted, even past the budget. Finer levels are then
+  // handed out one per texture per pass, in priority order, so textures of
+  // equal priority share what is left instead of the first one taking it all.
+  void plan() {
+    order.clear();
+    resident_bytes = 0;
+    VkDeviceSize planned = 0;
+    for (Handle h = 0; h < textures.size(); ++h) {
+      Texture& t = textures[h];
+      if (t.state != State::Ready || t.released) {
+        continue;
+      }
+      if (t.resident_first != kNotResident) {
+        resident_bytes += range_bytes(*t.cache, t.resident_first);
+      }
+      t.target = t.tail_first;
+      planned += range_bytes(*t.cache, t.tail_first);
+      order.push_back(h);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [this](Handle a, Handle b) {
+      return textures[a].priority > textures[b].priority;
+    });
+
+    for (bool grew = true; grew;) {
+      grew = false;
+      for (Handle h : order) {
+        Texture& t = textures[h];
+        if (t.priority <= 0.0f || t.target <= t.min_first) {
+          continue;
+        }
+        VkDeviceSize const cost = t.cache->level(t.target - 1U).size;
+        if (planned + cost > budget_bytes) {
+          continue;
+        }
+        planned += cost;
+        --t.target;
+        grew = true;
+      }
+    }
+  }
+
+  // Creates an image for levels [first, levels) and enqueues them, coarsest
+  // first, straight out of the mapping.
+  void rebuild(Context const& ctx, Upload& uploader, Texture& t, std::uint32_t first) {
+    assets::TextureCache::Level const& top = t.cache->level(first);
+
+    Image* image = new (std::nothrow) Image();
+    if (image == nullptr) {
+      fail("TextureStreamer: allocation failed");
+    }
+    image->init_2d(ctx,
+                   VkExtent2D{top.width, top.height},
+                   t.format,
+                   VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                   VK_IMAGE_ASPECT_COLOR_BIT,
+                   t.levels - first);
+
+    for (std::uint32_t l = t.levels; l-- > first;) {
+      assets::TextureCache::Level const& lv = t.cache->level(l);
+      std::span<unsigned char const> const data = t.cache->level_data(l);
+
+      ImageUpload dst{};
+      dst.image = image->image();
+      dst.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+      dst.mip_level = l - first;
+      dst.extent = VkExtent3D{lv.width, lv.height, 1};
+      dst.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+      dst.new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      uploader.enqueue_image(ctx, dst, data.data(), data.size());
+      uploaded_bytes += data.size();
+    }
+
+    t.pending = image;
+    t.pending_first = first;
+    t.ticket = uploader.pending_ticket();
+    ++uploads_in_flight;
+  }
+
+  // At most one rebuild per texture in flight. Returns the bytes enqueued.
+  VkDeviceSize step(Context const& ctx, Upload& uploader, Handle h, VkDeviceSize enqueued) {
+    Texture& t = textures[h];
+    if (t.pending != nullptr) {
+      return 0;
+    }
+
+    std::uint32_t first = t.tail_first; // nothing resident yet; the open job touched the tail
+    bool evict = false;
+    if (t.resident_first != kNotResident) {
+      if (t.target > t.resident_first) {
+        first = t.target;
+        evict = true;
+      } else if (t.target < t.resident_first) {
+        if (t.prefetched > t.target && !t.prefetch_queued) {
+          Job job{};
+          job.kind = JobKind::Prefetch;
+          job.handle = h;
+          job.load_id = t.load_id;
+          job.first = t.target;
+          job.cache = t.cache;
+          push_job(std::move(job));
+          t.prefetch_queued = true;
+        }
+        first = t.resident_first - 1U;
+        if (t.prefetched > first) {
+          return 0;
+        }
+      } else {
+        return 0;
+      }
+    }
+
+    VkDeviceSize const cost = range_bytes(*t.cache, first);
+    if (enqueued > 0U && enqueued + cost > config.upload_bytes_per_frame) {
+      return 0;
+    }
+    rebuild(ctx, uploader, t, first);
+    if (evict) {
+      ++evictions;
+    }
+    return cost;
+  }
+
+  void update(Context const& ctx, Upload& uploader, std::uint64_t submitted_frames, std::uint64_t completed_frames) {
+    CORE_ZONE("texture streaming");
+
+    // Keyed on frames, not updates: a frame that is skipped (out-of-date
+    // swapchain) still calls update() but submits nothing.
+    submitted = submitted_frames;
+    retired.collect(ctx, completed_frames);
+
+    apply_results(ctx);
+    complete_uploads(ctx, uploader);
+    if (updates % std::max(1U, config.budget_interval) == 0U) {
+      refresh_budget(ctx);
+    }
+    plan();
+
+    VkDeviceSize enqueued = 0;
+    for (Handle h : order) {
+      enqueued += step(ctx, uploader, h, enqueued);
+    }
+    if (enqueued > 0U) {
+      // Ordered: other users of the ring rely on batch order.
+      (void)uploader.flush(ctx, UploadSync::Ordered);
+    }
+
+    ++updates;
+  }
+};
+
+TextureStreamer::~TextureStreamer() {
+}
+
+TextureStreamer::TextureStreamer(TextureStreamer&& other) noexcept {
+  *this = std::move(other);
+}
+
+TextureStreamer& TextureStreamer::operator=(TextureStreamer&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  impl_ = other.impl_;
+  other.impl_ = nullptr;
+
+  return *this;
+}
+
+void TextureStreamer::init(Context const& ctx,
+                           VkDescriptorSetLayout material_layout,
+                           core::JobSystem& jobs,
+                           TextureStreamerConfig const& config) {
+  if (impl_ != nullptr) {
+    fail("TextureStreamer::init called twice");
+  }
+  if (material_layout == VK_NULL_HANDLE || config.max_textures == 0U || config.frames_in_flight == 0U) {
+    fail("TextureStreamer::init: invalid arguments");
+  }
+  // Without workers a job would run inline, under the streamer's lock.
+  if (jobs.thread_count() == 0U) {
+    fail("TextureStreamer::init: job system not initialized");
+  }
+
+  impl_ = new (std::nothrow) Impl();
+  if (impl_ == nullptr) {
+    fail("TextureStreamer: allocation failed");
+  }
+  impl_->config = config;
+  impl_->layout = material_layout;
+
+  // Each texture holds one set and may have one more retired per frame still
+  // in flight.
+  std::uint32_t const sets = config.max_textures * (config.frames_in_flight + 2U);
+
+  VkDescriptorPoolSize pool_size{};
+  pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_size.descriptorCount = sets;
+
+  VkDescriptorPoolCreateInfo dpci{};
+  dpci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  dpci.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  dpci.maxSets = sets;
+  dpci.poolSizeCount = 1;
+  dpci.pPoolSizes = &pool_size;
+  vk_check(vkCreateDescriptorPool(ctx.device(), &dpci, nullptr, &impl_->pool), "vkCreateDescriptorPool(textures)");
+
+  VkSamplerCreateInfo sci{};
+  sci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sci.magFilter = VK_FILTER_LINEAR;
+  sci.minFilter = VK_FILTER_LINEAR;
+  sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  sci.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sci.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sci.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sci.maxLod = VK_LOD_CLAMP_NONE; // views start at the finest resident level
+  vk_check(vkCreateSampler(ctx.device(), &sci, nullptr, &impl_->sampler), "vkCreateSampler(textures)");
+
+  impl_->textures.reserve(config.max_textures);
+  impl_->jobs = &jobs;
+}
+
+void TextureStreamer::shutdown(Context const& ctx) {
+  if (impl_ == nullptr) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->stop = true;
+    impl_->queue.clear();
+  }
+  impl_->jobs->wait(impl_->running);
+
+  for (Impl::Texture& t : impl_->textures) {
+    if (t.image != nullptr) {
+      t.image->shutdown(ctx);
+      delete t.image;
+    }
+    if (t.pending != nullptr) {
+      t.pending->shutdown(ctx);
+      delete t.pending;
+    }
+  }
+  impl_->retired.flush(ctx);
+
+  // The sets go with the pool.
+  if (impl_->pool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(ctx.device(), impl_->pool, nullptr);
+  }
+  if (impl_->sampler != VK_NULL_HANDLE) {
+    vkDestroySampler(ctx.device(), impl_->sampler, nullptr);
+  }
+
+  delete impl_;
+  impl_ = nullptr;
+}
+
+TextureStreamer::Handle TextureStreamer::load(std::string const& path, float priority) {
+  if (impl_ == nullptr) {
+    fail("TextureStreamer::load: not initialized");
+  }
+
+  Handle h = kInvalidHandle;
+  if (!impl_->free_handles.empty()) {
+    h = impl_->free_handles.back();
+    impl_->free_handles.pop_back();
+  } else if (impl_->textures.size() < impl_->config.max_textures) {
+    h = static_cast<Handle>(impl_->textures.size());
+    impl_->textures.emplace_back();
+  } else {
+    fail("TextureStreamer::load: max_textures reached");
+  }
+
+  Impl::Texture& t = impl_->textures[h];
+  t.state = Impl::State::Opening;
+  t.load_id = impl_->next_load_id++;
+  t.priority = priority;
+
+  Impl::Job job{};
+  job.kind = Impl::JobKind::Open;
+  job.handle = h;
+  job.load_id = t.load_id;
+  job.path = path;
+  impl_->push_job(std::move(job));
+  return h;
+}
+
+void TextureStreamer::release(Handle h) {
+  if (impl_ == nullptr || h >= impl_->textures.size() || impl_->textures[h].state == Impl::State::Free) {
+    return;
+  }
+
+  // An upload still writing into the pending image has to finish first.
+  Impl::Texture& t = impl_->textures[h];
+  if (t.pending != nullptr) {
+    t.released = true;
+  } else {
+    impl_->free_slot(h);
+  }
+}
+
+void TextureStreamer::set_priority(Handle h, float priority) {
+  if (impl_ != nullptr && h < impl_->textures.size()) {
+    impl_->textures[h].priority = priority;
+  }
+}
+
+void TextureStreamer::update(Context const& ctx,
+                             Upload& uploader,
+                             std::uint64_t submitted_frames,
+                             std::uint64_t completed_frames) {
+  if (impl_ != nullptr) {
+    impl_->update(ctx, uploader, submitted_frames, completed_frames);
+  }
+}
+
+VkDescriptorSet TextureStreamer::descriptor_set(Handle h) const {
+  if (impl_ == nullptr || h >= impl_->textures.size()) {
+    return VK_NULL_HANDLE;
+  }
+  return impl_->textures[h].set;
+}
+
+std::uint32_t TextureStreamer::resident_level(Handle h) const {
+  if (impl_ == nullptr || h >= impl_->textures.size()) {
+    return kNotResident;
+  }
+  return impl_->textures[h].resident_first;
+}
+
+TextureStreamerStats TextureStreamer::stats() const {
+  TextureStreamerStats s{};
+  if (impl_ == nullptr) {
+    return s;
+  }
+
+  for (Impl::Texture const& t : impl_->textures) {
+    if (t.state != Impl::State::Free) {
+      ++s.textures;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    s.pending = impl_->pending_jobs;
+  }
+  s.pending += impl_->uploads_in_flight;
+  s.resident_bytes = impl_->resident_bytes;
+  s.budget_bytes = impl_->budget_bytes;
+  s.evictions = impl_->evictions;
+  s.uploaded_bytes = impl_->uploaded_bytes;
+  return s;
+}
+
+} // namespace gfx
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+namespace core { class JobSystem; }
+
+namespace gfx {
+
+class Context;
+class Upload;
+
+struct TextureStreamerConfig {
+  std::uint32_t frames_in_flight = 2; // Renderer::frames_in_flight()
+  std::uint32_t max_textures = 256;
+  std::uint32_t max_jobs = 1; // opens / prefetches running at once on the job system
+
+  // Bytes of resident mip data. 0 derives it every `budget_interval` updates
+  // from Context::device_local_budget(): `budget_fraction` of what the rest of
+  // the process leaves free.
+  VkDeviceSize budget = 0;
+  float budget_fraction = 0.5f;
+  std::uint32_t budget_interval = 30;
+
+  // Levels no larger than this on either side form the tail, which is always
+  // resident once the file is open.
+  std::uint32_t tail_size = 64;
+
+  // Soft cap on mip data enqueued per update; one step always goes through.
+  VkDeviceSize upload_bytes_per_frame = 16ull * 1024ull * 1024ull;
+};
+
+struct TextureStreamerStats {
+  std::uint32_t textures = 0;
+  std::uint32_t pending = 0; // opens, prefetches and uploads in flight
+  VkDeviceSize resident_bytes = 0;
+  VkDeviceSize budget_bytes = 0;
+  std::uint64_t evictions = 0;
+  std::uint64_t uploaded_bytes = 0;
+};
+
+// Mip residency for cooked textures (assets::TextureCache). Jobs on the
+// engine's JobSystem map each file and touch the pages of the levels about to
+// be uploaded; update() then copies them out of the mapping through the Upload
+// ring. Every texture keeps its coarse tail resident; finer levels are added
+// one at a time, coarsest first, in priority order while they fit the budget,
+// and dropped again once they no longer do.
+//
+// Changing the resident range rebuilds the image with the new mip count and
+// re-uploads the levels it keeps, so the old image stays valid for frames in
+// flight until it is retired.
+class TextureStreamer {
+public:
+  using Handle = std::uint32_t;
+  static constexpr Handle kInvalidHandle = UINT32_MAX;
+
+public:
+  TextureStreamer() = default;
+  ~TextureStreamer();
+
+  TextureStreamer(TextureStreamer const&) = delete;
+  TextureStreamer& operator=(TextureStreamer const&) = delete;
+
+  TextureStreamer(TextureStreamer&& other) noexcept;
+  TextureStreamer& operator=(TextureStreamer&& other) noexcept;
+
+  // `material_layout` is Pipeline::material_set_layout(); every texture gets a
+  // set of that layout with its image at binding 0. `jobs` (initialized) must
+  // outlive the streamer.
+  void init(Context const& ctx,
+            VkDescriptorSetLayout material_layout,
+            core::JobSystem& jobs,
+            TextureStreamerConfig const& config = {});
+
+  // The caller guarantees the device is idle.
+  void shutdown(Context const& ctx);
+
+  // Opens `path` in the background. Higher priorities get their finer levels
+  // first; 0 keeps the texture at its tail. Throws when max_textures are live.
+  Handle load(std::string const& path, float priority = 1.0f);
+  void release(Handle h);
+  void set_priority(Handle h, float priority);
+
+  // Once per frame, after Renderer::wait_for_frame: applies finished work,
+  // re-plans residency and flushes `uploader` when it enqueued anything.
+  // Replaced images and sets are retired under `submitted_frames` and freed
+  // once `completed_frames` reaches it (Renderer::submitted_frames() /
+  // completed_frames()).
+  void update(Context const& ctx,
+              Upload& uploader,
+              std::uint64_t submitted_frames,
+              std::uint64_t completed_frames);
+
+  // VK_NULL_HANDLE until the tail is resident (or if the file failed to open),
+  // in which case the renderer's default material stands in. Valid until the
+  // next update().
+  VkDescriptorSet descriptor_set(Handle h) const;
+
+  // Finest resident level; UINT32_MAX when nothing is resident.
+  std::uint32_t resident_level(Handle h) const;
+
+  TextureStreamerStats stats() const;
+
+private:
+  struct Impl;
+  Impl* impl_ = nullptr; // owned; jobs point into it
+};
+
+} // namespace gfx
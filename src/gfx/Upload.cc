@@ -1,7 +1,14 @@
 #include "gfx/Upload.h"
 
+#include "core/JobSystem.h"
+#include "gfx/Buffer.h"
 #include "gfx/Context.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -19,6 +26,27 @@ void vk_check(VkResult r, char const* what) {
   }
 }
 
+std::uint64_t align_up(std::uint64_t v, std::uint64_t a) {
+  return (a <= 1U) ? v : ((v + a - 1U) / a) * a;
+}
+
+// Everything an uploaded resource can be consumed by after the batch.
+constexpr VkPipelineStageFlags kConsumerStages =
+  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+  VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+constexpr VkAccessFlags kConsumerAccess =
+  VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+  VK_ACCESS_INDEX_READ_BIT |
+  VK_ACCESS_UNIFORM_READ_BIT |
+  VK_ACCESS_SHADER_READ_BIT |
+  VK_ACCESS_TRANSFER_READ_BIT;
+
 } // namespace
 
 Upload::~Upload() {
@@ -34,24 +62,118 @@ Upload& Upload::operator=(Upload&& other) noexcept {
   }
 
   command_pool_ = other.command_pool_;
+  transfer_pool_ = other.transfer_pool_;
+  graphics_family_ = other.graphics_family_;
+  transfer_family_ = other.transfer_family_;
+  staging_ = other.staging_;
+  jobs_ = other.jobs_;
+  staging_size_ = other.staging_size_;
+  copy_alignment_ = other.copy_alignment_;
+  ring_write_ = other.ring_write_;
+  ring_read_ = other.ring_read_;
+  buffer_copies_ = std::move(other.buffer_copies_);
+  image_copies_ = std::move(other.image_copies_);
+  region_scratch_ = std::move(other.region_scratch_);
+  barrier_scratch_ = std::move(other.barrier_scratch_);
+  buffer_barrier_scratch_ = std::move(other.buffer_barrier_scratch_);
+  in_flight_ = std::move(other.in_flight_);
+  free_batches_ = std::move(other.free_batches_);
+  next_ticket_ = other.next_ticket_;
+  completed_ticket_ = other.completed_ticket_;
+
   other.command_pool_ = VK_NULL_HANDLE;
+  other.transfer_pool_ = VK_NULL_HANDLE;
+  other.graphics_family_ = UINT32_MAX;
+  other.transfer_family_ = UINT32_MAX;
+  other.staging_ = nullptr;
+  other.jobs_ = nullptr;
+  other.staging_size_ = 0;
+  other.ring_write_ = 0;
+  other.ring_read_ = 0;
+  other.buffer_copies_.clear();
+  other.image_copies_.clear();
+  other.in_flight_.clear();
+  other.free_batches_.clear();
+  other.next_ticket_ = 1;
+  other.completed_ticket_ = 0;
   return *this;
 }
 
-void Upload::init(Context const& ctx) {
+void Upload::init(Context const& ctx, VkDeviceSize staging_size) {
   if (command_pool_ != VK_NULL_HANDLE) {
     fail("Upload::init called twice");
   }
+  if (staging_size == 0U) {
+    fail("Upload::init: staging_size == 0");
+  }
 
   VkCommandPoolCreateInfo ci{};
   ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   ci.queueFamilyIndex = ctx.graphics_queue_family();
-  ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
   vk_check(vkCreateCommandPool(ctx.device(), &ci, nullptr, &command_pool_), "vkCreateCommandPool(Upload)");
+
+  graphics_family_ = ctx.graphics_queue_family();
+  transfer_family_ = ctx.transfer_queue_family();
+
+  if (ctx.has_dedicated_transfer_queue()) {
+    ci.queueFamilyIndex = transfer_family_;
+    vk_check(vkCreateCommandPool(ctx.device(), &ci, nullptr, &transfer_pool_), "vkCreateCommandPool(Upload transfer)");
+  }
+
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(ctx.physical_device(), &props);
+
+  // 16 covers the texel block size of every uncompressed and BC/ASTC format we upload.
+  copy_alignment_ = std::max<VkDeviceSize>(16U, props.limits.optimalBufferCopyOffsetAlignment);
+  staging_size_ = align_up(staging_size, copy_alignment_);
+
+  staging_ = new (std::nothrow) Buffer();
+  if (staging_ == nullptr) {
+    fail("Upload: staging allocation failed");
+  }
+
+  AllocationCreateInfo alloc{};
+  alloc.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  alloc.dedicated = true;
+  staging_->init(ctx, staging_size_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, alloc);
+
+  ring_write_ = 0;
+  ring_read_ = 0;
+  next_ticket_ = 1;
+  completed_ticket_ = 0;
 }
 
 void Upload::shutdown(Context const& ctx) {
+  for (auto const& b : in_flight_) {
+    // an unsubmitted acquire leaves only the transfer half to wait for
+    VkFence const last = b.acquire_pending ? b.transfer_fence : b.fence;
+    (void)vkWaitForFences(ctx.device(), 1, &last, VK_TRUE, UINT64_MAX);
+    destroy_batch(ctx, b);
+  }
+  in_flight_.clear();
+
+  for (auto const& b : free_batches_) {
+    destroy_batch(ctx, b);
+  }
+  free_batches_.clear();
+
+  // Anything still enqueued was never submitted; drop it.
+  buffer_copies_.clear();
+  image_copies_.clear();
+
+  if (staging_ != nullptr) {
+    staging_->shutdown(ctx);
+    delete staging_;
+    staging_ = nullptr;
+  }
+  staging_size_ = 0;
+
+  if (transfer_pool_ != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(ctx.device(), transfer_pool_, nullptr);
+    transfer_pool_ = VK_NULL_HANDLE;
+  }
   if (command_pool_ != VK_NULL_HANDLE) {
     vkDestroyCommandPool(ctx.device(), command_pool_, nullptr);
     command_pool_ = VK_NULL_HANDLE;
@@ -88,15 +210,520 @@ void Upload::end_and_submit(Context const& ctx, VkCommandBuffer cb) {
 
   vk_check(vkEndCommandBuffer(cb), "vkEndCommandBuffer(Upload)");
 
+  // Pending batches go first so one-shot work observes them.
+  (void)flush(ctx);
+
+  VkFenceCreateInfo fci{};
+  fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  VkFence fence = VK_NULL_HANDLE;
+  vk_check(vkCreateFence(ctx.device(), &fci, nullptr, &fence), "vkCreateFence(Upload)");
+
   VkSubmitInfo si{};
   si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
   si.commandBufferCount = 1;
   si.pCommandBuffers = &cb;
 
-  vk_check(vkQueueSubmit(ctx.graphics_queue(), 1, &si, VK_NULL_HANDLE), "vkQueueSubmit(Upload)");
-  vk_check(vkQueueWaitIdle(ctx.graphics_queue()), "vkQueueWaitIdle(Upload)");
+  VkResult r = vkQueueSubmit(ctx.graphics_queue(), 1, &si, fence);
+  if (r == VK_SUCCESS) {
+    // Wait for this submit only, not for whatever rendering is in flight.
+    r = vkWaitForFences(ctx.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+  vkDestroyFence(ctx.device(), fence, nullptr);
+  vk_check(r, "vkQueueSubmit/vkWaitForFences(Upload)");
 
   vkFreeCommandBuffers(ctx.device(), command_pool_, 1, &cb);
 }
 
+void Upload::write_staging(Context const& ctx, VkDeviceSize offset, void const* data, std::size_t size) {
+  if (jobs_ == nullptr || size < kParallelCopyBytes) {
+    staging_->upload(ctx, data, size, static_cast<std::size_t>(offset));
+    return;
+  }
+
+  // One thread rarely saturates memory bandwidth on a large copy, especially
+  // into write-combined memory; 1 MiB grains keep each chunk cheap to steal.
+  constexpr std::size_t kGrain = 1024u * 1024u;
+  auto* dst = static_cast<unsigned char*>(staging_->mapped()) + offset;
+  auto const* src = static_cast<unsigned char const*>(data);
+  jobs_->parallel_for((size + kGrain - 1U) / kGrain, 1, [&](std::size_t begin, std::size_t end) {
+    std::size_t const first = begin * kGrain;
+    std::size_t const last = std::min(end * kGrain, size);
+    std::memcpy(dst + first, src + first, last - first);
+  });
+  staging_->flush(ctx, offset, static_cast<VkDeviceSize>(size));
+}
+
+void Upload::enqueue_buffer(Context const& ctx,
+                            VkBuffer dst,
+                            VkDeviceSize dst_offset,
+                            void const* data,
+                            std::size_t size) {
+  if (staging_ == nullptr) {
+    fail("Upload::enqueue_buffer: not initialized");
+  }
+  if (dst == VK_NULL_HANDLE || data == nullptr) {
+    fail("Upload::enqueue_buffer: null dst/data");
+  }
+
+  auto const* src = static_cast<unsigned char const*>(data);
+
+  // Half the ring per chunk keeps one chunk copying while the next is written.
+  VkDeviceSize const max_chunk = std::max<VkDeviceSize>(staging_size_ / 2U, copy_alignment_);
+  VkDeviceSize remaining = static_cast<VkDeviceSize>(size);
+  VkDeviceSize done = 0;
+
+  while (remaining != 0U) {
+    VkDeviceSize const chunk = std::min(remaining, max_chunk);
+    VkDeviceSize const offset = reserve(ctx, chunk, copy_alignment_);
+
+    write_staging(ctx, offset, src + done, static_cast<std::size_t>(chunk));
+
+    PendingBufferCopy c{};
+    c.dst = dst;
+    c.region.srcOffset = offset;
+    c.region.dstOffset = dst_offset + done;
+    c.region.size = chunk;
+    buffer_copies_.push_back(c);
+
+    done += chunk;
+    remaining -= chunk;
+  }
+}
+
+void Upload::enqueue_image(Context const& ctx, ImageUpload const& dst, void const* data, std::size_t size) {
+  if (staging_ == nullptr) {
+    fail("Upload::enqueue_image: not initialized");
+  }
+  if (dst.image == VK_NULL_HANDLE || data == nullptr || size == 0U) {
+    fail("Upload::enqueue_image: null image/data");
+  }
+  if (static_cast<VkDeviceSize>(size) > staging_size_) {
+    fail("Upload::enqueue_image: subresource larger than the staging ring");
+  }
+
+  VkDeviceSize const offset = reserve(ctx, static_cast<VkDeviceSize>(size), copy_alignment_);
+  write_staging(ctx, offset, data, size);
+
+  PendingImageCopy c{};
+  c.dst = dst;
+  c.region.bufferOffset = offset;
+  c.region.bufferRowLength = 0;
+  c.region.bufferImageHeight = 0;
+  c.region.imageSubresource.aspectMask = dst.aspect;
+  c.region.imageSubresource.mipLevel = dst.mip_level;
+  c.region.imageSubresource.baseArrayLayer = dst.array_layer;
+  c.region.imageSubresource.layerCount = 1;
+  c.region.imageOffset = VkOffset3D{0, 0, 0};
+  c.region.imageExtent = dst.extent;
+  image_copies_.push_back(c);
+}
+
+UploadTicket Upload::flush(Context const& ctx, UploadSync sync) {
+  if (!has_pending()) {
+    // Everything enqueued so far is covered by the last submitted batch.
+    return UploadTicket{next_ticket_ - 1U};
+  }
+
+  retire_completed(ctx);
+
+  // Images whose old contents must survive are owned by the graphics family; keep
+  // such batches on the graphics queue instead of transferring ownership twice.
+  bool use_transfer = (transfer_pool_ != VK_NULL_HANDLE);
+  for (auto const& c : image_copies_) {
+    if (c.dst.old_layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+      use_transfer = false;
+    }
+  }
+
+  Batch b = acquire_batch(ctx);
+
+  VkCommandBufferBeginInfo bi{};
+  bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (!use_transfer) {
+    vk_check(vkBeginCommandBuffer(b.graphics_cb, &bi), "vkBeginCommandBuffer(Upload batch)");
+    record_image_pre_barriers(b.graphics_cb);
+    record_copies(b.graphics_cb);
+    record_visibility(b.graphics_cb);
+    vk_check(vkEndCommandBuffer(b.graphics_cb), "vkEndCommandBuffer(Upload batch)");
+
+    VkSubmitInfo si{};
+    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.commandBufferCount = 1;
+    si.pCommandBuffers = &b.graphics_cb;
+
+    vk_check(vkResetFences(ctx.device(), 1, &b.fence), "vkResetFences(Upload)");
+    VkResult const r = vkQueueSubmit(ctx.graphics_queue(), 1, &si, b.fence);
+    if (r != VK_SUCCESS) {
+      free_batches_.push_back(b);
+      vk_check(r, "vkQueueSubmit(Upload batch)");
+    }
+  } else {
+    vk_check(vkBeginCommandBuffer(b.transfer_cb, &bi), "vkBeginCommandBuffer(Upload transfer)");
+    record_image_pre_barriers(b.transfer_cb);
+    record_copies(b.transfer_cb);
+    record_ownership(b.transfer_cb, true);
+    vk_check(vkEndCommandBuffer(b.transfer_cb), "vkEndCommandBuffer(Upload transfer)");
+
+    // Recorded now since the pending lists are recycled below.
+    vk_check(vkBeginCommandBuffer(b.graphics_cb, &bi), "vkBeginCommandBuffer(Upload acquire)");
+    record_ownership(b.graphics_cb, false);
+    vk_check(vkEndCommandBuffer(b.graphics_cb), "vkEndCommandBuffer(Upload acquire)");
+
+    VkSubmitInfo si{};
+    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.commandBufferCount = 1;
+    si.pCommandBuffers = &b.transfer_cb;
+    si.signalSemaphoreCount = 1;
+    si.pSignalSemaphores = &b.released;
+
+    vk_check(vkResetFences(ctx.device(), 1, &b.transfer_fence), "vkResetFences(Upload transfer)");
+    VkResult const r = vkQueueSubmit(ctx.transfer_queue(), 1, &si, b.transfer_fence);
+    if (r != VK_SUCCESS) {
+      free_batches_.push_back(b);
+      vk_check(r, "vkQueueSubmit(Upload transfer)");
+    }
+
+    b.acquire_pending = true;
+    if (sync == UploadSync::Ordered) {
+      submit_acquire(ctx, b);
+    }
+  }
+
+  b.ticket = next_ticket_++;
+  b.ring_end = ring_write_;
+  in_flight_.push_back(b);
+
+  buffer_copies_.clear();
+  image_copies_.clear();
+
+  return UploadTicket{b.ticket};
+}
+
+void Upload::submit_acquire(Context const& ctx, Batch& b) {
+  VkPipelineStageFlags const wait_stages = kConsumerStages;
+
+  VkSubmitInfo si{};
+  si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  si.waitSemaphoreCount = 1;
+  si.pWaitSemaphores = &b.released;
+  si.pWaitDstStageMask = &wait_stages;
+  si.commandBufferCount = 1;
+  si.pCommandBuffers = &b.graphics_cb;
+
+  vk_check(vkResetFences(ctx.device(), 1, &b.fence), "vkResetFences(Upload acquire)");
+  vk_check(vkQueueSubmit(ctx.graphics_queue(), 1, &si, b.fence), "vkQueueSubmit(Upload acquire)");
+  b.acquire_pending = false;
+}
+
+bool Upload::is_complete(Context const& ctx, UploadTicket ticket) {
+  if (ticket.value <= completed_ticket_) {
+    return true;
+  }
+  if (ticket.value >= next_ticket_) {
+    return false; // not flushed yet
+  }
+  retire_completed(ctx);
+  return ticket.value <= completed_ticket_;
+}
+
+void Upload::wait(Context const& ctx, UploadTicket ticket) {
+  if (ticket.value >= next_ticket_) {
+    (void)flush(ctx);
+  }
+  while (!is_complete(ctx, ticket) && !in_flight_.empty()) {
+    wait_oldest(ctx);
+  }
+}
+
+VkDeviceSize Upload::reserve(Context const& ctx, VkDeviceSize size, VkDeviceSize alignment) {
+  if (size > staging_size_) {
+    fail("Upload::reserve: request larger than the staging ring");
+  }
+
+  for (;;) {
+    std::uint64_t start = align_up(ring_write_, alignment);
+    std::uint64_t pos = start % staging_size_;
+    if (pos + size > staging_size_) {
+      // Regions never straddle the end; skip the tail.
+      start += staging_size_ - pos;
+      pos = 0;
+    }
+
+    if (start + size - ring_read_ <= staging_size_) {
+      ring_write_ = start + size;
+      return static_cast<VkDeviceSize>(pos);
+    }
+
+    retire_completed(ctx);
+    if (start + size - ring_read_ <= staging_size_) {
+      continue;
+    }
+
+    // Ring is full: the open batch has to go out before its space can come back.
+    if (in_flight_.empty()) {
+      if (!has_pending()) {
+        fail("Upload::reserve: staging ring exhausted with nothing in flight");
+      }
+      (void)flush(ctx);
+    }
+    wait_oldest(ctx);
+  }
+}
+
+void Upload::retire_completed(Context const& ctx) {
+  while (!in_flight_.empty()) {
+    Batch& front = in_flight_.front();
+
+    if (front.acquire_pending) {
+      // Async batch: hand over to graphics only once the copies are done, so the
+      // semaphore wait never stalls the graphics queue.
+      VkResult const tr = vkGetFenceStatus(ctx.device(), front.transfer_fence);
+      if (tr == VK_NOT_READY) {
+        break;
+      }
+      vk_check(tr, "vkGetFenceStatus(Upload transfer)");
+      submit_acquire(ctx, front);
+    }
+
+    Batch const b = front;
+
+    VkResult const r = vkGetFenceStatus(ctx.device(), b.fence);
+    if (r == VK_NOT_READY) {
+      break;
+    }
+    vk_check(r, "vkGetFenceStatus(Upload)");
+
+    completed_ticket_ = b.ticket;
+    ring_read_ = b.ring_end;
+
+    in_flight_.pop_front();
+    free_batches_.push_back(b);
+  }
+
+  if (in_flight_.empty() && !has_pending()) {
+    // Idle ring: rewind so the next batch starts at offset 0.
+    ring_write_ = 0;
+    ring_read_ = 0;
+  }
+}
+
+void Upload::wait_oldest(Context const& ctx) {
+  if (in_flight_.empty()) {
+    return;
+  }
+  if (in_flight_.front().acquire_pending) {
+    submit_acquire(ctx, in_flight_.front());
+  }
+  VkFence const fence = in_flight_.front().fence;
+  vk_check(vkWaitForFences(ctx.device(), 1, &fence, VK_TRUE, UINT64_MAX), "vkWaitForFences(Upload)");
+  retire_completed(ctx);
+}
+
+Upload::Batch Upload::acquire_batch(Context const& ctx) {
+  if (!free_batches_.empty()) {
+    Batch b = free_batches_.back();
+    free_batches_.pop_back();
+    b.acquire_pending = false;
+    return b;
+  }
+
+  Batch b{};
+
+  try {
+    VkCommandBufferAllocateInfo ai{};
+    ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    ai.commandPool = command_pool_;
+    ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    ai.commandBufferCount = 1;
+    vk_check(vkAllocateCommandBuffers(ctx.device(), &ai, &b.graphics_cb), "vkAllocateCommandBuffers(Upload batch)");
+
+    VkFenceCreateInfo fci{};
+    fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    vk_check(vkCreateFence(ctx.device(), &fci, nullptr, &b.fence), "vkCreateFence(Upload batch)");
+
+    if (transfer_pool_ != VK_NULL_HANDLE) {
+      ai.commandPool = transfer_pool_;
+      vk_check(vkAllocateCommandBuffers(ctx.device(), &ai, &b.transfer_cb), "vkAllocateCommandBuffers(Upload transfer)");
+      vk_check(vkCreateFence(ctx.device(), &fci, nullptr, &b.transfer_fence), "vkCreateFence(Upload transfer)");
+
+      VkSemaphoreCreateInfo sci{};
+      sci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      vk_check(vkCreateSemaphore(ctx.device(), &sci, nullptr, &b.released), "vkCreateSemaphore(Upload)");
+    }
+  } catch (...) {
+    destroy_batch(ctx, b);
+    throw;
+  }
+  return b;
+}
+
+void Upload::destroy_batch(Context const& ctx, Batch const& b) {
+  // command buffers go with their pools
+  if (b.released != VK_NULL_HANDLE) {
+    vkDestroySemaphore(ctx.device(), b.released, nullptr);
+  }
+  if (b.transfer_fence != VK_NULL_HANDLE) {
+    vkDestroyFence(ctx.device(), b.transfer_fence, nullptr);
+  }
+  if (b.fence != VK_NULL_HANDLE) {
+    vkDestroyFence(ctx.device(), b.fence, nullptr);
+  }
+}
+
+void Upload::record_image_pre_barriers(VkCommandBuffer cb) {
+  if (image_copies_.empty()) {
+    return;
+  }
+
+  barrier_scratch_.clear();
+  VkPipelineStageFlags src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+  for (auto const& c : image_copies_) {
+    VkImageMemoryBarrier b{};
+    b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    b.srcAccessMask = 0;
+    b.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    b.oldLayout = c.dst.old_layout;
+    b.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.image = c.dst.image;
+    b.subresourceRange.aspectMask = c.dst.aspect;
+    b.subresourceRange.baseMipLevel = c.dst.mip_level;
+    b.subresourceRange.levelCount = 1;
+    b.subresourceRange.baseArrayLayer = c.dst.array_layer;
+    b.subresourceRange.layerCount = 1;
+    barrier_scratch_.push_back(b);
+
+    if (c.dst.old_layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+      // previous contents may still be read by earlier work
+      src_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+  }
+
+  vkCmdPipelineBarrier(cb,
+                       src_stages,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       0, nullptr,
+                       0, nullptr,
+                       static_cast<std::uint32_t>(barrier_scratch_.size()), barrier_scratch_.data());
+}
+
+void Upload::record_copies(VkCommandBuffer cb) {
+  // one vkCmdCopyBuffer per run of the same destination
+  std::size_t i = 0;
+  while (i < buffer_copies_.size()) {
+    VkBuffer const dst = buffer_copies_[i].dst;
+    region_scratch_.clear();
+    while (i < buffer_copies_.size() && buffer_copies_[i].dst == dst) {
+      region_scratch_.push_back(buffer_copies_[i].region);
+      ++i;
+    }
+    vkCmdCopyBuffer(cb,
+                    staging_->handle(),
+                    dst,
+                    static_cast<std::uint32_t>(region_scratch_.size()),
+                    region_scratch_.data());
+  }
+
+  for (auto const& c : image_copies_) {
+    vkCmdCopyBufferToImage(cb, staging_->handle(), c.dst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &c.region);
+  }
+}
+
+void Upload::record_visibility(VkCommandBuffer cb) {
+  // Same queue: one global barrier covers buffers; images still need their layout change.
+  barrier_scratch_.clear();
+  for (auto const& c : image_copies_) {
+    VkImageMemoryBarrier b{};
+    b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    b.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    b.dstAccessMask = kConsumerAccess;
+    b.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    b.newLayout = c.dst.new_layout;
+    b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.image = c.dst.image;
+    b.subresourceRange.aspectMask = c.dst.aspect;
+    b.subresourceRange.baseMipLevel = c.dst.mip_level;
+    b.subresourceRange.levelCount = 1;
+    b.subresourceRange.baseArrayLayer = c.dst.array_layer;
+    b.subresourceRange.layerCount = 1;
+    barrier_scratch_.push_back(b);
+  }
+
+  VkMemoryBarrier mb{};
+  mb.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  mb.dstAccessMask = kConsumerAccess;
+
+  vkCmdPipelineBarrier(cb,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       kConsumerStages,
+                       0,
+                       1, &mb,
+                       0, nullptr,
+                       static_cast<std::uint32_t>(barrier_scratch_.size()),
+                       barrier_scratch_.empty() ? nullptr : barrier_scratch_.data());
+}
+
+void Upload::record_ownership(VkCommandBuffer cb, bool release) {
+  // Release (transfer queue) and acquire (graphics queue) must describe identical
+  // ranges and layouts; only access masks and stages differ.
+  VkAccessFlags const src_access = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0U;
+  VkAccessFlags const dst_access = release ? 0U : kConsumerAccess;
+
+  buffer_barrier_scratch_.clear();
+  for (auto const& c : buffer_copies_) {
+    VkBufferMemoryBarrier b{};
+    b.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    b.srcAccessMask = src_access;
+    b.dstAccessMask = dst_access;
+    b.srcQueueFamilyIndex = transfer_family_;
+    b.dstQueueFamilyIndex = graphics_family_;
+    b.buffer = c.dst;
+    b.offset = c.region.dstOffset;
+    b.size = c.region.size;
+    buffer_barrier_scratch_.push_back(b);
+  }
+
+  barrier_scratch_.clear();
+  for (auto const& c : image_copies_) {
+    VkImageMemoryBarrier b{};
+    b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    b.srcAccessMask = src_access;
+    b.dstAccessMask = dst_access;
+    b.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    b.newLayout = c.dst.new_layout;
+    b.srcQueueFamilyIndex = transfer_family_;
+    b.dstQueueFamilyIndex = graphics_family_;
+    b.image = c.dst.image;
+    b.subresourceRange.aspectMask = c.dst.aspect;
+    b.subresourceRange.baseMipLevel = c.dst.mip_level;
+    b.subresourceRange.levelCount = 1;
+    b.subresourceRange.baseArrayLayer = c.dst.array_layer;
+    b.subresourceRange.layerCount = 1;
+    barrier_scratch_.push_back(b);
+  }
+
+  // Acquire stages match the semaphore wait mask in submit_acquire().
+  VkPipelineStageFlags const src_stages = release ? VK_PIPELINE_STAGE_TRANSFER_BIT : kConsumerStages;
+  VkPipelineStageFlags const dst_stages = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : kConsumerStages;
+
+  vkCmdPipelineBarrier(cb,
+                       src_stages,
+                       dst_stages,
+                       0,
+                       0, nullptr,
+                       static_cast<std::uint32_t>(buffer_barrier_scratch_.size()),
+                       buffer_barrier_scratch_.empty() ? nullptr : buffer_barrier_scratch_.data(),
+                       static_cast<std::uint32_t>(barrier_scratch_.size()),
+                       barrier_scratch_.empty() ? nullptr : barrier_scratch_.data());
+}
+
 } // namespace gfx
@@ -2,13 +2,45 @@
 
 #include <vulkan/vulkan.h>
 
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace core { class JobSystem; }
 
 namespace gfx {
 
+class Buffer;
 class Context;
 
+// Identifies one submitted upload batch. value == 0 means "nothing to wait for".
+struct UploadTicket {
+  std::uint64_t value = 0;
+};
+
+struct ImageUpload {
+  VkImage image = VK_NULL_HANDLE;
+  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+  std::uint32_t mip_level = 0;
+  std::uint32_t array_layer = 0;
+  VkExtent3D extent{};
+  VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkImageLayout new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+};
+
+enum class UploadSync : std::uint8_t {
+  Ordered, // later graphics submissions see the data; they may wait on the transfer queue
+  Async,   // graphics never waits on the transfer; data is usable once is_complete(ticket)
+};
+
+// With a dedicated transfer family, copies run on the transfer queue and ownership is
+// released to the graphics family; the acquire half is a small graphics submit per batch.
 class Upload {
+public:
+  static constexpr VkDeviceSize kDefaultStagingSize = 64ull * 1024ull * 1024ull;
+  static constexpr std::size_t kParallelCopyBytes = 4u * 1024u * 1024u;
+
 public:
   Upload() = default;
   ~Upload();
@@ -19,15 +51,99 @@ public:
   Upload(Upload&& other) noexcept;
   Upload& operator=(Upload&& other) noexcept;
 
-  void init(Context const& ctx);
+  void init(Context const& ctx, VkDeviceSize staging_size = kDefaultStagingSize);
   void shutdown(Context const& ctx);
 
+  // Copies of at least kParallelCopyBytes into the staging ring are split
+  // across `jobs` (not owned; nullptr copies on the calling thread).
+  void set_jobs(core::JobSystem* jobs) { jobs_ = jobs; }
+
   // Begin/End one-shot command buffer, submit to graphics queue, and wait for completion.
   VkCommandBuffer begin(Context const& ctx);
   void end_and_submit(Context const& ctx, VkCommandBuffer cb);
 
+  // Batched path: data is copied into the persistent staging ring right away,
+  // the GPU copy is recorded at flush(). Large buffer uploads are split into
+  // chunks; regions written within one batch must not overlap.
+  void enqueue_buffer(Context const& ctx, VkBuffer dst, VkDeviceSize dst_offset, void const* data, std::size_t size);
+  void enqueue_image(Context const& ctx, ImageUpload const& dst, void const* data, std::size_t size);
+
+  // Ticket the currently open batch will carry once flushed.
+  UploadTicket pending_ticket() const { return UploadTicket{next_ticket_}; }
+
+  // Submit everything enqueued so far as a single batch (no-op when empty).
+  UploadTicket flush(Context const& ctx, UploadSync sync = UploadSync::Ordered);
+
+  // Non-blocking poll; also recycles staging space of finished batches.
+  bool is_complete(Context const& ctx, UploadTicket ticket);
+  void wait(Context const& ctx, UploadTicket ticket);
+
+private:
+  struct PendingBufferCopy {
+    VkBuffer dst = VK_NULL_HANDLE;
+    VkBufferCopy region{};
+  };
+
+  struct PendingImageCopy {
+    ImageUpload dst{};
+    VkBufferImageCopy region{};
+  };
+
+  struct Batch {
+    VkCommandBuffer graphics_cb = VK_NULL_HANDLE; // copies, or the acquire half
+    VkCommandBuffer transfer_cb = VK_NULL_HANDLE; // copies + release (dedicated queue only)
+    VkSemaphore released = VK_NULL_HANDLE;
+    VkFence transfer_fence = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE; // last submit of the batch
+    std::uint64_t ticket = 0;
+    std::uint64_t ring_end = 0;
+    bool acquire_pending = false; // Async: graphics half not submitted yet
+  };
+
+  // Returns an offset into the staging ring with `size` bytes reserved.
+  VkDeviceSize reserve(Context const& ctx, VkDeviceSize size, VkDeviceSize alignment);
+  void write_staging(Context const& ctx, VkDeviceSize offset, void const* data, std::size_t size);
+  void retire_completed(Context const& ctx);
+  void wait_oldest(Context const& ctx);
+  Batch acquire_batch(Context const& ctx);
+  void destroy_batch(Context const& ctx, Batch const& b);
+  void submit_acquire(Context const& ctx, Batch& b);
+
+  void record_image_pre_barriers(VkCommandBuffer cb);
+  void record_copies(VkCommandBuffer cb);
+  void record_visibility(VkCommandBuffer cb);
+  void record_ownership(VkCommandBuffer cb, bool release);
+  bool has_pending() const { return !buffer_copies_.empty() || !image_copies_.empty(); }
+
 private:
   VkCommandPool command_pool_ = VK_NULL_HANDLE;
+  VkCommandPool transfer_pool_ = VK_NULL_HANDLE; // dedicated transfer family only
+
+  std::uint32_t graphics_family_ = UINT32_MAX;
+  std::uint32_t transfer_family_ = UINT32_MAX;
+
+  Buffer* staging_ = nullptr; // owned, persistently mapped
+  core::JobSystem* jobs_ = nullptr;
+  VkDeviceSize staging_size_ = 0;
+  VkDeviceSize copy_alignment_ = 16;
+
+  // Monotonic byte counters; position in the ring is counter % staging_size_.
+  std::uint64_t ring_write_ = 0;
+  std::uint64_t ring_read_ = 0;
+
+  std::vector<PendingBufferCopy> buffer_copies_;
+  std::vector<PendingImageCopy> image_copies_;
+
+  // Reused by record_batch so steady-state flushes do not allocate.
+  std::vector<VkBufferCopy> region_scratch_;
+  std::vector<VkImageMemoryBarrier> barrier_scratch_;
+  std::vector<VkBufferMemoryBarrier> buffer_barrier_scratch_;
+
+  std::deque<Batch> in_flight_;
+  std::vector<Batch> free_batches_; // cb + fence pairs ready for reuse
+
+  std::uint64_t next_ticket_ = 1;
+  std::uint64_t completed_ticket_ = 0;
 };
 
 } // namespace gfx
@@ -0,0 +1,169 @@
+#include "gfx/Vertex.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace gfx {
+
+namespace {
+
+std::int16_t snorm16(float v) {
+  float const c = std::clamp(v, -1.0f, 1.0f);
+  return static_cast<std::int16_t>(std::lround(c * 32767.0f));
+}
+
+// Octahedral mapping: project onto |x|+|y|+|z| = 1, fold the lower hemisphere
+// over the diagonals. Degenerate normals encode as +Z.
+void encode_octahedral(float const n[3], std::int16_t out[2]) {
+  float const l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+  if (!(l1 > 0.0f)) {
+    out[0] = 0;
+    out[1] = 0;
+    return;
+  }
+
+  float x = n[0] / l1;
+  float y = n[1] / l1;
+  if (n[2] < 0.0f) {
+    float const fx = (1.0f - std::fabs(y)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+    float const fy = (1.0f - std::fabs(x)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+    x = fx;
+    y = fy;
+  }
+
+  out[0] = snorm16(x);
+  out[1] = snorm16(y);
+}
+
+} // namespace
+
+glm::mat4 dequant_matrix(PositionDequant const& dq) {
+  glm::mat4 m(1.0f);
+  m[0][0] = dq.scale[0];
+  m[1][1] = dq.scale[1];
+  m[2][2] = dq.scale[2];
+  m[3] = glm::vec4(dq.bias[0], dq.bias[1], dq.bias[2], 1.0f);
+  return m;
+}
+
+std::uint32_t vertex_stride(VertexFormat format) {
+  switch (format) {
+    case VertexFormat::Quantized:
+      return static_cast<std::uint32_t>(sizeof(VertexQuantized));
+    case VertexFormat::Float32:
+    default:
+      return static_cast<std::uint32_t>(sizeof(Vertex));
+  }
+}
+
+VkVertexInputBindingDescription vertex_binding_description(VertexFormat format) {
+  VkVertexInputBindingDescription b{};
+  b.binding = 0;
+  b.stride = vertex_stride(format);
+  b.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  return b;
+}
+
+void vertex_attribute_descriptions(VertexFormat format, VkVertexInputAttributeDescription out[3]) {
+  bool const quantized = (format == VertexFormat::Quantized);
+
+  VkVertexInputAttributeDescription a0{};
+  a0.location = 0;
+  a0.binding = 0;
+  a0.format = quantized ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+  a0.offset = static_cast<uint32_t>(quantized ? offsetof(VertexQuantized, pos) : offsetof(Vertex, pos));
+
+  VkVertexInputAttributeDescription a1{};
+  a1.location = 1;
+  a1.binding = 0;
+  a1.format = quantized ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+  a1.offset = static_cast<uint32_t>(quantized ? offsetof(VertexQuantized, normal) : offsetof(Vertex, normal));
+
+  VkVertexInputAttributeDescription a2{};
+  a2.location = 2;
+  a2.binding = 0;
+  a2.format = quantized ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+  a2.offset = static_cast<uint32_t>(quantized ? offsetof(VertexQuantized, uv) : offsetof(Vertex, uv));
+
+  out[0] = a0;
+  out[1] = a1;
+  out[2] = a2;
+}
+
+std::uint16_t float_to_half(float f) {
+  std::uint32_t x = 0;
+  std::memcpy(&x, &f, sizeof(x));
+
+  std::uint32_t const sign = (x >> 16) & 0x8000U;
+  std::uint32_t const abs = x & 0x7fffffffU;
+
+  if (abs >= 0x7f800000U) {
+    // inf stays inf, NaN stays (quiet) NaN
+    return static_cast<std::uint16_t>(sign | 0x7c00U | ((abs > 0x7f800000U) ? 0x0200U : 0U));
+  }
+  if (abs >= 0x477ff000U) {
+    // rounds past 65504
+    return static_cast<std::uint16_t>(sign | 0x7c00U);
+  }
+  if (abs < 0x38800000U) {
+    // half subnormal (or zero): scaling by 2^24 is exact, lrint rounds to even
+    float a = 0.0f;
+    std::memcpy(&a, &abs, sizeof(a));
+    return static_cast<std::uint16_t>(sign | static_cast<std::uint32_t>(std::lrint(a * 16777216.0f)));
+  }
+
+  // rebias 127 -> 15, round the 13 dropped mantissa bits to nearest even
+  std::uint32_t const e = abs - 0x38000000U;
+  std::uint32_t const r = e + 0x0fffU + ((e >> 13) & 1U);
+  return static_cast<std::uint16_t>(sign | (r >> 13));
+}
+
+PositionDequant quantize_vertices(std::span<Vertex const> in, std::vector<VertexQuantized>& out) {
+  out.resize(in.size());
+
+  PositionDequant dq{};
+  if (in.empty()) {
+    return dq;
+  }
+
+  float lo[3] = {in[0].pos[0], in[0].pos[1], in[0].pos[2]};
+  float hi[3] = {lo[0], lo[1], lo[2]};
+  for (Vertex const& v : in) {
+    for (int a = 0; a < 3; ++a) {
+      lo[a] = std::min(lo[a], v.pos[a]);
+      hi[a] = std::max(hi[a], v.pos[a]);
+    }
+  }
+
+  float inv_scale[3]{};
+  for (int a = 0; a < 3; ++a) {
+    float const half_extent = 0.5f * (hi[a] - lo[a]);
+    dq.bias[a] = 0.5f * (hi[a] + lo[a]);
+    dq.scale[a] = (half_extent > 0.0f) ? half_extent : 1.0f; // flat axis
+    inv_scale[a] = 1.0f / dq.scale[a];
+  }
+
+  for (std::size_t i = 0; i < in.size(); ++i) {
+    Vertex const& v = in[i];
+    VertexQuantized& q = out[i];
+
+    for (int a = 0; a < 3; ++a) {
+      q.pos[a] = snorm16((v.pos[a] - dq.bias[a]) * inv_scale[a]);
+    }
+    q.pos[3] = 0;
+
+    encode_octahedral(v.normal, q.normal);
+
+    q.uv[0] = float_to_half(v.uv[0]);
+    q.uv[1] = float_to_half(v.uv[1]);
+  }
+
+  return dq;
+}
+
+} // namespace gfx
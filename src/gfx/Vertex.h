@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "assets/ObjLoader.h"
+
+namespace gfx {
+
+// How a mesh's vertices are stored on the GPU. The pipeline's vertex input and
+// vertex shader must be built for the same format as the mesh they draw.
+enum class VertexFormat : std::uint8_t {
+  Float32,   // Vertex, 32 bytes
+  Quantized, // VertexQuantized, 16 bytes
+};
+
+// The loader's vertex, so loaded and cached vertex arrays are uploaded (and
+// quantized) in place, without a conversion or a cast to another type.
+using Vertex = assets::VertexPNUV;
+
+// Positions are SNORM16 relative to the mesh bounds (w is padding), normals are
+// octahedral-encoded SNORM16x2, UVs are half floats. See PositionDequant.
+struct VertexQuantized {
+  std::int16_t pos[4];
+  std::int16_t normal[2];
+  std::uint16_t uv[2];
+};
+
+static_assert(sizeof(VertexQuantized) == 16, "VertexQuantized must stay 16 bytes");
+
+// Object-space position = snorm_pos * scale + bias. Identity for Float32 meshes.
+// The renderer folds this into the model matrix, so shaders never see it.
+struct PositionDequant {
+  float scale[3] = {1.0f, 1.0f, 1.0f};
+  float bias[3] = {0.0f, 0.0f, 0.0f};
+};
+
+// Stored position -> object space as a matrix, for folding into a model matrix.
+glm::mat4 dequant_matrix(PositionDequant const& dq);
+
+std::uint32_t vertex_stride(VertexFormat format);
+
+// Vertex input for binding 0: pos, normal and uv at locations 0-2.
+VkVertexInputBindingDescription vertex_binding_description(VertexFormat format);
+void vertex_attribute_descriptions(VertexFormat format, VkVertexInputAttributeDescription out[3]);
+
+// Encodes `in` into `out` (resized to match) and returns the dequant that maps
+// the SNORM positions back onto the source bounds.
+PositionDequant quantize_vertices(std::span<Vertex const> in, std::vector<VertexQuantized>& out);
+
+std::uint16_t float_to_half(float f);
+
+} // namespace gfx
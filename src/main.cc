@@ -1,64 +1,92 @@
 #include <GLFW/glfw3.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <span>
+#include <system_error>
+#include <thread>
 #include <vector>
 
+#include "app/Support.h"
+#include "assets/MeshCache.h"
+#include "assets/MeshOptimize.h"
+#include "assets/MeshSimplify.h"
+#include "assets/Meshlet.h"
 #include "assets/ObjLoader.h"
+#include "core/JobSystem.h"
+#include "core/Mailbox.h"
+#include "core/Profile.h"
 #include "gfx/Context.h"
 #include "gfx/Depth.h"
+#include "gfx/DrawList.h"
+#include "gfx/GeometryPool.h"
+#include "gfx/GpuProfiler.h"
+#include "gfx/GpuScene.h"
 #include "gfx/Mesh.h"
+#include "gfx/MeshClusters.h"
+#include "gfx/OffscreenTarget.h"
 #include "gfx/Pipeline.h"
+#include "gfx/PipelineRegistry.h"
 #include "gfx/Renderer.h"
 #include "gfx/Swapchain.h"
+#include "gfx/TextureStreamer.h"
+#include "gfx/Upload.h"
 #include "math/Camera.h"
+#include "math/Cull.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace {
 
-[[noreturn]] void die(char const* msg) {
-  std::fprintf(stderr, "%s\n", msg);
-  std::fflush(stderr);
-  std::exit(EXIT_FAILURE);
-}
-
 void set_glfw_callbacks() {
   glfwSetErrorCallback([](int code, char const* desc) {
     std::fprintf(stderr, "GLFW error (%d): %s\n", code, (desc != nullptr) ? desc : "(null)");
   });
 }
 
-char const* shader_vert_path() {
-#ifdef GFX_SHADER_VERT_PATH
-  return GFX_SHADER_VERT_PATH;
-#else
-  return "shaders/compiled/mesh.vert.spv";
-#endif
-}
-
-char const* shader_frag_path() {
-#ifdef GFX_SHADER_FRAG_PATH
-  return GFX_SHADER_FRAG_PATH;
-#else
-  return "shaders/compiled/mesh.frag.spv";
-#endif
+// Keys the simulation reads. GLFW only polls input on the main thread, so it is
+// sampled there and handed over like a frame snapshot.
+struct InputState {
+  bool yaw_left = false;
+  bool yaw_right = false;
+  bool pitch_up = false;
+  bool pitch_down = false;
+  bool grow = false;
+  bool shrink = false;
+};
+
+InputState sample_input(GLFWwindow* window) {
+  InputState in{};
+  in.yaw_left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+  in.yaw_right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+  in.pitch_up = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+  in.pitch_down = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+  in.grow = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+  in.shrink = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+  return in;
 }
 
-void update_angles(GLFWwindow* window, float dt, float& yaw, float& pitch) {
+void update_angles(InputState const& in, float dt, float& yaw, float& pitch) {
   float const speed = 1.5f; // rad/s
 
-  if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+  if (in.yaw_left) {
     yaw += speed * dt;
   }
-  if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+  if (in.yaw_right) {
     yaw -= speed * dt;
   }
-  if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+  if (in.pitch_up) {
     pitch += speed * dt;
   }
-  if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+  if (in.pitch_down) {
     pitch -= speed * dt;
   }
 
@@ -71,14 +99,14 @@ void update_angles(GLFWwindow* window, float dt, float& yaw, float& pitch) {
   }
 }
 
-float update_scale(GLFWwindow* window, float dt, float scale) {
+float update_scale(InputState const& in, float dt, float scale) {
   float const speed = 1.5f; // units per second (multiplicative-ish)
   float const factor = 1.0f + speed * dt;
 
-  if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
+  if (in.grow) {
     scale *= factor;
   }
-  if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
+  if (in.shrink) {
     scale /= factor;
   }
 
@@ -95,6 +123,14 @@ float update_scale(GLFWwindow* window, float dt, float scale) {
   return scale;
 }
 
+// True on the frame `key` goes down.
+bool key_pressed(GLFWwindow* window, int key, bool& was_down) {
+  bool const down = glfwGetKey(window, key) == GLFW_PRESS;
+  bool const pressed = down && !was_down;
+  was_down = down;
+  return pressed;
+}
+
 glm::mat4 make_model_matrix(float yaw, float pitch, float scale) {
   glm::mat4 model(1.0f);
 
@@ -105,13 +141,369 @@ glm::mat4 make_model_matrix(float yaw, float pitch, float scale) {
   return model;
 }
 
+math::Camera make_camera() {
+  math::Camera cam{};
+  cam.set_perspective(60.0f * 3.1415926535f / 180.0f, 0.1f, 100.0f);
+  cam.set_look_at(glm::vec3(1.8f, 1.2f, 2.8f),
+                  glm::vec3(0.0f, 0.0f, 0.0f),
+                  glm::vec3(0.0f, 1.0f, 0.0f));
+  return cam;
+}
+
+// Simulation tick rate, independent of the display.
+constexpr std::uint32_t kSimHz = 120;
+
+// Everything the render thread needs from the simulation for one frame.
+// Immutable once published.
+struct FrameSnapshot {
+  math::Camera cam{};
+  glm::mat4 model{1.0f};
+  std::uint64_t tick = 0;
+};
+
+// Fixed-step simulation on its own thread: reads the newest input, advances the
+// model and publishes a snapshot per tick. The render thread draws whichever
+// snapshot is newest when it starts a frame, so a slow tick only delays the
+// next snapshot and a slow frame never holds the simulation back.
+void run_simulation(core::Mailbox<InputState>& input,
+                    core::Mailbox<FrameSnapshot>& snapshots,
+                    std::atomic<bool> const& running) {
+  CORE_THREAD_NAME("simulation");
+  using clock = std::chrono::steady_clock;
+  auto const step = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / kSimHz));
+  float const dt = 1.0f / static_cast<float>(kSimHz);
+
+  FrameSnapshot snap = snapshots.write_slot();
+  float yaw = 0.0f;
+  float pitch = 0.0f;
+  float scale = 1.0f;
+
+  auto next = clock::now();
+  while (running.load(std::memory_order_acquire)) {
+    {
+      CORE_ZONE("simulate");
+      (void)input.acquire();
+      InputState const& in = input.read_slot();
+      update_angles(in, dt, yaw, pitch);
+      scale = update_scale(in, dt, scale);
+
+      snap.model = make_model_matrix(yaw, pitch, scale);
+      ++snap.tick;
+      snapshots.write_slot() = snap;
+      snapshots.publish();
+    }
+
+    // Ticks missed by more than one step are dropped rather than replayed.
+    next += step;
+    auto const now = clock::now();
+    if (now > next + step) {
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+constexpr char const* kModelPath = "assets/model.obj";
+constexpr char const* kModelCachePath = "assets/model.mesh";
+constexpr char const* kModelTexturePath = "assets/model.tex"; // texcook output; optional
+constexpr char const* kPipelineCachePath = "assets/pipelines.cache";
+constexpr char const* kGpuTraceCsvPath = "gpu_trace.csv";
+constexpr char const* kGpuTraceJsonPath = "gpu_trace.json";
+constexpr char const* kCpuTracePath = "cpu_trace.json";
+constexpr char const* kHeadlessImagePath = "headless.ppm";
+
+// Interactive default: two frames in flight, paced on the display where the
+// device can tell us when a present reaches it.
+constexpr gfx::FramePacing kFramePacing{2, true};
+
+// Headless: nothing to pace against; three frames keep the GPU busy while the
+// CPU records and reads back.
+constexpr gfx::FramePacing kHeadlessPacing{3, false};
+constexpr std::uint32_t kHeadlessFrames = 1000;
+
+// Half the vertex bandwidth of Float32; the pipeline is built to match.
+constexpr gfx::VertexFormat kModelFormat = gfx::VertexFormat::Quantized;
+
+// Every mesh goes into one pool, so a frame binds its buffers once. 16-bit
+// indices, as a standalone mesh would pick for the model; each mesh in the pool
+// is limited to 65536 vertices.
+constexpr gfx::GeometryPoolConfig kGeometryPoolConfig{kModelFormat, VK_INDEX_TYPE_UINT16};
+
+constexpr std::uint32_t kMaxSceneObjects = 4096;
+constexpr std::uint32_t kMaxSceneMeshes = 64;
+
+void build_clusters(std::span<assets::VertexPNUV const> vertices,
+                    std::span<std::uint32_t const> indices,
+                    gfx::MeshClusters& clusters) {
+  clusters.clear();
+  for (assets::Meshlet const& m : assets::build_meshlets(vertices, indices)) {
+    clusters.add(gfx::IndexRange{m.first_index, m.triangle_count * 3U},
+                 glm::vec3(m.center[0], m.center[1], m.center[2]),
+                 m.radius,
+                 glm::vec3(m.cone_axis[0], m.cone_axis[1], m.cone_axis[2]),
+                 m.cone_cutoff);
+  }
+}
+
+// Returns the bounds the loader (or the cache) recorded for CPU culling, and
+// splits the mesh's level 0 into clusters for the same purpose. The mesh data
+// goes into `geometry`.
+assets::MeshBounds load_model(gfx::Context& ctx,
+                              core::JobSystem& jobs,
+                              gfx::GeometryPool& geometry,
+                              gfx::Mesh& mesh,
+                              gfx::MeshClusters& clusters) {
+  {
+    // Warm path: blobs go from the mapping straight into the staging ring.
+    assets::MeshCache cache{};
+    if (cache.open(kModelCachePath) && cache.matches(kModelPath)) {
+      mesh.init_from_data(ctx,
+                          ctx.uploader(),
+                          geometry,
+                          cache.vertices(),
+                          cache.indices(),
+                          cache.lods());
+      build_clusters(cache.vertices(), cache.indices().first(mesh.lod(0).index_count), clusters);
+      return cache.bounds();
+    }
+  }
+
+  assets::SourceStamp const stamp = assets::MeshCache::stamp(kModelPath);
+  assets::ObjIndexedMesh om = assets::ObjLoader::load_parallel(kModelPath, jobs);
+
+  // File order is scan order; reorder once here and the cache keeps the result.
+  assets::MeshOptimizeStats const opt = assets::optimize_mesh(om);
+  std::fprintf(stderr, "%s: ACMR %.3f -> %.3f\n", kModelPath, opt.acmr_before, opt.acmr_after);
+
+  // Coarser levels go after level 0 in the same index array.
+  std::size_t const level0_count = om.indices.size();
+  assets::build_lods(om);
+  std::fprintf(stderr, "%s: %zu LOD levels\n", kModelPath, om.lods.size());
+
+  // The upload copies straight out of the loader's arrays into the staging ring;
+  // `om` is the only CPU copy of the mesh.
+  mesh.init_from_data(ctx,
+                      ctx.uploader(),
+                      geometry,
+                      om.vertices,
+                      om.indices,
+                      om.lods);
+  build_clusters(om.vertices, std::span<std::uint32_t const>(om.indices).first(level0_count), clusters);
+
+  try {
+    assets::MeshCache::write(kModelCachePath, om, stamp);
+  } catch (std::exception const& e) {
+    // read-only install dir etc.; next launch just parses again
+    std::fprintf(stderr, "Mesh cache not written: %s\n", e.what());
+  }
+  return om.bounds;
+}
+
+char const* present_mode_name(gfx::PresentMode m) {
+  switch (m) {
+    case gfx::PresentMode::Fifo: return "fifo";
+    case gfx::PresentMode::FifoRelaxed: return "fifo-relaxed";
+    case gfx::PresentMode::Mailbox: return "mailbox";
+    case gfx::PresentMode::Immediate: return "immediate";
+  }
+  return "?";
+}
+
+gfx::PresentMode next_present_mode(gfx::PresentMode m) {
+  switch (m) {
+    case gfx::PresentMode::Mailbox: return gfx::PresentMode::Fifo;
+    case gfx::PresentMode::Fifo: return gfx::PresentMode::FifoRelaxed;
+    case gfx::PresentMode::FifoRelaxed: return gfx::PresentMode::Immediate;
+    case gfx::PresentMode::Immediate: return gfx::PresentMode::Mailbox;
+  }
+  return gfx::PresentMode::Mailbox;
+}
+
+void show_latency(GLFWwindow* window, gfx::Swapchain const& sc, gfx::PresentLatency const& lat) {
+  char title[128];
+  std::snprintf(title, sizeof(title), "Renderer | %s | %.1f ms input-to-%s",
+                present_mode_name(sc.config().present_mode), lat.average_ms,
+                lat.to_display ? "display" : "present");
+  glfwSetWindowTitle(window, title);
+}
+
+// Percentiles to stderr, the recent frames to CSV and a Chrome trace.
+void dump_gpu_profile(gfx::GpuProfiler const& profiler) {
+  if (!profiler.enabled()) {
+    std::fprintf(stderr, "GPU profiler disabled on this device\n");
+    return;
+  }
+
+  for (gfx::GpuProfiler::ScopeStats const& s : profiler.scope_stats()) {
+    std::fprintf(stderr, "gpu %-10s last %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f ms (%zu)\n",
+                 s.name.c_str(), s.last_ms, s.p50_ms, s.p95_ms, s.p99_ms, s.samples);
+  }
+  gfx::GpuProfiler::Statistics const& st = profiler.last_statistics();
+  if (st.valid) {
+    for (std::uint32_t i = 0; i < gfx::GpuProfiler::kStatisticCount; ++i) {
+      std::fprintf(stderr, "gpu %-20s %llu\n", gfx::GpuProfiler::statistic_name(i),
+                   static_cast<unsigned long long>(st.values[i]));
+    }
+  }
+
+  bool const ok = profiler.write_csv(kGpuTraceCsvPath) && profiler.write_json(kGpuTraceJsonPath);
+  std::fprintf(stderr, ok ? "GPU trace written to %s and %s\n" : "GPU trace not written (%s, %s)\n",
+               kGpuTraceCsvPath, kGpuTraceJsonPath);
+}
+
+// Last frame's CPU time split into waiting and work, and a Chrome trace of the
+// zones. Needs a build with ENABLE_PROFILING.
+void dump_cpu_profile() {
+#if CORE_PROFILE
+  core::profile::FrameStats const f = core::profile::last_frame();
+  double const frame_ms = static_cast<double>(f.frame_ns) * 1e-6;
+  double const wait_ms = static_cast<double>(f.wait_ns) * 1e-6;
+  std::fprintf(stderr, "cpu frame %llu: %.3f ms, %.3f ms waiting (%s-bound)\n",
+               static_cast<unsigned long long>(f.frame_number), frame_ms, wait_ms,
+               (wait_ms * 2.0 > frame_ms) ? "GPU/display" : "CPU");
+
+  bool const ok = core::profile::write_chrome_trace(kCpuTracePath);
+  std::fprintf(stderr, ok ? "CPU trace written to %s\n" : "CPU trace not written (%s)\n", kCpuTracePath);
+#else
+  std::fprintf(stderr, "CPU zones compiled out (configure with ENABLE_PROFILING=ON)\n");
+#endif
+}
+
+// Binary PPM of an RGBA8 readback.
+bool write_ppm(char const* path, std::vector<unsigned char> const& rgba, VkExtent2D extent) {
+  std::FILE* f = std::fopen(path, "wb");
+  if (f == nullptr) {
+    return false;
+  }
+  std::fprintf(f, "P6\n%u %u\n255\n", extent.width, extent.height);
+  for (std::size_t i = 0; i + 3U < rgba.size(); i += 4U) {
+    std::fputc(rgba[i], f);
+    std::fputc(rgba[i + 1U], f);
+    std::fputc(rgba[i + 2U], f);
+  }
+  bool const ok = std::ferror(f) == 0;
+  return (std::fclose(f) == 0) && ok;
+}
+
+// `app --headless [frames]`: no window, surface or display. Renders the model
+// into an offscreen target as fast as the GPU allows, reads every frame back and
+// reports the throughput; the last frame is written to kHeadlessImagePath.
+int run_headless(std::uint32_t frame_count) {
+  core::JobSystem jobs{};
+  gfx::Context ctx{};
+  gfx::OffscreenTarget target{};
+  gfx::Depth depth{};
+  gfx::Pipeline pl{};
+  gfx::Renderer rd{};
+  gfx::GeometryPool geometry{};
+  gfx::Mesh mesh{};
+  gfx::MeshClusters clusters{};
+  math::Camera const cam = make_camera();
+
+  auto const shutdown = [&]() {
+    mesh.shutdown(ctx, rd.submitted_frames());
+    rd.shutdown(ctx);
+    geometry.shutdown(ctx);
+    pl.shutdown(ctx);
+    depth.shutdown(ctx);
+    target.shutdown(ctx);
+    ctx.shutdown();
+    jobs.shutdown();
+  };
+
+  try {
+    jobs.init();
+
+    gfx::ContextCreateInfo ci{};
+    ci.enable_validation = false; // measuring, not debugging
+    ci.enable_debug_utils = false;
+    ci.pipeline_cache_path = kPipelineCachePath;
+    ctx.init(ci);
+    ctx.uploader().set_jobs(&jobs);
+
+    gfx::OffscreenConfig oc{};
+    oc.image_count = kHeadlessPacing.frames_in_flight;
+    target.init(ctx, oc);
+    depth.init(ctx, target.extent());
+
+    gfx::PipelineState state{};
+    state.vert_spv_path = app::shader_vert_path(kModelFormat);
+    state.frag_spv_path = app::shader_frag_path();
+    state.vertex_format = kModelFormat;
+    pl.init(ctx, target, depth.format(), state);
+    rd.init(ctx, target, pl, depth, 1, kHeadlessPacing);
+
+    geometry.init(ctx, kGeometryPoolConfig);
+    (void)load_model(ctx, jobs, geometry, mesh, clusters);
+    (void)ctx.uploader().flush(ctx);
+  } catch (std::exception const& e) {
+    std::fprintf(stderr, "Headless init failed: %s\n", e.what());
+    shutdown();
+    return EXIT_FAILURE;
+  }
+
+  std::uint64_t readback_bytes = 0;
+  std::vector<unsigned char> last;
+  target.set_readback_handler([&](gfx::Readback const& r) {
+    std::size_t const size = r.row_pitch * r.extent.height;
+    readback_bytes += size;
+    if (r.frame == frame_count) {
+      auto const* p = static_cast<unsigned char const*>(r.pixels);
+      last.assign(p, p + size);
+    }
+  });
+
+  gfx::DrawList list{};
+  auto const start = std::chrono::steady_clock::now();
+  try {
+    for (std::uint32_t i = 0; i < frame_count; ++i) {
+      geometry.collect(rd.completed_frames());
+      list.clear();
+      list.add(mesh, make_model_matrix(0.01f * static_cast<float>(i), 0.0f, 1.0f));
+      (void)rd.draw_frame(ctx, target, pl, list, cam, depth);
+    }
+    rd.finish(ctx, target);
+  } catch (std::exception const& e) {
+    std::fprintf(stderr, "Headless frame failed: %s\n", e.what());
+    shutdown();
+    return EXIT_FAILURE;
+  }
+  double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::printf("headless: %u frames at %ux%u in %.3f s: %.1f fps, %.3f ms/frame, readback %.1f MB/s\n",
+              frame_count, target.extent().width, target.extent().height, seconds,
+              static_cast<double>(frame_count) / seconds, seconds * 1000.0 / static_cast<double>(frame_count),
+              static_cast<double>(readback_bytes) / (1024.0 * 1024.0) / seconds);
+  if (!last.empty() && !write_ppm(kHeadlessImagePath, last, target.extent())) {
+    std::fprintf(stderr, "Could not write %s\n", kHeadlessImagePath);
+  }
+
+  shutdown();
+  return EXIT_SUCCESS;
+}
+
+float aspect_ratio(gfx::Swapchain const& sc) {
+  VkExtent2D const e = sc.extent();
+  return (e.height > 0U) ? static_cast<float>(e.width) / static_cast<float>(e.height) : 1.0f;
+}
+
 } // namespace
 
-int main() {
+int main(int argc, char** argv) {
+  CORE_THREAD_NAME("main");
+
+  if (argc > 1 && std::strcmp(argv[1], "--headless") == 0) {
+    unsigned long const frames = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : kHeadlessFrames;
+    if (frames == 0UL || frames > UINT32_MAX) {
+      app::die("usage: app --headless [frames]");
+    }
+    return run_headless(static_cast<std::uint32_t>(frames));
+  }
+
   set_glfw_callbacks();
 
   if (glfwInit() == GLFW_FALSE) {
-    die("glfwInit() failed.");
+    app::die("glfwInit() failed.");
   }
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -120,90 +512,206 @@ int main() {
   GLFWwindow* window = glfwCreateWindow(1280, 720, "Renderer", nullptr, nullptr);
   if (window == nullptr) {
     glfwTerminate();
-    die("glfwCreateWindow() failed.");
+    app::die("glfwCreateWindow() failed.");
   }
 
+  core::JobSystem jobs{};
   gfx::Context ctx{};
   gfx::Swapchain sc{};
   gfx::Depth depth{};
   gfx::Pipeline pl{};
+  gfx::PipelineRegistry pipelines{};
   gfx::Renderer rd{};
+  gfx::GpuProfiler profiler{};
+  gfx::GeometryPool geometry{};
   gfx::Mesh mesh{};
-  math::Camera cam{};
+  gfx::MeshClusters clusters{};
+  gfx::GpuScene scene{};
+  gfx::TextureStreamer textures{};
+
+  bool gpu_driven = false;
+  gfx::TextureStreamer::Handle model_texture = gfx::TextureStreamer::kInvalidHandle;
+  std::uint32_t object = 0;
+  assets::MeshBounds bounds{};
 
   try {
+    // One pool for loading, recording, pipeline compiles and texture IO.
+    jobs.init();
+
     gfx::ContextCreateInfo ci{};
     ci.enable_validation = true;
     ci.enable_debug_utils = true;
+    ci.pipeline_cache_path = kPipelineCachePath;
     ctx.init(window, ci);
+    ctx.uploader().set_jobs(&jobs);
 
     sc.init(ctx, window);
     depth.init(ctx, sc);
 
-    pl.init(ctx, sc, depth.format(), shader_vert_path(), shader_frag_path());
-    rd.init(ctx, sc, pl, depth);
-
-    assets::ObjIndexedMesh const om = assets::ObjLoader::load("assets/model.obj");
-
-    std::vector<gfx::Vertex> verts;
-    verts.reserve(om.vertices.size());
-    for (auto const& v : om.vertices) {
-      gfx::Vertex gv{};
-      gv.pos[0] = v.pos[0];
-      gv.pos[1] = v.pos[1];
-      gv.pos[2] = v.pos[2];
-      gv.normal[0] = v.normal[0];
-      gv.normal[1] = v.normal[1];
-      gv.normal[2] = v.normal[2];
-      gv.uv[0] = v.uv[0];
-      gv.uv[1] = v.uv[1];
-      verts.push_back(gv);
+    pl.init(ctx, sc, depth.format(), app::shader_vert_path(kModelFormat), app::shader_frag_path(), kModelFormat);
+    pipelines.init(ctx, pl, jobs);
+    rd.init(ctx, sc, pl, depth, 0, kFramePacing);
+    rd.set_jobs(&jobs);
+    profiler.init(ctx, rd.frames_in_flight());
+    rd.set_profiler(&profiler);
+
+    geometry.init(ctx, kGeometryPoolConfig);
+    bounds = load_model(ctx, jobs, geometry, mesh, clusters);
+
+    // Cull and draw on the GPU where the device allows it.
+    gpu_driven = ctx.supports_indirect_draws();
+    if (gpu_driven) {
+      scene.init(ctx, app::shader_cull_path(), kMaxSceneObjects, kMaxSceneMeshes, rd.frames_in_flight());
+      object = scene.add_object(scene.add_mesh(mesh), glm::mat4(1.0f));
+      if (!rd.enable_occlusion_culling(ctx, app::shader_depth_pyramid_path(), pl, depth)) {
+        std::fprintf(stderr, "Occlusion culling unavailable (needs dynamic rendering and a sampled depth format)\n");
+      }
     }
 
-    mesh.init_from_data(ctx, ctx.uploader(), verts, om.indices);
+    // Untextured (white) until the streamer has the tail resident.
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(kModelTexturePath, ec)) {
+      gfx::TextureStreamerConfig tc{};
+      tc.frames_in_flight = rd.frames_in_flight();
+      textures.init(ctx, pl.material_set_layout(), jobs, tc);
+      model_texture = textures.load(kModelTexturePath);
+    }
 
-    cam.set_perspective(60.0f * 3.1415926535f / 180.0f, 0.1f, 100.0f);
-    cam.set_look_at(glm::vec3(1.8f, 1.2f, 2.8f),
-                    glm::vec3(0.0f, 0.0f, 0.0f),
-                    glm::vec3(0.0f, 1.0f, 0.0f));
+    // One submit for all mesh data; the first frame is ordered after it on the queue.
+    (void)ctx.uploader().flush(ctx);
   } catch (std::exception const& e) {
     std::fprintf(stderr, "Init failed: %s\n", e.what());
-    mesh.shutdown(ctx);
+    mesh.shutdown(ctx, rd.submitted_frames());
     rd.shutdown(ctx);
+    geometry.shutdown(ctx);
+    textures.shutdown(ctx);
+    profiler.shutdown(ctx);
+    scene.shutdown(ctx);
+    pipelines.shutdown(ctx);
     pl.shutdown(ctx);
     depth.shutdown(ctx);
     sc.shutdown(ctx);
     ctx.shutdown();
+    jobs.shutdown();
     glfwDestroyWindow(window);
     glfwTerminate();
     return EXIT_FAILURE;
   }
 
-  float yaw = 0.0f;
-  float pitch = 0.0f;
-  float prev_time = static_cast<float>(glfwGetTime());
+  // The simulation runs on its own thread (run_simulation); this one polls
+  // input, streams textures and records whatever snapshot is newest.
+  core::Mailbox<InputState> input{};
+  FrameSnapshot initial{};
+  initial.cam = make_camera();
+  initial.model = make_model_matrix(0.0f, 0.0f, 1.0f);
+  core::Mailbox<FrameSnapshot> snapshots{initial};
+  std::atomic<bool> running{true};
+  std::thread sim([&] { run_simulation(input, snapshots, running); });
+
+  // CPU culling for the fallback path.
+  gfx::DrawList list{};
+  math::SphereSoA spheres{};
+  std::vector<std::uint64_t> visible;
+  std::vector<gfx::IndexRange> ranges;
+  glm::vec3 const local_center(bounds.sphere_center[0], bounds.sphere_center[1], bounds.sphere_center[2]);
+
+  // C toggles back-face culling on the fallback path. The variant compiles in
+  // the background; until it is ready the base pipeline stands in.
+  gfx::PipelineState two_sided = pl.state();
+  two_sided.cull_mode = VK_CULL_MODE_NONE;
+  pipelines.prefetch(two_sided);
+  bool two_sided_on = false;
+  bool c_down = false;
+
+  // P cycles the present mode; the title shows the resulting latency.
+  bool p_down = false;
+  // G dumps GPU timings and CPU zones.
+  bool g_down = false;
+  float title_time = static_cast<float>(glfwGetTime());
 
-  float scale = 1.0f;
   while (glfwWindowShouldClose(window) == GLFW_FALSE) {
-    glfwPollEvents();
+    CORE_FRAME_MARK();
+    rd.wait_for_frame(ctx, sc);
+    geometry.collect(rd.completed_frames());
+    {
+      CORE_ZONE("poll events");
+      glfwPollEvents();
+    }
+    textures.update(ctx, ctx.uploader(), rd.submitted_frames(), rd.completed_frames());
+    rd.set_default_material(textures.descriptor_set(model_texture));
 
-    float const now = static_cast<float>(glfwGetTime());
-    float const dt = now - prev_time;
-    prev_time = now;
+    input.write_slot() = sample_input(window);
+    input.publish();
 
-    update_angles(window, dt, yaw, pitch);
-    scale = update_scale(window, dt, scale);
+    float const now = static_cast<float>(glfwGetTime());
+    if (key_pressed(window, GLFW_KEY_C, c_down)) {
+      two_sided_on = !two_sided_on;
+    }
+    if (key_pressed(window, GLFW_KEY_P, p_down)) {
+      gfx::SwapchainConfig sc_config = sc.config();
+      sc_config.present_mode = next_present_mode(sc_config.present_mode);
+      sc.set_config(sc_config);
+    }
+    if (key_pressed(window, GLFW_KEY_G, g_down)) {
+      dump_gpu_profile(profiler);
+      dump_cpu_profile();
+    }
+    if (now - title_time >= 1.0f) {
+      show_latency(window, sc, rd.latency());
+      title_time = now;
+    }
 
-    glm::mat4 const model = make_model_matrix(yaw, pitch, scale);
-    (void)rd.draw_frame(ctx, window, sc, pl, mesh, cam, model, depth);
+    (void)snapshots.acquire();
+    FrameSnapshot const& snap = snapshots.read_slot();
+    math::Camera const& cam = snap.cam;
+    glm::mat4 const& model = snap.model;
+    if (gpu_driven) {
+      scene.set_transform(object, model);
+      (void)rd.draw_frame(ctx, window, sc, pl, scene, cam, depth);
+    } else {
+      glm::vec3 center{};
+      float const radius = math::transform_sphere(model, local_center, bounds.sphere_radius, center);
+      spheres.clear();
+      spheres.push_back(center, radius);
+      float const aspect = aspect_ratio(sc);
+      math::cull_spheres(cam.frustum(aspect), spheres, visible);
+
+      // Whole-mesh test first, then only the clusters that pass. Clusters cover
+      // level 0; a coarser level is drawn whole. Their normal cones assume back
+      // faces are culled, so two-sided drawing skips them.
+      list.clear();
+      if (math::is_visible(visible, 0)) {
+        std::uint32_t const level = rd.select_lod(mesh, model, cam, static_cast<float>(sc.extent().height));
+        if (two_sided_on) {
+          list.set_pipeline(pipelines.get(two_sided));
+          list.add(mesh, model);
+        } else if (level > 0U) {
+          gfx::MeshLod const& lod = mesh.lod(level);
+          list.add(mesh, std::span<glm::mat4 const>(&model, 1), gfx::IndexRange{lod.first_index, lod.index_count});
+        } else {
+          clusters.cull(cam.view_proj(aspect), model, cam.eye(), ranges);
+          list.add(mesh, model, ranges);
+        }
+      }
+      (void)rd.draw_frame(ctx, window, sc, pl, list, cam, depth);
+    }
   }
 
-  mesh.shutdown(ctx);
+  running.store(false, std::memory_order_release);
+  sim.join();
+
+  mesh.shutdown(ctx, rd.submitted_frames());
   rd.shutdown(ctx);
+  geometry.shutdown(ctx);
+  textures.shutdown(ctx);
+  profiler.shutdown(ctx);
+  scene.shutdown(ctx);
+  pipelines.shutdown(ctx);
   pl.shutdown(ctx);
   depth.shutdown(ctx);
   sc.shutdown(ctx);
   ctx.shutdown();
+  jobs.shutdown();
 
   glfwDestroyWindow(window);
   glfwTerminate();
@@ -1,5 +1,7 @@
 #include "math/Camera.h"
 
+#include <cmath>
+
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace math {
@@ -17,13 +19,21 @@ void Camera::set_look_at(glm::vec3 eye, glm::vec3 center, glm::vec3 up) {
 }
 
 glm::mat4 Camera::mvp(float aspect, glm::mat4 const& model) const {
+  return view_proj(aspect) * model;
+}
+
+glm::mat4 Camera::view_proj(float aspect) const {
   glm::mat4 const view = glm::lookAt(eye_, center_, up_);
   glm::mat4 proj = glm::perspective(fovy_, aspect, near_z_, far_z_);
 
   // Vulkan NDC: Y inverted compared to OpenGL conventions used by glm::perspective.
   proj[1][1] *= -1.0f;
 
-  return proj * view * model;
+  return proj * view;
+}
+
+float Camera::projection_scale(float viewport_height) const {
+  return viewport_height / (2.0f * std::tan(0.5f * fovy_));
 }
 
 } // namespace math
@@ -2,6 +2,8 @@
 
 #include <glm/glm.hpp>
 
+#include "math/Frustum.h"
+
 namespace math {
 
 class Camera {
@@ -13,6 +15,14 @@ public:
 
   // Vulkan clip space adjustment included (proj[1][1] *= -1).
   glm::mat4 mvp(float aspect, glm::mat4 const& model) const;
+  glm::mat4 view_proj(float aspect) const;
+  Frustum frustum(float aspect) const { return Frustum::from_view_proj(view_proj(aspect)); }
+
+  glm::vec3 const& eye() const { return eye_; }
+
+  // Pixels per world unit at distance 1 along the view axis, for a viewport
+  // `viewport_height` pixels tall. Scales object-space errors to screen space.
+  float projection_scale(float viewport_height) const;
 
 private:
   float fovy_ = 1.0f;
@@ -0,0 +1,293 @@
+#include "math/Cull.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The widest instruction set the compiler targets; ENABLE_AVX2 in CMake turns on
+// the AVX2 path. Everything else (and each batch's tail) uses Frustum's scalar
+// tests, which the vector paths reproduce operation for operation.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MATH_CULL_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MATH_CULL_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MATH_CULL_NEON 1
+#endif
+
+namespace math {
+
+namespace {
+
+#if defined(MATH_CULL_AVX2)
+
+constexpr std::size_t kLanes = 8;
+using V = __m256;
+using M = __m256;
+
+V load(float const* p) { return _mm256_loadu_ps(p); }
+V splat(float v) { return _mm256_set1_ps(v); }
+V add(V a, V b) { return _mm256_add_ps(a, b); }
+V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+V neg(V a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+M none() { return _mm256_setzero_ps(); }
+M less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+M either(M a, M b) { return _mm256_or_ps(a, b); }
+std::uint32_t lane_bits(M m) { return static_cast<std::uint32_t>(_mm256_movemask_ps(m)); }
+
+#elif defined(MATH_CULL_SSE2)
+
+constexpr std::size_t kLanes = 4;
+using V = __m128;
+using M = __m128;
+
+V load(float const* p) { return _mm_loadu_ps(p); }
+V splat(float v) { return _mm_set1_ps(v); }
+V add(V a, V b) { return _mm_add_ps(a, b); }
+V mul(V a, V b) { return _mm_mul_ps(a, b); }
+V neg(V a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+M none() { return _mm_setzero_ps(); }
+M less(V a, V b) { return _mm_cmplt_ps(a, b); }
+M either(M a, M b) { return _mm_or_ps(a, b); }
+std::uint32_t lane_bits(M m) { return static_cast<std::uint32_t>(_mm_movemask_ps(m)); }
+
+#elif defined(MATH_CULL_NEON)
+
+constexpr std::size_t kLanes = 4;
+using V = float32x4_t;
+using M = uint32x4_t;
+
+V load(float const* p) { return vld1q_f32(p); }
+V splat(float v) { return vdupq_n_f32(v); }
+V add(V a, V b) { return vaddq_f32(a, b); }
+V mul(V a, V b) { return vmulq_f32(a, b); }
+V neg(V a) { return vnegq_f32(a); }
+M none() { return vdupq_n_u32(0U); }
+M less(V a, V b) { return vcltq_f32(a, b); }
+M either(M a, M b) { return vorrq_u32(a, b); }
+std::uint32_t lane_bits(M m) {
+  uint32x4_t const weights = {1U, 2U, 4U, 8U};
+  return vaddvq_u32(vandq_u32(m, weights));
+}
+
+#endif
+
+#if defined(MATH_CULL_AVX2) || defined(MATH_CULL_SSE2) || defined(MATH_CULL_NEON)
+#define MATH_CULL_SIMD 1
+
+static_assert(64U % kLanes == 0U, "a lane block must not straddle mask words");
+
+constexpr std::uint32_t kLaneMask = (1U << kLanes) - 1U;
+
+struct PlanesV {
+  V x[6];
+  V y[6];
+  V z[6];
+  V w[6];
+  V ax[6]; // |x|, |y|, |z| for the box test
+  V ay[6];
+  V az[6];
+
+  explicit PlanesV(Frustum const& f) {
+    for (int p = 0; p < 6; ++p) {
+      x[p] = splat(f.planes[p].x);
+      y[p] = splat(f.planes[p].y);
+      z[p] = splat(f.planes[p].z);
+      w[p] = splat(f.planes[p].w);
+      ax[p] = splat(std::fabs(f.planes[p].x));
+      ay[p] = splat(std::fabs(f.planes[p].y));
+      az[p] = splat(std::fabs(f.planes[p].z));
+    }
+  }
+
+  V distance(int p, V cx, V cy, V cz) const {
+    return add(add(add(mul(x[p], cx), mul(y[p], cy)), mul(z[p], cz)), w[p]);
+  }
+};
+
+// Returns how many leading objects were tested (a multiple of kLanes).
+std::size_t cull_spheres_simd(Frustum const& f, SphereSoA const& s, std::uint64_t* out) {
+  PlanesV const planes(f);
+  std::size_t const n = s.size() - s.size() % kLanes;
+
+  for (std::size_t i = 0; i < n; i += kLanes) {
+    V const cx = load(s.x.data() + i);
+    V const cy = load(s.y.data() + i);
+    V const cz = load(s.z.data() + i);
+    V const neg_r = neg(load(s.r.data() + i));
+
+    M outside = none();
+    for (int p = 0; p < 6; ++p) {
+      outside = either(outside, less(planes.distance(p, cx, cy, cz), neg_r));
+    }
+
+    std::uint64_t const bits = ~lane_bits(outside) & kLaneMask;
+    out[i / 64U] |= bits << (i % 64U);
+  }
+  return n;
+}
+
+std::size_t cull_aabbs_simd(Frustum const& f, AabbSoA const& b, std::uint64_t* out) {
+  PlanesV const planes(f);
+  std::size_t const n = b.size() - b.size() % kLanes;
+
+  for (std::size_t i = 0; i < n; i += kLanes) {
+    V const cx = load(b.cx.data() + i);
+    V const cy = load(b.cy.data() + i);
+    V const cz = load(b.cz.data() + i);
+    V const ex = load(b.ex.data() + i);
+    V const ey = load(b.ey.data() + i);
+    V const ez = load(b.ez.data() + i);
+
+    M outside = none();
+    for (int p = 0; p < 6; ++p) {
+      V const r = add(add(mul(planes.ax[p], ex), mul(planes.ay[p], ey)), mul(planes.az[p], ez));
+      outside = either(outside, less(planes.distance(p, cx, cy, cz), neg(r)));
+    }
+
+    std::uint64_t const bits = ~lane_bits(outside) & kLaneMask;
+    out[i / 64U] |= bits << (i % 64U);
+  }
+  return n;
+}
+
+#endif
+
+void reset_mask(std::vector<std::uint64_t>& visible, std::size_t count) {
+  visible.assign((count + 63U) / 64U, 0U);
+}
+
+} // namespace
+
+void SphereSoA::clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  r.clear();
+}
+
+void SphereSoA::reserve(std::size_t n) {
+  x.reserve(n);
+  y.reserve(n);
+  z.reserve(n);
+  r.reserve(n);
+}
+
+void SphereSoA::push_back(glm::vec3 const& center, float radius) {
+  x.push_back(center.x);
+  y.push_back(center.y);
+  z.push_back(center.z);
+  r.push_back(radius);
+}
+
+void AabbSoA::clear() {
+  cx.clear();
+  cy.clear();
+  cz.clear();
+  ex.clear();
+  ey.clear();
+  ez.clear();
+}
+
+void AabbSoA::reserve(std::size_t n) {
+  cx.reserve(n);
+  cy.reserve(n);
+  cz.reserve(n);
+  ex.reserve(n);
+  ey.reserve(n);
+  ez.reserve(n);
+}
+
+void AabbSoA::push_back(glm::vec3 const& min, glm::vec3 const& max) {
+  cx.push_back(0.5f * (min.x + max.x));
+  cy.push_back(0.5f * (min.y + max.y));
+  cz.push_back(0.5f * (min.z + max.z));
+  ex.push_back(0.5f * (max.x - min.x));
+  ey.push_back(0.5f * (max.y - min.y));
+  ez.push_back(0.5f * (max.z - min.z));
+}
+
+void cull_spheres(Frustum const& frustum, SphereSoA const& spheres, std::vector<std::uint64_t>& visible) {
+  std::size_t const n = spheres.size();
+  reset_mask(visible, n);
+
+  std::size_t i = 0;
+#if defined(MATH_CULL_SIMD)
+  i = cull_spheres_simd(frustum, spheres, visible.data());
+#endif
+  for (; i < n; ++i) {
+    glm::vec3 const c(spheres.x[i], spheres.y[i], spheres.z[i]);
+    if (frustum.intersects_sphere(c, spheres.r[i])) {
+      visible[i / 64U] |= std::uint64_t{1} << (i % 64U);
+    }
+  }
+}
+
+void cull_aabbs(Frustum const& frustum, AabbSoA const& boxes, std::vector<std::uint64_t>& visible) {
+  std::size_t const n = boxes.size();
+  reset_mask(visible, n);
+
+  std::size_t i = 0;
+#if defined(MATH_CULL_SIMD)
+  i = cull_aabbs_simd(frustum, boxes, visible.data());
+#endif
+  for (; i < n; ++i) {
+    glm::vec3 const c(boxes.cx[i], boxes.cy[i], boxes.cz[i]);
+    glm::vec3 const e(boxes.ex[i], boxes.ey[i], boxes.ez[i]);
+    if (frustum.intersects_aabb(c, e)) {
+      visible[i / 64U] |= std::uint64_t{1} << (i % 64U);
+    }
+  }
+}
+
+char const* cull_simd_path() {
+#if defined(MATH_CULL_AVX2)
+  return "avx2";
+#elif defined(MATH_CULL_SSE2)
+  return "sse2";
+#elif defined(MATH_CULL_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+void transform_aabb(glm::mat4 const& m,
+                    glm::vec3 const& min,
+                    glm::vec3 const& max,
+                    glm::vec3& out_min,
+                    glm::vec3& out_max) {
+  glm::vec3 const center = 0.5f * (min + max);
+  glm::vec3 const extent = 0.5f * (max - min);
+
+  glm::vec3 c(m[3][0], m[3][1], m[3][2]);
+  glm::vec3 e(0.0f);
+  for (int col = 0; col < 3; ++col) {
+    for (int row = 0; row < 3; ++row) {
+      c[row] += m[col][row] * center[col];
+      e[row] += std::fabs(m[col][row]) * extent[col];
+    }
+  }
+
+  out_min = c - e;
+  out_max = c + e;
+}
+
+float transform_sphere(glm::mat4 const& m, glm::vec3 const& center, float radius, glm::vec3& out_center) {
+  glm::vec4 const c = m * glm::vec4(center, 1.0f);
+  out_center = glm::vec3(c.x, c.y, c.z);
+
+  float scale2 = 0.0f;
+  for (int col = 0; col < 3; ++col) {
+    glm::vec3 const axis(m[col][0], m[col][1], m[col][2]);
+    scale2 = std::max(scale2, axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+  }
+  return radius * std::sqrt(scale2);
+}
+
+} // namespace math
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "math/Frustum.h"
+
+namespace math {
+
+// Bounding volumes in structure-of-arrays form so the batch tests below load
+// several objects per register. Index i is the same object in every array.
+struct SphereSoA {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> r;
+
+  std::size_t size() const { return r.size(); }
+  void clear();
+  void reserve(std::size_t n);
+  void push_back(glm::vec3 const& center, float radius);
+};
+
+// Center / half-extent form: the plane test needs |n| . extent, not min and max.
+struct AabbSoA {
+  std::vector<float> cx;
+  std::vector<float> cy;
+  std::vector<float> cz;
+  std::vector<float> ex;
+  std::vector<float> ey;
+  std::vector<float> ez;
+
+  std::size_t size() const { return ex.size(); }
+  void clear();
+  void reserve(std::size_t n);
+  void push_back(glm::vec3 const& min, glm::vec3 const& max);
+};
+
+// Batch frustum tests. Bit (i % 64) of word (i / 64) is set when object i may be
+// visible; `visible` is resized to cover every object and unused bits are zero.
+// Results match Frustum::intersects_sphere / intersects_aabb exactly.
+void cull_spheres(Frustum const& frustum, SphereSoA const& spheres, std::vector<std::uint64_t>& visible);
+void cull_aabbs(Frustum const& frustum, AabbSoA const& boxes, std::vector<std::uint64_t>& visible);
+
+inline bool is_visible(std::span<std::uint64_t const> visible, std::size_t i) {
+  return ((visible[i / 64U] >> (i % 64U)) & 1U) != 0U;
+}
+
+// SIMD path the batch tests were compiled for: "avx2", "sse2", "neon" or "scalar".
+char const* cull_simd_path();
+
+// Bounds of an object-space box or sphere under `m`, for filling the arrays above
+// with world-space volumes. The box stays axis-aligned (Arvo), the sphere radius
+// scales by the largest axis.
+void transform_aabb(glm::mat4 const& m,
+                    glm::vec3 const& min,
+                    glm::vec3 const& max,
+                    glm::vec3& out_min,
+                    glm::vec3& out_max);
+float transform_sphere(glm::mat4 const& m, glm::vec3 const& center, float radius, glm::vec3& out_center);
+
+} // namespace math
@@ -0,0 +1,56 @@
+#include "math/Frustum.h"
+
+#include <cmath>
+
+namespace math {
+
+namespace {
+
+glm::vec4 row(glm::mat4 const& m, int r) {
+  return glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+}
+
+glm::vec4 normalize_plane(glm::vec4 p) {
+  float const len = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+  return (len > 0.0f) ? glm::vec4(p.x / len, p.y / len, p.z / len, p.w / len) : p;
+}
+
+} // namespace
+
+Frustum Frustum::from_view_proj(glm::mat4 const& view_proj) {
+  glm::vec4 const r0 = row(view_proj, 0);
+  glm::vec4 const r1 = row(view_proj, 1);
+  glm::vec4 const r2 = row(view_proj, 2);
+  glm::vec4 const r3 = row(view_proj, 3);
+
+  Frustum f{};
+  f.planes[0] = normalize_plane(r3 + r0);
+  f.planes[1] = normalize_plane(r3 - r0);
+  f.planes[2] = normalize_plane(r3 + r1);
+  f.planes[3] = normalize_plane(r3 - r1);
+  f.planes[4] = normalize_plane(r3 + r2);
+  f.planes[5] = normalize_plane(r3 - r2);
+  return f;
+}
+
+bool Frustum::intersects_sphere(glm::vec3 const& center, float radius) const {
+  for (glm::vec4 const& p : planes) {
+    if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Frustum::intersects_aabb(glm::vec3 const& center, glm::vec3 const& extent) const {
+  // Outside when even the corner furthest along the plane normal is behind it.
+  for (glm::vec4 const& p : planes) {
+    float const r = std::fabs(p.x) * extent.x + std::fabs(p.y) * extent.y + std::fabs(p.z) * extent.z;
+    if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -r) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace math
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace math {
+
+// Six inward-facing planes (xyz = unit normal, w = distance), so a point p is
+// inside when dot(n, p) + w >= 0 for all of them. Order: left, right, bottom,
+// top, near, far.
+struct Frustum {
+  glm::vec4 planes[6];
+
+  // Gribb/Hartmann extraction from a view-projection matrix. The near plane is
+  // taken as z >= -w, which is exact for GL-style depth and conservative for
+  // Vulkan's [0, 1].
+  static Frustum from_view_proj(glm::mat4 const& view_proj);
+
+  bool intersects_sphere(glm::vec3 const& center, float radius) const;
+  bool intersects_aabb(glm::vec3 const& center, glm::vec3 const& extent) const; // extent = half size
+};
+
+} // namespace math
@@ -0,0 +1,46 @@
+// meshcook: OBJ -> binary mesh cache (see assets/MeshCache.h).
+//
+//   meshcook <input.obj> <output.mesh> [threads]
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+#include "assets/MeshCache.h"
+#include "assets/MeshOptimize.h"
+#include "assets/MeshSimplify.h"
+#include "assets/ObjLoader.h"
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 4) {
+    std::fprintf(stderr, "usage: %s <input.obj> <output.mesh> [threads]\n", (argc > 0) ? argv[0] : "meshcook");
+    return EXIT_FAILURE;
+  }
+
+  std::string const input = argv[1];
+  std::string const output = argv[2];
+  unsigned const threads = (argc == 4) ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 0U;
+
+  try {
+    assets::SourceStamp const stamp = assets::MeshCache::stamp(input);
+    assets::ObjIndexedMesh mesh = assets::ObjLoader::load_parallel(input, threads);
+    assets::MeshOptimizeStats const opt = assets::optimize_mesh(mesh);
+    assets::build_lods(mesh);
+    assets::MeshCache::write(output, mesh, stamp);
+
+    std::printf("%s: %zu vertices, %zu indices, ACMR %.3f -> %.3f -> %s\n",
+                input.c_str(), mesh.vertices.size(), mesh.indices.size(),
+                opt.acmr_before, opt.acmr_after, output.c_str());
+    for (std::size_t l = 0; l < mesh.lods.size(); ++l) {
+      std::printf("  LOD %zu: %u triangles, error %.5f\n",
+                  l, mesh.lods[l].index_count / 3U, static_cast<double>(mesh.lods[l].error));
+    }
+  } catch (std::exception const& e) {
+    std::fprintf(stderr, "meshcook failed: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+// texcook: TGA / binary PPM -> cooked RGBA8 texture with a full mip chain (see
+// assets/TextureCache.h). BC7 / ASTC data comes from an external encoder.
+//
+//   texcook <input.tga|input.ppm> <output.tex> [--linear]
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assets/MappedFile.h"
+#include "assets/TextureCache.h"
+
+namespace {
+
+struct Image {
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  std::vector<unsigned char> rgba;
+};
+
+[[noreturn]] void fail(std::string const& msg) {
+  throw std::runtime_error(msg);
+}
+
+bool ends_with(std::string const& s, char const* suffix) {
+  std::size_t const n = std::strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// Uncompressed (type 2) and RLE (type 10) true-color, 24 or 32 bits.
+Image load_tga(assets::MappedFile const& file) {
+  auto const* p = reinterpret_cast<unsigned char const*>(file.data());
+  std::size_t const size = file.size();
+  if (size < 18U) {
+    fail("TGA: truncated header");
+  }
+
+  std::size_t const id_length = p[0];
+  unsigned const color_map = p[1];
+  unsigned const type = p[2];
+  Image img{};
+  img.width = static_cast<std::uint32_t>(p[12] | (p[13] << 8));
+  img.height = static_cast<std::uint32_t>(p[14] | (p[15] << 8));
+  unsigned const bpp = p[16];
+  bool const top_down = (p[17] & 0x20U) != 0U;
+
+  if (color_map != 0U || (type != 2U && type != 10U) || (bpp != 24U && bpp != 32U)) {
+    fail("TGA: only 24/32-bit true-color images are supported");
+  }
+  if (img.width == 0U || img.height == 0U) {
+    fail("TGA: empty image");
+  }
+
+  std::size_t const bytes = bpp / 8U;
+  std::size_t const count = std::size_t{img.width} * img.height;
+  img.rgba.resize(count * 4U);
+
+  std::size_t at = 18U + id_length;
+  auto const read_pixel = [&](std::size_t i) {
+    if (at + bytes > size) {
+      fail("TGA: truncated pixel data");
+    }
+    unsigned char* q = &img.rgba[i * 4U];
+    q[0] = p[at + 2U]; // stored BGR(A)
+    q[1] = p[at + 1U];
+    q[2] = p[at];
+    q[3] = (bytes == 4U) ? p[at + 3U] : 255U;
+  };
+
+  std::size_t i = 0;
+  while (i < count) {
+    if (type == 2U) {
+      read_pixel(i++);
+      at += bytes;
+      continue;
+    }
+
+    if (at >= size) {
+      fail("TGA: truncated packet");
+    }
+    unsigned const header = p[at++];
+    std::size_t const run = std::min<std::size_t>((header & 0x7FU) + 1U, count - i);
+    if ((header & 0x80U) != 0U) {
+      read_pixel(i);
+      at += bytes;
+      for (std::size_t k = 1; k < run; ++k) {
+        std::memcpy(&img.rgba[(i + k) * 4U], &img.rgba[i * 4U], 4U);
+      }
+    } else {
+      for (std::size_t k = 0; k < run; ++k) {
+        read_pixel(i + k);
+        at += bytes;
+      }
+    }
+    i += run;
+  }
+
+  if (!top_down) {
+    // Textures are sampled with v = 0 at the first row.
+    std::size_t const row = std::size_t{img.width} * 4U;
+    for (std::uint32_t y = 0; y < img.height / 2U; ++y) {
+      std::swap_ranges(img.rgba.begin() + static_cast<std::ptrdiff_t>(y * row),
+                       img.rgba.begin() + static_cast<std::ptrdiff_t>((y + 1U) * row),
+                       img.rgba.begin() + static_cast<std::ptrdiff_t>((img.height - 1U - y) * row));
+    }
+  }
+  return img;
+}
+
+// P6 with maxval 255.
+Image load_ppm(assets::MappedFile const& file) {
+  char const* p = file.data();
+  std::size_t const size = file.size();
+  std::size_t at = 0;
+
+  auto const next_value = [&]() {
+    // Whitespace and # comments separate header fields.
+    while (at < size && (std::strchr(" \t\r\n", p[at]) != nullptr || p[at] == '#')) {
+      if (p[at] == '#') {
+        while (at < size && p[at] != '\n') {
+          ++at;
+        }
+      } else {
+        ++at;
+      }
+    }
+    unsigned long v = 0;
+    std::size_t const begin = at;
+    while (at < size && p[at] >= '0' && p[at] <= '9' && v < 1000000UL) {
+      v = v * 10U + static_cast<unsigned long>(p[at++] - '0');
+    }
+    if (at == begin) {
+      fail("PPM: malformed header");
+    }
+    return v;
+  };
+
+  if (size < 2U || p[0] != 'P' || p[1] != '6') {
+    fail("PPM: only binary P6 is supported");
+  }
+  at = 2;
+
+  Image img{};
+  img.width = static_cast<std::uint32_t>(next_value());
+  img.height = static_cast<std::uint32_t>(next_value());
+  if (next_value() != 255UL) {
+    fail("PPM: only maxval 255 is supported");
+  }
+  ++at; // single whitespace before the raster
+
+  std::size_t const count = std::size_t{img.width} * img.height;
+  if (count == 0U || at > size || count * 3U > size - at) {
+    fail("PPM: truncated pixel data");
+  }
+
+  img.rgba.resize(count * 4U);
+  for (std::size_t i = 0; i < count; ++i) {
+    img.rgba[i * 4U] = static_cast<unsigned char>(p[at + i * 3U]);
+    img.rgba[i * 4U + 1U] = static_cast<unsigned char>(p[at + i * 3U + 1U]);
+    img.rgba[i * 4U + 2U] = static_cast<unsigned char>(p[at + i * 3U + 2U]);
+    img.rgba[i * 4U + 3U] = 255U;
+  }
+  return img;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  bool const linear = (argc == 4) && std::strcmp(argv[3], "--linear") == 0;
+  if (argc < 3 || argc > 4 || (argc == 4 && !linear)) {
+    std::fprintf(stderr, "usage: %s <input.tga|input.ppm> <output.tex> [--linear]\n", (argc > 0) ? argv[0] : "texcook");
+    return EXIT_FAILURE;
+  }
+
+  std::string const input = argv[1];
+  std::string const output = argv[2];
+
+  try {
+    assets::MappedFile file{};
+    file.open(input);
+
+    Image const img = (ends_with(input, ".ppm") || ends_with(input, ".PPM")) ? load_ppm(file) : load_tga(file);
+    assets::TextureFormat const format = linear ? assets::TextureFormat::RGBA8_UNORM : assets::TextureFormat::RGBA8_SRGB;
+    assets::TextureData const tex = assets::build_mips_rgba8(img.width, img.height, img.rgba, format);
+    assets::TextureCache::write(output, tex);
+
+    std::printf("%s: %ux%u, %zu levels, %s -> %s\n",
+                input.c_str(), img.width, img.height, tex.levels.size(), linear ? "linear" : "sRGB", output.c_str());
+  } catch (std::exception const& e) {
+    std::fprintf(stderr, "texcook failed: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}